@@ -4,6 +4,7 @@
 #include <QtNetwork/qabstractsocket.h>
 #include <QCryptographicHash>
 #include <QtCore/qdir.h>
+#include <QtCore/qvector.h>
 
 #include <dzapp.h>
 #include <dzscene.h>
@@ -30,6 +31,7 @@
 
 #include "DzBlenderAction.h"
 #include "DzBlenderDialog.h"
+#include "DzBlenderTexturePipeline.h"
 #include "DzBridgeMorphSelectionDialog.h"
 #include "DzBridgeSubdivisionDialog.h"
 
@@ -146,7 +148,9 @@ bool DzBlenderUtils::PrepareAndRunBlenderProcessing(QString sDestinationFbx, QSt
 		"create_blend.py" <<
 		"blender_tools.py" <<
 		"NodeArrange.py" <<
-		"game_readiness_tools.py"
+		"game_readiness_tools.py" <<
+		"native_tools.py" <<
+		DZ_NATIVETOOLS_LIBRARY_NAME
 		);
 	// copy 
 	foreach(auto sScriptFilename, aScriptFilelist)
@@ -222,11 +226,18 @@ DzError	DzBlenderExporter::write(const QString& filename, const DzFileIOSettings
 	bool bGenerateUsd = false;
 	bool bGenerateFbx = false;
 	bool bEmbedTextures = false;
+	bool bOptimizeVertexCache = true;
+	bool bTransferSkinWeights = false;
+	bool bMorphSidecarFile = true;
 	LOAD_BOOL_FROM_OPTION(bRunSilent, "RunSilent", optionsMap);
 	LOAD_BOOL_FROM_OPTION(bGenerateGlb, "GenerateGlb", optionsMap);
 	LOAD_BOOL_FROM_OPTION(bGenerateUsd, "GenerateUsd", optionsMap);
 	LOAD_BOOL_FROM_OPTION(bGenerateFbx, "GenerateFbx", optionsMap);
 	LOAD_BOOL_FROM_OPTION(bEmbedTextures, "EmbedTextures", optionsMap);
+	LOAD_BOOL_FROM_OPTION(bOptimizeVertexCache, "OptimizeVertexCache", optionsMap);
+	LOAD_BOOL_FROM_OPTION(bTransferSkinWeights, "TransferSkinWeights", optionsMap);
+	// the FBX then has no blend shapes, only create_blend.py adds the morphs back from the sidecar file
+	LOAD_BOOL_FROM_OPTION(bMorphSidecarFile, "MorphSidecarFile", optionsMap);
 	LOAD_STRING_FROM_OPTION(sAssetType, "AssetType", optionsMap);
 	LOAD_STRING_FROM_OPTION(sRigConversion, "RigConversion", optionsMap);
 	// General Bridge options
@@ -263,11 +274,71 @@ DzError	DzBlenderExporter::write(const QString& filename, const DzFileIOSettings
 	LOAD_BOOL_FROM_OPTION(bMultiplyTextureValues, "MultiplyTextureValues", optionsMap);
 	LOAD_BOOL_FROM_OPTION(bRecompressIfFileSizeTooBig, "RecompressIfFileSizeTooBig", optionsMap);
 	LOAD_INT_FROM_OPTION(nFileSizeThresholdToInitiateRecompression, "FileSizeThresholdToInitiateRecompression", optionsMap);
+	bool bRecompressToFileSize = false;
+	LOAD_BOOL_FROM_OPTION(bRecompressToFileSize, "RecompressToFileSize", optionsMap);
 	LOAD_BOOL_FROM_OPTION(bForceReEncoding, "ForceReEncoding", optionsMap);
 	LOAD_BOOL_FROM_OPTION(bBakeMakeupOverlay, "BakeMakeupOverlay", optionsMap);
 	LOAD_BOOL_FROM_OPTION(bBakeTranslucency, "BakeTranslucency", optionsMap);
 	LOAD_BOOL_FROM_OPTION(bBakeSpecularToMetallic, "BakeSpecularToMetallic", optionsMap);
 	LOAD_BOOL_FROM_OPTION(bBakeRefractionWeight, "BakeRefractionWeight", optionsMap);
+	// Texture cache options
+	bool bUseTextureCache = true;
+	QString sTextureCachePath = "";
+	int nTextureCacheSize = 4096; // size in MB
+	int nTextureMemoryBudget = 0; // size in MB, 0 = half of the available memory
+	LOAD_BOOL_FROM_OPTION(bUseTextureCache, "UseTextureCache", optionsMap);
+	LOAD_STRING_FROM_OPTION(sTextureCachePath, "TextureCachePath", optionsMap);
+	LOAD_INT_FROM_OPTION(nTextureCacheSize, "TextureCacheSize", optionsMap);
+	LOAD_INT_FROM_OPTION(nTextureMemoryBudget, "TextureMemoryBudget", optionsMap);
+	bool bDeduplicateTextures = true;
+	int nPngCompressionLevel = 6; // 0 = fastest, 9 = smallest
+	bool bPackOrmTextures = false;
+	bool bWriteCompressedTextures = false;
+	LOAD_BOOL_FROM_OPTION(bDeduplicateTextures, "DeduplicateTextures", optionsMap);
+	LOAD_BOOL_FROM_OPTION(bPackOrmTextures, "PackOrmTextures", optionsMap);
+	LOAD_BOOL_FROM_OPTION(bWriteCompressedTextures, "CompressedTextures", optionsMap);
+	bool bCollapseConstantTextures = false;
+	LOAD_BOOL_FROM_OPTION(bCollapseConstantTextures, "CollapseConstantTextures", optionsMap);
+	bool bAutoTextureSize = false;
+	int nTargetTexelDensity = 1024; // texels per meter
+	int nAutoTextureBudget = 0; // size in MB, 0 = no limit
+	LOAD_BOOL_FROM_OPTION(bAutoTextureSize, "AutoTextureSize", optionsMap);
+	LOAD_INT_FROM_OPTION(nTargetTexelDensity, "TargetTexelDensity", optionsMap);
+	LOAD_INT_FROM_OPTION(nAutoTextureBudget, "AutoTextureBudget", optionsMap);
+	// comma separated longest edges, ex: "2048,1024,512"
+	QList<int> aTexturePyramidSizes;
+	if (optionsMap.contains("TexturePyramidSizes")) {
+		foreach(QString sSize, optionsMap["TexturePyramidSizes"].split(",", QString::SkipEmptyParts)) {
+			int nSize = sSize.trimmed().toInt();
+			if (nSize > 0 && aTexturePyramidSizes.contains(nSize) == false) {
+				aTexturePyramidSizes.append(nSize);
+			}
+		}
+	}
+	LOAD_INT_FROM_OPTION(nPngCompressionLevel, "PngCompressionLevel", optionsMap);
+	// ex: "0.01", influences below this weight are removed
+	double fSkinWeightThreshold = 0.0;
+	if (optionsMap.contains("SkinWeightThreshold")) {
+		fSkinWeightThreshold = optionsMap["SkinWeightThreshold"].toDouble();
+	}
+	int nMaxBoneInfluences = 0; // 4 or 8, 0 = no limit
+	int nSkinWeightQuantization = 0; // 8 or 16 bits, 0 = off
+	LOAD_INT_FROM_OPTION(nMaxBoneInfluences, "MaxBoneInfluences", optionsMap);
+	LOAD_INT_FROM_OPTION(nSkinWeightQuantization, "SkinWeightQuantization", optionsMap);
+	int nMorphQuantization = 0; // 8 or 16 bits, 0 = float deltas
+	LOAD_INT_FROM_OPTION(nMorphQuantization, "MorphQuantization", optionsMap);
+	// comma separated triangle ratios of the LODs, ex: "0.5,0.25,0.125"
+	QList<double> aLodRatios;
+	if (optionsMap.contains("LodRatios")) {
+		foreach(QString sRatio, optionsMap["LodRatios"].split(",", QString::SkipEmptyParts)) {
+			double fRatio = sRatio.trimmed().toDouble();
+			if (fRatio > 0.0 && fRatio < 1.0 && aLodRatios.contains(fRatio) == false) {
+				aLodRatios.append(fRatio);
+			}
+		}
+		// the LODs are generated largest first
+		qSort(aLodRatios.begin(), aLodRatios.end(), qGreater<double>());
+	}
 
 	if (dzScene->getPrimarySelection() == NULL)
 	{
@@ -300,19 +371,68 @@ DzError	DzBlenderExporter::write(const QString& filename, const DzFileIOSettings
 		pBlenderAction->m_bGenerateFinalFbx = bGenerateFbx;
 		pBlenderAction->m_bGenerateFinalUsd = bGenerateUsd;
 		pBlenderAction->m_bEmbedTexturesInOutputFile = bEmbedTextures;
+		pBlenderAction->m_bOptimizeVertexCache = bOptimizeVertexCache;
+		pBlenderAction->m_bTransferSkinWeights = bTransferSkinWeights;
+		pBlenderAction->m_fSkinWeightThreshold = qBound(0.0, fSkinWeightThreshold, 1.0);
+		pBlenderAction->m_nMaxSkinInfluences = qMax(0, nMaxBoneInfluences);
+		if (nSkinWeightQuantization == 8 || nSkinWeightQuantization == 16) {
+			pBlenderAction->m_nSkinWeightQuantizationBits = nSkinWeightQuantization;
+		}
+		pBlenderAction->m_bMorphSidecarFile = bMorphSidecarFile;
+		if (nMorphQuantization == 8 || nMorphQuantization == 16) {
+			pBlenderAction->m_nMorphQuantizationBits = nMorphQuantization;
+		}
+		pBlenderAction->m_aLodRatios = aLodRatios;
 		//// General Bridge Options
 		pBlenderAction->setConvertToPng(bConvertToPng);
 		pBlenderAction->setConvertToJpg(bConvertToJpg);
 		pBlenderAction->setExportAllTextures(bExportAllTextures);
 		pBlenderAction->setExportAllTextures(bExportAllTextures);
-		pBlenderAction->setCombineDiffuseAndAlphaMaps(bCombineDiffuseAndAlphaMaps);
-		pBlenderAction->setResizeTextures(bResizeTextures);
-		// qTargetTextureSize
-		pBlenderAction->setTargetTexturesSize(qTargetTextureSize);
-		pBlenderAction->setMultiplyTextureValues(bMultiplyTextureValues);
-		pBlenderAction->setRecompressIfFileSizeTooBig(bRecompressIfFileSizeTooBig);
-		pBlenderAction->setFileSizeThresholdToInitiateRecompression(nFileSizeThresholdToInitiateRecompression);
-		pBlenderAction->setForceReEncoding(bForceReEncoding);
+		pBlenderAction->m_pTexturePipeline->getSettings().bDeduplicateTextures = bDeduplicateTextures;
+		pBlenderAction->m_pTexturePipeline->getSettings().bPackOrmTextures = bPackOrmTextures;
+		pBlenderAction->m_pTexturePipeline->getSettings().bWriteCompressedTextures = bWriteCompressedTextures;
+		pBlenderAction->m_pTexturePipeline->getSettings().bCollapseConstantTextures = bCollapseConstantTextures;
+		pBlenderAction->m_pTexturePipeline->getSettings().bAutoTextureSize = bAutoTextureSize;
+		pBlenderAction->m_pTexturePipeline->getSettings().fTargetTexelDensity = qMax(1, nTargetTexelDensity);
+		pBlenderAction->m_pTexturePipeline->getSettings().nAutoTextureBudgetMB = qMax(0, nAutoTextureBudget);
+		pBlenderAction->m_pTexturePipeline->getSettings().aTexturePyramidSizes = aTexturePyramidSizes;
+		// the memory budget and PNG encoder also apply to the ORM, pyramid, DDS and statistics jobs without the cache
+		DzBlenderTextureSettings& textureSettings = pBlenderAction->m_pTexturePipeline->getSettings();
+		textureSettings.bUseTextureCache = bUseTextureCache;
+		textureSettings.nTextureMemoryBudgetMB = nTextureMemoryBudget;
+		textureSettings.nPngCompressionLevel = qBound(0, nPngCompressionLevel, 9);
+		if (bUseTextureCache) {
+			// Texture transforms are done by the Blender texture pipeline, so that results can be cached across exports
+			textureSettings.bCombineDiffuseAndAlphaMaps = bCombineDiffuseAndAlphaMaps;
+			textureSettings.bMultiplyTextureValues = bMultiplyTextureValues;
+			textureSettings.sTextureCachePath = sTextureCachePath;
+			textureSettings.nTextureCacheSizeMB = nTextureCacheSize;
+			textureSettings.bConvertToPng = bConvertToPng;
+			textureSettings.bConvertToJpg = bConvertToJpg;
+			textureSettings.bResizeTextures = bResizeTextures;
+			textureSettings.qTargetTextureSize = qTargetTextureSize;
+			textureSettings.bRecompressIfFileSizeTooBig = bRecompressIfFileSizeTooBig;
+			textureSettings.nFileSizeThresholdToInitiateRecompression = nFileSizeThresholdToInitiateRecompression;
+			textureSettings.bRecompressToFileSize = bRecompressToFileSize;
+			textureSettings.bForceReEncoding = bForceReEncoding;
+			pBlenderAction->setCombineDiffuseAndAlphaMaps(false);
+			pBlenderAction->setMultiplyTextureValues(false);
+			pBlenderAction->setConvertToPng(false);
+			pBlenderAction->setConvertToJpg(false);
+			pBlenderAction->setResizeTextures(false);
+			pBlenderAction->setRecompressIfFileSizeTooBig(false);
+			pBlenderAction->setForceReEncoding(false);
+		}
+		else {
+			pBlenderAction->setCombineDiffuseAndAlphaMaps(bCombineDiffuseAndAlphaMaps);
+			pBlenderAction->setMultiplyTextureValues(bMultiplyTextureValues);
+			pBlenderAction->setResizeTextures(bResizeTextures);
+			// qTargetTextureSize
+			pBlenderAction->setTargetTexturesSize(qTargetTextureSize);
+			pBlenderAction->setRecompressIfFileSizeTooBig(bRecompressIfFileSizeTooBig);
+			pBlenderAction->setFileSizeThresholdToInitiateRecompression(nFileSizeThresholdToInitiateRecompression);
+			pBlenderAction->setForceReEncoding(bForceReEncoding);
+		}
 		pBlenderAction->setBakeMakeupOverlay(bBakeMakeupOverlay);
 		pBlenderAction->setBakeTranslucency(bBakeTranslucency);
 		pBlenderAction->setBakeSpecularToMetallic(bBakeSpecularToMetallic);
@@ -361,7 +481,9 @@ DzError	DzBlenderExporter::write(const QString& filename, const DzFileIOSettings
 		"create_blend.py" <<
 		"blender_tools.py" <<
 		"NodeArrange.py" <<
-		"game_readiness_tools.py"
+		"game_readiness_tools.py" <<
+		"native_tools.py" <<
+		DZ_NATIVETOOLS_LIBRARY_NAME
 		);
 	// copy 
 	foreach(auto sScriptFilename, aScriptFilelist)
@@ -411,6 +533,11 @@ DzError	DzBlenderExporter::write(const QString& filename, const DzFileIOSettings
 	}
     thisProcess->deleteLater();
 
+	// Blender may finish (or fail) before the background texture jobs, so join them here
+	if (pBlenderAction->waitForTextureJobs() == false) {
+		dzApp->log("Daz To Blender: ERROR: one or more texture jobs failed, please check log files.");
+	}
+
 	exportProgress.step(25);
 
 	if (result)
@@ -690,6 +817,23 @@ DzBlenderAction::DzBlenderAction() :
 	m_aKnownIntermediateFileExtensionsList += "blend";
 	m_aKnownIntermediateFileExtensionsList += "blend1";
 
+	m_pTexturePipeline = new DzBlenderTexturePipeline();
+}
+
+DzBlenderAction::~DzBlenderAction()
+{
+	if (m_pTexturePipeline) {
+		delete m_pTexturePipeline;
+		m_pTexturePipeline = nullptr;
+	}
+}
+
+bool DzBlenderAction::waitForTextureJobs()
+{
+	if (m_pTexturePipeline == nullptr) {
+		return true;
+	}
+	return m_pTexturePipeline->waitForImageJobs(true);
 }
 
 bool DzBlenderAction::createUI()
@@ -928,6 +1072,13 @@ void DzBlenderAction::executeAction()
 			}
 		}
 
+		// DzExporter modes join the texture jobs after Blender is done, all other modes must finish them here
+		if (m_nNonInteractiveMode != DZ_BRIDGE_NAMESPACE::eNonInteractiveMode::DzExporterMode &&
+			m_nNonInteractiveMode != DZ_BRIDGE_NAMESPACE::eNonInteractiveMode::DzExporterModeRunSilent)
+		{
+			waitForTextureJobs();
+		}
+
 		exportProgress->update(10);
 		// DB 2021-09-02: messagebox "Export Complete"
 		if (m_nNonInteractiveMode == 0)
@@ -985,6 +1136,30 @@ void DzBlenderAction::writeConfiguration()
 	writer.addMember("Generate Final Glb", m_bGenerateFinalGlb);
 	writer.addMember("Generate Final Usd", m_bGenerateFinalUsd);
 	writer.addMember("Use MaterialX", m_bUseMaterialX);
+	// Texture jobs run in the background, Blender waits on this manifest before loading textures
+	QString sTextureJobsManifest = m_sDestinationPath + m_sExportFilename + "_texture_jobs.json";
+	m_pTexturePipeline->prepareManifest(sTextureJobsManifest, m_sDestinationPath + "ProcessedTextures");
+	writer.addMember("Texture Jobs Manifest", sTextureJobsManifest);
+	// the packed textures themselves are listed in the manifest
+	writer.addMember("Pack ORM Textures", m_pTexturePipeline->getSettings().bPackOrmTextures);
+	writer.addMember("Write Compressed Textures", m_pTexturePipeline->getSettings().bWriteCompressedTextures);
+	// constant maps are replaced through the manifest "Material Overrides", with their statistics in "Texture Statistics"
+	writer.addMember("Collapse Constant Textures", m_pTexturePipeline->getSettings().bCollapseConstantTextures);
+	// per texture sizes and the memory before and after are in the manifest "Texture Sizing"
+	writer.addMember("Auto Texture Size", m_pTexturePipeline->getSettings().bAutoTextureSize);
+	writer.addMember("Target Texel Density", m_pTexturePipeline->getSettings().fTargetTexelDensity);
+	writer.addMember("Auto Texture Budget MB", m_pTexturePipeline->getSettings().nAutoTextureBudgetMB);
+	writer.startMemberArray("Texture Pyramid Sizes", true);
+	foreach(int nSize, m_pTexturePipeline->getSettings().aTexturePyramidSizes) {
+		writer.addItem(nSize);
+	}
+	writer.finishArray();
+	// create_blend.py adds "<mesh>_LOD1".."_LODn" objects with these triangle ratios
+	writer.startMemberArray("LOD Ratios", true);
+	foreach(double fRatio, m_aLodRatios) {
+		writer.addItem(fRatio);
+	}
+	writer.finishArray();
 	pDtuProgress->step();
 
 	if (m_pSelectedNode->inherits("DzFigure")) {
@@ -1019,6 +1194,8 @@ void DzBlenderAction::writeConfiguration()
 			writeAllMaterials(m_pSelectedNode, writer, pCVSStream);
 			pDtuProgress->step();
 		}
+		// all image jobs are enqueued at this point, the texture stages start while the rest of the DTU is written
+		startTextureJobs();
 
 		writeAllMorphs(writer);
 		writeMorphLinks(writer);
@@ -1040,15 +1217,23 @@ void DzBlenderAction::writeConfiguration()
 		pDtuProgress->step();
 	}
 
-	m_ImageToolsJobsManager->processJobs();
-	m_ImageToolsJobsManager->clearJobs();
-
 	writer.finishObject();
 	DTUfile.close();
+	m_pTexturePipeline->finishDtu(DTUfilename);
 
 	pDtuProgress->finish();
 }
 
+// The ImageTools jobs are enqueued by the DzBridge material writer, so nothing can start before the FBX export and
+// postProcessFbx() are done.  ImageTools is not written for worker threads, its jobs still run here on the main thread;
+// with UseTextureCache (the default) the queue is empty, and the transforms run in the pipeline's background stages.
+void DzBlenderAction::startTextureJobs()
+{
+	m_ImageToolsJobsManager->processJobs();
+	m_ImageToolsJobsManager->clearJobs();
+	m_pTexturePipeline->startImageJobs();
+}
+
 // Setup custom FBX export options
 void DzBlenderAction::setExportOptions(DzFileIOSettings& ExportOptions)
 {
@@ -1219,38 +1404,32 @@ bool DzBlenderAction::readGui(DZ_BRIDGE_NAMESPACE::DzBridgeDialog* BridgeDialog)
 
 #include "FbxTools.h"
 #include "OpenFBXInterface.h"
+#include "DzMeshKernels.h"
+#include "DzMeshOptimizer.h"
+#include "DzWeightTransfer.h"
+#include "DzMorphDeltas.h"
+#include "DzBlenderFbxSceneIndex.h"
 
-void FixPrePostRotations(FbxNode* pNode)
+void FixPrePostRotations(const DzBlenderFbxSceneIndex& sceneIndex, int nNodeIndex)
 {
-	QString sNodeName = pNode->GetName();
-	for (int nChildIndex = 0; nChildIndex < pNode->GetChildCount(); nChildIndex++)
-	{
-		FbxNode* pChildBone = pNode->GetChild(nChildIndex);
-		FixPrePostRotations(pChildBone);
-	}
-	if (sNodeName.contains("twist", Qt::CaseInsensitive) == false)
+	// the node and all its descendants are one contiguous range of the index
+	for (int nIndex = nNodeIndex; nIndex < sceneIndex.getSubtreeEnd(nNodeIndex); nIndex++)
 	{
-		pNode->SetPreRotation(FbxNode::EPivotSet::eSourcePivot, FbxVector4(0, 0, 0));
-		pNode->SetPostRotation(FbxNode::EPivotSet::eSourcePivot, FbxVector4(0, 0, 0));
-	}
-}
-
-FbxNode* GetBone(FbxNode* pNode) {
-	for (int i = 0; i < pNode->GetChildCount(); i++) {
-		FbxNode* pChild = pNode->GetChild(i);
-		auto attribute = pChild->GetNodeAttribute();
-		if (attribute && attribute->GetAttributeType() == FbxNodeAttribute::eSkeleton) {
-			FbxSkeleton* pSkeleton = (FbxSkeleton*) attribute;
-			if (pSkeleton->GetSkeletonType() == FbxSkeleton::eLimbNode) {
-				return pChild;
-			}
+		if (sceneIndex.getName(nIndex).contains("twist", Qt::CaseInsensitive) == false)
+		{
+			FbxNode* pNode = sceneIndex.getNode(nIndex);
+			pNode->SetPreRotation(FbxNode::EPivotSet::eSourcePivot, FbxVector4(0, 0, 0));
+			pNode->SetPostRotation(FbxNode::EPivotSet::eSourcePivot, FbxVector4(0, 0, 0));
 		}
 	}
+}
 
-	return NULL;
+FbxNode* GetBone(const DzBlenderFbxSceneIndex& sceneIndex, int nNodeIndex) {
+	int nBone = sceneIndex.getFirstLimbChild(nNodeIndex);
+	return nBone < 0 ? NULL : sceneIndex.getNode(nBone);
 }
 
-FbxNode* GetMeshRootBone(FbxMesh* meshNode) {
+FbxNode* GetMeshRootBone(const DzBlenderFbxSceneIndex& sceneIndex, FbxMesh* meshNode) {
 	if (meshNode == nullptr) {
 		return nullptr;
 	}
@@ -1258,42 +1437,605 @@ FbxNode* GetMeshRootBone(FbxMesh* meshNode) {
 	// Iterate through the connected nodes
 	int connectionCount = meshNode->GetSrcObjectCount(FbxCriteria::ObjectType(FbxNode::ClassId));
 	for (int i = 0; i < connectionCount; ++i) {
-		FbxNode* connectedNode = (FbxNode*)meshNode->GetSrcObject(FbxCriteria::ObjectType(FbxNode::ClassId), i);
-
-		// Check if this node has a FbxSkeleton attribute
-		if (connectedNode && connectedNode->GetNodeAttribute()) {
-			FbxNodeAttribute* attribute = connectedNode->GetNodeAttribute();
-			if (attribute->GetAttributeType() == FbxNodeAttribute::eSkeleton) {
-//				FbxSkeleton* skeleton = (FbxSkeleton*)attribute;
-				return GetBone(connectedNode);
-			}
+		int nIndex = sceneIndex.indexOf((FbxNode*)meshNode->GetSrcObject(FbxCriteria::ObjectType(FbxNode::ClassId), i));
+		if (nIndex >= 0 && sceneIndex.getAttributeType(nIndex) == FbxNodeAttribute::eSkeleton) {
+			return GetBone(sceneIndex, nIndex);
 		}
 	}
 
 	return nullptr;  // No eLimbNode found
 }
 
-bool DzBlenderAction::postProcessFbx(QString fbxFilePath)
+// World space surface area (square meters) and UV area of every material, each polygon triangulated as a fan
+void MeasureMaterialAreas(FbxScene* pScene, const DzBlenderFbxSceneIndex& sceneIndex, QMap<QString, DzBlenderMaterialArea>& mapMaterialAreas)
 {
-	bool result = DzBridgeAction::postProcessFbx(fbxFilePath);
-	if (!result) return false;
+	double fUnitToMeters = pScene->GetGlobalSettings().GetSystemUnit().GetScaleFactor() / 100.0;
+	foreach(int nMeshIndex, sceneIndex.getMeshes()) {
+		FbxNode* pNode = sceneIndex.getNode(nMeshIndex);
+		FbxMesh* pMesh = pNode->GetMesh();
+		if (pMesh == nullptr || pMesh->GetControlPoints() == nullptr) continue;
+		FbxStringList aUVSetNames;
+		pMesh->GetUVSetNames(aUVSetNames);
+		if (aUVSetNames.GetCount() == 0) continue;
+		const char* sUVSetName = aUVSetNames.GetStringAt(0);
+		FbxGeometryElementMaterial* pMaterialElement = pMesh->GetElementMaterial();
+		FbxAMatrix matrix = pNode->EvaluateGlobalTransform();
+		for (int nPolygon = 0; nPolygon < pMesh->GetPolygonCount(); nPolygon++) {
+			int nMaterialIndex = 0;
+			if (pMaterialElement && pMaterialElement->GetMappingMode() == FbxGeometryElement::eByPolygon) {
+				nMaterialIndex = pMaterialElement->GetIndexArray().GetAt(nPolygon);
+			}
+			FbxSurfaceMaterial* pMaterial = pNode->GetMaterial(nMaterialIndex);
+			if (pMaterial == nullptr) continue;
+			DzBlenderMaterialArea& area = mapMaterialAreas[QString(pMaterial->GetName())];
+
+			FbxVector4 aPositions[3];
+			FbxVector2 aUVs[3];
+			bool bUnmapped = false;
+			aPositions[0] = matrix.MultT(pMesh->GetControlPointAt(pMesh->GetPolygonVertex(nPolygon, 0)));
+			pMesh->GetPolygonVertexUV(nPolygon, 0, sUVSetName, aUVs[0], bUnmapped);
+			for (int nVertex = 1; nVertex + 1 < pMesh->GetPolygonSize(nPolygon); nVertex++) {
+				for (int i = 1; i < 3; i++) {
+					aPositions[i] = matrix.MultT(pMesh->GetControlPointAt(pMesh->GetPolygonVertex(nPolygon, nVertex + i - 1)));
+					pMesh->GetPolygonVertexUV(nPolygon, nVertex + i - 1, sUVSetName, aUVs[i], bUnmapped);
+				}
+				FbxVector4 edge1 = aPositions[1] - aPositions[0];
+				FbxVector4 edge2 = aPositions[2] - aPositions[0];
+				area.fSurfaceArea += 0.5 * edge1.CrossProduct(edge2).Length() * fUnitToMeters * fUnitToMeters;
+				area.fUVArea += 0.5 * fabs((aUVs[1][0] - aUVs[0][0]) * (aUVs[2][1] - aUVs[0][1]) -
+					(aUVs[2][0] - aUVs[0][0]) * (aUVs[1][1] - aUVs[0][1]));
+			}
+		}
+	}
+}
 
-	if (m_bPostProcessFbx == false)
+// Global position of pNode in pPose, or its evaluated global transform when the pose does not contain it (FBX SDK ViewScene sample)
+FbxAMatrix GetPoseGlobalPosition(FbxNode* pNode, FbxPose* pPose)
+{
+	int nNodeIndex = pPose ? pPose->Find(pNode) : -1;
+	if (nNodeIndex < 0) {
+		return pNode->EvaluateGlobalTransform();
+	}
+	FbxMatrix poseMatrix = pPose->GetMatrix(nNodeIndex);
+	FbxAMatrix matrix;
+	memcpy((double*)matrix, (double*)poseMatrix, sizeof(poseMatrix.mData));
+	if (pPose->IsBindPose() || pPose->IsLocalMatrix(nNodeIndex) == false || pNode->GetParent() == nullptr) {
+		return matrix;
+	}
+	return GetPoseGlobalPosition(pNode->GetParent(), pPose) * matrix;
+}
+
+// FbxAMatrix transforms row vectors, the mesh kernels take row-major 3x4 matrices for column vectors
+void AppendClusterMatrix(const FbxAMatrix& matrix, std::vector<double>& aClusterMatrices)
+{
+	for (int nRow = 0; nRow < 3; nRow++) {
+		for (int nColumn = 0; nColumn < 4; nColumn++) {
+			aClusterMatrices.push_back(matrix.Get(nColumn, nRow));
+		}
+	}
+}
+
+// Collects the cluster deformations and weights of a linear or rigid skinned mesh for DzMeshKernels::BakeLinearSkinning(),
+// the same deformation FbxTools::BakePoseToVertexBuffer() applies.  Returns false for other skinning types, additive
+// clusters or meshes without skin, which are left to FbxTools.
+bool PrepareSkinBake(FbxMesh* pMesh, FbxVector4* pVertexBuffer, const FbxAMatrix& globalPosition, FbxPose* pPose, DzSkinBakeMesh& skinMesh)
+{
+	int nSkinCount = pMesh->GetDeformerCount(FbxDeformer::eSkin);
+	if (nSkinCount == 0) {
+		return false;
+	}
+	FbxSkin* pFirstSkin = (FbxSkin*)pMesh->GetDeformer(0, FbxDeformer::eSkin);
+	if (pFirstSkin->GetClusterCount() == 0) {
 		return false;
+	}
+	FbxCluster::ELinkMode eLinkMode = pFirstSkin->GetCluster(0)->GetLinkMode();
+	if (eLinkMode == FbxCluster::eAdditive) {
+		return false;
+	}
 
-	OpenFBXInterface* openFBX = OpenFBXInterface::GetInterface();
-	FbxScene* pScene = openFBX->CreateScene("Base Mesh Scene");
-	if (openFBX->LoadScene(pScene, fbxFilePath) == false)
-	{
-		QString sFbxErrorMessage = tr("ERROR: DzBlenderBridge: openFBX->LoadScene():\n\n")
-			+ QString("File: \"%1\"\n\n").arg(fbxFilePath)
-			+ QString("FbxStatusCode: %1\n").arg(openFBX->GetErrorCode())
-			+ QString("Error Message: %1\n\n").arg(openFBX->GetErrorString());
-		dzApp->log(sFbxErrorMessage);
-		if (m_nNonInteractiveMode == 0) QMessageBox::warning(0, tr("Error"),
-			tr("An error occurred while processing the Fbx file:\n\n") + sFbxErrorMessage, QMessageBox::Ok);
+	FbxNode* pNode = pMesh->GetNode();
+	FbxAMatrix geometry(pNode->GetGeometricTranslation(FbxNode::eSourcePivot),
+		pNode->GetGeometricRotation(FbxNode::eSourcePivot), pNode->GetGeometricScaling(FbxNode::eSourcePivot));
+	FbxAMatrix globalPositionInverse = globalPosition.Inverse();
+
+	skinMesh.pPoints = (double*)pVertexBuffer;
+	skinMesh.nPoints = pMesh->GetControlPointsCount();
+	skinMesh.bNormalize = eLinkMode == FbxCluster::eNormalize;
+	skinMesh.aClusterOffsets.assign(1, 0);
+	for (int nSkin = 0; nSkin < nSkinCount; nSkin++) {
+		FbxSkin* pSkin = (FbxSkin*)pMesh->GetDeformer(nSkin, FbxDeformer::eSkin);
+		FbxSkin::EType eType = pSkin->GetSkinningType();
+		if (eType != FbxSkin::eLinear && eType != FbxSkin::eRigid) {
+			return false;
+		}
+		for (int nCluster = 0; nCluster < pSkin->GetClusterCount(); nCluster++) {
+			FbxCluster* pCluster = pSkin->GetCluster(nCluster);
+			if (pCluster->GetLink() == nullptr) {
+				continue;
+			}
+			FbxAMatrix referenceGlobalInit;
+			pCluster->GetTransformMatrix(referenceGlobalInit);
+			referenceGlobalInit *= geometry;
+			FbxAMatrix clusterGlobalInit;
+			pCluster->GetTransformLinkMatrix(clusterGlobalInit);
+			FbxAMatrix clusterGlobalCurrent = GetPoseGlobalPosition(pCluster->GetLink(), pPose);
+			FbxAMatrix vertexTransform = (globalPositionInverse * clusterGlobalCurrent) * (clusterGlobalInit.Inverse() * referenceGlobalInit);
+			AppendClusterMatrix(vertexTransform, skinMesh.aClusterMatrices);
+			int nCount = pCluster->GetControlPointIndicesCount();
+			const int* pIndices = pCluster->GetControlPointIndices();
+			const double* pWeights = pCluster->GetControlPointWeights();
+			skinMesh.aIndices.insert(skinMesh.aIndices.end(), pIndices, pIndices + nCount);
+			skinMesh.aWeights.insert(skinMesh.aWeights.end(), pWeights, pWeights + nCount);
+			skinMesh.aClusterOffsets.push_back((uint32_t)skinMesh.aIndices.size());
+		}
+	}
+	return true;
+}
+
+// Collects the clusters and weights of every skin of pMesh for DzMeshKernels::OptimizeSkinWeights().  The cluster matrices are a
+// test pose that rotates every bone by 20 degrees around its bind position, about the X, Y or Z axis in turn, so that
+// DzMeshKernels::MeasureSkinningDifference() can report how far the reduced weights move the vertices.
+bool PrepareSkinWeights(FbxMesh* pMesh, DzSkinBakeMesh& skinMesh, QList<FbxCluster*>& aClusters)
+{
+	FbxNode* pNode = pMesh->GetNode();
+	FbxAMatrix geometry(pNode->GetGeometricTranslation(FbxNode::eSourcePivot),
+		pNode->GetGeometricRotation(FbxNode::eSourcePivot), pNode->GetGeometricScaling(FbxNode::eSourcePivot));
+
+	skinMesh.pPoints = (double*)pMesh->GetControlPoints();
+	skinMesh.nPoints = pMesh->GetControlPointsCount();
+	skinMesh.aClusterOffsets.assign(1, 0);
+	for (int nSkin = 0; nSkin < pMesh->GetDeformerCount(FbxDeformer::eSkin); nSkin++) {
+		FbxSkin* pSkin = (FbxSkin*)pMesh->GetDeformer(nSkin, FbxDeformer::eSkin);
+		for (int nCluster = 0; nCluster < pSkin->GetClusterCount(); nCluster++) {
+			FbxCluster* pCluster = pSkin->GetCluster(nCluster);
+			if (pCluster->GetLink() == nullptr || pCluster->GetLinkMode() == FbxCluster::eAdditive) {
+				continue;
+			}
+			skinMesh.bNormalize = pCluster->GetLinkMode() == FbxCluster::eNormalize;
+			FbxAMatrix referenceGlobalInit;
+			pCluster->GetTransformMatrix(referenceGlobalInit);
+			referenceGlobalInit *= geometry;
+			FbxAMatrix clusterGlobalInit;
+			pCluster->GetTransformLinkMatrix(clusterGlobalInit);
+			FbxVector4 pivot = (referenceGlobalInit.Inverse() * clusterGlobalInit).GetT();
+
+			FbxVector4 rotation(0, 0, 0);
+			rotation[aClusters.size() % 3] = 20.0;
+			FbxAMatrix toPivot, rotate, fromPivot;
+			toPivot.SetT(pivot);
+			rotate.SetR(rotation);
+			fromPivot.SetT(FbxVector4(-pivot[0], -pivot[1], -pivot[2]));
+			AppendClusterMatrix(toPivot * rotate * fromPivot, skinMesh.aClusterMatrices);
+
+			int nCount = pCluster->GetControlPointIndicesCount();
+			const int* pIndices = pCluster->GetControlPointIndices();
+			const double* pWeights = pCluster->GetControlPointWeights();
+			skinMesh.aIndices.insert(skinMesh.aIndices.end(), pIndices, pIndices + nCount);
+			skinMesh.aWeights.insert(skinMesh.aWeights.end(), pWeights, pWeights + nCount);
+			skinMesh.aClusterOffsets.push_back((uint32_t)skinMesh.aIndices.size());
+			aClusters.append(pCluster);
+		}
+	}
+	return aClusters.isEmpty() == false && skinMesh.pPoints != nullptr;
+}
+
+// Control points of pMesh in world space, and its polygons as triangle fans
+void GetWorldTriangles(FbxMesh* pMesh, const FbxAMatrix& global, std::vector<float>& aPositions, std::vector<int>* pTriangles)
+{
+	const FbxVector4* pPoints = pMesh->GetControlPoints();
+	for (int i = 0; i < pMesh->GetControlPointsCount(); i++) {
+		FbxVector4 point = global.MultT(pPoints[i]);
+		for (int c = 0; c < 3; c++) aPositions.push_back((float)point[c]);
+	}
+	if (pTriangles == nullptr) return;
+	const int* pPolygonVertices = pMesh->GetPolygonVertices();
+	for (int nPolygon = 0; nPolygon < pMesh->GetPolygonCount(); nPolygon++) {
+		int nStart = pMesh->GetPolygonVertexIndex(nPolygon);
+		for (int k = 2; k < pMesh->GetPolygonSize(nPolygon); k++) {
+			pTriangles->push_back(pPolygonVertices[nStart]);
+			pTriangles->push_back(pPolygonVertices[nStart + k - 1]);
+			pTriangles->push_back(pPolygonVertices[nStart + k]);
+		}
+	}
+}
+
+FbxAMatrix GetMeshGlobalTransform(FbxNode* pNode)
+{
+	FbxAMatrix geometry(pNode->GetGeometricTranslation(FbxNode::eSourcePivot),
+		pNode->GetGeometricRotation(FbxNode::eSourcePivot), pNode->GetGeometricScaling(FbxNode::eSourcePivot));
+	return pNode->EvaluateGlobalTransform() * geometry;
+}
+
+// Gives every mesh without a skin the skin of the skinned mesh with the most control points (the figure), with the weights
+// of the closest point on its surface, so that geografts and props exported without weights follow the figure.  Meshes
+// parented to a bone already follow it and are left alone.  Returns the number of meshes that got a skin.
+int TransferSkinWeights(FbxScene* pScene, const DzBlenderFbxSceneIndex& sceneIndex, int nMaxInfluences, DzWeightTransferStats& stats)
+{
+	FbxMesh* pSourceMesh = nullptr;
+	QList<int> aTargets;
+	foreach(int nMeshIndex, sceneIndex.getMeshes()) {
+		FbxMesh* pMesh = sceneIndex.getNode(nMeshIndex)->GetMesh();
+		if (pMesh->GetDeformerCount(FbxDeformer::eSkin) > 0) {
+			if (pSourceMesh == nullptr || pMesh->GetControlPointsCount() > pSourceMesh->GetControlPointsCount()) {
+				pSourceMesh = pMesh;
+			}
+		}
+		else if (pMesh->GetControlPointsCount() > 0) {
+			int nParent = sceneIndex.getParent(nMeshIndex);
+			if (nParent < 0 || sceneIndex.getAttributeType(nParent) != FbxNodeAttribute::eSkeleton) {
+				aTargets.append(nMeshIndex);
+			}
+		}
+	}
+	if (pSourceMesh == nullptr || aTargets.isEmpty()) {
+		return 0;
+	}
+
+	DzWeightTransferSource source;
+	std::vector<float> aSourcePositions;
+	std::vector<int> aSourceTriangles, aWeightVertices, aWeightGroups;
+	std::vector<float> aWeights;
+	QList<FbxCluster*> aClusters;
+	GetWorldTriangles(pSourceMesh, GetMeshGlobalTransform(pSourceMesh->GetNode()), aSourcePositions, &aSourceTriangles);
+	for (int nSkin = 0; nSkin < pSourceMesh->GetDeformerCount(FbxDeformer::eSkin); nSkin++) {
+		FbxSkin* pSkin = (FbxSkin*)pSourceMesh->GetDeformer(nSkin, FbxDeformer::eSkin);
+		for (int nCluster = 0; nCluster < pSkin->GetClusterCount(); nCluster++) {
+			FbxCluster* pCluster = pSkin->GetCluster(nCluster);
+			if (pCluster->GetLink() == nullptr || pCluster->GetLinkMode() == FbxCluster::eAdditive) {
+				continue;
+			}
+			const int* pIndices = pCluster->GetControlPointIndices();
+			const double* pWeights = pCluster->GetControlPointWeights();
+			for (int k = 0; k < pCluster->GetControlPointIndicesCount(); k++) {
+				aWeightVertices.push_back(pIndices[k]);
+				aWeightGroups.push_back(aClusters.size());
+				aWeights.push_back((float)pWeights[k]);
+			}
+			aClusters.append(pCluster);
+		}
+	}
+	source.pPositions = aSourcePositions.data();
+	source.nVertices = aSourcePositions.size() / 3;
+	source.pTriangles = aSourceTriangles.data();
+	source.nTriangles = aSourceTriangles.size() / 3;
+	source.pWeightVertices = aWeightVertices.data();
+	source.pWeightGroups = aWeightGroups.data();
+	source.pWeights = aWeights.data();
+	source.nWeights = aWeights.size();
+
+	// all target meshes are queried at once, their points one after the other
+	std::vector<float> aTargetPositions;
+	QVector<FbxAMatrix> aTargetTransforms;
+	foreach(int nMeshIndex, aTargets) {
+		FbxNode* pNode = sceneIndex.getNode(nMeshIndex);
+		aTargetTransforms.append(GetMeshGlobalTransform(pNode));
+		GetWorldTriangles(pNode->GetMesh(), aTargetTransforms.last(), aTargetPositions, nullptr);
+	}
+	DzWeightTransferSettings settings;
+	settings.nMaxInfluences = nMaxInfluences;
+	std::vector<int> aGroups;
+	std::vector<float> aGroupWeights;
+	if (DzWeightTransfer::Transfer(source, aTargetPositions.data(), aTargetPositions.size() / 3, settings, aGroups, aGroupWeights,
+		nullptr, &stats) == false) {
+		return 0;
+	}
+
+	QList<FbxPose*> aBindPoses;
+	for (int nPose = 0; nPose < pScene->GetPoseCount(); nPose++) {
+		if (pScene->GetPose(nPose)->IsBindPose()) aBindPoses.append(pScene->GetPose(nPose));
+	}
+	size_t nFirstPoint = 0;
+	for (int nTarget = 0; nTarget < aTargets.size(); nTarget++) {
+		FbxNode* pNode = sceneIndex.getNode(aTargets[nTarget]);
+		FbxMesh* pMesh = pNode->GetMesh();
+		QVector<FbxCluster*> aNewClusters(aClusters.size(), nullptr);
+		FbxSkin* pSkin = FbxSkin::Create(pScene, "");
+		for (int nPoint = 0; nPoint < pMesh->GetControlPointsCount(); nPoint++) {
+			for (int i = 0; i < nMaxInfluences; i++) {
+				size_t k = (nFirstPoint + nPoint) * nMaxInfluences + i;
+				int nGroup = aGroups[k];
+				if (nGroup < 0) break;
+				if (aNewClusters[nGroup] == nullptr) {
+					FbxCluster* pSourceCluster = aClusters[nGroup];
+					FbxCluster* pCluster = FbxCluster::Create(pScene, pSourceCluster->GetName());
+					pCluster->SetLink(pSourceCluster->GetLink());
+					pCluster->SetLinkMode(pSourceCluster->GetLinkMode());
+					FbxAMatrix linkMatrix;
+					pSourceCluster->GetTransformLinkMatrix(linkMatrix);
+					pCluster->SetTransformLinkMatrix(linkMatrix);
+					pCluster->SetTransformMatrix(aTargetTransforms[nTarget]);
+					pSkin->AddCluster(pCluster);
+					aNewClusters[nGroup] = pCluster;
+				}
+				aNewClusters[nGroup]->AddControlPointIndex(nPoint, aGroupWeights[k]);
+			}
+		}
+		pMesh->AddDeformer(pSkin);
+		foreach(FbxPose* pPose, aBindPoses) {
+			if (pPose->Find(pNode) < 0) pPose->Add(pNode, FbxMatrix(pNode->EvaluateGlobalTransform()));
+		}
+		nFirstPoint += pMesh->GetControlPointsCount();
+	}
+	return aTargets.size();
+}
+
+// Collects the polygons of pMesh for DzMeshOptimizer.  Returns false for meshes that cannot be reordered in place: layer
+// elements mapped by edge or holding user data, vertex cache deformers, or invalid polygon vertices.
+bool PrepareMeshOrder(FbxMesh* pMesh, DzMeshOrder& meshOrder)
+{
+	if (pMesh->GetDeformerCount(FbxDeformer::eVertexCache) > 0) {
 		return false;
 	}
+	for (int nLayer = 0; nLayer < pMesh->GetLayerCount(); nLayer++) {
+		FbxLayer* pLayer = pMesh->GetLayer(nLayer);
+		if (pLayer->GetUserData()) {
+			return false;
+		}
+		for (int nType = FbxLayerElement::eUnknown + 1; nType < FbxLayerElement::eTypeCount; nType++) {
+			bool bIsUV = nType >= FbxLayerElement::sTypeTextureStartIndex && nType <= FbxLayerElement::sTypeTextureEndIndex;
+			const FbxLayerElement* pElement = pLayer->GetLayerElementOfType((FbxLayerElement::EType)nType, bIsUV);
+			if (pElement && pElement->GetMappingMode() == FbxLayerElement::eByEdge) {
+				return false;
+			}
+		}
+	}
+
+	int nPolygonCount = pMesh->GetPolygonCount();
+	const int* pPolygonVertices = pMesh->GetPolygonVertices();
+	meshOrder.nVertices = pMesh->GetControlPointsCount();
+	meshOrder.bKeepFaceSizes = true;
+	meshOrder.aOffsets.assign(1, 0);
+	meshOrder.aOffsets.reserve(nPolygonCount + 1);
+	for (int nPolygon = 0; nPolygon < nPolygonCount; nPolygon++) {
+		int nStart = pMesh->GetPolygonVertexIndex(nPolygon);
+		int nSize = pMesh->GetPolygonSize(nPolygon);
+		for (int k = 0; k < nSize; k++) {
+			int nVertex = pPolygonVertices[nStart + k];
+			if (nVertex < 0 || nVertex >= (int)meshOrder.nVertices) {
+				return false;
+			}
+			meshOrder.aCorners.push_back((uint32_t)nVertex);
+		}
+		meshOrder.aOffsets.push_back((uint32_t)meshOrder.aCorners.size());
+	}
+	return nPolygonCount > 0;
+}
+
+// Moves the values of a layer array: control point values to their new vertex, polygon and polygon vertex values from
+// their source position
+template <class T>
+void RemapLayerArray(FbxLayerElementArrayTemplate<T>& array, FbxLayerElement::EMappingMode eMapping,
+	const std::vector<uint32_t>& aVertexRemap, const QVector<int>& aPolygonSources, const QVector<int>& aPolygonVertexSources)
+{
+	int nCount = array.GetCount();
+	QVector<T> aValues(nCount);
+	for (int i = 0; i < nCount; i++) {
+		aValues[i] = array.GetAt(i);
+	}
+	if (eMapping == FbxLayerElement::eByControlPoint) {
+		for (int v = 0; v < nCount && v < (int)aVertexRemap.size(); v++) {
+			array.SetAt(aVertexRemap[v], aValues[v]);
+		}
+		return;
+	}
+	const QVector<int>& aSources = eMapping == FbxLayerElement::eByPolygon ? aPolygonSources : aPolygonVertexSources;
+	for (int i = 0; i < nCount && i < aSources.size(); i++) {
+		array.SetAt(i, aValues[aSources[i]]);
+	}
+}
+
+template <class T>
+void RemapLayerElement(FbxLayerElementTemplate<T>* pElement, const std::vector<uint32_t>& aVertexRemap,
+	const QVector<int>& aPolygonSources, const QVector<int>& aPolygonVertexSources)
+{
+	if (pElement == nullptr) {
+		return;
+	}
+	FbxLayerElement::EMappingMode eMapping = pElement->GetMappingMode();
+	if (eMapping != FbxLayerElement::eByControlPoint && eMapping != FbxLayerElement::eByPolygon && eMapping != FbxLayerElement::eByPolygonVertex) {
+		return;
+	}
+	// indexed elements only reorder their indices, the shared values stay where they are
+	if (pElement->GetReferenceMode() == FbxLayerElement::eDirect) {
+		RemapLayerArray(pElement->GetDirectArray(), eMapping, aVertexRemap, aPolygonSources, aPolygonVertexSources);
+	}
+	else {
+		RemapLayerArray(pElement->GetIndexArray(), eMapping, aVertexRemap, aPolygonSources, aPolygonVertexSources);
+	}
+}
+
+void RemapLayers(FbxLayerContainer* pGeometry, const std::vector<uint32_t>& aVertexRemap,
+	const QVector<int>& aPolygonSources, const QVector<int>& aPolygonVertexSources)
+{
+	for (int nLayer = 0; nLayer < pGeometry->GetLayerCount(); nLayer++) {
+		FbxLayer* pLayer = pGeometry->GetLayer(nLayer);
+		RemapLayerElement(pLayer->GetNormals(), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		RemapLayerElement(pLayer->GetBinormals(), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		RemapLayerElement(pLayer->GetTangents(), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		RemapLayerElement(pLayer->GetVertexColors(), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		RemapLayerElement(pLayer->GetMaterials(), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		RemapLayerElement(pLayer->GetSmoothing(), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		RemapLayerElement(pLayer->GetPolygonGroups(), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		RemapLayerElement(pLayer->GetVertexCrease(), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		RemapLayerElement(pLayer->GetHole(), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		RemapLayerElement(pLayer->GetVisibility(), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		for (int nType = FbxLayerElement::sTypeTextureStartIndex; nType <= FbxLayerElement::sTypeTextureEndIndex; nType++) {
+			RemapLayerElement(pLayer->GetUVs((FbxLayerElement::EType)nType), aVertexRemap, aPolygonSources, aPolygonVertexSources);
+		}
+	}
+}
+
+// Applies the face order and vertex remap of DzMeshOptimizer to pMesh and to everything indexed by its control points,
+// polygons or polygon vertices: layer elements (UVs, normals, materials...), skin clusters and blend shape targets.
+void ApplyMeshOrder(FbxMesh* pMesh, const DzMeshOrder& meshOrder)
+{
+	int nPolygonCount = (int)meshOrder.aFaceOrder.size();
+	QVector<int> aPolygonSources(nPolygonCount);
+	QVector<int> aPolygonVertexSources;
+	aPolygonVertexSources.reserve((int)meshOrder.aCorners.size());
+	for (int nPolygon = 0; nPolygon < nPolygonCount; nPolygon++) {
+		// faces only moved between polygons of the same size, so the polygon vertex ranges are unchanged
+		uint32_t nSource = meshOrder.aFaceOrder[nPolygon];
+		aPolygonSources[nPolygon] = (int)nSource;
+		for (uint32_t k = meshOrder.aOffsets[nSource]; k < meshOrder.aOffsets[nSource + 1]; k++) {
+			pMesh->SetPolygonVertex(nPolygon, (int)(k - meshOrder.aOffsets[nSource]), (int)meshOrder.aVertexRemap[meshOrder.aCorners[k]]);
+			aPolygonVertexSources.append((int)k);
+		}
+	}
+
+	QVector<FbxVector4> aPoints(pMesh->GetControlPointsCount());
+	memcpy(aPoints.data(), pMesh->GetControlPoints(), aPoints.size() * sizeof(FbxVector4));
+	for (int v = 0; v < aPoints.size(); v++) {
+		pMesh->SetControlPointAt(aPoints[v], (int)meshOrder.aVertexRemap[v]);
+	}
+	RemapLayers(pMesh, meshOrder.aVertexRemap, aPolygonSources, aPolygonVertexSources);
+	if (pMesh->GetMeshEdgeCount() > 0) {
+		pMesh->BuildMeshEdgeArray();
+	}
+
+	for (int nSkin = 0; nSkin < pMesh->GetDeformerCount(FbxDeformer::eSkin); nSkin++) {
+		FbxSkin* pSkin = (FbxSkin*)pMesh->GetDeformer(nSkin, FbxDeformer::eSkin);
+		for (int nCluster = 0; nCluster < pSkin->GetClusterCount(); nCluster++) {
+			FbxCluster* pCluster = pSkin->GetCluster(nCluster);
+			int* pIndices = pCluster->GetControlPointIndices();
+			for (int k = 0; k < pCluster->GetControlPointIndicesCount(); k++) {
+				if (pIndices[k] >= 0 && pIndices[k] < (int)meshOrder.nVertices) pIndices[k] = (int)meshOrder.aVertexRemap[pIndices[k]];
+			}
+		}
+	}
+
+	for (int nBlendShape = 0; nBlendShape < pMesh->GetDeformerCount(FbxDeformer::eBlendShape); nBlendShape++) {
+		FbxBlendShape* pBlendShape = (FbxBlendShape*)pMesh->GetDeformer(nBlendShape, FbxDeformer::eBlendShape);
+		for (int nChannel = 0; nChannel < pBlendShape->GetBlendShapeChannelCount(); nChannel++) {
+			FbxBlendShapeChannel* pChannel = pBlendShape->GetBlendShapeChannel(nChannel);
+			for (int nTarget = 0; nTarget < pChannel->GetTargetShapeCount(); nTarget++) {
+				FbxShape* pShape = pChannel->GetTargetShape(nTarget);
+				if (pShape->GetControlPointIndicesCount() > 0) {
+					// sparse target, the indices move and the deltas stay paired with them
+					int* pIndices = pShape->GetControlPointIndices();
+					for (int k = 0; k < pShape->GetControlPointIndicesCount(); k++) {
+						if (pIndices[k] >= 0 && pIndices[k] < (int)meshOrder.nVertices) pIndices[k] = (int)meshOrder.aVertexRemap[pIndices[k]];
+					}
+				}
+				else {
+					QVector<FbxVector4> aShapePoints(pShape->GetControlPointsCount());
+					memcpy(aShapePoints.data(), pShape->GetControlPoints(), aShapePoints.size() * sizeof(FbxVector4));
+					for (int v = 0; v < aShapePoints.size() && v < (int)meshOrder.nVertices; v++) {
+						pShape->SetControlPointAt(aShapePoints[v], (int)meshOrder.aVertexRemap[v]);
+					}
+				}
+				RemapLayers(pShape, meshOrder.aVertexRemap, aPolygonSources, aPolygonVertexSources);
+			}
+		}
+	}
+}
+
+QString GetSparseMorphPath(const QString& sFbxFilePath)
+{
+	QFileInfo fileInfo(sFbxFilePath);
+	return fileInfo.path() + "/" + fileInfo.completeBaseName() + "_morphs.bin";
+}
+
+// Moves the blend shapes of every mesh into the sparse morph file, named as Blender's FBX importer names shape keys.  Blend
+// shapes with in-between targets, animated channels or targets of another size stay in the FBX, as do the blend shapes of
+// meshes with a geometric transform, which the importer would apply to their deltas.  Returns the number of morphs moved,
+// or -1 if the file could not be written.
+int WriteSparseMorphs(FbxScene* pScene, const DzBlenderFbxSceneIndex& sceneIndex, const QString& sMorphPath,
+	const DzMorphDeltaFile::Settings& settings, DzMorphDeltaFile::Result& result)
+{
+	std::vector<DzMorphMesh> aMeshes;
+	QList<QPair<FbxMesh*, FbxBlendShape*> > aBlendShapes;
+	foreach(int nMeshIndex, sceneIndex.getMeshes()) {
+		FbxNode* pNode = sceneIndex.getNode(nMeshIndex);
+		FbxMesh* pMesh = pNode->GetMesh();
+		if (pNode->GetGeometricTranslation(FbxNode::eSourcePivot) != FbxVector4(0, 0, 0) ||
+			pNode->GetGeometricRotation(FbxNode::eSourcePivot) != FbxVector4(0, 0, 0) ||
+			pNode->GetGeometricScaling(FbxNode::eSourcePivot) != FbxVector4(1, 1, 1)) {
+			continue;
+		}
+		DzMorphMesh morphMesh;
+		morphMesh.sName = pNode->GetName();
+		morphMesh.pBasePoints = (const double*)pMesh->GetControlPoints();
+		morphMesh.nVertices = pMesh->GetControlPointsCount();
+		for (int nBlendShape = 0; nBlendShape < pMesh->GetDeformerCount(FbxDeformer::eBlendShape); nBlendShape++) {
+			FbxBlendShape* pBlendShape = (FbxBlendShape*)pMesh->GetDeformer(nBlendShape, FbxDeformer::eBlendShape);
+			std::vector<DzMorphTarget> aTargets;
+			for (int nChannel = 0; nChannel < pBlendShape->GetBlendShapeChannelCount(); nChannel++) {
+				FbxBlendShapeChannel* pChannel = pBlendShape->GetBlendShapeChannel(nChannel);
+				FbxShape* pShape = pChannel->GetTargetShapeCount() == 1 ? pChannel->GetTargetShape(0) : nullptr;
+				if (pShape == nullptr || pChannel->DeformPercent.GetCurveNode() != nullptr) {
+					aTargets.clear();
+					break;
+				}
+				DzMorphTarget target;
+				// the importer names a shape key after its shape
+				target.sName = strlen(pShape->GetName()) > 0 ? pShape->GetName() : pChannel->GetName();
+				target.fDefaultValue = (float)(pChannel->DeformPercent.Get() / 100.0);
+				target.pPoints = (const double*)pShape->GetControlPoints();
+				target.nPoints = pShape->GetControlPointsCount();
+				if (pShape->GetControlPointIndicesCount() > 0) {
+					target.pIndices = pShape->GetControlPointIndices();
+					target.nPoints = qMin(target.nPoints, (size_t)pShape->GetControlPointIndicesCount());
+				}
+				else if (target.nPoints != morphMesh.nVertices) {
+					aTargets.clear();
+					break;
+				}
+				aTargets.push_back(target);
+			}
+			if (aTargets.empty()) continue;
+			morphMesh.aTargets.insert(morphMesh.aTargets.end(), aTargets.begin(), aTargets.end());
+			aBlendShapes.append(qMakePair(pMesh, pBlendShape));
+		}
+		if (morphMesh.aTargets.empty() == false) {
+			aMeshes.push_back(morphMesh);
+		}
+	}
+	if (aMeshes.empty()) {
+		return 0;
+	}
+
+	if (DzMorphDeltaFile::Write(sMorphPath.toUtf8().constData(), aMeshes, settings, result) == false) {
+		dzApp->log(QString("ERROR: DzBlenderBridge: WriteSparseMorphs(): %1: %2").arg(sMorphPath).arg(result.sError.c_str()));
+		QFile::remove(sMorphPath);
+		return -1;
+	}
+	for (int i = 0; i < aBlendShapes.size(); i++) {
+		FbxMesh* pMesh = aBlendShapes[i].first;
+		for (int nDeformer = 0; nDeformer < pMesh->GetDeformerCount(); nDeformer++) {
+			if (pMesh->GetDeformer(nDeformer) == aBlendShapes[i].second) {
+				pMesh->RemoveDeformer(nDeformer);
+				break;
+			}
+		}
+		// with its channels and shapes
+		aBlendShapes[i].second->Destroy(true);
+	}
+	return (int)result.nMorphs;
+}
+
+// One pass of DzBlenderAction::postProcessFbx().  Every stage works on the same FbxScene, which is loaded and saved only once,
+// and finds its nodes through the scene index, which is rebuilt after stages that add, remove or reparent nodes.
+struct DzBlenderFbxStage
+{
+	enum EFlags {
+		ReadsScene = 0,
+		ModifiesScene = 1,
+		ModifiesHierarchy = 2 | ModifiesScene
+	};
+
+	DzBlenderFbxStage(const QString& sStageName, int nStageFlags, std::function<bool(FbxScene*, DzBlenderFbxSceneIndex&)> fnStage) :
+		sName(sStageName), nFlags(nStageFlags), fnRun(fnStage) {}
+
+	QString sName;
+	int nFlags;
+	std::function<bool(FbxScene*, DzBlenderFbxSceneIndex&)> fnRun;
+};
+
+bool DzBlenderAction::postProcessFbx(QString fbxFilePath)
+{
+	bool result = DzBridgeAction::postProcessFbx(fbxFilePath);
+	if (!result) return false;
 
 	m_bExperimental_FbxPostProcessing = false;
 	if (m_nNonInteractiveMode == DZ_BRIDGE_NAMESPACE::eNonInteractiveMode::DzExporterMode ||
@@ -1301,76 +2043,289 @@ bool DzBlenderAction::postProcessFbx(QString fbxFilePath)
 	{
 		m_bExperimental_FbxPostProcessing = true;
 	}
-	if (m_bExperimental_FbxPostProcessing)
+
+	// a morph file left by an earlier export would be applied to this one
+	QString sMorphPath = GetSparseMorphPath(fbxFilePath);
+	if (QFile::exists(sMorphPath)) {
+		QFile::remove(sMorphPath);
+	}
+
+	QList<DzBlenderFbxStage> aStages;
+	if (m_pTexturePipeline->getSettings().bAutoTextureSize) {
+		// measured before any post processing changes the vertex buffers
+		aStages.append(DzBlenderFbxStage("MeasureMaterialAreas", DzBlenderFbxStage::ReadsScene, [this](FbxScene* pScene, DzBlenderFbxSceneIndex& sceneIndex) {
+			QMap<QString, DzBlenderMaterialArea> mapMaterialAreas;
+			MeasureMaterialAreas(pScene, sceneIndex, mapMaterialAreas);
+			m_pTexturePipeline->setMaterialAreas(mapMaterialAreas);
+			dzApp->log(QString("INFO: DzBlenderBridge: measured texel density areas of %1 materials").arg(mapMaterialAreas.size()));
+			return true;
+		}));
+	}
+
+	if (m_bTransferSkinWeights)
+	{
+		// before the bind pose bake, so the new skins are baked with the others
+		aStages.append(DzBlenderFbxStage("TransferSkinWeights", DzBlenderFbxStage::ModifiesScene, [this](FbxScene* pScene, DzBlenderFbxSceneIndex& sceneIndex) {
+			DzWeightTransferStats stats;
+			int nMeshes = TransferSkinWeights(pScene, sceneIndex, m_nMaxSkinInfluences > 0 ? m_nMaxSkinInfluences : 8, stats);
+			dzApp->log(QString("INFO: DzBlenderBridge: transferred skin weights to %1 meshes: %2 vertices, %3 influences, %4 vertices out of reach, "
+				"largest distance to the figure %5").arg(nMeshes).arg(stats.nPoints).arg(stats.nInfluences).arg(stats.nUnmatchedPoints)
+				.arg(stats.fMaxDistance));
+			return true;
+		}));
+	}
+
+	// Daz Studio puts the base bone rotations in a different place than Unreal expects them.
+	FbxNode* RootBone = nullptr;
+	if (m_bPostProcessFbx && m_bExperimental_FbxPostProcessing &&
+		(m_sExportRigMode == "unreal" || m_sExportRigMode == "metahuman"))
 	{
 		// Find the root bone.  There should only be one bone off the scene root
-		FbxNode* RootNode = pScene->GetRootNode();
-		FbxNode* RootBone = nullptr;
-		QString RootBoneName("");
-		for (int ChildIndex = 0; ChildIndex < RootNode->GetChildCount(); ++ChildIndex)
-		{
-			FbxNode* ChildNode = RootNode->GetChild(ChildIndex);
-			FbxNodeAttribute* Attr = ChildNode->GetNodeAttribute();
-			if (Attr && Attr->GetAttributeType() == FbxNodeAttribute::eSkeleton)
+		aStages.append(DzBlenderFbxStage("FindRootBone", DzBlenderFbxStage::ModifiesScene, [&RootBone](FbxScene* pScene, DzBlenderFbxSceneIndex& sceneIndex) {
+			int nRootBone = sceneIndex.getRootBone();
+			if (nRootBone >= 0)
 			{
-				RootBone = ChildNode;
-				RootBoneName = RootBone->GetName();
-				if (m_sExportRigMode == "unreal" || m_sExportRigMode == "metahuman") {
-					RootBone->SetName("root");
-					Attr->SetName("root");
-				}
-				//else if (m_sExportRigMode == "mixamo") {
-				//	RootBone->SetName("Armature");
-				//	Attr->SetName("Armature");
-				//}
-				break;
+				RootBone = sceneIndex.getNode(nRootBone);
+				RootBone->GetNodeAttribute()->SetName("root");
+				sceneIndex.setNodeName(nRootBone, "root");
 			}
-		}
-
-		//// Daz characters sometimes have additional skeletons inside the character for accesories
-		//if (AssetType == DazAssetType::SkeletalMesh)
-		//{
-		//	FDazToUnrealFbx::ParentAdditionalSkeletalMeshes(Scene);
-		//}
-		// Daz Studio puts the base bone rotations in a different place than Unreal expects them.
-		//if (CachedSettings->FixBoneRotationsOnImport && AssetType == DazAssetType::SkeletalMesh && RootBone)
-		//{
-		//	FDazToUnrealFbx::RemoveBindPoses(Scene);
-		//	FDazToUnrealFbx::FixClusterTranformLinks(Scene, RootBone);
-		//}		
-		if (RootBone)
-		{
-
-			if (m_sExportRigMode == "unreal" || m_sExportRigMode == "metahuman") {
-				FbxTools::RemoveBindPoses(pScene);
-				FbxTools::FixClusterTranformLinks(pScene, RootBone);
-
-				FbxTools::AddIkNodes(pScene, RootBone, "foot_l", "foot_r", "hand_l", "hand_r");
-
-				FbxPose* pNewBindPose = FbxTools::SaveBindMatrixToPose(pScene, "NewBindPose", nullptr, true);
-				FbxTools::ApplyBindPose(pScene, pNewBindPose);
-				QList<FbxNode*> nodeList;
-				FbxTools::GetAllMeshes(RootNode, nodeList);
-				foreach(FbxNode * pNode, nodeList) {
-					QString debugName(pNode->GetName());
-					FbxMesh* pMesh = pNode->GetMesh();
-					FbxAMatrix matrix = pNode->EvaluateGlobalTransform();
-					FbxVector4* pVertexBuffer = pMesh->GetControlPoints();
-					if (pVertexBuffer == NULL) continue;
+			return true;
+		}));
+		aStages.append(DzBlenderFbxStage("RemoveBindPoses", DzBlenderFbxStage::ModifiesScene, [&RootBone](FbxScene* pScene, DzBlenderFbxSceneIndex&) {
+			if (RootBone) FbxTools::RemoveBindPoses(pScene);
+			return true;
+		}));
+		aStages.append(DzBlenderFbxStage("FixClusterTranformLinks", DzBlenderFbxStage::ModifiesScene, [&RootBone](FbxScene* pScene, DzBlenderFbxSceneIndex&) {
+			if (RootBone) FbxTools::FixClusterTranformLinks(pScene, RootBone);
+			return true;
+		}));
+		aStages.append(DzBlenderFbxStage("AddIkNodes", DzBlenderFbxStage::ModifiesHierarchy, [&RootBone](FbxScene* pScene, DzBlenderFbxSceneIndex&) {
+			if (RootBone) FbxTools::AddIkNodes(pScene, RootBone, "foot_l", "foot_r", "hand_l", "hand_r");
+			return true;
+		}));
+		aStages.append(DzBlenderFbxStage("BakePoseToVertexBuffer", DzBlenderFbxStage::ModifiesScene, [&RootBone](FbxScene* pScene, DzBlenderFbxSceneIndex& sceneIndex) {
+			if (RootBone == nullptr) return true;
+			FbxPose* pNewBindPose = FbxTools::SaveBindMatrixToPose(pScene, "NewBindPose", nullptr, true);
+			FbxTools::ApplyBindPose(pScene, pNewBindPose);
+			// set DZ_BLENDER_VERIFY_POSE_BAKE to also bake every mesh with FbxTools and log the largest difference
+			bool bVerify = qgetenv("DZ_BLENDER_VERIFY_POSE_BAKE").isEmpty() == false;
+			std::vector<DzSkinBakeMesh> aSkinMeshes;
+			int nFbxToolsMeshes = 0;
+			QList<QVector<FbxVector4> > aReferencePoints;
+			foreach(int nMeshIndex, sceneIndex.getMeshes()) {
+				FbxNode* pNode = sceneIndex.getNode(nMeshIndex);
+				FbxMesh* pMesh = pNode->GetMesh();
+				FbxAMatrix matrix = pNode->EvaluateGlobalTransform();
+				FbxVector4* pVertexBuffer = pMesh->GetControlPoints();
+				if (pVertexBuffer == NULL) continue;
+				// the cluster matrices are read here, in the same order as before, the vertices are baked for all meshes at once below
+				DzSkinBakeMesh skinMesh;
+				if (PrepareSkinBake(pMesh, pVertexBuffer, matrix, pNewBindPose, skinMesh)) {
+					aSkinMeshes.push_back(skinMesh);
+					if (bVerify) {
+						QVector<FbxVector4> aPoints(pMesh->GetControlPointsCount());
+						memcpy(aPoints.data(), pVertexBuffer, aPoints.size() * sizeof(FbxVector4));
+						FbxTools::BakePoseToVertexBuffer(aPoints.data(), &matrix, pNewBindPose, pMesh);
+						aReferencePoints.append(aPoints);
+					}
+				}
+				else {
 					FbxTools::BakePoseToVertexBuffer(pVertexBuffer, &matrix, pNewBindPose, pMesh);
-
-					pNode->SetPreRotation(FbxNode::eSourcePivot, FbxVector4(0, 0, 0));
-					pNode->SetPostRotation(FbxNode::eSourcePivot, FbxVector4(0, 0, 0));
-					pNode->LclScaling.Set(FbxDouble3(1.0, 1.0, 1.0));
-					pNode->LclRotation.Set(FbxDouble3(0, 0, 0));
-					pNode->LclTranslation.Set(FbxDouble3(0, 0, 0));
+					nFbxToolsMeshes++;
 				}
 
-				FbxTools::DetachGeometry(pScene);
+				pNode->SetPreRotation(FbxNode::eSourcePivot, FbxVector4(0, 0, 0));
+				pNode->SetPostRotation(FbxNode::eSourcePivot, FbxVector4(0, 0, 0));
+				pNode->LclScaling.Set(FbxDouble3(1.0, 1.0, 1.0));
+				pNode->LclRotation.Set(FbxDouble3(0, 0, 0));
+				pNode->LclTranslation.Set(FbxDouble3(0, 0, 0));
+			}
+			DzMeshKernels::BakeLinearSkinning(aSkinMeshes);
+			dzApp->log(QString("INFO: DzBlenderBridge: baked the bind pose of %1 skinned meshes, %2 meshes left to FbxTools")
+				.arg(aSkinMeshes.size()).arg(nFbxToolsMeshes));
+			if (bVerify) {
+				double fMaxDifference = 0.0;
+				for (int nMesh = 0; nMesh < aReferencePoints.size(); nMesh++) {
+					const double* pBaked = aSkinMeshes[nMesh].pPoints;
+					const double* pReference = (const double*)aReferencePoints[nMesh].constData();
+					for (size_t i = 0; i < aSkinMeshes[nMesh].nPoints * 4; i++) {
+						if (i % 4 != 3) fMaxDifference = qMax(fMaxDifference, fabs(pBaked[i] - pReference[i]));
+					}
+				}
+				dzApp->log(QString("INFO: DzBlenderBridge: largest difference to FbxTools::BakePoseToVertexBuffer(): %1").arg(fMaxDifference));
+			}
+			return true;
+		}));
+		aStages.append(DzBlenderFbxStage("DetachGeometry", DzBlenderFbxStage::ModifiesHierarchy, [&RootBone](FbxScene* pScene, DzBlenderFbxSceneIndex&) {
+			if (RootBone) FbxTools::DetachGeometry(pScene);
+			return true;
+		}));
+	}
+	if (m_fSkinWeightThreshold > 0.0 || m_nMaxSkinInfluences > 0 || m_nSkinWeightQuantizationBits > 0)
+	{
+		// after the bind pose bake, so the baked vertices still use every original influence
+		aStages.append(DzBlenderFbxStage("OptimizeSkinWeights", DzBlenderFbxStage::ModifiesScene, [this](FbxScene* pScene, DzBlenderFbxSceneIndex& sceneIndex) {
+			DzSkinWeightSettings settings;
+			settings.fMinWeight = m_fSkinWeightThreshold;
+			settings.nMaxInfluences = m_nMaxSkinInfluences;
+			settings.nQuantizationBits = m_nSkinWeightQuantizationBits;
+			int nMeshes = 0, nPointsChanged = 0, nMaxInfluencesBefore = 0, nMaxInfluencesAfter = 0;
+			qint64 nInfluencesBefore = 0, nInfluencesAfter = 0;
+			double fMaxError = 0.0;
+			foreach(int nMeshIndex, sceneIndex.getMeshes()) {
+				FbxMesh* pMesh = sceneIndex.getNode(nMeshIndex)->GetMesh();
+				DzSkinBakeMesh skinMesh;
+				QList<FbxCluster*> aClusters;
+				if (PrepareSkinWeights(pMesh, skinMesh, aClusters) == false) continue;
+
+				DzSkinBakeMesh optimizedMesh = skinMesh;
+				DzSkinWeightStats stats;
+				DzMeshKernels::OptimizeSkinWeights(optimizedMesh, settings, stats);
+				fMaxError = qMax(fMaxError, DzMeshKernels::MeasureSkinningDifference(skinMesh, optimizedMesh));
+				for (int nCluster = 0; nCluster < aClusters.size(); nCluster++) {
+					FbxCluster* pCluster = aClusters[nCluster];
+					pCluster->SetControlPointIWCount(0);
+					for (uint32_t k = optimizedMesh.aClusterOffsets[nCluster]; k < optimizedMesh.aClusterOffsets[nCluster + 1]; k++) {
+						pCluster->AddControlPointIndex(optimizedMesh.aIndices[k], optimizedMesh.aWeights[k]);
+					}
+				}
+				nMeshes++;
+				nPointsChanged += (int)stats.nPointsChanged;
+				nInfluencesBefore += stats.nInfluencesBefore;
+				nInfluencesAfter += stats.nInfluencesAfter;
+				nMaxInfluencesBefore = qMax(nMaxInfluencesBefore, stats.nMaxInfluencesBefore);
+				nMaxInfluencesAfter = qMax(nMaxInfluencesAfter, stats.nMaxInfluencesAfter);
+			}
+			// an FBX cluster stores an int index and a double weight per influence
+			dzApp->log(QString("INFO: DzBlenderBridge: reduced the skin weights of %1 meshes: %2 -> %3 influences (%4 KB less), "
+				"%5 vertices changed, at most %6 -> %7 influences per vertex, largest vertex offset on the test pose %8")
+				.arg(nMeshes).arg(nInfluencesBefore).arg(nInfluencesAfter).arg((nInfluencesBefore - nInfluencesAfter) * 12 / 1024)
+				.arg(nPointsChanged).arg(nMaxInfluencesBefore).arg(nMaxInfluencesAfter).arg(fMaxError));
+			return true;
+		}));
+	}
+	bool bGameRig = m_sExportRigMode == "unreal" || m_sExportRigMode == "metahuman" || m_sExportRigMode == "unity" || m_sExportRigMode == "mixamo";
+	// the legacy addon finds Genesis features by hardcoded vertex indices (toGeniVIndex in Global.py, DtbIKBones.py,
+	// ToRigify.py, ToHighReso.py), so the vertex order is left as Daz Studio wrote it
+	if (m_bOptimizeVertexCache && (bGameRig || m_bGenerateFinalGlb || m_bGenerateFinalFbx) && m_bUseLegacyAddon == false)
+	{
+		// last, every earlier stage still sees the authoring order
+		aStages.append(DzBlenderFbxStage("OptimizeVertexCache", DzBlenderFbxStage::ModifiesScene, [](FbxScene* pScene, DzBlenderFbxSceneIndex& sceneIndex) {
+			std::vector<DzMeshOrder> aMeshOrders;
+			QList<FbxMesh*> aMeshes;
+			int nSkippedMeshes = 0;
+			foreach(int nMeshIndex, sceneIndex.getMeshes()) {
+				FbxMesh* pMesh = sceneIndex.getNode(nMeshIndex)->GetMesh();
+				DzMeshOrder meshOrder;
+				if (PrepareMeshOrder(pMesh, meshOrder)) {
+					aMeshOrders.push_back(meshOrder);
+					aMeshes.append(pMesh);
+				}
+				else {
+					nSkippedMeshes++;
+				}
+			}
+			DzMeshOptimizer::OptimizeMeshOrder(aMeshOrders);
+
+			DzVertexCacheStats before, after;
+			for (int nMesh = 0; nMesh < aMeshes.size(); nMesh++) {
+				DzVertexCacheStats meshBefore = DzMeshOptimizer::AnalyzeVertexCache(aMeshOrders[nMesh], false);
+				DzVertexCacheStats meshAfter = DzMeshOptimizer::AnalyzeVertexCache(aMeshOrders[nMesh], true);
+				// keep the authoring order where the optimizer found nothing better
+				if (meshAfter.nCacheMisses >= meshBefore.nCacheMisses) {
+					meshAfter = meshBefore;
+				}
+				else {
+					ApplyMeshOrder(aMeshes[nMesh], aMeshOrders[nMesh]);
+				}
+				before.nTriangles += meshBefore.nTriangles;
+				before.nVertices += meshBefore.nVertices;
+				before.nCacheMisses += meshBefore.nCacheMisses;
+				after.nTriangles += meshAfter.nTriangles;
+				after.nVertices += meshAfter.nVertices;
+				after.nCacheMisses += meshAfter.nCacheMisses;
+			}
+			dzApp->log(QString("INFO: DzBlenderBridge: optimized the vertex cache order of %1 meshes (%2 skipped): ACMR %3 -> %4, ATVR %5 -> %6")
+				.arg(aMeshes.size()).arg(nSkippedMeshes).arg(before.getAcmr(), 0, 'f', 3).arg(after.getAcmr(), 0, 'f', 3)
+				.arg(before.getAtvr(), 0, 'f', 3).arg(after.getAtvr(), 0, 'f', 3));
+			return true;
+		}));
+	}
+	// only create_blend.py reads the morph file, the legacy addon imports the FBX blend shapes
+	if (m_bPostProcessFbx && m_bMorphSidecarFile && m_bEnableMorphs && m_bExperimental_FbxPostProcessing && m_bUseLegacyAddon == false)
+	{
+		// after the vertex cache order, so the morph file indexes the final control points
+		aStages.append(DzBlenderFbxStage("WriteSparseMorphs", DzBlenderFbxStage::ModifiesScene, [this, sMorphPath](FbxScene* pScene, DzBlenderFbxSceneIndex& sceneIndex) {
+			DzMorphDeltaFile::Settings settings;
+			settings.nQuantizationBits = m_nMorphQuantizationBits;
+			DzMorphDeltaFile::Result result;
+			// on failure the blend shapes stay in the FBX
+			int nMorphs = WriteSparseMorphs(pScene, sceneIndex, sMorphPath, settings, result);
+			if (nMorphs > 0) {
+				dzApp->log(QString("INFO: DzBlenderBridge: moved %1 morphs out of the FBX blend shapes into %2: %3 deltas, %4 KB instead of %5 KB, largest delta error %6")
+					.arg(nMorphs).arg(sMorphPath).arg(result.nDeltas).arg(result.nFileBytes / 1024).arg(result.nSourceBytes / 1024)
+					.arg(result.fMaxError));
+			}
+			return true;
+		}));
+	}
+	// with post-processing off, the FBX is left as exported and only the stages that read it run
+	if (m_bPostProcessFbx == false)
+	{
+		for (int nStage = aStages.size() - 1; nStage >= 0; nStage--) {
+			if (aStages[nStage].nFlags & DzBlenderFbxStage::ModifiesScene) {
+				aStages.removeAt(nStage);
 			}
 		}
 	}
+	if (aStages.isEmpty())
+		return m_bPostProcessFbx;
+
+	QTime timer;
+	timer.start();
+	OpenFBXInterface* openFBX = OpenFBXInterface::GetInterface();
+	FbxScene* pScene = openFBX->CreateScene("Base Mesh Scene");
+	if (openFBX->LoadScene(pScene, fbxFilePath) == false)
+	{
+		QString sFbxErrorMessage = tr("ERROR: DzBlenderBridge: openFBX->LoadScene():\n\n")
+			+ QString("File: \"%1\"\n\n").arg(fbxFilePath)
+			+ QString("FbxStatusCode: %1\n").arg(openFBX->GetErrorCode())
+			+ QString("Error Message: %1\n\n").arg(openFBX->GetErrorString());
+		dzApp->log(sFbxErrorMessage);
+		if (m_nNonInteractiveMode == 0) QMessageBox::warning(0, tr("Error"),
+			tr("An error occurred while processing the Fbx file:\n\n") + sFbxErrorMessage, QMessageBox::Ok);
+		pScene->Destroy();
+		return false;
+	}
+	dzApp->log(QString("INFO: DzBlenderBridge: postProcessFbx(): loaded %1 in %2 ms").arg(fbxFilePath).arg(timer.elapsed()));
+
+	timer.restart();
+	DzBlenderFbxSceneIndex sceneIndex;
+	sceneIndex.build(pScene);
+	dzApp->log(QString("INFO: DzBlenderBridge: postProcessFbx(): indexed %1 nodes in %2 ms").arg(sceneIndex.getCount()).arg(timer.elapsed()));
+
+	bool bModified = false;
+	for (int nStage = 0; nStage < aStages.size(); nStage++) {
+		const DzBlenderFbxStage& stage = aStages[nStage];
+		timer.restart();
+		if (stage.fnRun(pScene, sceneIndex) == false) {
+			dzApp->log(QString("ERROR: DzBlenderBridge: postProcessFbx(): stage %1 failed").arg(stage.sName));
+			pScene->Destroy();
+			return false;
+		}
+		bModified = bModified || (stage.nFlags & DzBlenderFbxStage::ModifiesScene);
+		if ((stage.nFlags & DzBlenderFbxStage::ModifiesHierarchy) == DzBlenderFbxStage::ModifiesHierarchy && nStage + 1 < aStages.size()) {
+			sceneIndex.build(pScene);
+		}
+		dzApp->log(QString("INFO: DzBlenderBridge: postProcessFbx(): %1 took %2 ms").arg(stage.sName).arg(timer.elapsed()));
+	}
+	// nothing to write back, skip the save
+	if (bModified == false) {
+		pScene->Destroy();
+		return m_bPostProcessFbx;
+	}
 
+	timer.restart();
 	if (openFBX->SaveScene(pScene, fbxFilePath) == false)
 	{
 		QString sFbxErrorMessage = tr("ERROR: DzBlenderBridge: openFBX->SaveScene():\n\n")
@@ -1380,8 +2335,11 @@ bool DzBlenderAction::postProcessFbx(QString fbxFilePath)
 		dzApp->log(sFbxErrorMessage);
 		if (m_nNonInteractiveMode == 0) QMessageBox::warning(0, tr("Error"),
 			tr("An error occurred while processing the Fbx file:\n\n") + sFbxErrorMessage, QMessageBox::Ok);
+		pScene->Destroy();
 		return false;
 	}
+	dzApp->log(QString("INFO: DzBlenderBridge: postProcessFbx(): saved %1 in %2 ms").arg(fbxFilePath).arg(timer.elapsed()));
+	pScene->Destroy();
 
 	return true;
 }
@@ -10,6 +10,7 @@
 #include "DzBlenderDialog.h"
 
 class UnitTest_DzBlenderAction;
+class DzBlenderTexturePipeline;
 
 #include "dzbridge.h"
 
@@ -40,8 +41,12 @@ class DzBlenderAction : public DZ_BRIDGE_NAMESPACE::DzBridgeAction {
 	 Q_OBJECT
 public:
 	DzBlenderAction();
+	virtual ~DzBlenderAction();
 	DzError getExecutActionResult() { return m_nExecuteActionResult; }
 
+	// Blocks until background texture jobs started by writeConfiguration() are done
+	Q_INVOKABLE bool waitForTextureJobs();
+
 protected:
 	Q_INVOKABLE virtual void setUseLegacyPaths(bool arg) { m_bUseLegacyPaths = arg; }
 	Q_INVOKABLE virtual bool getUseLegacyPaths() { return m_bUseLegacyPaths; }
@@ -63,6 +68,8 @@ protected:
 	 virtual bool preProcessScene(DzNode* parentNode) override;
 	 virtual bool postProcessFbx(QString fbxFilePath) override;
 
+	 void startTextureJobs();
+
 	 int m_nPythonExceptionExitCode = 11;  // arbitrary exit code to check for blener python exceptions
 	 int m_nBlenderExitCode = 0;
 	 QString m_sBlenderExecutablePath = "";
@@ -81,6 +88,22 @@ protected:
 	 bool m_bGenerateFinalUsd = false;
 	 bool m_bUseMaterialX = false;
 
+	 // skin weight reduction during postProcessFbx(), 0 = off
+	 double m_fSkinWeightThreshold = 0.0;
+	 int m_nMaxSkinInfluences = 0;
+	 int m_nSkinWeightQuantizationBits = 0;
+	 // vertex cache and fetch order of the meshes, for the game rig modes and the final GLB/FBX files (not with the legacy addon)
+	 bool m_bOptimizeVertexCache = true;
+	 // skins for the unskinned meshes from the closest point on the figure, during postProcessFbx()
+	 bool m_bTransferSkinWeights = false;
+	 // morphs as sparse deltas in the "<fbx name>_morphs.bin" sidecar file instead of FBX blend shapes, 0 bits = float deltas.
+	 // Only create_blend.py reads the sidecar, the FBX alone has no morphs.
+	 bool m_bMorphSidecarFile = true;
+	 int m_nMorphQuantizationBits = 0;
+	 // triangle ratios of the LOD objects create_blend.py generates for every mesh, largest first, empty = no LODs
+	 QList<double> m_aLodRatios;
+
+	 DzBlenderTexturePipeline* m_pTexturePipeline = nullptr;
 
 	 friend class DzBlenderExporter;
 #ifdef UNITTEST_DZBRIDGE
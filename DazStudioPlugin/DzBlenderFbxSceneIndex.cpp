@@ -0,0 +1,127 @@
+#include <QtCore/qpair.h>
+
+#include "DzBlenderFbxSceneIndex.h"
+
+void DzBlenderFbxSceneIndex::clear()
+{
+	m_aNodes.clear();
+	m_aParents.clear();
+	m_aSubtreeEnds.clear();
+	m_aAttributeTypes.clear();
+	m_aSkeletonTypes.clear();
+	m_aNameIds.clear();
+	m_aNames.clear();
+	m_mapNameIds.clear();
+	m_mapNodesByName.clear();
+	m_mapNodeIndices.clear();
+	m_aMeshes.clear();
+	m_nRootBone = -1;
+}
+
+void DzBlenderFbxSceneIndex::build(FbxScene* pScene)
+{
+	clear();
+	FbxNode* pRootNode = pScene ? pScene->GetRootNode() : nullptr;
+	if (pRootNode == nullptr) {
+		return;
+	}
+	int nNodeCount = pScene->GetNodeCount();
+	m_aNodes.reserve(nNodeCount);
+	m_aParents.reserve(nNodeCount);
+	m_aAttributeTypes.reserve(nNodeCount);
+	m_aSkeletonTypes.reserve(nNodeCount);
+	m_aNameIds.reserve(nNodeCount);
+
+	// depth-first with an explicit stack, environment scenes can be large
+	QVector<QPair<FbxNode*, int> > aStack;
+	aStack.append(qMakePair(pRootNode, -1));
+	while (aStack.isEmpty() == false) {
+		QPair<FbxNode*, int> entry = aStack.last();
+		aStack.removeLast();
+		int nIndex = m_aNodes.size();
+		addNode(entry.first, entry.second);
+		for (int nChild = entry.first->GetChildCount() - 1; nChild >= 0; nChild--) {
+			aStack.append(qMakePair(entry.first->GetChild(nChild), nIndex));
+		}
+	}
+
+	// a subtree ends where the last subtree of its children ends
+	m_aSubtreeEnds.resize(m_aNodes.size());
+	for (int i = 0; i < m_aNodes.size(); i++) {
+		m_aSubtreeEnds[i] = i + 1;
+	}
+	for (int i = m_aNodes.size() - 1; i > 0; i--) {
+		int nParent = m_aParents[i];
+		m_aSubtreeEnds[nParent] = qMax(m_aSubtreeEnds[nParent], m_aSubtreeEnds[i]);
+	}
+
+	for (int i = 1; i < m_aNodes.size() && m_nRootBone < 0; i = m_aSubtreeEnds[i]) {
+		if (m_aAttributeTypes[i] == FbxNodeAttribute::eSkeleton) {
+			m_nRootBone = i;
+		}
+	}
+}
+
+void DzBlenderFbxSceneIndex::addNode(FbxNode* pNode, int nParent)
+{
+	int nIndex = m_aNodes.size();
+	FbxNodeAttribute* pAttribute = pNode->GetNodeAttribute();
+	FbxNodeAttribute::EType eType = pAttribute ? pAttribute->GetAttributeType() : FbxNodeAttribute::eUnknown;
+	int nSkeletonType = -1;
+	if (eType == FbxNodeAttribute::eSkeleton) {
+		nSkeletonType = (int)((FbxSkeleton*)pAttribute)->GetSkeletonType();
+	}
+
+	m_aNodes.append(pNode);
+	m_aParents.append(nParent);
+	m_aAttributeTypes.append(eType);
+	m_aSkeletonTypes.append(nSkeletonType);
+	m_aNameIds.append(internName(QString::fromUtf8(pNode->GetName()), nIndex));
+	m_mapNodeIndices.insert(pNode, nIndex);
+	if (eType == FbxNodeAttribute::eMesh && pNode->GetMesh()) {
+		m_aMeshes.append(nIndex);
+	}
+}
+
+int DzBlenderFbxSceneIndex::internName(const QString& sName, int nIndex)
+{
+	int nNameId = m_mapNameIds.value(sName, -1);
+	if (nNameId < 0) {
+		nNameId = m_aNames.size();
+		m_aNames.append(sName);
+		m_mapNameIds.insert(sName, nNameId);
+	}
+	int nFirstNode = m_mapNodesByName.value(sName, -1);
+	if (nFirstNode < 0 || nIndex < nFirstNode) {
+		m_mapNodesByName.insert(sName, nIndex);
+	}
+	return nNameId;
+}
+
+void DzBlenderFbxSceneIndex::setNodeName(int nIndex, const QString& sName)
+{
+	QString sOldName = getName(nIndex);
+	m_aNodes[nIndex]->SetName(sName.toUtf8().constData());
+	m_aNameIds[nIndex] = internName(sName, nIndex);
+	if (m_mapNodesByName.value(sOldName, -1) == nIndex) {
+		// the next node with the old name, if any, becomes the first one
+		m_mapNodesByName.remove(sOldName);
+		int nOldNameId = m_mapNameIds.value(sOldName);
+		for (int i = nIndex + 1; i < m_aNodes.size(); i++) {
+			if (m_aNameIds[i] == nOldNameId) {
+				m_mapNodesByName.insert(sOldName, i);
+				break;
+			}
+		}
+	}
+}
+
+int DzBlenderFbxSceneIndex::getFirstLimbChild(int nIndex) const
+{
+	for (int nChild = nIndex + 1; nChild < m_aSubtreeEnds[nIndex]; nChild = m_aSubtreeEnds[nChild]) {
+		if (m_aSkeletonTypes[nChild] == FbxSkeleton::eLimbNode) {
+			return nChild;
+		}
+	}
+	return -1;
+}
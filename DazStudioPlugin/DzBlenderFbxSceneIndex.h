@@ -0,0 +1,69 @@
+#pragma once
+#include <QtCore/qstring.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qhash.h>
+
+#include <fbxsdk.h>
+
+/*****************************
+DzBlenderFbxSceneIndex
+
+Flat table of the nodes of an FbxScene, built once per FBX post-processing
+run so that the passes iterate arrays and look up hash maps instead of
+walking the node tree and its connections through the FBX SDK each time.
+Nodes are stored depth-first, parents before their children, and every
+subtree is the contiguous range [nIndex, getSubtreeEnd(nIndex)).  Node
+names are interned: nodes with the same name share one name id.  Index 0 is
+the scene root.  The table must be rebuilt after a pass adds, removes or
+reparents nodes.
+*****************************/
+class DzBlenderFbxSceneIndex
+{
+public:
+	void build(FbxScene* pScene);
+	void clear();
+
+	int getCount() const { return m_aNodes.size(); }
+	FbxNode* getNode(int nIndex) const { return m_aNodes[nIndex]; }
+	// -1 for the scene root
+	int getParent(int nIndex) const { return m_aParents[nIndex]; }
+	int getSubtreeEnd(int nIndex) const { return m_aSubtreeEnds[nIndex]; }
+	// eUnknown for nodes without attribute
+	FbxNodeAttribute::EType getAttributeType(int nIndex) const { return m_aAttributeTypes[nIndex]; }
+	// -1 for nodes that are not skeletons, else an FbxSkeleton::EType
+	int getSkeletonType(int nIndex) const { return m_aSkeletonTypes[nIndex]; }
+	int getNameId(int nIndex) const { return m_aNameIds[nIndex]; }
+	const QString& getName(int nIndex) const { return m_aNames[m_aNameIds[nIndex]]; }
+
+	// First node with the name in depth-first order, -1 if none
+	int findNode(const QString& sName) const { return m_mapNodesByName.value(sName, -1); }
+	int indexOf(FbxNode* pNode) const { return m_mapNodeIndices.value(pNode, -1); }
+
+	// Nodes with a mesh attribute, in depth-first order (the order of FbxTools::GetAllMeshes())
+	const QVector<int>& getMeshes() const { return m_aMeshes; }
+	// First skeleton directly below the scene root, -1 if none
+	int getRootBone() const { return m_nRootBone; }
+	// First child of nIndex that is an eLimbNode skeleton, -1 if none
+	int getFirstLimbChild(int nIndex) const;
+
+	// Renames the node and keeps the name tables up to date, no rebuild needed
+	void setNodeName(int nIndex, const QString& sName);
+
+protected:
+	void addNode(FbxNode* pNode, int nParent);
+	int internName(const QString& sName, int nIndex);
+
+	QVector<FbxNode*> m_aNodes;
+	QVector<int> m_aParents;
+	QVector<int> m_aSubtreeEnds;
+	QVector<FbxNodeAttribute::EType> m_aAttributeTypes;
+	QVector<int> m_aSkeletonTypes;
+	QVector<int> m_aNameIds;
+	QStringList m_aNames;
+	QHash<QString, int> m_mapNameIds;
+	QHash<QString, int> m_mapNodesByName;
+	QHash<FbxNode*, int> m_mapNodeIndices;
+	QVector<int> m_aMeshes;
+	int m_nRootBone = -1;
+};
@@ -0,0 +1,124 @@
+#include <QtCore/qmutex.h>
+#include <QtGui/qimage.h>
+#include <QtGui/qimagewriter.h>
+
+#include "DzBlenderImageCodecs.h"
+#include "DzPngStream.h"
+
+namespace
+{
+	struct CodecRegistry
+	{
+		CodecRegistry()
+		{
+			aCodecs.append(new DzBlenderNativePngCodec());
+			aCodecs.append(new DzBlenderQtImageCodec());
+		}
+		~CodecRegistry()
+		{
+			qDeleteAll(aCodecs);
+		}
+
+		QMutex mutex;
+		// highest priority first
+		QList<DzBlenderImageCodec*> aCodecs;
+	};
+
+	CodecRegistry& getRegistry()
+	{
+		static CodecRegistry oRegistry;
+		return oRegistry;
+	}
+}
+
+///////////////////////////////
+// DzBlenderQtImageCodec
+///////////////////////////////
+
+bool DzBlenderQtImageCodec::canWrite(const QString& sFormat) const
+{
+	return QImageWriter::supportedImageFormats().contains(sFormat.toLatin1());
+}
+
+bool DzBlenderQtImageCodec::write(const QImage& image, const QString& sPath, const QString& sFormat,
+	const DzBlenderCodecSettings& settings, QString& sErrorMessage) const
+{
+	QImageWriter writer(sPath);
+	writer.setFormat(sFormat.toLatin1());
+	if (sFormat == "jpg") {
+		writer.setQuality(settings.nJpegQuality);
+	}
+	if (writer.write(image) == false) {
+		sErrorMessage = writer.errorString();
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////
+// DzBlenderNativePngCodec
+///////////////////////////////
+
+bool DzBlenderNativePngCodec::write(const QImage& image, const QString& sPath, const QString& sFormat,
+	const DzBlenderCodecSettings& settings, QString& sErrorMessage) const
+{
+	bool bAlpha = image.hasAlphaChannel();
+	QImage::Format eFormat = bAlpha ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+	// premultiplied, indexed and 16-bit images are converted, ARGB32 and RGB32 are written as they are
+	QImage converted = image.format() == eFormat ? image : image.convertToFormat(eFormat);
+	if (converted.isNull()) {
+		sErrorMessage = "unable to convert image to 32 bit";
+		return false;
+	}
+
+	DzPngWriteSettings pngSettings;
+	pngSettings.nCompressionLevel = settings.nPngCompressionLevel;
+	std::string sError;
+	if (DzPngImageWriter::Write(sPath.toUtf8().constData(), (const uint32_t*)converted.constBits(),
+		converted.width(), converted.height(), converted.bytesPerLine() / 4, bAlpha, pngSettings, sError) == false)
+	{
+		sErrorMessage = QString::fromUtf8(sError.c_str());
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////
+// DzBlenderImageCodecs
+///////////////////////////////
+
+void DzBlenderImageCodecs::RegisterCodec(DzBlenderImageCodec* pCodec)
+{
+	if (pCodec == nullptr) {
+		return;
+	}
+	CodecRegistry& registry = getRegistry();
+	QMutexLocker locker(&registry.mutex);
+	registry.aCodecs.prepend(pCodec);
+}
+
+const DzBlenderImageCodec* DzBlenderImageCodecs::FindWriter(const QString& sFormat)
+{
+	CodecRegistry& registry = getRegistry();
+	QMutexLocker locker(&registry.mutex);
+	foreach(DzBlenderImageCodec* pCodec, registry.aCodecs) {
+		if (pCodec->canWrite(sFormat)) {
+			return pCodec;
+		}
+	}
+	return nullptr;
+}
+
+bool DzBlenderImageCodecs::Write(const QImage& image, const QString& sPath, const QString& sFormat,
+	const DzBlenderCodecSettings& settings, QString& sErrorMessage, QString* psCodecName)
+{
+	const DzBlenderImageCodec* pCodec = FindWriter(sFormat);
+	if (pCodec == nullptr) {
+		sErrorMessage = "no codec can write " + sFormat;
+		return false;
+	}
+	if (psCodecName) {
+		*psCodecName = pCodec->getName();
+	}
+	return pCodec->write(image, sPath, sFormat, settings, sErrorMessage);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <QtCore/qstring.h>
+#include <QtCore/qlist.h>
+
+class QImage;
+
+// Encoder options shared by all codecs
+struct DzBlenderCodecSettings
+{
+	int nJpegQuality = 90;
+	int nPngCompressionLevel = 6; // 0 (fastest) to 9 (smallest)
+};
+
+// One image encoder.  Codecs are shared by concurrent texture jobs and must be thread safe.
+class DzBlenderImageCodec
+{
+public:
+	virtual ~DzBlenderImageCodec() {}
+
+	virtual QString getName() const = 0;
+	// sFormat is a lower case file suffix, "jpg" for JPEG
+	virtual bool canWrite(const QString& sFormat) const = 0;
+	virtual bool write(const QImage& image, const QString& sPath, const QString& sFormat,
+		const DzBlenderCodecSettings& settings, QString& sErrorMessage) const = 0;
+};
+
+// Qt's image writer plugins, handles every format Qt can write
+class DzBlenderQtImageCodec : public DzBlenderImageCodec
+{
+public:
+	virtual QString getName() const override { return "qt"; }
+	virtual bool canWrite(const QString& sFormat) const override;
+	virtual bool write(const QImage& image, const QString& sPath, const QString& sFormat,
+		const DzBlenderCodecSettings& settings, QString& sErrorMessage) const override;
+};
+
+// NativeTools DzPngImageWriter: parallel filtering and compression, configurable compression level
+class DzBlenderNativePngCodec : public DzBlenderImageCodec
+{
+public:
+	virtual QString getName() const override { return "native-png"; }
+	virtual bool canWrite(const QString& sFormat) const override { return sFormat == "png"; }
+	virtual bool write(const QImage& image, const QString& sPath, const QString& sFormat,
+		const DzBlenderCodecSettings& settings, QString& sErrorMessage) const override;
+};
+
+/*****************************
+DzBlenderImageCodecs
+
+Codec registry used by the texture pipeline to encode processed textures.
+Each format is written by the most recently registered codec that accepts
+it, so a faster encoder (for example a libjpeg-turbo based JPEG codec) can
+be plugged in with RegisterCodec() without touching the pipeline.  The
+native PNG codec is registered on top of the Qt codec by default.  Every
+codec must write the exact pixels it is given, only the file size and
+speed may differ.
+*****************************/
+class DzBlenderImageCodecs
+{
+public:
+	// Takes ownership of pCodec
+	static void RegisterCodec(DzBlenderImageCodec* pCodec);
+	static const DzBlenderImageCodec* FindWriter(const QString& sFormat);
+
+	// Writes with the first codec that accepts sFormat, and returns its name in psCodecName
+	static bool Write(const QImage& image, const QString& sPath, const QString& sFormat,
+		const DzBlenderCodecSettings& settings, QString& sErrorMessage, QString* psCodecName = nullptr);
+};
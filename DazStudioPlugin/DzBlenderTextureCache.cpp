@@ -0,0 +1,352 @@
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qtextstream.h>
+#include <QtCore/qstringlist.h>
+#include <QtGui/qdesktopservices.h>
+#include <QCryptographicHash>
+
+#include <dzapp.h>
+
+#include "DzBlenderTextureCache.h"
+
+#ifdef WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <unistd.h>
+#include <sys/clonefile.h>
+#else
+#include <unistd.h>
+#endif
+
+#define CACHE_INDEX_FILENAME "cache_index.txt"
+#define SOURCE_HASHES_FILENAME "source_hashes.txt"
+
+DzBlenderTextureCache::DzBlenderTextureCache()
+{
+}
+
+DzBlenderTextureCache::~DzBlenderTextureCache()
+{
+	close();
+}
+
+QString DzBlenderTextureCache::GetDefaultCachePath()
+{
+	QString sCachePath = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+	if (sCachePath == "") {
+		sCachePath = dzApp->getTempPath();
+	}
+	return QString(sCachePath + "/DazToBlender/TextureCache").replace("\\", "/");
+}
+
+bool DzBlenderTextureCache::open(const QString& sCachePath, qint64 nMaxSizeInBytes)
+{
+	QMutexLocker locker(&m_mutex);
+
+	m_sCachePath = QString(sCachePath).replace("\\", "/");
+	m_nMaxSize = nMaxSizeInBytes;
+	m_nNumHits = 0;
+	m_nNumMisses = 0;
+	if (QDir().mkpath(m_sCachePath) == false) {
+		dzApp->log("DzBlenderTextureCache: ERROR: unable to create cache folder: " + m_sCachePath);
+		m_bIsOpen = false;
+		return false;
+	}
+	loadIndex();
+	m_bIsOpen = true;
+
+	return true;
+}
+
+void DzBlenderTextureCache::close()
+{
+	QMutexLocker locker(&m_mutex);
+	if (!m_bIsOpen) {
+		return;
+	}
+	evictToSize(m_nMaxSize);
+	if (m_bIndexDirty) {
+		saveIndex();
+	}
+	m_bIsOpen = false;
+}
+
+QString DzBlenderTextureCache::getContentHash(const QString& sFilePath)
+{
+	QFileInfo fileInfo(sFilePath);
+	if (fileInfo.exists() == false) {
+		return "";
+	}
+	qint64 nSize = fileInfo.size();
+	qint64 nModified = fileInfo.lastModified().toTime_t();
+	QString sLookup = QString(sFilePath).replace("\\", "/");
+
+	{
+		QMutexLocker locker(&m_mutex);
+		if (m_mapSourceHashes.contains(sLookup)) {
+			const SourceHashEntry& entry = m_mapSourceHashes[sLookup];
+			if (entry.nSize == nSize && entry.nModified == nModified) {
+				return entry.sHash;
+			}
+		}
+	}
+
+	QFile file(sFilePath);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return "";
+	}
+	QCryptographicHash hasher(QCryptographicHash::Sha1);
+	const qint64 nChunkSize = 1024 * 1024;
+	qint64 nBytes = 0;
+	while (!file.atEnd()) {
+		QByteArray buffer = file.read(nChunkSize);
+		hasher.addData(buffer);
+		nBytes += buffer.size();
+	}
+	file.close();
+	// the length is part of the content hash, so a cached output is only reused for a source of the same size
+	QString sHash = QString(hasher.result().toHex()) + "-" + QString::number(nBytes);
+
+	QMutexLocker locker(&m_mutex);
+	SourceHashEntry entry;
+	entry.nSize = nSize;
+	entry.nModified = nModified;
+	entry.sHash = sHash;
+	m_mapSourceHashes.insert(sLookup, entry);
+	m_bIndexDirty = true;
+
+	return sHash;
+}
+
+QString DzBlenderTextureCache::makeKey(const QString& sContentHash, const QString& sOperationParams) const
+{
+	QByteArray keyData = (sContentHash + "|" + sOperationParams).toUtf8();
+	return QString(QCryptographicHash::hash(keyData, QCryptographicHash::Sha1).toHex());
+}
+
+QString DzBlenderTextureCache::fetch(const QString& sKey, const QString& sDestinationPathNoExt)
+{
+	QString sCachedFilePath;
+	{
+		QMutexLocker locker(&m_mutex);
+		if (!m_bIsOpen || m_mapEntries.contains(sKey) == false) {
+			m_nNumMisses++;
+			return "";
+		}
+		sCachedFilePath = m_sCachePath + "/" + m_mapEntries[sKey].sFilename;
+		if (QFileInfo(sCachedFilePath).exists() == false) {
+			// entry was removed from disk behind our back
+			m_nCurrentSize -= m_mapEntries[sKey].nSize;
+			m_mapEntries.remove(sKey);
+			m_bIndexDirty = true;
+			m_nNumMisses++;
+			return "";
+		}
+	}
+
+	QString sDestinationPath = sDestinationPathNoExt + "." + QFileInfo(sCachedFilePath).suffix();
+	bool bLinked = LinkOrCopyFile(sCachedFilePath, sDestinationPath);
+
+	QMutexLocker locker(&m_mutex);
+	if (bLinked == false) {
+		m_nNumMisses++;
+		return "";
+	}
+	if (m_mapEntries.contains(sKey)) {
+		m_mapEntries[sKey].nLastAccess = QDateTime::currentDateTime().toTime_t();
+		m_bIndexDirty = true;
+	}
+	m_nNumHits++;
+
+	return sDestinationPath;
+}
+
+bool DzBlenderTextureCache::store(const QString& sKey, const QString& sProcessedFilePath)
+{
+	QFileInfo processedInfo(sProcessedFilePath);
+	if (processedInfo.exists() == false) {
+		return false;
+	}
+	QString sFilename = sKey.left(2) + "/" + sKey + "." + processedInfo.suffix().toLower();
+	QString sCachedFilePath = m_sCachePath + "/" + sFilename;
+	QString sTempPath = sCachedFilePath + ".tmp";
+
+	QDir().mkpath(QFileInfo(sCachedFilePath).path());
+	QFile::remove(sTempPath);
+	// link or copy to a temporary name first, so a partially written entry is never visible
+	if (LinkOrCopyFile(sProcessedFilePath, sTempPath) == false) {
+		dzApp->log("DzBlenderTextureCache: ERROR: unable to store cache entry: " + sCachedFilePath);
+		return false;
+	}
+	QFile::remove(sCachedFilePath);
+	if (QFile::rename(sTempPath, sCachedFilePath) == false) {
+		QFile::remove(sTempPath);
+		return false;
+	}
+
+	QMutexLocker locker(&m_mutex);
+	if (m_mapEntries.contains(sKey)) {
+		m_nCurrentSize -= m_mapEntries[sKey].nSize;
+	}
+	CacheEntry entry;
+	entry.sFilename = sFilename;
+	entry.nSize = processedInfo.size();
+	entry.nLastAccess = QDateTime::currentDateTime().toTime_t();
+	m_mapEntries.insert(sKey, entry);
+	m_nCurrentSize += entry.nSize;
+	m_bIndexDirty = true;
+
+	return true;
+}
+
+bool DzBlenderTextureCache::LinkOrCopyFile(const QString& sSourcePath, const QString& sDestinationPath)
+{
+	if (QFileInfo(sDestinationPath).exists()) {
+		QFile::remove(sDestinationPath);
+	}
+#ifdef WIN32
+	if (CreateHardLinkW((LPCWSTR)sDestinationPath.utf16(), (LPCWSTR)sSourcePath.utf16(), NULL)) {
+		return true;
+	}
+#elif defined(__APPLE__)
+	QByteArray source = QFile::encodeName(sSourcePath);
+	QByteArray destination = QFile::encodeName(sDestinationPath);
+	if (clonefile(source.constData(), destination.constData(), 0) == 0) {
+		return true;
+	}
+	if (link(source.constData(), destination.constData()) == 0) {
+		return true;
+	}
+#else
+	QByteArray source = QFile::encodeName(sSourcePath);
+	QByteArray destination = QFile::encodeName(sDestinationPath);
+	if (link(source.constData(), destination.constData()) == 0) {
+		return true;
+	}
+#endif
+	// different volume or unsupported filesystem
+	return QFile::copy(sSourcePath, sDestinationPath);
+}
+
+bool DzBlenderTextureCache::loadIndex()
+{
+	m_mapEntries.clear();
+	m_mapSourceHashes.clear();
+	m_nCurrentSize = 0;
+	m_bIndexDirty = false;
+
+	QFile indexFile(m_sCachePath + "/" + CACHE_INDEX_FILENAME);
+	if (indexFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		QTextStream stream(&indexFile);
+		stream.setCodec("UTF-8");
+		while (!stream.atEnd()) {
+			QStringList aFields = stream.readLine().split("\t");
+			if (aFields.size() != 4) continue;
+			CacheEntry entry;
+			entry.sFilename = aFields[1];
+			entry.nSize = aFields[2].toLongLong();
+			entry.nLastAccess = aFields[3].toLongLong();
+			m_mapEntries.insert(aFields[0], entry);
+			m_nCurrentSize += entry.nSize;
+		}
+		indexFile.close();
+	}
+
+	QFile hashesFile(m_sCachePath + "/" + SOURCE_HASHES_FILENAME);
+	if (hashesFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		QTextStream stream(&hashesFile);
+		stream.setCodec("UTF-8");
+		while (!stream.atEnd()) {
+			QStringList aFields = stream.readLine().split("\t");
+			if (aFields.size() != 4) continue;
+			// hashes from before the length was appended are computed again
+			if (aFields[3].contains("-") == false) continue;
+			SourceHashEntry entry;
+			entry.nSize = aFields[1].toLongLong();
+			entry.nModified = aFields[2].toLongLong();
+			entry.sHash = aFields[3];
+			m_mapSourceHashes.insert(aFields[0], entry);
+		}
+		hashesFile.close();
+	}
+
+	return true;
+}
+
+bool DzBlenderTextureCache::saveIndex()
+{
+	// drop memoized hashes for files that no longer exist, the list would otherwise grow forever
+	QStringList aStaleSources;
+	foreach(QString sSourcePath, m_mapSourceHashes.keys()) {
+		if (QFileInfo(sSourcePath).exists() == false) {
+			aStaleSources.append(sSourcePath);
+		}
+	}
+	foreach(QString sSourcePath, aStaleSources) {
+		m_mapSourceHashes.remove(sSourcePath);
+	}
+
+	QString sIndexPath = m_sCachePath + "/" + CACHE_INDEX_FILENAME;
+	QFile indexFile(sIndexPath + ".tmp");
+	if (!indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+		dzApp->log("DzBlenderTextureCache: ERROR: unable to write cache index: " + sIndexPath);
+		return false;
+	}
+	QTextStream indexStream(&indexFile);
+	indexStream.setCodec("UTF-8");
+	for (QMap<QString, CacheEntry>::const_iterator it = m_mapEntries.constBegin(); it != m_mapEntries.constEnd(); ++it) {
+		indexStream << it.key() << "\t" << it.value().sFilename << "\t" << it.value().nSize << "\t" << it.value().nLastAccess << "\n";
+	}
+	indexStream.flush();
+	indexFile.close();
+	QFile::remove(sIndexPath);
+	QFile::rename(sIndexPath + ".tmp", sIndexPath);
+
+	QString sHashesPath = m_sCachePath + "/" + SOURCE_HASHES_FILENAME;
+	QFile hashesFile(sHashesPath + ".tmp");
+	if (hashesFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+		QTextStream hashesStream(&hashesFile);
+		hashesStream.setCodec("UTF-8");
+		for (QMap<QString, SourceHashEntry>::const_iterator it = m_mapSourceHashes.constBegin(); it != m_mapSourceHashes.constEnd(); ++it) {
+			hashesStream << it.key() << "\t" << it.value().nSize << "\t" << it.value().nModified << "\t" << it.value().sHash << "\n";
+		}
+		hashesStream.flush();
+		hashesFile.close();
+		QFile::remove(sHashesPath);
+		QFile::rename(sHashesPath + ".tmp", sHashesPath);
+	}
+
+	m_bIndexDirty = false;
+	return true;
+}
+
+void DzBlenderTextureCache::evictToSize(qint64 nTargetSize)
+{
+	if (m_nCurrentSize <= nTargetSize) {
+		return;
+	}
+
+	// least recently used first
+	QMultiMap<qint64, QString> mapByAccess;
+	for (QMap<QString, CacheEntry>::const_iterator it = m_mapEntries.constBegin(); it != m_mapEntries.constEnd(); ++it) {
+		mapByAccess.insert(it.value().nLastAccess, it.key());
+	}
+	int nNumEvicted = 0;
+	qint64 nBytesEvicted = 0;
+	for (QMultiMap<qint64, QString>::const_iterator it = mapByAccess.constBegin(); it != mapByAccess.constEnd(); ++it) {
+		if (m_nCurrentSize <= nTargetSize) {
+			break;
+		}
+		const CacheEntry& entry = m_mapEntries[it.value()];
+		QFile::remove(m_sCachePath + "/" + entry.sFilename);
+		m_nCurrentSize -= entry.nSize;
+		nBytesEvicted += entry.nSize;
+		nNumEvicted++;
+		m_mapEntries.remove(it.value());
+	}
+	m_bIndexDirty = true;
+
+	dzApp->log(QString("DzBlenderTextureCache: INFO: evicted %1 entries (%2 MB)").arg(nNumEvicted).arg(nBytesEvicted / (1024 * 1024)));
+}
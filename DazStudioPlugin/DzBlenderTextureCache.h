@@ -0,0 +1,72 @@
+#pragma once
+#include <QtCore/qstring.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qmutex.h>
+
+/*****************************
+DzBlenderTextureCache
+
+Persistent cross-export cache for processed textures.  Entries are keyed by the
+content hash of the source file plus a string describing the operation parameters.
+Cache hits are reflinked (APFS), hardlinked or copied into the intermediate folder.
+The cache is bounded in size and evicts least-recently-used entries first.
+*****************************/
+class DzBlenderTextureCache
+{
+public:
+	DzBlenderTextureCache();
+	~DzBlenderTextureCache();
+
+	static QString GetDefaultCachePath();
+
+	// Loads the cache index.  Must be called before any other method.
+	bool open(const QString& sCachePath, qint64 nMaxSizeInBytes);
+	// Evicts entries over the size limit and saves the index.
+	void close();
+	bool isOpen() const { return m_bIsOpen; }
+
+	// Content hash of a source file, memoized by path, size and modification time
+	QString getContentHash(const QString& sFilePath);
+	QString makeKey(const QString& sContentHash, const QString& sOperationParams) const;
+
+	// On hit, places the cached file at sDestinationPathNoExt + cached extension and returns the full path.
+	// Returns an empty string on miss.
+	QString fetch(const QString& sKey, const QString& sDestinationPathNoExt);
+	// Stores a processed file in the cache.  The file itself is left in place.
+	bool store(const QString& sKey, const QString& sProcessedFilePath);
+
+	int getNumHits() const { return m_nNumHits; }
+	int getNumMisses() const { return m_nNumMisses; }
+	qint64 getCurrentSize() const { return m_nCurrentSize; }
+
+	// Reflink, hardlink or copy, in order of preference
+	static bool LinkOrCopyFile(const QString& sSourcePath, const QString& sDestinationPath);
+
+protected:
+	struct CacheEntry {
+		QString sFilename;
+		qint64 nSize = 0;
+		qint64 nLastAccess = 0;
+	};
+	struct SourceHashEntry {
+		qint64 nSize = 0;
+		qint64 nModified = 0;
+		QString sHash;
+	};
+
+	bool loadIndex();
+	bool saveIndex();
+	void evictToSize(qint64 nTargetSize);
+
+	QString m_sCachePath = "";
+	qint64 m_nMaxSize = 0;
+	qint64 m_nCurrentSize = 0;
+	bool m_bIsOpen = false;
+	bool m_bIndexDirty = false;
+	int m_nNumHits = 0;
+	int m_nNumMisses = 0;
+
+	QMap<QString, CacheEntry> m_mapEntries;
+	QMap<QString, SourceHashEntry> m_mapSourceHashes;
+	QMutex m_mutex;
+};
@@ -0,0 +1,2144 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qthreadpool.h>
+#include <QtCore/qrunnable.h>
+#include <QtCore/qset.h>
+#include <QtCore/qvector.h>
+#include <QtGui/qimage.h>
+#include <QtGui/qcolor.h>
+#include <QtGui/qimagereader.h>
+#include <QtScript/qscriptengine.h>
+
+#include <dzapp.h>
+#include <dzjsonwriter.h>
+#include "dzprogress.h"
+
+#include "DzBlenderTexturePipeline.h"
+#include "DzBlenderImageCodecs.h"
+#include "DzBlockCompression.h"
+#include "DzContentHash.h"
+#include "DzImageResampler.h"
+#include "DzImageKernels.h"
+#include "DzNativeMemory.h"
+#include "DzPngStream.h"
+#include "DzTextureStream.h"
+
+// rows per strip for DzTextureStream jobs
+static const int kStripRows = 64;
+// read size when hashing texture files
+static const qint64 kHashChunkBytes = 1024 * 1024;
+
+// same naming as the low resolution variants blender_tools.swap_lowres_filename() looks for
+static QString getVariantSuffix(int nSize)
+{
+	if (nSize % 1024 == 0) {
+		return QString("_%1k").arg(nSize / 1024);
+	}
+	return QString("_%1").arg(nSize);
+}
+
+// Decoded image, its 32 bit copy, the mip chain (a third of the image) and the largest level's blocks
+static qint64 getDdsBytes(const QSize& size)
+{
+	if (size.isValid() == false) {
+		return 0;
+	}
+	qint64 nPixels = (qint64)size.width() * size.height();
+	return nPixels * 4 * 2 + nPixels * 4 / 3 + nPixels;
+}
+
+class DzBlenderTextureTask : public QRunnable
+{
+public:
+	DzBlenderTextureTask(std::function<void()> fnTask) : m_fnTask(fnTask) { setAutoDelete(true); }
+	virtual void run() override { m_fnTask(); }
+
+protected:
+	std::function<void()> m_fnTask;
+};
+
+// Holds part of the texture memory budget for the lifetime of one job, and measures how long the job waited for it
+class DzBlenderMemoryReservation
+{
+public:
+	DzBlenderMemoryReservation(QSemaphore& budget) : m_budget(budget) {}
+	~DzBlenderMemoryReservation() { m_budget.release(m_nMB); }
+
+	// Takes nMB only if they are free right now
+	bool tryAcquire(int nMB)
+	{
+		if (m_budget.tryAcquire(nMB) == false) {
+			return false;
+		}
+		m_nMB = nMB;
+		return true;
+	}
+	// Waits until nMB are free
+	void acquire(int nMB)
+	{
+		QTime waitTimer;
+		waitTimer.start();
+		m_budget.acquire(nMB);
+		m_nMB = nMB;
+		m_nWaitMs = waitTimer.elapsed();
+	}
+
+	qint64 getWaitMs() const { return m_nWaitMs; }
+
+protected:
+	QSemaphore& m_budget;
+	int m_nMB = 0;
+	qint64 m_nWaitMs = 0;
+};
+
+DzBlenderTexturePipeline::DzBlenderTexturePipeline()
+{
+}
+
+DzBlenderTexturePipeline::~DzBlenderTexturePipeline()
+{
+	// never let the worker outlive the object that owns its state
+	finishDtu("");
+	wait();
+}
+
+void DzBlenderTexturePipeline::prepareManifest(const QString& sManifestPath, const QString& sOutputFolder)
+{
+	finishDtu("");
+	wait();
+
+	m_sManifestPath = sManifestPath;
+	m_sOutputFolder = sOutputFolder;
+	if (QFileInfo(m_sManifestPath).exists()) {
+		QFile::remove(m_sManifestPath);
+	}
+	if (QFileInfo(m_sManifestPath + ".tmp").exists()) {
+		QFile::remove(m_sManifestPath + ".tmp");
+	}
+}
+
+bool DzBlenderTexturePipeline::startImageJobs()
+{
+	// only one batch of jobs may be in flight at a time
+	finishDtu("");
+	wait();
+
+	m_bJobsSucceeded = false;
+	m_aErrorMessages.clear();
+	m_nElapsedMs = 0;
+	m_aTextures.clear();
+	m_mapTextureRemap.clear();
+	m_aMaterialOverrides.clear();
+	m_aJobStats.clear();
+	m_mapDuplicateTextures.clear();
+	m_nUniqueTextures = 0;
+	m_nDeduplicatedBytes = 0;
+	m_aOrmTextures.clear();
+	m_mapPackedProperties.clear();
+	m_mapTextureVariants.clear();
+	m_aCompressedTextures.clear();
+	m_mapTextureSizing.clear();
+	m_mapTextureStatistics.clear();
+	m_nCollapsedTextures = 0;
+	m_nSizingBytesBefore = 0;
+	m_nSizingBytesAfter = 0;
+	m_mutex.lock();
+	m_bDtuReady = false;
+	m_sDtuPath = "";
+	m_mutex.unlock();
+
+	dzApp->log("DzBlenderTexturePipeline: INFO: starting background texture jobs...");
+	start(QThread::LowPriority);
+
+	return true;
+}
+
+void DzBlenderTexturePipeline::finishDtu(const QString& sDtuPath)
+{
+	QMutexLocker locker(&m_mutex);
+	if (m_bDtuReady) {
+		return;
+	}
+	m_sDtuPath = sDtuPath;
+	m_bDtuReady = true;
+	m_dtuReadyCondition.wakeAll();
+}
+
+bool DzBlenderTexturePipeline::waitForImageJobs(bool bShowProgress)
+{
+	if (isRunning() == false) {
+		return m_bJobsSucceeded;
+	}
+
+	// the worker can not finish without a DTU, never block on a DTU that will not come
+	finishDtu("");
+
+	DzProgress* pProgress = nullptr;
+	if (bShowProgress) {
+		pProgress = new DzProgress("Finishing texture processing", 0, false, true);
+		pProgress->enable(true);
+	}
+	while (wait(200) == false) {
+		if (pProgress) pProgress->step();
+	}
+	if (pProgress) {
+		pProgress->finish();
+		delete pProgress;
+	}
+
+	return m_bJobsSucceeded;
+}
+
+void DzBlenderTexturePipeline::setMaterialAreas(const QMap<QString, DzBlenderMaterialArea>& mapMaterialAreas)
+{
+	QMutexLocker locker(&m_mutex);
+	for (QMap<QString, DzBlenderMaterialArea>::const_iterator it = mapMaterialAreas.constBegin(); it != mapMaterialAreas.constEnd(); ++it) {
+		m_mapMaterialAreas.insert(it.key(), it.value());
+	}
+}
+
+void DzBlenderTexturePipeline::run()
+{
+	QTime timer;
+	timer.start();
+
+	m_bJobsSucceeded = true;
+	m_mutex.lock();
+	while (m_bDtuReady == false) {
+		m_dtuReadyCondition.wait(&m_mutex);
+	}
+	QString sDtuPath = m_sDtuPath;
+	m_mutex.unlock();
+
+	bool bTextureJobs = m_oSettings.hasTransforms() || m_oSettings.bWriteCompressedTextures || m_oSettings.bCollapseConstantTextures;
+	if (sDtuPath != "" && (bTextureJobs || m_oSettings.bDeduplicateTextures)) {
+		QVariantList aMaterials;
+		if (loadDtuMaterials(aMaterials)) {
+			if (m_oSettings.bDeduplicateTextures) {
+				deduplicateTextures(aMaterials);
+			}
+			if (bTextureJobs) {
+				beginTextureJobs();
+			}
+			if (m_oSettings.bCollapseConstantTextures) {
+				analyzeTextures(aMaterials);
+			}
+			if (m_oSettings.bAutoTextureSize) {
+				selectTextureSizes(aMaterials);
+			}
+			if (m_oSettings.hasTransforms() && collectTextures(aMaterials)) {
+				runTextureStages();
+			}
+			remapDuplicateTextures();
+			// last, so that it compresses the textures Blender actually ends up using
+			if (m_oSettings.bWriteCompressedTextures) {
+				compressTextures(aMaterials);
+			}
+			if (bTextureJobs) {
+				endTextureJobs();
+			}
+		}
+	}
+	m_nElapsedMs = timer.elapsed();
+
+	writeManifest();
+
+	// areas belong to this export only
+	m_mutex.lock();
+	m_mapMaterialAreas.clear();
+	m_mutex.unlock();
+
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: background texture jobs %1 in %2 ms.")
+		.arg(m_bJobsSucceeded ? "completed" : "FAILED")
+		.arg(m_nElapsedMs));
+}
+
+bool DzBlenderTexturePipeline::loadDtuMaterials(QVariantList& aMaterials)
+{
+	QFile dtuFile(m_sDtuPath);
+	if (!dtuFile.open(QIODevice::ReadOnly)) {
+		logError("Unable to open DTU for reading: " + m_sDtuPath);
+		return false;
+	}
+	QString sJson = QString::fromUtf8(dtuFile.readAll());
+	dtuFile.close();
+
+	QScriptEngine engine;
+	QScriptValue dtuRoot = engine.evaluate("(" + sJson + ")");
+	if (engine.hasUncaughtException()) {
+		logError("Unable to parse DTU: " + m_sDtuPath + ", " + engine.uncaughtException().toString());
+		return false;
+	}
+	aMaterials = dtuRoot.property("Materials").toVariant().toList();
+
+	return true;
+}
+
+// Streams the whole file through XXH64, nBytes is the length that was hashed
+static bool hashTextureFile(const QString& sPath, quint64& nHash, qint64& nBytes)
+{
+	QFile file(sPath);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	DzContentHash hash;
+	QByteArray buffer;
+	while (file.atEnd() == false) {
+		buffer = file.read(kHashChunkBytes);
+		if (buffer.isEmpty()) {
+			return false;
+		}
+		hash.update(buffer.constData(), buffer.size());
+		nBytes += buffer.size();
+	}
+	nHash = hash.finish();
+	return true;
+}
+
+void DzBlenderTexturePipeline::deduplicateTextures(QVariantList& aMaterials)
+{
+	QTime timer;
+	timer.start();
+
+	// every referenced file in DTU order, the first reference of a content becomes its canonical path
+	QStringList aPaths;
+	QSet<QString> setPaths;
+	foreach(QVariant vMaterial, aMaterials) {
+		foreach(QVariant vProperty, vMaterial.toMap().value("Properties").toList()) {
+			QString sTexture = vProperty.toMap().value("Texture").toString();
+			if (sTexture == "" || setPaths.contains(sTexture)) {
+				continue;
+			}
+			setPaths.insert(sTexture);
+			if (QFileInfo(sTexture).isFile()) {
+				aPaths.append(sTexture);
+			}
+		}
+	}
+
+	// different spellings of the same file are duplicates without reading it, the rest is grouped by size
+	QMap<QString, QString> mapFileIdentity;
+	QMap<qint64, QStringList> mapSizeGroups;
+	QMap<QString, qint64> mapFileSize;
+	foreach(QString sPath, aPaths) {
+		QFileInfo fileInfo(sPath);
+		QString sIdentity = fileInfo.canonicalFilePath();
+#ifdef WIN32
+		sIdentity = sIdentity.toLower();
+#endif
+		mapFileSize.insert(sPath, fileInfo.size());
+		if (mapFileIdentity.contains(sIdentity)) {
+			m_mapDuplicateTextures.insert(sPath, mapFileIdentity[sIdentity]);
+			continue;
+		}
+		mapFileIdentity.insert(sIdentity, sPath);
+		mapSizeGroups[fileInfo.size()].append(sPath);
+	}
+
+	// only files sharing their size with another file can have identical contents
+	QStringList aHashPaths;
+	foreach(QStringList aGroup, mapSizeGroups) {
+		if (aGroup.size() > 1) {
+			aHashPaths.append(aGroup);
+		}
+	}
+	QVector<quint64> aHashes(aHashPaths.size(), 0);
+	QVector<qint64> aHashedBytes(aHashPaths.size(), 0);
+	QVector<bool> aHashed(aHashPaths.size(), false);
+	QThreadPool threadPool;
+	threadPool.setMaxThreadCount(QThread::idealThreadCount());
+	for (int i = 0; i < aHashPaths.size(); i++) {
+		QString sPath = aHashPaths[i];
+		quint64* pHash = &aHashes[i];
+		qint64* pBytes = &aHashedBytes[i];
+		bool* pHashed = &aHashed[i];
+		threadPool.start(new DzBlenderTextureTask([sPath, pHash, pBytes, pHashed]() {
+			*pHashed = hashTextureFile(sPath, *pHash, *pBytes);
+		}));
+	}
+	threadPool.waitForDone();
+
+	QMap<QString, int> mapHashIndex;
+	for (int i = 0; i < aHashPaths.size(); i++) {
+		if (aHashed[i] == false) {
+			dzApp->log("DzBlenderTexturePipeline: WARNING: unable to read texture for deduplication: " + aHashPaths[i]);
+			continue;
+		}
+		mapHashIndex.insert(aHashPaths[i], i);
+	}
+	// a hash match alone is not proof of identical content: the hashed lengths have to agree as well, so a file that
+	// changed after it was sized, or a collision with another length, never replaces a texture
+	foreach(QStringList aGroup, mapSizeGroups) {
+		QMap<quint64, QString> mapCanonical;
+		foreach(QString sPath, aGroup) {
+			if (mapHashIndex.contains(sPath) == false) {
+				continue;
+			}
+			int nIndex = mapHashIndex[sPath];
+			quint64 nHash = aHashes[nIndex];
+			if (mapCanonical.contains(nHash) == false) {
+				mapCanonical.insert(nHash, sPath);
+				continue;
+			}
+			QString sCanonical = mapCanonical[nHash];
+			qint64 nBytes = aHashedBytes[nIndex];
+			if (nBytes == aHashedBytes[mapHashIndex[sCanonical]] && nBytes == mapFileSize.value(sPath)
+				&& QFileInfo(sPath).size() == QFileInfo(sCanonical).size()) {
+				m_mapDuplicateTextures.insert(sPath, sCanonical);
+			}
+			else {
+				dzApp->log("DzBlenderTexturePipeline: WARNING: texture hash matches but the size differs, not deduplicated: " + sPath);
+			}
+		}
+	}
+
+	m_nUniqueTextures = aPaths.size() - m_mapDuplicateTextures.size();
+	m_nDeduplicatedBytes = 0;
+	for (QMap<QString, QString>::const_iterator it = m_mapDuplicateTextures.constBegin(); it != m_mapDuplicateTextures.constEnd(); ++it) {
+		m_nDeduplicatedBytes += mapFileSize.value(it.key());
+	}
+
+	// the texture stages only ever see canonical paths
+	if (m_mapDuplicateTextures.isEmpty() == false) {
+		for (int nMaterialIndex = 0; nMaterialIndex < aMaterials.size(); nMaterialIndex++) {
+			QVariantMap material = aMaterials[nMaterialIndex].toMap();
+			QVariantList aProperties = material.value("Properties").toList();
+			for (int nPropertyIndex = 0; nPropertyIndex < aProperties.size(); nPropertyIndex++) {
+				QVariantMap property = aProperties[nPropertyIndex].toMap();
+				QString sTexture = property.value("Texture").toString();
+				if (m_mapDuplicateTextures.contains(sTexture)) {
+					property.insert("Texture", m_mapDuplicateTextures[sTexture]);
+					aProperties[nPropertyIndex] = property;
+				}
+			}
+			material.insert("Properties", aProperties);
+			aMaterials[nMaterialIndex] = material;
+		}
+	}
+
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: texture deduplication: %1 files, %2 unique, %3 duplicates, %4 bytes saved, %5 files hashed in %6 ms.")
+		.arg(aPaths.size()).arg(m_nUniqueTextures).arg(m_mapDuplicateTextures.size())
+		.arg(m_nDeduplicatedBytes).arg(aHashPaths.size()).arg(timer.elapsed()));
+}
+
+// Points every duplicate at whatever its canonical texture became
+void DzBlenderTexturePipeline::remapDuplicateTextures()
+{
+	for (QMap<QString, QString>::const_iterator it = m_mapDuplicateTextures.constBegin(); it != m_mapDuplicateTextures.constEnd(); ++it) {
+		m_mapTextureRemap.insert(it.key(), m_mapTextureRemap.value(it.value(), it.value()));
+	}
+}
+
+// Statistics of every referenced texture, computed in parallel, then maps that carry a single value are collapsed
+void DzBlenderTexturePipeline::analyzeTextures(QVariantList& aMaterials)
+{
+	QTime timer;
+	timer.start();
+
+	m_mapTextureStatistics.clear();
+	QStringList aTextures;
+	foreach(QVariant vMaterial, aMaterials) {
+		foreach(QVariant vProperty, vMaterial.toMap().value("Properties").toList()) {
+			QString sTexture = vProperty.toMap().value("Texture").toString();
+			if (sTexture != "" && aTextures.contains(sTexture) == false && QFileInfo(sTexture).isFile()) {
+				aTextures.append(sTexture);
+			}
+		}
+	}
+
+	QList<DzBlenderTextureJob> aJobs;
+	foreach(QString sTexture, aTextures) {
+		DzBlenderTextureJob job;
+		job.sName = sTexture;
+		job.nReservationBytes = getStatisticsBytes(sTexture);
+		job.fnRun = [this, sTexture](const DzBlenderMemoryReservation&) {
+			DzImageStatistics stats;
+			if (computeTextureStatistics(sTexture, stats)) {
+				QMutexLocker locker(&m_mutex);
+				m_mapTextureStatistics.insert(sTexture, stats);
+			}
+		};
+		aJobs.append(job);
+	}
+	runJobs(aJobs);
+
+	collapseConstantTextures(aMaterials);
+
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: analyzed %1 textures in %2 ms, %3 constant map references replaced by values.")
+		.arg(m_mapTextureStatistics.size()).arg(timer.elapsed()).arg(m_nCollapsedTextures));
+}
+
+// A strip of a PNG file, or the whole decoded image and its 32 bit copy
+qint64 DzBlenderTexturePipeline::getStatisticsBytes(const QString& sTexture)
+{
+	QSize size = QImageReader(sTexture).size();
+	if (size.isValid() == false) {
+		return 0;
+	}
+	if (DzTextureStream::CanStream(sTexture.toUtf8().constData())) {
+		return (qint64)DzTextureStream::EstimateBufferBytes(size.width(), 1, kStripRows, false);
+	}
+	return (qint64)size.width() * size.height() * 4 * 2;
+}
+
+// PNG files are read in strips, other formats are decoded whole.  Results are kept in the texture
+// cache as small text files, so unchanged textures are only decoded once.  The files pass through the
+// temp folder, never the exported texture folder.
+bool DzBlenderTexturePipeline::computeTextureStatistics(const QString& sTexture, DzImageStatistics& stats)
+{
+	QString sKey = "";
+	QString sStatsPath = "";
+	if (m_oTextureCache.isOpen()) {
+		sKey = m_oTextureCache.makeKey(m_oTextureCache.getContentHash(sTexture), "stats:v1");
+		QString sStatsPathNoExt = QDir::tempPath() + "/dzstats_" + sKey;
+		QString sCachedPath = m_oTextureCache.fetch(sKey, sStatsPathNoExt);
+		if (sCachedPath != "") {
+			QFile statsFile(sCachedPath);
+			QStringList aValues;
+			if (statsFile.open(QIODevice::ReadOnly)) {
+				aValues = QString::fromLatin1(statsFile.readAll()).split(" ", QString::SkipEmptyParts);
+				statsFile.close();
+			}
+			QFile::remove(sCachedPath);
+			if (aValues.size() == 15 && aValues[0] == "dzstats1") {
+				stats.nPixels = aValues[1].toULongLong();
+				stats.nMaxChroma = (uint8_t)aValues[2].toUInt();
+				for (int c = 0; c < 4; c++) {
+					stats.aMin[c] = (uint8_t)aValues[3 + c].toUInt();
+					stats.aMax[c] = (uint8_t)aValues[7 + c].toUInt();
+					stats.aSum[c] = aValues[11 + c].toULongLong();
+				}
+				return true;
+			}
+		}
+		sStatsPath = sStatsPathNoExt + ".stats";
+	}
+
+	QByteArray sUtf8Path = sTexture.toUtf8();
+	if (DzTextureStream::CanStream(sUtf8Path.constData())) {
+		DzPngStripReader reader;
+		if (reader.open(sUtf8Path.constData()) == false) {
+			logError("Unable to read texture: " + sTexture + ", " + QString::fromUtf8(reader.getErrorString().c_str()));
+			return false;
+		}
+		std::vector<uint32_t> aStrip((size_t)reader.getWidth() * kStripRows);
+		for (int nRow = 0; nRow < reader.getHeight(); ) {
+			int nRows = reader.readRows(aStrip.data(), kStripRows);
+			if (nRows <= 0) {
+				logError("Unable to decode texture: " + sTexture + ", " + QString::fromUtf8(reader.getErrorString().c_str()));
+				return false;
+			}
+			DzImageKernels::AccumulateStatistics(aStrip.data(), (size_t)nRows * reader.getWidth(), stats);
+			nRow += nRows;
+		}
+	}
+	else {
+		QImageReader reader(sTexture);
+		QImage image = reader.read();
+		if (image.isNull()) {
+			logError("Unable to decode texture: " + sTexture + ", " + reader.errorString());
+			return false;
+		}
+		if (image.format() != QImage::Format_ARGB32) {
+			image = image.convertToFormat(QImage::Format_ARGB32);
+		}
+		for (int y = 0; y < image.height(); y++) {
+			DzImageKernels::AccumulateStatistics(reinterpret_cast<const uint32_t*>(image.constScanLine(y)), image.width(), stats);
+		}
+	}
+
+	if (sStatsPath != "") {
+		QString sValues = QString("dzstats1 %1 %2").arg((qulonglong)stats.nPixels).arg(stats.nMaxChroma);
+		for (int c = 0; c < 4; c++) sValues += QString(" %1").arg(stats.aMin[c]);
+		for (int c = 0; c < 4; c++) sValues += QString(" %1").arg(stats.aMax[c]);
+		for (int c = 0; c < 4; c++) sValues += QString(" %1").arg((qulonglong)stats.aSum[c]);
+		QFile statsFile(sStatsPath);
+		if (statsFile.open(QIODevice::WriteOnly) && statsFile.write(sValues.toLatin1()) > 0) {
+			statsFile.close();
+			m_oTextureCache.store(sKey, sStatsPath);
+		}
+		statsFile.close();
+		QFile::remove(sStatsPath);
+	}
+	return true;
+}
+
+// Daz multiplies a map with the property value, so a constant map becomes value * mean.  Normal and
+// bump maps only carry information in their variation: a constant one is dropped and the strength kept.
+void DzBlenderTexturePipeline::collapseConstantTextures(QVariantList& aMaterials)
+{
+	int nTolerance = m_oSettings.nConstantTextureTolerance;
+	m_nCollapsedTextures = 0;
+	for (int nMaterialIndex = 0; nMaterialIndex < aMaterials.size(); nMaterialIndex++) {
+		QVariantMap material = aMaterials[nMaterialIndex].toMap();
+		QVariantList aProperties = material.value("Properties").toList();
+		bool bChanged = false;
+		for (int nPropertyIndex = 0; nPropertyIndex < aProperties.size(); nPropertyIndex++) {
+			QVariantMap property = aProperties[nPropertyIndex].toMap();
+			QString sPropertyName = property.value("Name").toString();
+			QString sTexture = property.value("Texture").toString();
+			if (sTexture == "" || m_mapTextureStatistics.contains(sTexture) == false) {
+				continue;
+			}
+			const DzImageStatistics& stats = m_mapTextureStatistics[sTexture];
+			if (stats.isConstant(nTolerance) == false || sPropertyName.contains("Displacement")) {
+				continue;
+			}
+
+			QVariant vValue = property.value("Value");
+			QString sValue = "";
+			if (sPropertyName == "Normal Map" || sPropertyName.contains("Bump")) {
+				// a normal map must also be a flat tangent space normal
+				if (sPropertyName == "Normal Map" && (qAbs(stats.getMean(0) - 128.0) > nTolerance + 1 ||
+					qAbs(stats.getMean(1) - 128.0) > nTolerance + 1 || stats.getMean(2) < 254.0 - nTolerance))
+				{
+					continue;
+				}
+			}
+			else if (vValue.type() == QVariant::String && vValue.toString().startsWith("#")) {
+				// the alpha of a color map can still be used as a cutout
+				QColor color(vValue.toString());
+				if (color.isValid() == false || stats.usesAlpha()) {
+					continue;
+				}
+				color.setRgb(qRound(color.red() * stats.getMean(0) / 255.0), qRound(color.green() * stats.getMean(1) / 255.0),
+					qRound(color.blue() * stats.getMean(2) / 255.0));
+				sValue = color.name();
+			}
+			else if (vValue.type() == QVariant::Double || vValue.type() == QVariant::Int || vValue.type() == QVariant::LongLong) {
+				double fMean = (0.2126 * stats.getMean(0) + 0.7152 * stats.getMean(1) + 0.0722 * stats.getMean(2)) / 255.0;
+				sValue = QString::number(vValue.toDouble() * fMean, 'g', 6);
+			}
+			else {
+				continue;
+			}
+
+			property.insert("Texture", QString(""));
+			if (sValue != "") {
+				property.insert("Value", sValue);
+			}
+			aProperties[nPropertyIndex] = property;
+			bChanged = true;
+
+			DzBlenderMaterialOverride target;
+			target.nMaterialIndex = nMaterialIndex;
+			target.sPropertyName = sPropertyName;
+			target.sValue = sValue;
+			m_aMaterialOverrides.append(target);
+			m_nCollapsedTextures++;
+		}
+		if (bChanged) {
+			material.insert("Properties", aProperties);
+			aMaterials[nMaterialIndex] = material;
+		}
+	}
+}
+
+// Texel density of a texture on a material is sqrt(texels * UV area / surface area).  Each texture
+// gets the smallest power of two longest edge that reaches the target density on every material
+// using it, never larger than the source.  Over the budget, the texture with the highest density
+// is halved until the total fits.
+void DzBlenderTexturePipeline::selectTextureSizes(const QVariantList& aMaterials)
+{
+	static const int kMinAutoTextureSize = 128;
+
+	m_mapTextureSizing.clear();
+	m_mutex.lock();
+	QMap<QString, DzBlenderMaterialArea> mapMaterialAreas = m_mapMaterialAreas;
+	m_mutex.unlock();
+
+	QSet<QString> setUnmeasured;
+	foreach(QVariant vMaterial, aMaterials) {
+		QVariantMap material = vMaterial.toMap();
+		DzBlenderMaterialArea area = mapMaterialAreas.value(material.value("Material Name").toString());
+		bool bMeasured = area.fSurfaceArea > 0.0 && area.fUVArea > 0.0;
+		foreach(QVariant vProperty, material.value("Properties").toList()) {
+			QString sTexture = vProperty.toMap().value("Texture").toString();
+			if (sTexture == "") {
+				continue;
+			}
+			if (m_mapTextureSizing.contains(sTexture) == false) {
+				QSize sourceSize = QImageReader(sTexture).size();
+				if (sourceSize.isValid() == false) {
+					continue;
+				}
+				DzBlenderTextureSizing sizing;
+				sizing.sourceSize = sourceSize;
+				sizing.size = sourceSize;
+				m_mapTextureSizing.insert(sTexture, sizing);
+			}
+			DzBlenderTextureSizing& sizing = m_mapTextureSizing[sTexture];
+			if (bMeasured == false) {
+				// unknown density, keep the source size
+				setUnmeasured.insert(sTexture);
+				continue;
+			}
+			double fDensity = sqrt((double)sizing.sourceSize.width() * sizing.sourceSize.height() * area.fUVArea / area.fSurfaceArea);
+			if (sizing.fSourceTexelDensity == 0.0 || fDensity < sizing.fSourceTexelDensity) {
+				sizing.fSourceTexelDensity = fDensity;
+			}
+		}
+	}
+
+	auto getLongestEdge = [](const QSize& size) { return qMax(size.width(), size.height()); };
+	auto setLongestEdge = [&](DzBlenderTextureSizing& sizing, int nLongestEdge) {
+		sizing.size = nLongestEdge >= getLongestEdge(sizing.sourceSize) ? sizing.sourceSize :
+			sizing.sourceSize.scaled(QSize(nLongestEdge, nLongestEdge), Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+	};
+	auto getDensity = [&](const DzBlenderTextureSizing& sizing) {
+		return sizing.fSourceTexelDensity * getLongestEdge(sizing.size) / getLongestEdge(sizing.sourceSize);
+	};
+
+	m_nSizingBytesBefore = 0;
+	m_nSizingBytesAfter = 0;
+	for (QMap<QString, DzBlenderTextureSizing>::iterator it = m_mapTextureSizing.begin(); it != m_mapTextureSizing.end(); ++it) {
+		DzBlenderTextureSizing& sizing = it.value();
+		if (setUnmeasured.contains(it.key())) {
+			sizing.fSourceTexelDensity = 0.0;
+		}
+		if (sizing.fSourceTexelDensity > 0.0) {
+			int nSourceEdge = getLongestEdge(sizing.sourceSize);
+			double fRequiredEdge = nSourceEdge * m_oSettings.fTargetTexelDensity / sizing.fSourceTexelDensity;
+			int nEdge = kMinAutoTextureSize;
+			while (nEdge < fRequiredEdge && nEdge < nSourceEdge) {
+				nEdge *= 2;
+			}
+			setLongestEdge(sizing, nEdge);
+		}
+		m_nSizingBytesBefore += (qint64)sizing.sourceSize.width() * sizing.sourceSize.height() * 4;
+		m_nSizingBytesAfter += (qint64)sizing.size.width() * sizing.size.height() * 4;
+	}
+
+	qint64 nBudgetBytes = (qint64)m_oSettings.nAutoTextureBudgetMB * 1024 * 1024;
+	while (nBudgetBytes > 0 && m_nSizingBytesAfter > nBudgetBytes) {
+		DzBlenderTextureSizing* pDensest = nullptr;
+		for (QMap<QString, DzBlenderTextureSizing>::iterator it = m_mapTextureSizing.begin(); it != m_mapTextureSizing.end(); ++it) {
+			DzBlenderTextureSizing& sizing = it.value();
+			if (sizing.fSourceTexelDensity > 0.0 && getLongestEdge(sizing.size) / 2 >= kMinAutoTextureSize &&
+				(pDensest == nullptr || getDensity(sizing) > getDensity(*pDensest)))
+			{
+				pDensest = &sizing;
+			}
+		}
+		if (pDensest == nullptr) {
+			dzApp->log(QString("DzBlenderTexturePipeline: INFO: texture sizes do not fit the %1 MB budget, unmeasured textures are kept at their source size.")
+				.arg(m_oSettings.nAutoTextureBudgetMB));
+			break;
+		}
+		m_nSizingBytesAfter -= (qint64)pDensest->size.width() * pDensest->size.height() * 4;
+		setLongestEdge(*pDensest, getLongestEdge(pDensest->size) / 2);
+		m_nSizingBytesAfter += (qint64)pDensest->size.width() * pDensest->size.height() * 4;
+	}
+
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: texel density sizing: %1 textures (%2 not measured), %3 MB -> %4 MB.")
+		.arg(m_mapTextureSizing.size()).arg(setUnmeasured.size())
+		.arg(m_nSizingBytesBefore / (1024.0 * 1024.0), 0, 'f', 1)
+		.arg(m_nSizingBytesAfter / (1024.0 * 1024.0), 0, 'f', 1));
+}
+
+// The resize cap applies to every texture, the texel density size can only make it smaller.  A texture
+// combined from several sources gets the largest density size of its sources.
+QSize DzBlenderTexturePipeline::getTargetSize(const QStringList& aSourcePaths, const QSize& sourceSize) const
+{
+	QSize targetSize = sourceSize;
+	if (m_oSettings.bResizeTextures &&
+		(sourceSize.width() > m_oSettings.qTargetTextureSize.width() || sourceSize.height() > m_oSettings.qTargetTextureSize.height()))
+	{
+		targetSize = sourceSize.scaled(m_oSettings.qTargetTextureSize, Qt::KeepAspectRatio);
+	}
+	if (m_oSettings.bAutoTextureSize == false) {
+		return targetSize;
+	}
+	int nAutoEdge = 0;
+	foreach(QString sPath, aSourcePaths) {
+		if (sPath == "") {
+			continue;
+		}
+		DzBlenderTextureSizing sizing = m_mapTextureSizing.value(sPath);
+		if (sizing.fSourceTexelDensity <= 0.0) {
+			return targetSize;
+		}
+		nAutoEdge = qMax(nAutoEdge, qMax(sizing.size.width(), sizing.size.height()));
+	}
+	if (nAutoEdge > 0 && nAutoEdge < qMax(targetSize.width(), targetSize.height())) {
+		targetSize = sourceSize.scaled(QSize(nAutoEdge, nAutoEdge), Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+	}
+	return targetSize;
+}
+
+bool DzBlenderTexturePipeline::collectTextures(const QVariantList& aMaterials)
+{
+	m_aTextures.clear();
+	m_aOrmTextures.clear();
+	m_mapPackedProperties.clear();
+
+	QMap<QString, int> mapTextureIndex;
+	QMap<QString, int> mapOperationIndex;
+	QMap<QString, int> mapOrmIndex;
+	for (int nMaterialIndex = 0; nMaterialIndex < aMaterials.size(); nMaterialIndex++) {
+		QVariantMap material = aMaterials[nMaterialIndex].toMap();
+		QStringList aPackedProperties;
+		if (m_oSettings.bPackOrmTextures) {
+			aPackedProperties = collectOrmTexture(nMaterialIndex, material, mapOrmIndex);
+			if (aPackedProperties.isEmpty() == false) {
+				m_mapPackedProperties.insert(nMaterialIndex, aPackedProperties);
+			}
+		}
+		if (m_oSettings.hasMaterialOperations()) {
+			collectMaterialOperations(nMaterialIndex, material, mapOperationIndex);
+		}
+		if (m_oSettings.hasFileTransforms() == false) {
+			continue;
+		}
+		QString sMaterialName = material.value("Material Name").toString();
+		foreach(QVariant vProperty, material.value("Properties").toList()) {
+			QVariantMap property = vProperty.toMap();
+			QString sTexture = property.value("Texture").toString();
+			if (sTexture == "" || QFileInfo(sTexture).isFile() == false) {
+				continue;
+			}
+			// only the packed texture is loaded for these
+			if (aPackedProperties.contains(property.value("Name").toString())) {
+				continue;
+			}
+			if (mapTextureIndex.contains(sTexture) == false) {
+				DzBlenderTextureRecord record;
+				record.sDtuPath = sTexture;
+				mapTextureIndex.insert(sTexture, m_aTextures.size());
+				m_aTextures.append(record);
+			}
+			DzBlenderTextureRecord& record = m_aTextures[mapTextureIndex[sTexture]];
+			if (record.aMaterialNames.contains(sMaterialName) == false) {
+				record.aMaterialNames.append(sMaterialName);
+			}
+			QString sPropertyName = property.value("Name").toString();
+			if (record.aPropertyNames.contains(sPropertyName) == false) {
+				record.aPropertyNames.append(sPropertyName);
+			}
+		}
+	}
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: %1 unique textures referenced by DTU.").arg(m_aTextures.size()));
+	if (m_oSettings.bPackOrmTextures) {
+		dzApp->log(QString("DzBlenderTexturePipeline: INFO: %1 ORM textures to pack.").arg(m_aOrmTextures.size()));
+	}
+
+	return true;
+}
+
+void DzBlenderTexturePipeline::collectMaterialOperations(int nMaterialIndex, const QVariantMap& material, QMap<QString, int>& mapOperationIndex)
+{
+	QString sMaterialName = material.value("Material Name").toString();
+	QVariantList aProperties = material.value("Properties").toList();
+
+	QString sCutoutTexture = "";
+	if (m_oSettings.bCombineDiffuseAndAlphaMaps) {
+		foreach(QVariant vProperty, aProperties) {
+			QVariantMap property = vProperty.toMap();
+			if (property.value("Name").toString() == "Cutout Opacity") {
+				sCutoutTexture = property.value("Texture").toString();
+			}
+		}
+		if (sCutoutTexture != "" && QFileInfo(sCutoutTexture).isFile() == false) {
+			sCutoutTexture = "";
+		}
+	}
+
+	foreach(QVariant vProperty, aProperties) {
+		QVariantMap property = vProperty.toMap();
+		QString sPropertyName = property.value("Name").toString();
+		QString sTexture = property.value("Texture").toString();
+		if (sTexture == "" || QFileInfo(sTexture).isFile() == false) {
+			continue;
+		}
+
+		DzBlenderTextureRecord operation;
+		operation.sDtuPath = sTexture;
+		// a cutout that is already the diffuse map means the alpha is already in place
+		if (sPropertyName == "Diffuse Color" && sCutoutTexture != "" && sCutoutTexture != sTexture) {
+			operation.sAlphaSourcePath = sCutoutTexture;
+		}
+		if (m_oSettings.bMultiplyTextureValues) {
+			QString sValue = property.value("Value").toString();
+			QColor color(sValue);
+			if (sValue.startsWith("#") && color.isValid() && (color.rgb() & 0x00ffffff) != 0x00ffffff) {
+				operation.bMultiplyByColor = true;
+				operation.multiplyColor = color.rgb();
+			}
+		}
+		if (operation.hasMaterialOperations() == false) {
+			continue;
+		}
+
+		// materials sharing the same texture and operations share one output file
+		QString sOperationKey = QString("%1|%2|%3").arg(sTexture).arg(operation.sAlphaSourcePath)
+			.arg(operation.bMultiplyByColor ? QString::number(operation.multiplyColor & 0x00ffffff, 16) : "");
+		if (mapOperationIndex.contains(sOperationKey) == false) {
+			mapOperationIndex.insert(sOperationKey, m_aTextures.size());
+			m_aTextures.append(operation);
+		}
+		DzBlenderTextureRecord& record = m_aTextures[mapOperationIndex[sOperationKey]];
+		if (record.aMaterialNames.contains(sMaterialName) == false) {
+			record.aMaterialNames.append(sMaterialName);
+		}
+		if (record.aPropertyNames.contains(sPropertyName) == false) {
+			record.aPropertyNames.append(sPropertyName);
+		}
+
+		DzBlenderMaterialOverride target;
+		target.nMaterialIndex = nMaterialIndex;
+		target.sPropertyName = sPropertyName;
+		if (operation.bMultiplyByColor) {
+			// the color is baked into the texture
+			target.sValue = "#ffffff";
+		}
+		record.aMaterialTargets.append(target);
+		if (operation.sAlphaSourcePath != "") {
+			// same as ImageTools: the cutout points to the combined map, blender_tools then links its alpha
+			DzBlenderMaterialOverride cutoutTarget;
+			cutoutTarget.nMaterialIndex = nMaterialIndex;
+			cutoutTarget.sPropertyName = "Cutout Opacity";
+			record.aMaterialTargets.append(cutoutTarget);
+		}
+	}
+}
+
+// Finds the maps that blender_tools links to occlusion, roughness and metallic, where the last
+// roughness property with a texture wins.  Returns the properties replaced by the packed texture.
+QStringList DzBlenderTexturePipeline::collectOrmTexture(int nMaterialIndex, const QVariantMap& material, QMap<QString, int>& mapOrmIndex)
+{
+	DzBlenderOrmRecord orm;
+	QString sRoughnessProperty = "";
+	double fMetallicValue = 0.0;
+	foreach(QVariant vProperty, material.value("Properties").toList()) {
+		QVariantMap property = vProperty.toMap();
+		QString sPropertyName = property.value("Name").toString();
+		QString sTexture = property.value("Texture").toString();
+		if (sTexture != "" && QFileInfo(sTexture).isFile() == false) {
+			sTexture = "";
+		}
+		if (sPropertyName == "Glossy Roughness" || sPropertyName == "Specular Lobe 1 Roughness") {
+			if (sTexture != "") {
+				orm.sRoughnessPath = sTexture;
+				sRoughnessProperty = sPropertyName;
+			}
+		}
+		else if (sPropertyName == "Metallic Weight") {
+			orm.sMetallicPath = sTexture;
+			fMetallicValue = property.value("Value").toDouble();
+		}
+		else if (sPropertyName == "Ambient Occlusion") {
+			orm.sOcclusionPath = sTexture;
+		}
+	}
+	// a single map gains nothing from packing
+	if (orm.sRoughnessPath == "" || (orm.sMetallicPath == "" && orm.sOcclusionPath == "")) {
+		return QStringList();
+	}
+	if (orm.sMetallicPath == "") {
+		orm.nMetallicValue = qBound(0, qRound(fMetallicValue * 255.0), 255);
+	}
+
+	QString sOrmKey = QString("%1|%2|%3|%4").arg(orm.sOcclusionPath).arg(orm.sRoughnessPath).arg(orm.sMetallicPath).arg(orm.nMetallicValue);
+	if (mapOrmIndex.contains(sOrmKey) == false) {
+		mapOrmIndex.insert(sOrmKey, m_aOrmTextures.size());
+		m_aOrmTextures.append(orm);
+	}
+	m_aOrmTextures[mapOrmIndex[sOrmKey]].aMaterialIndices.append(nMaterialIndex);
+
+	QStringList aPackedProperties;
+	aPackedProperties.append(sRoughnessProperty);
+	if (orm.sMetallicPath != "") {
+		aPackedProperties.append("Metallic Weight");
+	}
+	if (orm.sOcclusionPath != "") {
+		aPackedProperties.append("Ambient Occlusion");
+	}
+	return aPackedProperties;
+}
+
+void DzBlenderTexturePipeline::beginTextureJobs()
+{
+	QDir().mkpath(m_sOutputFolder);
+
+	if (m_oSettings.bUseTextureCache) {
+		QString sCachePath = m_oSettings.sTextureCachePath;
+		if (sCachePath == "") {
+			sCachePath = DzBlenderTextureCache::GetDefaultCachePath();
+		}
+		m_oTextureCache.open(sCachePath, (qint64)m_oSettings.nTextureCacheSizeMB * 1024 * 1024);
+	}
+
+	// reset the budget, jobs reserve their estimated memory before decoding
+	m_nMemoryBudgetMB = m_oSettings.nTextureMemoryBudgetMB;
+	if (m_nMemoryBudgetMB <= 0) {
+		// leave the other half to Daz Studio and Blender, which keep running next to the texture jobs
+		qint64 nAvailableMB = (qint64)(DzNativeMemory::GetAvailablePhysicalBytes() / (1024 * 1024));
+		if (nAvailableMB <= 0) {
+			// a quarter of the machine when the free memory cannot be queried
+			nAvailableMB = (qint64)(DzNativeMemory::GetTotalPhysicalBytes() / (1024 * 1024)) / 2;
+		}
+		m_nMemoryBudgetMB = nAvailableMB > 0 ? (int)qMin(nAvailableMB / 2, (qint64)65536) : 2048;
+	}
+	m_nMemoryBudgetMB = qMax(64, m_nMemoryBudgetMB);
+	m_nAdmittedJobs = 0;
+	m_nWaitedJobs = 0;
+	m_nAdmissionWaitMs = 0;
+	m_nMaxAdmissionWaitMs = 0;
+	m_oMemoryBudget.acquire(m_oMemoryBudget.available());
+	m_oMemoryBudget.release(m_nMemoryBudgetMB);
+}
+
+void DzBlenderTexturePipeline::endTextureJobs()
+{
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: memory budget %1 MB, %2 of %3 jobs waited for admission, %4 ms in total, %5 ms at most")
+		.arg(m_nMemoryBudgetMB).arg(m_nWaitedJobs).arg(m_nAdmittedJobs).arg(m_nAdmissionWaitMs).arg(m_nMaxAdmissionWaitMs));
+	if (m_oTextureCache.isOpen()) {
+		dzApp->log(QString("DzBlenderTexturePipeline: INFO: texture cache hits=%1, misses=%2")
+			.arg(m_oTextureCache.getNumHits()).arg(m_oTextureCache.getNumMisses()));
+		m_oTextureCache.close();
+	}
+}
+
+void DzBlenderTexturePipeline::runTextureStages()
+{
+	QList<DzBlenderTextureJob> aJobs;
+	foreach(DzBlenderTextureRecord record, m_aTextures) {
+		DzBlenderTransformPlan plan;
+		if (planTransform(record, plan) == false) {
+			continue;
+		}
+		// without any transform only the texture pyramid is written, and Blender keeps using the source
+		if (plan.bTransform == false && plan.aVariants.isEmpty()) {
+			continue;
+		}
+		DzBlenderTextureJob job;
+		job.sName = record.sDtuPath;
+		job.nReservationBytes = getTransformBytes(record, plan);
+		job.fnRun = [this, record, plan](const DzBlenderMemoryReservation& reservation) { transformTexture(record, plan, reservation); };
+		aJobs.append(job);
+	}
+	for (int nOrmIndex = 0; nOrmIndex < m_aOrmTextures.size(); nOrmIndex++) {
+		const DzBlenderOrmRecord& orm = m_aOrmTextures[nOrmIndex];
+		QSize targetSize;
+		qint64 nSourceBytes = 0;
+		if (getOrmSize(orm, targetSize, nSourceBytes) == false) {
+			continue;
+		}
+		DzBlenderTextureJob job;
+		job.sName = orm.sRoughnessPath;
+		job.nReservationBytes = getOrmBytes(targetSize, nSourceBytes);
+		job.fnRun = [this, nOrmIndex, targetSize](const DzBlenderMemoryReservation& reservation) {
+			packOrmTexture(nOrmIndex, targetSize, reservation);
+		};
+		aJobs.append(job);
+	}
+	runJobs(aJobs);
+}
+
+void DzBlenderTexturePipeline::runJobs(QList<DzBlenderTextureJob> aJobs)
+{
+	// largest first, so that the jobs needing most of the budget are not left waiting behind many small ones
+	std::stable_sort(aJobs.begin(), aJobs.end(), [](const DzBlenderTextureJob& a, const DzBlenderTextureJob& b) {
+		return a.nReservationBytes > b.nReservationBytes;
+	});
+
+	QMutex queueMutex;
+	auto fnWorker = [this, &aJobs, &queueMutex]() {
+		while (true) {
+			DzBlenderMemoryReservation reservation(m_oMemoryBudget);
+			queueMutex.lock();
+			if (aJobs.isEmpty()) {
+				queueMutex.unlock();
+				return;
+			}
+			// The largest job that fits in what is left of the budget is reserved and taken in one step.  When none
+			// fits, the largest job waits for its memory with the queue locked, so smaller jobs cannot starve it.
+			int nJobIndex = -1;
+			for (int i = 0; i < aJobs.size(); i++) {
+				if (reservation.tryAcquire(getReservationMB(aJobs[i].nReservationBytes))) {
+					nJobIndex = i;
+					break;
+				}
+			}
+			if (nJobIndex < 0) {
+				nJobIndex = 0;
+				reservation.acquire(getReservationMB(aJobs[0].nReservationBytes));
+			}
+			DzBlenderTextureJob job = aJobs.takeAt(nJobIndex);
+			queueMutex.unlock();
+			recordAdmission(reservation.getWaitMs());
+
+			try {
+				job.fnRun(reservation);
+			}
+			catch (...) {
+				logError("Unhandled exception while processing texture: " + job.sName);
+			}
+		}
+	};
+
+	int nWorkers = qMin(QThread::idealThreadCount(), aJobs.size());
+	QThreadPool threadPool;
+	threadPool.setMaxThreadCount(qMax(1, nWorkers));
+	for (int i = 0; i < nWorkers; i++) {
+		threadPool.start(new DzBlenderTextureTask(fnWorker));
+	}
+	threadPool.waitForDone();
+}
+
+void DzBlenderTexturePipeline::recordAdmission(qint64 nWaitMs)
+{
+	QMutexLocker locker(&m_mutex);
+	m_nAdmittedJobs++;
+	if (nWaitMs > 0) {
+		m_nWaitedJobs++;
+		m_nAdmissionWaitMs += nWaitMs;
+		m_nMaxAdmissionWaitMs = qMax(m_nMaxAdmissionWaitMs, nWaitMs);
+	}
+}
+
+bool DzBlenderTexturePipeline::planTransform(const DzBlenderTextureRecord& record, DzBlenderTransformPlan& plan)
+{
+	QFileInfo sourceInfo(record.sDtuPath);
+	QString sSourceFormat = sourceInfo.suffix().toLower();
+	if (sSourceFormat == "jpeg") sSourceFormat = "jpg";
+
+	plan.sourceSize = QImageReader(record.sDtuPath).size();
+	if (plan.sourceSize.isValid() == false) {
+		logError("Unable to read texture header: " + record.sDtuPath);
+		return false;
+	}
+
+	plan.targetSize = getTargetSize(QStringList() << record.sDtuPath, plan.sourceSize);
+	plan.sTargetFormat = sSourceFormat;
+	if (m_oSettings.bConvertToPng) {
+		plan.sTargetFormat = "png";
+	}
+	else if (m_oSettings.bConvertToJpg) {
+		plan.sTargetFormat = "jpg";
+	}
+	bool bRecompress = m_oSettings.bRecompressIfFileSizeTooBig && sourceInfo.size() > m_oSettings.nFileSizeThresholdToInitiateRecompression;
+	plan.nTargetFileBytes = 0;
+	if (bRecompress) {
+		plan.sTargetFormat = "jpg";
+		if (m_oSettings.bRecompressToFileSize) {
+			plan.nTargetFileBytes = m_oSettings.nFileSizeThresholdToInitiateRecompression;
+		}
+	}
+	plan.bTransform = record.hasMaterialOperations() || plan.targetSize != plan.sourceSize ||
+		plan.sTargetFormat != sSourceFormat || bRecompress || m_oSettings.bForceReEncoding;
+	plan.aVariants = getTextureVariants(plan.targetSize);
+	plan.bStream = canStreamTexture(record, plan.sourceSize, plan.sTargetFormat);
+	return true;
+}
+
+// The strip buffers and pyramid levels of a streamed texture, or the decoded images and variants of a full decode
+qint64 DzBlenderTexturePipeline::getTransformBytes(const DzBlenderTextureRecord& record, const DzBlenderTransformPlan& plan)
+{
+	if (plan.bStream) {
+		qint64 nBytes = (qint64)DzTextureStream::EstimateBufferBytes(plan.sourceSize.width(), plan.targetSize.width(), kStripRows,
+			record.sAlphaSourcePath != "");
+		int nInputWidth = plan.targetSize.width();
+		foreach(const DzBlenderTextureVariant& variant, plan.aVariants) {
+			nBytes += (qint64)DzTextureStream::EstimateLevelBytes(nInputWidth, variant.size.width());
+			nInputWidth = variant.size.width();
+		}
+		return nBytes;
+	}
+	qint64 nBytes = estimateDecodeBytes(record, plan.sourceSize, plan.targetSize);
+	foreach(const DzBlenderTextureVariant& variant, plan.aVariants) {
+		nBytes += (qint64)variant.size.width() * variant.size.height() * 4;
+	}
+	return nBytes;
+}
+
+bool DzBlenderTexturePipeline::transformTexture(const DzBlenderTextureRecord& record, DzBlenderTransformPlan plan,
+	const DzBlenderMemoryReservation& reservation)
+{
+	QString sSourcePath = record.sDtuPath;
+	QFileInfo sourceInfo(sSourcePath);
+	const QSize& sourceSize = plan.sourceSize;
+	const QSize& targetSize = plan.targetSize;
+	const QString& sTargetFormat = plan.sTargetFormat;
+	qint64 nTargetFileBytes = plan.nTargetFileBytes;
+	bool bTransform = plan.bTransform;
+	QList<DzBlenderTextureVariant>& aVariants = plan.aVariants;
+
+	// everything that changes the output bytes must be part of the cache key
+	QString sOperationParams = QString("transform:v2;size=%1x%2;format=%3;quality=%4;pnglevel=%5")
+		.arg(targetSize.width()).arg(targetSize.height())
+		.arg(sTargetFormat).arg(m_oSettings.nJpegQuality).arg(m_oSettings.nPngCompressionLevel);
+	if (nTargetFileBytes > 0) {
+		sOperationParams += QString(";filesize=%1").arg(nTargetFileBytes);
+	}
+	if (record.bMultiplyByColor) {
+		sOperationParams += ";multiply=" + QString::number(record.multiplyColor & 0x00ffffff, 16);
+	}
+	QString sKey = "";
+	QString sOutputPathNoExt = m_sOutputFolder + "/" + sourceInfo.completeBaseName();
+	if (m_oTextureCache.isOpen()) {
+		if (record.sAlphaSourcePath != "") {
+			sOperationParams += ";alpha=" + m_oTextureCache.getContentHash(record.sAlphaSourcePath);
+		}
+		sKey = m_oTextureCache.makeKey(m_oTextureCache.getContentHash(sSourcePath), sOperationParams);
+		sOutputPathNoExt += "_" + sKey.left(8);
+		QString sCachedPath = bTransform ? m_oTextureCache.fetch(sKey, sOutputPathNoExt) : sSourcePath;
+		if (sCachedPath != "" && fetchTextureVariants(sKey, sOutputPathNoExt, aVariants)) {
+			if (bTransform) {
+				addTextureResult(record, sCachedPath);
+			}
+			addTextureVariants(sCachedPath, aVariants);
+			return true;
+		}
+	}
+	else {
+		sOutputPathNoExt += "_" + QString::number(qHash(sSourcePath + sOperationParams + record.sAlphaSourcePath), 16);
+	}
+
+	DzBlenderTextureJobStats stats;
+	stats.sSourcePath = sSourcePath;
+	stats.nVariants = aVariants.size();
+	stats.nAdmissionWaitMs = reservation.getWaitMs();
+	QTime jobTimer;
+	jobTimer.start();
+
+	bool bResult = false;
+	if (plan.bStream) {
+		stats.sMode = "strips";
+		stats.sOutputPath = bTransform ? sOutputPathNoExt + ".png" : "";
+		for (int i = 0; i < aVariants.size(); i++) {
+			aVariants[i].sPath = sOutputPathNoExt + getVariantSuffix(aVariants[i].nSize) + ".png";
+		}
+		bResult = streamTexture(record, targetSize, aVariants, stats);
+	}
+	else {
+		stats.sMode = "full";
+		bResult = decodeTexture(record, sourceSize, targetSize, sTargetFormat, sOutputPathNoExt, bTransform, nTargetFileBytes, aVariants, stats);
+	}
+	if (bResult == false) {
+		return false;
+	}
+
+	stats.nProcessPeakBytes = (qint64)DzNativeMemory::GetPeakResidentBytes();
+	stats.nElapsedMs = jobTimer.elapsed();
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: %1 -> %2 + %3 variants (%4, %5): job peak %6 MB, process peak RSS %7 MB, %8 ms")
+		.arg(stats.sSourcePath).arg(bTransform ? stats.sOutputPath : "-").arg(stats.nVariants).arg(stats.sMode).arg(stats.sCodec)
+		.arg(stats.nJobPeakBytes / (1024.0 * 1024.0), 0, 'f', 1)
+		.arg(stats.nProcessPeakBytes / (1024.0 * 1024.0), 0, 'f', 1)
+		.arg(stats.nElapsedMs));
+	m_mutex.lock();
+	m_aJobStats.append(stats);
+	m_mutex.unlock();
+
+	if (m_oTextureCache.isOpen()) {
+		if (bTransform) {
+			m_oTextureCache.store(sKey, stats.sOutputPath);
+		}
+		storeTextureVariants(sKey, aVariants);
+	}
+	if (bTransform) {
+		addTextureResult(record, stats.sOutputPath);
+	}
+	addTextureVariants(bTransform ? stats.sOutputPath : sSourcePath, aVariants);
+
+	return true;
+}
+
+bool DzBlenderTexturePipeline::canStreamTexture(const DzBlenderTextureRecord& record, const QSize& sourceSize, const QString& sTargetFormat)
+{
+	// strips are always written as PNG, which is also what a combined alpha map turns jpg into
+	if (sTargetFormat != "png" && (sTargetFormat != "jpg" || record.sAlphaSourcePath == "")) {
+		return false;
+	}
+	if (DzTextureStream::CanStream(record.sDtuPath.toUtf8().constData()) == false) {
+		return false;
+	}
+	if (record.sAlphaSourcePath != "") {
+		if (DzTextureStream::CanStream(record.sAlphaSourcePath.toUtf8().constData()) == false ||
+			QImageReader(record.sAlphaSourcePath).size() != sourceSize)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool DzBlenderTexturePipeline::streamTexture(const DzBlenderTextureRecord& record, const QSize& targetSize, QList<DzBlenderTextureVariant>& aVariants,
+	DzBlenderTextureJobStats& stats)
+{
+	DzTextureStreamJob job;
+	job.sColorPath = record.sDtuPath.toUtf8().constData();
+	job.sAlphaPath = record.sAlphaSourcePath.toUtf8().constData();
+	job.sOutputPath = stats.sOutputPath.toUtf8().constData();
+	job.bMultiplyByColor = record.bMultiplyByColor;
+	job.nMultiplyColor = record.multiplyColor;
+	job.nTargetWidth = targetSize.width();
+	job.nTargetHeight = targetSize.height();
+	job.nStripRows = kStripRows;
+	job.nCompressionLevel = m_oSettings.nPngCompressionLevel;
+	foreach(const DzBlenderTextureVariant& variant, aVariants) {
+		DzTextureStreamLevel level;
+		level.sOutputPath = variant.sPath.toUtf8().constData();
+		level.nWidth = variant.size.width();
+		level.nHeight = variant.size.height();
+		job.aLevels.push_back(level);
+	}
+	stats.sCodec = "png-strips";
+
+	DzTextureStreamResult result;
+	if (DzTextureStream::Run(job, result) == false) {
+		if (stats.sOutputPath != "") {
+			QFile::remove(stats.sOutputPath);
+		}
+		foreach(const DzBlenderTextureVariant& variant, aVariants) {
+			QFile::remove(variant.sPath);
+		}
+		logError("Unable to process texture in strips: " + QString::fromUtf8(result.sError.c_str()));
+		return false;
+	}
+	stats.nJobPeakBytes = (qint64)result.nPeakBufferBytes;
+
+	return true;
+}
+
+bool DzBlenderTexturePipeline::decodeTexture(const DzBlenderTextureRecord& record, const QSize& sourceSize, const QSize& targetSize,
+	QString sTargetFormat, const QString& sOutputPathNoExt, bool bWriteOutput, qint64 nTargetFileBytes, QList<DzBlenderTextureVariant>& aVariants,
+	DzBlenderTextureJobStats& stats)
+{
+	QString sSourcePath = record.sDtuPath;
+	QImageReader reader(sSourcePath);
+	// decode straight to the target size, readers without scaled decoding hold the full image only until it is scaled
+	qint64 nPeakBytes = 0;
+	if (targetSize != sourceSize) {
+		reader.setScaledSize(targetSize);
+		if (reader.supportsOption(QImageIOHandler::ScaledSize) == false) {
+			nPeakBytes = (qint64)sourceSize.width() * sourceSize.height() * 4;
+		}
+	}
+	QImage image = reader.read();
+	if (image.isNull()) {
+		logError("Unable to decode texture: " + sSourcePath + ", " + reader.errorString());
+		return false;
+	}
+	nPeakBytes += image.byteCount();
+	if (record.hasMaterialOperations() && applyMaterialOperations(record, image, nPeakBytes) == false) {
+		return false;
+	}
+	if (image.size() != targetSize) {
+		image = image.scaled(targetSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	}
+	// jpg can not store alpha
+	if (sTargetFormat == "jpg" && image.hasAlphaChannel()) {
+		sTargetFormat = "png";
+	}
+
+	stats.nJobPeakBytes = nPeakBytes;
+	if (bWriteOutput && nTargetFileBytes > 0 && sTargetFormat == "jpg") {
+		stats.sOutputPath = sOutputPathNoExt + "." + sTargetFormat;
+		if (writeToFileSize(image, stats.sOutputPath, nTargetFileBytes, stats) == false) {
+			return false;
+		}
+	}
+	else if (bWriteOutput) {
+		stats.sOutputPath = sOutputPathNoExt + "." + sTargetFormat;
+		DzBlenderCodecSettings codecSettings;
+		codecSettings.nJpegQuality = m_oSettings.nJpegQuality;
+		codecSettings.nPngCompressionLevel = m_oSettings.nPngCompressionLevel;
+		QString sErrorMessage;
+		if (DzBlenderImageCodecs::Write(image, stats.sOutputPath, sTargetFormat, codecSettings, sErrorMessage, &stats.sCodec) == false) {
+			QFile::remove(stats.sOutputPath);
+			logError("Unable to write texture: " + stats.sOutputPath + ", " + sErrorMessage);
+			return false;
+		}
+	}
+	if (aVariants.isEmpty() == false && writeTextureVariants(image, sTargetFormat, sOutputPathNoExt, aVariants, stats) == false) {
+		return false;
+	}
+
+	return true;
+}
+
+// Each round encodes several JPEG qualities of the same decoded image in parallel and narrows the
+// range to the qualities between the best one that fits and the lowest one over the budget.  File size
+// grows with quality, so the search ends on the highest quality that fits.  If even the lowest quality
+// is too big, that smallest file is kept.
+bool DzBlenderTexturePipeline::writeToFileSize(const QImage& image, const QString& sOutputPath, qint64 nTargetFileBytes, DzBlenderTextureJobStats& stats)
+{
+	static const int kMinJpegQuality = 10;
+	static const int kQualitiesPerRound = 4;
+
+	QMutex mutex;
+	QMap<int, qint64> mapFileBytes; // quality -> encoded size, -1 = failed
+	QString sErrorMessage;
+	auto getCandidatePath = [&](int nQuality) { return sOutputPath + QString(".q%1.tmp").arg(nQuality); };
+	auto encodeQualities = [&](const QList<int>& aQualities) {
+		QThreadPool threadPool;
+		threadPool.setMaxThreadCount(aQualities.size());
+		foreach(int nQuality, aQualities) {
+			threadPool.start(new DzBlenderTextureTask([&, nQuality]() {
+				DzBlenderCodecSettings codecSettings;
+				codecSettings.nJpegQuality = nQuality;
+				codecSettings.nPngCompressionLevel = m_oSettings.nPngCompressionLevel;
+				QString sCodecError;
+				QString sCodecName;
+				bool bWritten = DzBlenderImageCodecs::Write(image, getCandidatePath(nQuality), "jpg", codecSettings, sCodecError, &sCodecName);
+				qint64 nFileBytes = bWritten ? QFileInfo(getCandidatePath(nQuality)).size() : -1;
+				QMutexLocker locker(&mutex);
+				mapFileBytes.insert(nQuality, nFileBytes);
+				if (bWritten) {
+					stats.sCodec = sCodecName;
+				}
+				else {
+					sErrorMessage = sCodecError;
+				}
+			}));
+		}
+		threadPool.waitForDone();
+	};
+
+	// nFits: highest quality known to fit (kMinJpegQuality - 1 = none yet), nOver: lowest quality known to be too big
+	int nMaxQuality = qMax(kMinJpegQuality, m_oSettings.nJpegQuality);
+	encodeQualities(QList<int>() << nMaxQuality);
+	int nFits = kMinJpegQuality - 1;
+	int nOver = nMaxQuality;
+	if (mapFileBytes.value(nMaxQuality) >= 0 && mapFileBytes.value(nMaxQuality) <= nTargetFileBytes) {
+		nFits = nMaxQuality;
+	}
+	int nRounds = 1;
+	while (nFits < nMaxQuality && nOver - nFits > 1 && sErrorMessage == "") {
+		QList<int> aQualities;
+		for (int i = 1; i <= kQualitiesPerRound; i++) {
+			int nQuality = nFits + (nOver - nFits) * i / (kQualitiesPerRound + 1);
+			if (nQuality > nFits && nQuality < nOver && aQualities.contains(nQuality) == false) {
+				aQualities.append(nQuality);
+			}
+		}
+		if (aQualities.isEmpty()) {
+			aQualities.append(nFits + 1);
+		}
+		encodeQualities(aQualities);
+		nRounds++;
+		foreach(int nQuality, aQualities) {
+			qint64 nFileBytes = mapFileBytes.value(nQuality);
+			if (nFileBytes >= 0 && nFileBytes <= nTargetFileBytes) {
+				nFits = qMax(nFits, nQuality);
+			}
+		}
+		foreach(int nQuality, aQualities) {
+			if (nQuality > nFits && nQuality < nOver) {
+				nOver = nQuality;
+			}
+		}
+	}
+
+	int nBestQuality = nFits >= kMinJpegQuality ? nFits : nOver;
+	for (QMap<int, qint64>::const_iterator it = mapFileBytes.constBegin(); it != mapFileBytes.constEnd(); ++it) {
+		if (it.key() != nBestQuality) {
+			QFile::remove(getCandidatePath(it.key()));
+		}
+	}
+	if (sErrorMessage != "" || mapFileBytes.value(nBestQuality, -1) < 0) {
+		QFile::remove(getCandidatePath(nBestQuality));
+		logError("Unable to write texture: " + sOutputPath + ", " + sErrorMessage);
+		return false;
+	}
+	QFile::remove(sOutputPath);
+	if (QFile::rename(getCandidatePath(nBestQuality), sOutputPath) == false) {
+		QFile::remove(getCandidatePath(nBestQuality));
+		logError("Unable to write texture: " + sOutputPath);
+		return false;
+	}
+	stats.nQuality = nBestQuality;
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: %1: JPEG quality %2 (%3 bytes, budget %4) after %5 encodes in %6 rounds%7")
+		.arg(sOutputPath).arg(nBestQuality).arg(mapFileBytes.value(nBestQuality)).arg(nTargetFileBytes)
+		.arg(mapFileBytes.size()).arg(nRounds).arg(nFits >= kMinJpegQuality ? "" : ", over budget at the lowest quality"));
+
+	return true;
+}
+
+// The largest of the source maps, after the texture size selection
+bool DzBlenderTexturePipeline::getOrmSize(const DzBlenderOrmRecord& orm, QSize& targetSize, qint64& nSourceBytes)
+{
+	QStringList aSourcePaths;
+	aSourcePaths << orm.sOcclusionPath << orm.sRoughnessPath << orm.sMetallicPath;
+	targetSize = QSize(0, 0);
+	nSourceBytes = 0;
+	for (int i = 0; i < 3; i++) {
+		if (aSourcePaths[i] == "") {
+			continue;
+		}
+		QSize sourceSize = QImageReader(aSourcePaths[i]).size();
+		if (sourceSize.isValid() == false) {
+			logError("Unable to read texture header: " + aSourcePaths[i]);
+			return false;
+		}
+		targetSize = targetSize.expandedTo(sourceSize);
+		nSourceBytes += (qint64)sourceSize.width() * sourceSize.height() * 4;
+	}
+	targetSize = getTargetSize(aSourcePaths, targetSize);
+	return true;
+}
+
+// Sources decoded at the target size, their 32 bit copies, the packed image and its variants
+qint64 DzBlenderTexturePipeline::getOrmBytes(const QSize& targetSize, qint64 nSourceBytes) const
+{
+	qint64 nTargetBytes = (qint64)targetSize.width() * targetSize.height() * 4;
+	qint64 nVariantBytes = 0;
+	foreach(const DzBlenderTextureVariant& variant, getTextureVariants(targetSize)) {
+		nVariantBytes += (qint64)variant.size.width() * variant.size.height() * 4;
+	}
+	return nSourceBytes + nTargetBytes * 4 + nVariantBytes;
+}
+
+bool DzBlenderTexturePipeline::packOrmTexture(int nOrmIndex, const QSize& targetSize, const DzBlenderMemoryReservation& reservation)
+{
+	m_mutex.lock();
+	DzBlenderOrmRecord orm = m_aOrmTextures[nOrmIndex];
+	m_mutex.unlock();
+
+	// R = occlusion, G = roughness, B = metallic
+	QStringList aSourcePaths;
+	aSourcePaths << orm.sOcclusionPath << orm.sRoughnessPath << orm.sMetallicPath;
+
+	QList<DzBlenderTextureVariant> aVariants = getTextureVariants(targetSize);
+
+	QString sOperationParams = QString("orm:v1;size=%1x%2;metallic=%3;pnglevel=%4")
+		.arg(targetSize.width()).arg(targetSize.height())
+		.arg(orm.nMetallicValue).arg(m_oSettings.nPngCompressionLevel);
+	QString sKey = "";
+	QString sOutputPathNoExt = m_sOutputFolder + "/" + QFileInfo(orm.sRoughnessPath).completeBaseName() + "_orm";
+	if (m_oTextureCache.isOpen()) {
+		if (orm.sOcclusionPath != "") {
+			sOperationParams += ";occlusion=" + m_oTextureCache.getContentHash(orm.sOcclusionPath);
+		}
+		if (orm.sMetallicPath != "") {
+			sOperationParams += ";metallicmap=" + m_oTextureCache.getContentHash(orm.sMetallicPath);
+		}
+		sKey = m_oTextureCache.makeKey(m_oTextureCache.getContentHash(orm.sRoughnessPath), sOperationParams);
+		sOutputPathNoExt += "_" + sKey.left(8);
+		QString sCachedPath = m_oTextureCache.fetch(sKey, sOutputPathNoExt);
+		if (sCachedPath != "" && fetchTextureVariants(sKey, sOutputPathNoExt, aVariants)) {
+			addTextureVariants(sCachedPath, aVariants);
+			QMutexLocker locker(&m_mutex);
+			m_aOrmTextures[nOrmIndex].sTexture = sCachedPath;
+			return true;
+		}
+	}
+	else {
+		sOutputPathNoExt += "_" + QString::number(qHash(aSourcePaths.join("|") + sOperationParams), 16);
+	}
+
+	DzBlenderTextureJobStats stats;
+	stats.sSourcePath = orm.sRoughnessPath;
+	stats.sOutputPath = sOutputPathNoExt + ".png";
+	stats.sMode = "orm";
+	stats.nVariants = aVariants.size();
+	stats.nAdmissionWaitMs = reservation.getWaitMs();
+	QTime jobTimer;
+	jobTimer.start();
+	{
+		QImage packedImage(targetSize, QImage::Format_RGB32);
+		QImage aSourceImages[3];
+		const uint32_t* apSources[3] = { nullptr, nullptr, nullptr };
+		qint64 nPeakBytes = packedImage.byteCount();
+		for (int i = 0; i < 3; i++) {
+			if (aSourcePaths[i] == "") {
+				continue;
+			}
+			QImageReader reader(aSourcePaths[i]);
+			if (reader.size() != targetSize) {
+				reader.setScaledSize(targetSize);
+			}
+			QImage image = reader.read();
+			if (image.isNull()) {
+				logError("Unable to decode texture: " + aSourcePaths[i] + ", " + reader.errorString());
+				return false;
+			}
+			if (image.size() != targetSize) {
+				image = image.scaled(targetSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+			}
+			nPeakBytes += image.byteCount();
+			aSourceImages[i] = image.convertToFormat(QImage::Format_RGB32);
+			apSources[i] = reinterpret_cast<const uint32_t*>(aSourceImages[i].constBits());
+		}
+		// no occlusion map = unoccluded
+		const uint8_t aConstants[3] = { 255, 255, (uint8_t)orm.nMetallicValue };
+		DzImageKernels::PackLuminanceChannels(reinterpret_cast<uint32_t*>(packedImage.bits()), apSources, aConstants,
+			(size_t)targetSize.width() * targetSize.height());
+		for (int i = 0; i < 3; i++) {
+			aSourceImages[i] = QImage();
+		}
+
+		DzBlenderCodecSettings codecSettings;
+		codecSettings.nPngCompressionLevel = m_oSettings.nPngCompressionLevel;
+		QString sErrorMessage;
+		if (DzBlenderImageCodecs::Write(packedImage, stats.sOutputPath, "png", codecSettings, sErrorMessage, &stats.sCodec) == false) {
+			QFile::remove(stats.sOutputPath);
+			logError("Unable to write texture: " + stats.sOutputPath + ", " + sErrorMessage);
+			return false;
+		}
+		stats.nJobPeakBytes = nPeakBytes;
+		if (aVariants.isEmpty() == false && writeTextureVariants(packedImage, "png", sOutputPathNoExt, aVariants, stats) == false) {
+			return false;
+		}
+	}
+
+	stats.nProcessPeakBytes = (qint64)DzNativeMemory::GetPeakResidentBytes();
+	stats.nElapsedMs = jobTimer.elapsed();
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: %1 + %2 + %3 -> %4 + %5 variants (%6, %7): job peak %8 MB, %9 ms")
+		.arg(orm.sOcclusionPath == "" ? "-" : orm.sOcclusionPath).arg(orm.sRoughnessPath)
+		.arg(orm.sMetallicPath == "" ? "-" : orm.sMetallicPath).arg(stats.sOutputPath).arg(stats.nVariants)
+		.arg(stats.sMode).arg(stats.sCodec)
+		.arg(stats.nJobPeakBytes / (1024.0 * 1024.0), 0, 'f', 1)
+		.arg(stats.nElapsedMs));
+
+	if (m_oTextureCache.isOpen()) {
+		m_oTextureCache.store(sKey, stats.sOutputPath);
+		storeTextureVariants(sKey, aVariants);
+	}
+	addTextureVariants(stats.sOutputPath, aVariants);
+	QMutexLocker locker(&m_mutex);
+	m_aJobStats.append(stats);
+	m_aOrmTextures[nOrmIndex].sTexture = stats.sOutputPath;
+
+	return true;
+}
+
+// Collects the texture Blender ends up using for every material property, after material
+// overrides, ORM packing and deduplication, and picks its block format from how it is used.
+void DzBlenderTexturePipeline::compressTextures(const QVariantList& aMaterials)
+{
+	m_aCompressedTextures.clear();
+
+	QMap<QString, QString> mapOverrideTextures;
+	foreach(DzBlenderMaterialOverride materialOverride, m_aMaterialOverrides) {
+		if (materialOverride.sTexture != "") {
+			mapOverrideTextures.insert(QString("%1|%2").arg(materialOverride.nMaterialIndex).arg(materialOverride.sPropertyName), materialOverride.sTexture);
+		}
+	}
+
+	// a texture used in several ways is compressed once: normal map, then color, then single channel
+	QMap<QString, int> mapCompressedIndex;
+	QStringList aFormatPriority;
+	aFormatPriority << "BC4" << "BC7" << "BC5";
+	auto addTexture = [&](const QString& sTexture, const QString& sFormat, bool bSrgb) {
+		if (sTexture == "" || QFileInfo(sTexture).isFile() == false) {
+			return;
+		}
+		if (mapCompressedIndex.contains(sTexture) == false) {
+			DzBlenderCompressedTexture compressed;
+			compressed.sTexture = sTexture;
+			mapCompressedIndex.insert(sTexture, m_aCompressedTextures.size());
+			m_aCompressedTextures.append(compressed);
+		}
+		DzBlenderCompressedTexture& compressed = m_aCompressedTextures[mapCompressedIndex[sTexture]];
+		if (aFormatPriority.indexOf(sFormat) > aFormatPriority.indexOf(compressed.sFormat)) {
+			compressed.sFormat = sFormat;
+			compressed.bSrgb = bSrgb;
+		}
+	};
+
+	for (int nMaterialIndex = 0; nMaterialIndex < aMaterials.size(); nMaterialIndex++) {
+		QStringList aPackedProperties = m_mapPackedProperties.value(nMaterialIndex);
+		foreach(QVariant vProperty, aMaterials[nMaterialIndex].toMap().value("Properties").toList()) {
+			QVariantMap property = vProperty.toMap();
+			QString sPropertyName = property.value("Name").toString();
+			QString sTexture = property.value("Texture").toString();
+			if (sTexture == "" || aPackedProperties.contains(sPropertyName)) {
+				continue;
+			}
+			sTexture = mapOverrideTextures.value(QString("%1|%2").arg(nMaterialIndex).arg(sPropertyName),
+				m_mapTextureRemap.value(sTexture, sTexture));
+			if (sPropertyName == "Normal Map") {
+				addTexture(sTexture, "BC5", false);
+			}
+			else if (sPropertyName.endsWith("Color")) {
+				addTexture(sTexture, "BC7", true);
+			}
+			else {
+				addTexture(sTexture, "BC4", false);
+			}
+		}
+	}
+	foreach(DzBlenderOrmRecord orm, m_aOrmTextures) {
+		addTexture(orm.sTexture, "BC7", false);
+	}
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: %1 textures to block compress.").arg(m_aCompressedTextures.size()));
+
+	QList<DzBlenderTextureJob> aJobs;
+	for (int nCompressedIndex = 0; nCompressedIndex < m_aCompressedTextures.size(); nCompressedIndex++) {
+		DzBlenderTextureJob job;
+		job.sName = m_aCompressedTextures[nCompressedIndex].sTexture;
+		job.nReservationBytes = getDdsBytes(QImageReader(job.sName).size());
+		job.fnRun = [this, nCompressedIndex](const DzBlenderMemoryReservation& reservation) { compressTexture(nCompressedIndex, reservation); };
+		aJobs.append(job);
+	}
+	runJobs(aJobs);
+}
+
+bool DzBlenderTexturePipeline::compressTexture(int nCompressedIndex, const DzBlenderMemoryReservation& reservation)
+{
+	m_mutex.lock();
+	DzBlenderCompressedTexture compressed = m_aCompressedTextures[nCompressedIndex];
+	m_mutex.unlock();
+
+	DzBlockFormat eFormat = DzBlockFormat::BC7;
+	if (compressed.sFormat == "BC5") eFormat = DzBlockFormat::BC5;
+	else if (compressed.sFormat == "BC4") eFormat = DzBlockFormat::BC4;
+
+	QImageReader reader(compressed.sTexture);
+	QSize sourceSize = reader.size();
+	if (sourceSize.isValid() == false) {
+		logError("Unable to read texture header: " + compressed.sTexture);
+		return false;
+	}
+
+	QString sOperationParams = QString("dds:v1;format=%1;srgb=%2").arg(compressed.sFormat).arg(compressed.bSrgb ? 1 : 0);
+	QString sKey = "";
+	QString sOutputPathNoExt = m_sOutputFolder + "/" + QFileInfo(compressed.sTexture).completeBaseName();
+	if (m_oTextureCache.isOpen()) {
+		sKey = m_oTextureCache.makeKey(m_oTextureCache.getContentHash(compressed.sTexture), sOperationParams);
+		sOutputPathNoExt += "_" + sKey.left(8);
+		QString sCachedPath = m_oTextureCache.fetch(sKey, sOutputPathNoExt);
+		if (sCachedPath != "") {
+			QMutexLocker locker(&m_mutex);
+			DzBlenderCompressedTexture& result = m_aCompressedTextures[nCompressedIndex];
+			result.size = sourceSize;
+			result.nMipLevels = DzDdsWriter::GetMipLevelCount(sourceSize.width(), sourceSize.height());
+			result.sPath = sCachedPath;
+			return true;
+		}
+	}
+	else {
+		sOutputPathNoExt += "_" + QString::number(qHash(compressed.sTexture + sOperationParams), 16);
+	}
+
+	DzBlenderTextureJobStats stats;
+	stats.sSourcePath = compressed.sTexture;
+	stats.sOutputPath = sOutputPathNoExt + ".dds";
+	stats.sMode = "dds";
+	stats.sCodec = compressed.sFormat;
+	stats.nAdmissionWaitMs = reservation.getWaitMs();
+	QTime jobTimer;
+	jobTimer.start();
+	DzDdsWriter::Result ddsResult;
+	{
+		QImage image = reader.read();
+		if (image.isNull()) {
+			logError("Unable to decode texture: " + compressed.sTexture + ", " + reader.errorString());
+			return false;
+		}
+		qint64 nDecodeBytes = image.byteCount();
+		if (image.format() != QImage::Format_ARGB32) {
+			image = image.convertToFormat(QImage::Format_ARGB32);
+		}
+		if (DzDdsWriter::Write(stats.sOutputPath.toUtf8().constData(), reinterpret_cast<const uint32_t*>(image.constBits()),
+			image.width(), image.height(), image.bytesPerLine() / 4, eFormat, compressed.bSrgb, true, ddsResult) == false)
+		{
+			QFile::remove(stats.sOutputPath);
+			logError("Unable to write texture: " + stats.sOutputPath + ", " + QString::fromUtf8(ddsResult.sError.c_str()));
+			return false;
+		}
+		stats.nJobPeakBytes = qMax(nDecodeBytes, (qint64)image.byteCount()) + (qint64)ddsResult.nPeakBufferBytes;
+	}
+
+	stats.nProcessPeakBytes = (qint64)DzNativeMemory::GetPeakResidentBytes();
+	stats.nElapsedMs = jobTimer.elapsed();
+	dzApp->log(QString("DzBlenderTexturePipeline: INFO: %1 -> %2 (%3, %4 mip levels): job peak %5 MB, %6 ms")
+		.arg(stats.sSourcePath).arg(stats.sOutputPath).arg(stats.sCodec).arg(ddsResult.nMipLevels)
+		.arg(stats.nJobPeakBytes / (1024.0 * 1024.0), 0, 'f', 1)
+		.arg(stats.nElapsedMs));
+
+	if (m_oTextureCache.isOpen()) {
+		m_oTextureCache.store(sKey, stats.sOutputPath);
+	}
+	QMutexLocker locker(&m_mutex);
+	m_aJobStats.append(stats);
+	DzBlenderCompressedTexture& result = m_aCompressedTextures[nCompressedIndex];
+	result.size = sourceSize;
+	result.nMipLevels = ddsResult.nMipLevels;
+	result.sPath = stats.sOutputPath;
+
+	return true;
+}
+
+// Downscaled sizes for the texture pyramid of a texture, largest first.  Sizes that are
+// not smaller than the texture itself are skipped.
+QList<DzBlenderTextureVariant> DzBlenderTexturePipeline::getTextureVariants(const QSize& textureSize) const
+{
+	QList<int> aSizes = m_oSettings.aTexturePyramidSizes;
+	qSort(aSizes.begin(), aSizes.end(), qGreater<int>());
+	QList<DzBlenderTextureVariant> aVariants;
+	int nLongestEdge = qMax(textureSize.width(), textureSize.height());
+	foreach(int nSize, aSizes) {
+		if (nSize < 1 || nSize >= nLongestEdge || (aVariants.isEmpty() == false && aVariants.last().nSize == nSize)) {
+			continue;
+		}
+		DzBlenderTextureVariant variant;
+		variant.nSize = nSize;
+		variant.size = textureSize.scaled(nSize, nSize, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+		aVariants.append(variant);
+	}
+	return aVariants;
+}
+
+// Reduces all variants from one pass over the rows of image, then encodes them
+bool DzBlenderTexturePipeline::writeTextureVariants(const QImage& image, const QString& sFormat, const QString& sOutputPathNoExt,
+	QList<DzBlenderTextureVariant>& aVariants, DzBlenderTextureJobStats& stats)
+{
+	QImage::Format eFormat = image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+	QImage sourceImage = image;
+	qint64 nBytes = 0;
+	if (sourceImage.format() != eFormat) {
+		sourceImage = sourceImage.convertToFormat(eFormat);
+		nBytes += sourceImage.byteCount();
+	}
+
+	std::vector<int> aWidths;
+	std::vector<int> aHeights;
+	std::vector<QImage> aLevelImages;
+	foreach(const DzBlenderTextureVariant& variant, aVariants) {
+		aWidths.push_back(variant.size.width());
+		aHeights.push_back(variant.size.height());
+		aLevelImages.push_back(QImage(variant.size, eFormat));
+		nBytes += aLevelImages.back().byteCount();
+	}
+	std::vector<int> aNextRows(aVariants.size(), 0);
+	DzTexturePyramid pyramid(sourceImage.width(), sourceImage.height(), aWidths, aHeights, [&](int nLevel, const uint32_t* pRow) {
+		QImage& levelImage = aLevelImages[nLevel];
+		memcpy(levelImage.scanLine(aNextRows[nLevel]++), pRow, levelImage.width() * sizeof(uint32_t));
+		return true;
+	});
+	if (pyramid.getNumLevels() != aVariants.size()) {
+		logError("Invalid texture pyramid sizes for: " + stats.sSourcePath);
+		return false;
+	}
+	for (int y = 0; y < sourceImage.height(); y++) {
+		pyramid.addRow(reinterpret_cast<const uint32_t*>(sourceImage.constScanLine(y)));
+	}
+	sourceImage = QImage();
+	stats.nJobPeakBytes += nBytes;
+
+	DzBlenderCodecSettings codecSettings;
+	codecSettings.nJpegQuality = m_oSettings.nJpegQuality;
+	codecSettings.nPngCompressionLevel = m_oSettings.nPngCompressionLevel;
+	for (int i = 0; i < aVariants.size(); i++) {
+		DzBlenderTextureVariant& variant = aVariants[i];
+		variant.sPath = sOutputPathNoExt + getVariantSuffix(variant.nSize) + "." + sFormat;
+		QString sErrorMessage;
+		if (DzBlenderImageCodecs::Write(aLevelImages[i], variant.sPath, sFormat, codecSettings, sErrorMessage, &stats.sCodec) == false) {
+			QFile::remove(variant.sPath);
+			logError("Unable to write texture variant: " + variant.sPath + ", " + sErrorMessage);
+			return false;
+		}
+		aLevelImages[i] = QImage();
+	}
+	return true;
+}
+
+// Cache hit only if every variant is cached
+bool DzBlenderTexturePipeline::fetchTextureVariants(const QString& sKey, const QString& sOutputPathNoExt, QList<DzBlenderTextureVariant>& aVariants)
+{
+	for (int i = 0; i < aVariants.size(); i++) {
+		DzBlenderTextureVariant& variant = aVariants[i];
+		QString sVariantKey = m_oTextureCache.makeKey(sKey, QString("variant=%1x%2").arg(variant.size.width()).arg(variant.size.height()));
+		variant.sPath = m_oTextureCache.fetch(sVariantKey, sOutputPathNoExt + getVariantSuffix(variant.nSize));
+		if (variant.sPath == "") {
+			return false;
+		}
+	}
+	return true;
+}
+
+void DzBlenderTexturePipeline::storeTextureVariants(const QString& sKey, const QList<DzBlenderTextureVariant>& aVariants)
+{
+	foreach(const DzBlenderTextureVariant& variant, aVariants) {
+		QString sVariantKey = m_oTextureCache.makeKey(sKey, QString("variant=%1x%2").arg(variant.size.width()).arg(variant.size.height()));
+		m_oTextureCache.store(sVariantKey, variant.sPath);
+	}
+}
+
+void DzBlenderTexturePipeline::addTextureVariants(const QString& sTexture, const QList<DzBlenderTextureVariant>& aVariants)
+{
+	if (aVariants.isEmpty()) {
+		return;
+	}
+	QMutexLocker locker(&m_mutex);
+	m_mapTextureVariants.insert(sTexture, aVariants);
+}
+
+qint64 DzBlenderTexturePipeline::estimateDecodeBytes(const DzBlenderTextureRecord& record, const QSize& sourceSize, const QSize& targetSize)
+{
+	// full decode, scaled copy and format conversion
+	qint64 nTargetBytes = (qint64)targetSize.width() * targetSize.height() * 4;
+	qint64 nBytes = (qint64)sourceSize.width() * sourceSize.height() * 4 + nTargetBytes * 2;
+	if (record.sAlphaSourcePath != "") {
+		QSize alphaSize = QImageReader(record.sAlphaSourcePath).size();
+		nBytes += (qint64)alphaSize.width() * alphaSize.height() * 4 + nTargetBytes;
+	}
+	return nBytes;
+}
+
+int DzBlenderTexturePipeline::getReservationMB(qint64 nBytes) const
+{
+	// a job larger than the whole budget still runs, it just runs alone
+	int nMB = (int)((nBytes + 1024 * 1024 - 1) / (1024 * 1024));
+	return qBound(1, nMB, m_nMemoryBudgetMB);
+}
+
+bool DzBlenderTexturePipeline::applyMaterialOperations(const DzBlenderTextureRecord& record, QImage& image, qint64& nPeakBytes)
+{
+	bool bHasAlpha = record.sAlphaSourcePath != "" || image.hasAlphaChannel();
+	qint64 nDecodedBytes = image.byteCount();
+	image = image.convertToFormat(bHasAlpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+	nPeakBytes = qMax(nPeakBytes, nDecodedBytes + image.byteCount());
+	uint32_t* pPixels = reinterpret_cast<uint32_t*>(image.bits());
+	size_t nPixels = (size_t)image.width() * image.height();
+
+	if (record.sAlphaSourcePath != "") {
+		QImageReader alphaReader(record.sAlphaSourcePath);
+		if (alphaReader.size() != image.size()) {
+			alphaReader.setScaledSize(image.size());
+		}
+		QImage alphaImage = alphaReader.read();
+		if (alphaImage.isNull()) {
+			logError("Unable to decode cutout texture: " + record.sAlphaSourcePath + ", " + alphaReader.errorString());
+			return false;
+		}
+		if (alphaImage.size() != image.size()) {
+			alphaImage = alphaImage.scaled(image.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+		}
+		qint64 nAlphaBytes = alphaImage.byteCount();
+		alphaImage = alphaImage.convertToFormat(QImage::Format_RGB32);
+		nPeakBytes = qMax(nPeakBytes, image.byteCount() + nAlphaBytes + alphaImage.byteCount());
+		DzImageKernels::CombineColorAndAlpha(pPixels, pPixels, reinterpret_cast<const uint32_t*>(alphaImage.constBits()), nPixels);
+	}
+	if (record.bMultiplyByColor) {
+		DzImageKernels::MultiplyByColor(pPixels, nPixels, record.multiplyColor);
+	}
+
+	return true;
+}
+
+void DzBlenderTexturePipeline::addTextureResult(const DzBlenderTextureRecord& record, const QString& sNewPath)
+{
+	QMutexLocker locker(&m_mutex);
+	if (record.hasMaterialOperations()) {
+		foreach(DzBlenderMaterialOverride target, record.aMaterialTargets) {
+			target.sTexture = sNewPath;
+			m_aMaterialOverrides.append(target);
+		}
+	}
+	else {
+		m_mapTextureRemap.insert(record.sDtuPath, sNewPath);
+	}
+}
+
+void DzBlenderTexturePipeline::logError(const QString& sErrorMessage)
+{
+	dzApp->log("DzBlenderTexturePipeline: ERROR: " + sErrorMessage);
+	QMutexLocker locker(&m_mutex);
+	m_aErrorMessages.append(sErrorMessage);
+	m_bJobsSucceeded = false;
+}
+
+bool DzBlenderTexturePipeline::writeManifest()
+{
+	if (m_sManifestPath == "") {
+		return false;
+	}
+
+	// write to a temporary file first, then rename, so that Blender never reads a partial manifest
+	QString sTempPath = m_sManifestPath + ".tmp";
+	QFile manifestFile(sTempPath);
+	if (!manifestFile.open(QIODevice::WriteOnly)) {
+		dzApp->log("DzBlenderTexturePipeline: ERROR: unable to open manifest for writing: " + sTempPath);
+		return false;
+	}
+	DzJsonWriter writer(&manifestFile);
+	writer.startObject(true);
+	writer.addMember("Status", QString(m_bJobsSucceeded ? "Complete" : "Failed"));
+	writer.addMember("Error Message", m_aErrorMessages.join("\n"));
+	writer.addMember("Elapsed Ms", (int)m_nElapsedMs);
+
+	writer.startMemberObject("Texture Remap", true);
+	for (QMap<QString, QString>::const_iterator it = m_mapTextureRemap.constBegin(); it != m_mapTextureRemap.constEnd(); ++it) {
+		writer.addMember(it.key(), it.value());
+	}
+	writer.finishObject();
+
+	writer.startMemberArray("Material Overrides", true);
+	foreach(DzBlenderMaterialOverride materialOverride, m_aMaterialOverrides) {
+		writer.startObject(true);
+		writer.addMember("Material Index", materialOverride.nMaterialIndex);
+		writer.addMember("Property", materialOverride.sPropertyName);
+		writer.addMember("Texture", materialOverride.sTexture);
+		if (materialOverride.sValue != "") {
+			// numeric DTU values stay numbers, colors are "#rrggbb" strings
+			bool bNumber = false;
+			double fValue = materialOverride.sValue.toDouble(&bNumber);
+			if (bNumber) {
+				writer.addMember("Value", fValue);
+			}
+			else {
+				writer.addMember("Value", materialOverride.sValue);
+			}
+		}
+		writer.finishObject();
+	}
+	writer.finishArray();
+
+	writer.startMemberArray("ORM Textures", true);
+	foreach(DzBlenderOrmRecord orm, m_aOrmTextures) {
+		if (orm.sTexture == "") {
+			continue;
+		}
+		foreach(int nMaterialIndex, orm.aMaterialIndices) {
+			writer.startObject(true);
+			writer.addMember("Material Index", nMaterialIndex);
+			writer.addMember("Texture", orm.sTexture);
+			writer.addMember("Occlusion", orm.sOcclusionPath != "");
+			writer.addMember("Roughness", orm.sRoughnessPath != "");
+			writer.addMember("Metallic", orm.sMetallicPath != "");
+			writer.finishObject();
+		}
+	}
+	writer.finishArray();
+
+	writer.addMember("Memory Budget MB", m_nMemoryBudgetMB);
+	writer.startMemberObject("Admission", true);
+	writer.addMember("Jobs", m_nAdmittedJobs);
+	writer.addMember("Waited Jobs", m_nWaitedJobs);
+	writer.addMember("Total Wait Ms", (int)m_nAdmissionWaitMs);
+	writer.addMember("Max Wait Ms", (int)m_nMaxAdmissionWaitMs);
+	writer.finishObject();
+	writer.startMemberArray("Texture Jobs", true);
+	foreach(DzBlenderTextureJobStats stats, m_aJobStats) {
+		writer.startObject(true);
+		writer.addMember("Source", stats.sSourcePath);
+		writer.addMember("Output", stats.sOutputPath);
+		writer.addMember("Mode", stats.sMode);
+		writer.addMember("Codec", stats.sCodec);
+		if (stats.nQuality > 0) {
+			writer.addMember("Quality", stats.nQuality);
+		}
+		writer.addMember("Variants", stats.nVariants);
+		writer.addMember("Job Peak Bytes", (double)stats.nJobPeakBytes);
+		writer.addMember("Process Peak RSS Bytes", (double)stats.nProcessPeakBytes);
+		writer.addMember("Elapsed Ms", (int)stats.nElapsedMs);
+		writer.addMember("Admission Wait Ms", (int)stats.nAdmissionWaitMs);
+		writer.finishObject();
+	}
+	writer.finishArray();
+
+	writer.startMemberObject("Texture Variants", true);
+	for (QMap<QString, QList<DzBlenderTextureVariant> >::const_iterator it = m_mapTextureVariants.constBegin(); it != m_mapTextureVariants.constEnd(); ++it) {
+		writer.startMemberArray(it.key(), true);
+		foreach(DzBlenderTextureVariant variant, it.value()) {
+			writer.startObject(true);
+			writer.addMember("Size", variant.nSize);
+			writer.addMember("Width", variant.size.width());
+			writer.addMember("Height", variant.size.height());
+			writer.addMember("Texture", variant.sPath);
+			writer.finishObject();
+		}
+		writer.finishArray();
+	}
+	writer.finishObject();
+
+	writer.startMemberObject("Compressed Textures", true);
+	foreach(DzBlenderCompressedTexture compressed, m_aCompressedTextures) {
+		if (compressed.sPath == "") {
+			continue;
+		}
+		writer.startMemberObject(compressed.sTexture, true);
+		writer.addMember("Texture", compressed.sPath);
+		writer.addMember("Format", compressed.sFormat);
+		writer.addMember("sRGB", compressed.bSrgb);
+		writer.addMember("Width", compressed.size.width());
+		writer.addMember("Height", compressed.size.height());
+		writer.addMember("Mip Levels", compressed.nMipLevels);
+		writer.finishObject();
+	}
+	writer.finishObject();
+
+	writer.startMemberObject("Texture Statistics", true);
+	writer.addMember("Collapsed Textures", m_nCollapsedTextures);
+	writer.startMemberObject("Textures", true);
+	for (QMap<QString, DzImageStatistics>::const_iterator it = m_mapTextureStatistics.constBegin(); it != m_mapTextureStatistics.constEnd(); ++it) {
+		const DzImageStatistics& stats = it.value();
+		writer.startMemberObject(it.key(), true);
+		writer.startMemberArray("Min", true);
+		for (int c = 0; c < 4; c++) writer.addItem((int)stats.aMin[c]);
+		writer.finishArray();
+		writer.startMemberArray("Max", true);
+		for (int c = 0; c < 4; c++) writer.addItem((int)stats.aMax[c]);
+		writer.finishArray();
+		writer.startMemberArray("Mean", true);
+		for (int c = 0; c < 4; c++) writer.addItem(stats.getMean(c));
+		writer.finishArray();
+		writer.addMember("Uses Alpha", stats.usesAlpha());
+		writer.addMember("Grayscale", stats.isGrayscale(m_oSettings.nConstantTextureTolerance));
+		writer.addMember("Constant", stats.isConstant(m_oSettings.nConstantTextureTolerance));
+		writer.finishObject();
+	}
+	writer.finishObject();
+	writer.finishObject();
+
+	writer.startMemberObject("Texture Sizing", true);
+	writer.addMember("Enabled", m_oSettings.bAutoTextureSize);
+	writer.addMember("Target Texel Density", m_oSettings.fTargetTexelDensity);
+	writer.addMember("Budget MB", m_oSettings.nAutoTextureBudgetMB);
+	writer.addMember("Bytes Before", (double)m_nSizingBytesBefore);
+	writer.addMember("Bytes After", (double)m_nSizingBytesAfter);
+	writer.startMemberObject("Textures", true);
+	for (QMap<QString, DzBlenderTextureSizing>::const_iterator it = m_mapTextureSizing.constBegin(); it != m_mapTextureSizing.constEnd(); ++it) {
+		const DzBlenderTextureSizing& sizing = it.value();
+		writer.startMemberObject(it.key(), true);
+		writer.addMember("Source Width", sizing.sourceSize.width());
+		writer.addMember("Source Height", sizing.sourceSize.height());
+		writer.addMember("Width", sizing.size.width());
+		writer.addMember("Height", sizing.size.height());
+		writer.addMember("Texel Density", sizing.fSourceTexelDensity * qMax(sizing.size.width(), sizing.size.height()) /
+			qMax(1, qMax(sizing.sourceSize.width(), sizing.sourceSize.height())));
+		writer.finishObject();
+	}
+	writer.finishObject();
+	writer.finishObject();
+
+	writer.startMemberObject("Texture Deduplication", true);
+	writer.addMember("Enabled", m_oSettings.bDeduplicateTextures);
+	writer.addMember("Unique Textures", m_nUniqueTextures);
+	writer.addMember("Duplicate Textures", m_mapDuplicateTextures.size());
+	writer.addMember("Bytes Saved", (double)m_nDeduplicatedBytes);
+	writer.startMemberObject("Duplicates", true);
+	for (QMap<QString, QString>::const_iterator it = m_mapDuplicateTextures.constBegin(); it != m_mapDuplicateTextures.constEnd(); ++it) {
+		writer.addMember(it.key(), it.value());
+	}
+	writer.finishObject();
+	writer.finishObject();
+
+	writer.startMemberObject("Texture Cache", true);
+	writer.addMember("Enabled", m_oSettings.bUseTextureCache);
+	writer.addMember("Hits", m_oTextureCache.getNumHits());
+	writer.addMember("Misses", m_oTextureCache.getNumMisses());
+	writer.finishObject();
+
+	writer.finishObject();
+	manifestFile.close();
+
+	if (QFileInfo(m_sManifestPath).exists()) {
+		QFile::remove(m_sManifestPath);
+	}
+	if (QFile::rename(sTempPath, m_sManifestPath) == false) {
+		dzApp->log("DzBlenderTexturePipeline: ERROR: unable to finalize manifest: " + m_sManifestPath);
+		return false;
+	}
+
+	return true;
+}
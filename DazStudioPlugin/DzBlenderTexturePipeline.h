@@ -0,0 +1,346 @@
+#pragma once
+#include <QtCore/qstring.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qsemaphore.h>
+#include <QtCore/qwaitcondition.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qsize.h>
+#include <QtCore/qvariant.h>
+#include <QtGui/qrgb.h>
+
+#include <functional>
+
+#include "DzBlenderTextureCache.h"
+#include "DzImageKernels.h"
+
+class QImage;
+class DzBlenderMemoryReservation;
+
+// Texture transforms performed by the Blender bridge instead of ImageTools
+struct DzBlenderTextureSettings
+{
+	bool bCombineDiffuseAndAlphaMaps = false;
+	bool bMultiplyTextureValues = false;
+	bool bResizeTextures = false;
+	QSize qTargetTextureSize = QSize(4096, 4096);
+	bool bConvertToPng = false;
+	bool bConvertToJpg = false;
+	bool bRecompressIfFileSizeTooBig = false;
+	int nFileSizeThresholdToInitiateRecompression = 1024 * 1024 * 10; // size in bytes
+	// recompressed textures search the highest JPEG quality (up to nJpegQuality) that fits the threshold, instead of using nJpegQuality
+	bool bRecompressToFileSize = false;
+	bool bForceReEncoding = false;
+	int nJpegQuality = 90;
+	// 0 (fastest) to 9 (smallest), used by the native PNG encoders
+	int nPngCompressionLevel = 6;
+
+	bool bUseTextureCache = true;
+	QString sTextureCachePath = "";
+	int nTextureCacheSizeMB = 4096;
+
+	// decoded image memory shared by all concurrent texture jobs, 0 = half of the physical memory available when the jobs start
+	int nTextureMemoryBudgetMB = 0;
+
+	// collapse texture files with identical contents to one file before any processing
+	bool bDeduplicateTextures = true;
+
+	// longest edge of each downscaled variant written next to every processed texture, for example 2048, 1024, 512
+	QList<int> aTexturePyramidSizes;
+
+	// pack occlusion, roughness and metallic maps of each material into the R, G and B channels of one texture
+	bool bPackOrmTextures = false;
+
+	// replace maps that are one flat color or value with a material value, from per-texture statistics
+	bool bCollapseConstantTextures = false;
+	int nConstantTextureTolerance = 2; // largest difference within each 8-bit channel
+
+	// size each texture for a target texel density on the materials that use it, instead of one cap for every texture
+	bool bAutoTextureSize = false;
+	double fTargetTexelDensity = 1024.0; // texels per meter
+	// total RGBA8 size of the selected textures, 0 = no limit
+	int nAutoTextureBudgetMB = 0;
+
+	// also write every final texture as a block compressed DDS with mipmaps (BC7 color, BC5 normal maps, BC4 other maps)
+	bool bWriteCompressedTextures = false;
+
+	bool hasFileTransforms() const {
+		return bResizeTextures || bAutoTextureSize || bConvertToPng || bConvertToJpg || bRecompressIfFileSizeTooBig || bForceReEncoding ||
+			aTexturePyramidSizes.isEmpty() == false;
+	}
+	bool hasMaterialOperations() const {
+		return bCombineDiffuseAndAlphaMaps || bMultiplyTextureValues || bPackOrmTextures;
+	}
+	bool hasTransforms() const {
+		return hasFileTransforms() || hasMaterialOperations();
+	}
+};
+
+// World space and UV area of one material, measured on the exported mesh
+struct DzBlenderMaterialArea
+{
+	double fSurfaceArea = 0.0; // square meters
+	double fUVArea = 0.0; // 1 = the whole 0-1 UV square
+};
+
+// Size chosen for one texture by the texel density sizing
+struct DzBlenderTextureSizing
+{
+	QSize sourceSize;
+	QSize size;
+	// lowest texel density (texels per meter) of the materials using the texture, at the source size, 0 = not measured
+	double fSourceTexelDensity = 0.0;
+};
+
+// Replacement texture (and value) for one DTU material property
+struct DzBlenderMaterialOverride
+{
+	int nMaterialIndex = -1;
+	QString sPropertyName;
+	QString sTexture;
+	QString sValue; // empty = unchanged
+};
+
+// A texture file referenced by one or more DTU material properties.
+// Records with per-material operations (alpha combine, color multiply) only apply to
+// the material properties listed in aMaterialTargets, others apply to every reference of sDtuPath.
+struct DzBlenderTextureRecord
+{
+	QString sDtuPath;
+	QStringList aMaterialNames;
+	QStringList aPropertyNames;
+
+	QString sAlphaSourcePath = "";
+	bool bMultiplyByColor = false;
+	QRgb multiplyColor = 0xffffffff;
+	QList<DzBlenderMaterialOverride> aMaterialTargets;
+
+	bool hasMaterialOperations() const { return sAlphaSourcePath != "" || bMultiplyByColor; }
+};
+
+// Occlusion (R), roughness (G) and metallic (B) maps packed into one texture.
+// Materials using the same maps and metallic value share one record.
+struct DzBlenderOrmRecord
+{
+	QString sOcclusionPath;
+	QString sRoughnessPath;
+	QString sMetallicPath;
+	// fills the metallic channel when there is no metallic map, 0 to 255
+	int nMetallicValue = 0;
+	QList<int> aMaterialIndices;
+	QString sTexture; // packed output
+};
+
+// One downscaled variant of a processed texture, named like the blender_tools low resolution variants ("_2k")
+struct DzBlenderTextureVariant
+{
+	int nSize = 0; // requested longest edge
+	QSize size;
+	QString sPath;
+};
+
+// Block compressed copy of a texture used by Blender, for engines that load DDS directly
+struct DzBlenderCompressedTexture
+{
+	QString sTexture;
+	QString sFormat; // "BC7", "BC5" or "BC4"
+	bool bSrgb = false;
+	QSize size;
+	int nMipLevels = 0;
+	QString sPath; // DDS output
+};
+
+// Memory and timing report for one texture job, written to the completion manifest
+struct DzBlenderTextureJobStats
+{
+	QString sSourcePath;
+	QString sOutputPath;
+	QString sMode; // "strips" or "full"
+	QString sCodec;
+	int nQuality = 0; // JPEG quality picked by the file size search, 0 = none
+	int nVariants = 0;
+	qint64 nJobPeakBytes = 0;
+	qint64 nProcessPeakBytes = 0;
+	qint64 nElapsedMs = 0;
+	qint64 nAdmissionWaitMs = 0; // time spent waiting for the memory budget
+};
+
+// The decisions transformTexture() takes from the image headers, made when the job is queued
+struct DzBlenderTransformPlan
+{
+	QSize sourceSize;
+	QSize targetSize;
+	QString sTargetFormat;
+	qint64 nTargetFileBytes = 0; // 0 = no file size search
+	bool bTransform = false;
+	bool bStream = false;
+	QList<DzBlenderTextureVariant> aVariants;
+};
+
+// One job run by the texture stages.  nReservationBytes is what the job reserves from the memory budget, it is
+// computed from the image headers when the job is queued and taken before fnRun is called.
+struct DzBlenderTextureJob
+{
+	QString sName;
+	qint64 nReservationBytes = 0;
+	std::function<void(const DzBlenderMemoryReservation&)> fnRun;
+};
+
+/*****************************
+DzBlenderTexturePipeline
+
+Processes the textures referenced by the DTU on a background thread, so
+that the work overlaps with the rest of the DTU writer and with Blender
+startup.  The stages run in this order:
+  1. textures with identical contents are collapsed to one canonical file
+     (size prefilter, then XXH64 content hash and a length check)
+  2. optionally, maps of one flat color or value become material values,
+     found from per-texture statistics
+  3. optionally, each texture is sized to meet a target texel density on
+     the materials using it, within a total size budget
+  4. per-material operations with the NativeTools kernels: diffuse/alpha
+     combine, color multiply and occlusion/roughness/metallic packing.
+     Maps packed into an ORM texture are not transformed on their own.
+  5. cached per-file transforms, optionally with a pyramid of downscaled
+     variants reduced from the same decode (DzTexturePyramid)
+  6. optionally, block compressed DDS files with mip chains (DzDdsWriter)
+
+PNG textures are processed in horizontal strips (DzTextureStream), so their
+memory use does not depend on the image height.  Other formats are decoded
+directly at the target size and encoded through DzBlenderImageCodecs.
+Concurrent jobs share a memory budget, half of the available memory by
+default: each stage starts its largest jobs first and fills the rest of
+the budget with smaller ones.
+
+When everything is done, a small completion manifest with the material
+overrides, texture remapping and DDS files is written next to the DTU.
+Blender (blender_tools.process_dtu) waits for it only where the texture
+files are actually needed.
+*****************************/
+class DzBlenderTexturePipeline : public QThread
+{
+public:
+	DzBlenderTexturePipeline();
+	virtual ~DzBlenderTexturePipeline();
+
+	DzBlenderTextureSettings& getSettings() { return m_oSettings; }
+
+	// Removes any stale manifest and remembers where to write the new one.
+	// Processed textures are written to sOutputFolder.
+	void prepareManifest(const QString& sManifestPath, const QString& sOutputFolder);
+	QString getManifestPath() const { return m_sManifestPath; }
+
+	// Starts the background thread, which waits for finishDtu() before it runs the texture stages.
+	// The ImageTools jobs queue must already be processed.
+	bool startImageJobs();
+
+	// Tells the background thread that the DTU is complete and its textures can be processed.
+	// An empty path skips the texture stages.
+	void finishDtu(const QString& sDtuPath);
+
+	// Blocks until background processing is done.  Shows a progress bar when
+	// bShowProgress is true.  Returns false if processing failed.
+	bool waitForImageJobs(bool bShowProgress = true);
+
+	// Surface areas of the exported materials by material name, used by the texel density sizing.
+	// Must be called before finishDtu().
+	void setMaterialAreas(const QMap<QString, DzBlenderMaterialArea>& mapMaterialAreas);
+
+	bool getJobsSucceeded() const { return m_bJobsSucceeded; }
+	qint64 getElapsedMs() const { return m_nElapsedMs; }
+
+protected:
+	virtual void run() override;
+
+	bool loadDtuMaterials(QVariantList& aMaterials);
+	void deduplicateTextures(QVariantList& aMaterials);
+	void remapDuplicateTextures();
+	void analyzeTextures(QVariantList& aMaterials);
+	qint64 getStatisticsBytes(const QString& sTexture);
+	bool computeTextureStatistics(const QString& sTexture, DzImageStatistics& stats);
+	void collapseConstantTextures(QVariantList& aMaterials);
+	void selectTextureSizes(const QVariantList& aMaterials);
+	QSize getTargetSize(const QStringList& aSourcePaths, const QSize& sourceSize) const;
+	bool collectTextures(const QVariantList& aMaterials);
+	void collectMaterialOperations(int nMaterialIndex, const QVariantMap& material, QMap<QString, int>& mapOperationIndex);
+	QStringList collectOrmTexture(int nMaterialIndex, const QVariantMap& material, QMap<QString, int>& mapOrmIndex);
+	void beginTextureJobs();
+	void endTextureJobs();
+	void runTextureStages();
+	void runJobs(QList<DzBlenderTextureJob> aJobs);
+	void recordAdmission(qint64 nWaitMs);
+	void compressTextures(const QVariantList& aMaterials);
+	bool compressTexture(int nCompressedIndex, const DzBlenderMemoryReservation& reservation);
+	bool planTransform(const DzBlenderTextureRecord& record, DzBlenderTransformPlan& plan);
+	qint64 getTransformBytes(const DzBlenderTextureRecord& record, const DzBlenderTransformPlan& plan);
+	bool transformTexture(const DzBlenderTextureRecord& record, DzBlenderTransformPlan plan, const DzBlenderMemoryReservation& reservation);
+	bool canStreamTexture(const DzBlenderTextureRecord& record, const QSize& sourceSize, const QString& sTargetFormat);
+	bool streamTexture(const DzBlenderTextureRecord& record, const QSize& targetSize, QList<DzBlenderTextureVariant>& aVariants,
+		DzBlenderTextureJobStats& stats);
+	bool decodeTexture(const DzBlenderTextureRecord& record, const QSize& sourceSize, const QSize& targetSize,
+		QString sTargetFormat, const QString& sOutputPathNoExt, bool bWriteOutput, qint64 nTargetFileBytes, QList<DzBlenderTextureVariant>& aVariants,
+		DzBlenderTextureJobStats& stats);
+	bool writeToFileSize(const QImage& image, const QString& sOutputPath, qint64 nTargetFileBytes, DzBlenderTextureJobStats& stats);
+	QList<DzBlenderTextureVariant> getTextureVariants(const QSize& textureSize) const;
+	bool writeTextureVariants(const QImage& image, const QString& sFormat, const QString& sOutputPathNoExt,
+		QList<DzBlenderTextureVariant>& aVariants, DzBlenderTextureJobStats& stats);
+	bool fetchTextureVariants(const QString& sKey, const QString& sOutputPathNoExt, QList<DzBlenderTextureVariant>& aVariants);
+	void storeTextureVariants(const QString& sKey, const QList<DzBlenderTextureVariant>& aVariants);
+	void addTextureVariants(const QString& sTexture, const QList<DzBlenderTextureVariant>& aVariants);
+	bool getOrmSize(const DzBlenderOrmRecord& orm, QSize& targetSize, qint64& nSourceBytes);
+	qint64 getOrmBytes(const QSize& targetSize, qint64 nSourceBytes) const;
+	bool packOrmTexture(int nOrmIndex, const QSize& targetSize, const DzBlenderMemoryReservation& reservation);
+	qint64 estimateDecodeBytes(const DzBlenderTextureRecord& record, const QSize& sourceSize, const QSize& targetSize);
+	int getReservationMB(qint64 nBytes) const;
+	bool applyMaterialOperations(const DzBlenderTextureRecord& record, QImage& image, qint64& nPeakBytes);
+	void addTextureResult(const DzBlenderTextureRecord& record, const QString& sNewPath);
+	void logError(const QString& sErrorMessage);
+	bool writeManifest();
+
+	DzBlenderTextureSettings m_oSettings;
+	DzBlenderTextureCache m_oTextureCache;
+	QSemaphore m_oMemoryBudget;
+	int m_nMemoryBudgetMB = 0;
+	int m_nAdmittedJobs = 0;
+	int m_nWaitedJobs = 0;
+	qint64 m_nAdmissionWaitMs = 0;
+	qint64 m_nMaxAdmissionWaitMs = 0;
+
+	QString m_sManifestPath = "";
+	QString m_sOutputFolder = "";
+	QStringList m_aErrorMessages;
+	bool m_bJobsSucceeded = false;
+	qint64 m_nElapsedMs = 0;
+
+	QMutex m_mutex;
+	QWaitCondition m_dtuReadyCondition;
+	bool m_bDtuReady = false;
+	QString m_sDtuPath = "";
+
+	QList<DzBlenderTextureRecord> m_aTextures;
+	QMap<QString, QString> m_mapTextureRemap;
+	QList<DzBlenderMaterialOverride> m_aMaterialOverrides;
+	QList<DzBlenderOrmRecord> m_aOrmTextures;
+	// material index -> properties replaced by its ORM texture
+	QMap<int, QStringList> m_mapPackedProperties;
+	QList<DzBlenderCompressedTexture> m_aCompressedTextures;
+	// DTU texture path -> channel statistics
+	QMap<QString, DzImageStatistics> m_mapTextureStatistics;
+	int m_nCollapsedTextures = 0;
+	// material name -> measured areas
+	QMap<QString, DzBlenderMaterialArea> m_mapMaterialAreas;
+	// DTU texture path -> size picked for its texel density
+	QMap<QString, DzBlenderTextureSizing> m_mapTextureSizing;
+	qint64 m_nSizingBytesBefore = 0;
+	qint64 m_nSizingBytesAfter = 0;
+	// texture path used by Blender -> its downscaled variants, largest first
+	QMap<QString, QList<DzBlenderTextureVariant> > m_mapTextureVariants;
+	QList<DzBlenderTextureJobStats> m_aJobStats;
+
+	// duplicate DTU texture path -> canonical DTU texture path
+	QMap<QString, QString> m_mapDuplicateTextures;
+	int m_nUniqueTextures = 0;
+	qint64 m_nDeduplicatedBytes = 0;
+};
@@ -0,0 +1,1207 @@
+/*****************************
+DzNativeToolsBenchmark
+
+Per-kernel microbenchmark for DzImageKernels at 4K and 8K.  Every SIMD level
+supported by the CPU is timed and its output is checked against the scalar
+kernels: 8-bit kernels must match exactly, float kernels must stay within
+the documented tolerance.  The PNG encoders are then timed at several
+compression levels and every file is decoded again, its pixels must be
+identical to the input.  The BC4, BC5 and BC7 encoders are timed the same
+way and every block is decoded again, the channels the format keeps must
+stay above a minimum PSNR.  The linear skinning bake of DzMeshKernels is timed
+at every SIMD level on a synthetic skinned mesh and checked against a
+per-cluster reference, and the skin weight reduction is checked for its
+influence limit, weight sums and quantization steps.  The vertex cache
+optimization is run on a shuffled quad grid and must reduce its ACMR.  The
+simplifier builds a LOD chain of a bumpy grid with a UV seam, two materials
+and a region budget, and every LOD must hit its triangle target without
+flipped triangles, triangles across the seam or a region below its budget.
+The hidden surface removal is run on a figure-like sphere inside an open
+shell and must remove the same faces as a literal port of the Python ray
+cast loop, which is timed too.  The clothing auto-fit fits a band inside a
+sphere onto it: the band must end on the sphere except for the part
+without a vertex group in common with it, and no face may flip.  The
+weight transfer copies the weights of a sphere to points above its vertices
+and triangle centers, which must get the vertex weights and the average of
+the triangle's weights.  The morph sidecar writes hundreds of sparse and a
+few dense morphs of a figure-sized mesh, as floats and quantized, and reads
+them back: every morph must keep exactly its moved vertices, within half a
+quantization step.  Returns non-zero if any check fails.
+
+Usage: DzNativeToolsBenchmark [--iterations N] [--no-codecs] [--no-mesh] [size ...]
+*****************************/
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "DzImageKernels.h"
+#include "DzMeshKernels.h"
+#include "DzMeshOptimizer.h"
+#include "DzMeshSimplifier.h"
+#include "DzMeshOcclusion.h"
+#include "DzClothFitter.h"
+#include "DzWeightTransfer.h"
+#include "DzMorphDeltas.h"
+#include "DzCpuFeatures.h"
+#include "DzNativeParallel.h"
+#include "DzPngStream.h"
+#include "DzBlockCompression.h"
+
+namespace
+{
+	const float kFloatTolerance = 2e-6f;
+	const size_t kVerifyChunk = 64 * 1024;
+	const char* kPngPath = "DzNativeToolsBenchmark.png";
+	const char* kMorphPath = "DzNativeToolsBenchmark_morphs.bin";
+	// decoded blocks against the source channels of the test texture
+	const double kBlockMinPsnr = 35.0;
+	// relative to the coordinate magnitude
+	const double kSkinningTolerance = 1e-12;
+
+	// input values depend only on (seed, index) so any range can be regenerated for verification
+	inline uint32_t hashIndex(uint32_t nSeed, size_t nIndex)
+	{
+		uint64_t nValue = (uint64_t)nIndex * 0x9E3779B97F4A7C15ull + nSeed;
+		nValue = (nValue ^ (nValue >> 30)) * 0xBF58476D1CE4E5B9ull;
+		nValue = (nValue ^ (nValue >> 27)) * 0x94D049BB133111EBull;
+		return (uint32_t)(nValue ^ (nValue >> 31));
+	}
+
+	void fillU8(uint32_t* pPixels, size_t nBegin, size_t nCount, uint32_t nSeed)
+	{
+		for (size_t i = 0; i < nCount; i++) {
+			pPixels[i] = hashIndex(nSeed, nBegin + i);
+		}
+	}
+
+	void fillF32(float* pValues, size_t nBegin, size_t nCount, uint32_t nSeed)
+	{
+		for (size_t i = 0; i < nCount; i++) {
+			pValues[i] = (hashIndex(nSeed, nBegin + i) >> 8) * (1.0f / 16777216.0f);
+		}
+	}
+
+	struct Buffers
+	{
+		std::vector<uint32_t> aU8;
+		std::vector<uint32_t> aU8Second;
+		std::vector<float> aF32;
+		std::vector<float> aF32Second;
+	};
+
+	struct Kernel
+	{
+		const char* sName;
+		bool bFloat;
+		int nChannels;      // float values per pixel
+		bool bSecondInput;
+		void (*fnRun)(const DzImageKernelTable& kernels, uint32_t* pU8, const uint32_t* pU8Second, float* pF32, const float* pF32Second, size_t nPixels);
+	};
+
+	const Kernel kKernels[] = {
+		{ "CombineColorAndAlpha", false, 0, true, [](const DzImageKernelTable& k, uint32_t* p, const uint32_t* q, float*, const float*, size_t n) { k.CombineColorAndAlpha(p, p, q, n); } },
+		{ "MultiplyByColor", false, 0, false, [](const DzImageKernelTable& k, uint32_t* p, const uint32_t*, float*, const float*, size_t n) { k.MultiplyByColor(p, n, 0xc08040); } },
+		{ "SrgbToLinear", false, 0, false, [](const DzImageKernelTable& k, uint32_t* p, const uint32_t*, float*, const float*, size_t n) { k.SrgbToLinear(p, n); } },
+		{ "LinearToSrgb", false, 0, false, [](const DzImageKernelTable& k, uint32_t* p, const uint32_t*, float*, const float*, size_t n) { k.LinearToSrgb(p, n); } },
+		{ "IntensityToAlphaF32", true, 4, true, [](const DzImageKernelTable& k, uint32_t*, const uint32_t*, float* p, const float* q, size_t n) { k.IntensityToAlphaF32(p, q, n); } },
+		{ "SrgbToLinearF32 RGBA", true, 4, false, [](const DzImageKernelTable& k, uint32_t*, const uint32_t*, float* p, const float*, size_t n) { k.SrgbToLinearF32(p, n, 4); } },
+		{ "LinearToSrgbF32 RGBA", true, 4, false, [](const DzImageKernelTable& k, uint32_t*, const uint32_t*, float* p, const float*, size_t n) { k.LinearToSrgbF32(p, n, 4); } },
+		{ "SrgbToLinearF32 RGB", true, 3, false, [](const DzImageKernelTable& k, uint32_t*, const uint32_t*, float* p, const float*, size_t n) { k.SrgbToLinearF32(p, n, 3); } },
+	};
+
+	void fillInputs(const Kernel& kernel, Buffers& buffers, size_t nPixels)
+	{
+		if (kernel.bFloat) {
+			fillF32(buffers.aF32.data(), 0, nPixels * kernel.nChannels, 1);
+			if (kernel.bSecondInput) fillF32(buffers.aF32Second.data(), 0, nPixels * kernel.nChannels, 2);
+		}
+		else {
+			fillU8(buffers.aU8.data(), 0, nPixels, 1);
+			if (kernel.bSecondInput) fillU8(buffers.aU8Second.data(), 0, nPixels, 2);
+		}
+	}
+
+	// Recomputes the scalar result chunk by chunk and compares.  Returns the max error (float) or the mismatch count (8-bit).
+	double verify(const Kernel& kernel, const Buffers& buffers, size_t nPixels)
+	{
+		const DzImageKernelTable& scalar = DzGetScalarKernels();
+		double dResult = 0.0;
+		std::vector<uint32_t> aU8(kVerifyChunk), aU8Second(kVerifyChunk);
+		std::vector<float> aF32(kVerifyChunk * 4), aF32Second(kVerifyChunk * 4);
+		for (size_t nBegin = 0; nBegin < nPixels; nBegin += kVerifyChunk) {
+			size_t nCount = nPixels - nBegin < kVerifyChunk ? nPixels - nBegin : kVerifyChunk;
+			if (kernel.bFloat) {
+				size_t nValues = nCount * kernel.nChannels;
+				size_t nOffset = nBegin * kernel.nChannels;
+				fillF32(aF32.data(), nOffset, nValues, 1);
+				fillF32(aF32Second.data(), nOffset, nValues, 2);
+				kernel.fnRun(scalar, nullptr, nullptr, aF32.data(), aF32Second.data(), nCount);
+				for (size_t i = 0; i < nValues; i++) {
+					double dError = fabs((double)aF32[i] - (double)buffers.aF32[nOffset + i]);
+					if (dError > dResult) dResult = dError;
+				}
+			}
+			else {
+				fillU8(aU8.data(), nBegin, nCount, 1);
+				fillU8(aU8Second.data(), nBegin, nCount, 2);
+				kernel.fnRun(scalar, aU8.data(), aU8Second.data(), nullptr, nullptr, nCount);
+				for (size_t i = 0; i < nCount; i++) {
+					if (aU8[i] != buffers.aU8[nBegin + i]) dResult += 1.0;
+				}
+			}
+		}
+		return dResult;
+	}
+
+	// texture-like content: gradients, a repeating pattern and a little noise
+	void fillTexture(uint32_t* pPixels, int nSize)
+	{
+		for (int y = 0; y < nSize; y++) {
+			for (int x = 0; x < nSize; x++) {
+				uint32_t nNoise = hashIndex(3, (size_t)y * nSize + x);
+				uint32_t nR = (uint32_t)(x * 255 / nSize) ^ (nNoise & 3);
+				uint32_t nG = (uint32_t)(y * 255 / nSize) ^ ((nNoise >> 2) & 3);
+				uint32_t nB = (uint32_t)(((x >> 4) ^ (y >> 4)) & 1 ? 200 : 60) + ((nNoise >> 4) & 7);
+				uint32_t nA = x < nSize / 2 ? 255 : (uint32_t)(y * 255 / nSize);
+				pPixels[(size_t)y * nSize + x] = (nA << 24) | (nR << 16) | (nG << 8) | nB;
+			}
+		}
+	}
+
+	// Decodes kPngPath and counts the pixels that differ from pPixels
+	size_t countPngMismatches(const uint32_t* pPixels, int nSize)
+	{
+		DzPngStripReader reader;
+		if (reader.open(kPngPath) == false || reader.getWidth() != nSize || reader.getHeight() != nSize) {
+			return (size_t)nSize * nSize;
+		}
+		std::vector<uint32_t> aRows((size_t)nSize * 64);
+		size_t nMismatches = 0;
+		for (int y = 0; y < nSize; y += 64) {
+			int nRows = reader.readRows(aRows.data(), 64);
+			if (nRows <= 0) {
+				return (size_t)nSize * nSize;
+			}
+			const uint32_t* pExpected = pPixels + (size_t)y * nSize;
+			for (size_t i = 0; i < (size_t)nRows * nSize; i++) {
+				if (aRows[i] != pExpected[i]) nMismatches++;
+			}
+		}
+		return nMismatches;
+	}
+
+	bool benchmarkPngCodecs(int nSize, int nIterations)
+	{
+		std::vector<uint32_t> aPixels((size_t)nSize * nSize);
+		fillTexture(aPixels.data(), nSize);
+		size_t nPixels = aPixels.size();
+
+		struct Encoder {
+			const char* sName;
+			int nLevel;
+			bool bParallel;
+		};
+		const Encoder aEncoders[] = {
+			{ "strips", 6, false },
+			{ "parallel", 0, true },
+			{ "parallel", 1, true },
+			{ "parallel", 6, true },
+			{ "parallel", 9, true },
+		};
+		bool bAllPassed = true;
+		for (size_t e = 0; e < sizeof(aEncoders) / sizeof(aEncoders[0]); e++) {
+			const Encoder& encoder = aEncoders[e];
+			double dBestMs = 0.0;
+			bool bWritten = true;
+			for (int i = 0; i < nIterations && bWritten; i++) {
+				auto start = std::chrono::high_resolution_clock::now();
+				if (encoder.bParallel) {
+					DzPngWriteSettings settings;
+					settings.nCompressionLevel = encoder.nLevel;
+					std::string sError;
+					bWritten = DzPngImageWriter::Write(kPngPath, aPixels.data(), nSize, nSize, nSize, true, settings, sError);
+				}
+				else {
+					DzPngStripWriter writer;
+					bWritten = writer.open(kPngPath, nSize, nSize, true, encoder.nLevel) &&
+						writer.writeRows(aPixels.data(), nSize) && writer.close();
+				}
+				double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+			}
+			double dFileMB = 0.0;
+			FILE* pFile = fopen(kPngPath, "rb");
+			if (pFile) {
+				fseek(pFile, 0, SEEK_END);
+				dFileMB = ftell(pFile) / (1024.0 * 1024.0);
+				fclose(pFile);
+			}
+			size_t nMismatches = bWritten ? countPngMismatches(aPixels.data(), nSize) : nPixels;
+			bool bPassed = nMismatches == 0;
+			bAllPassed = bAllPassed && bPassed;
+			printf("png %-8s level %d  %6d %3d threads %10.2f %10.1f %8.1f MB  %s (%zu mismatches)\n", encoder.sName, encoder.nLevel, nSize,
+				encoder.bParallel ? DzNativeParallel::GetNumThreads() : 1, dBestMs, nPixels / 1000.0 / dBestMs, dFileMB,
+				bPassed ? "ok" : "FAILED", nMismatches);
+			fflush(stdout);
+		}
+		remove(kPngPath);
+		return bAllPassed;
+	}
+
+	// Encodes the test texture, decodes every block again and compares it with the channels the format keeps
+	bool benchmarkBlockCompression(int nSize, DzBlockFormat eFormat, int nIterations)
+	{
+		std::vector<uint32_t> aPixels((size_t)nSize * nSize);
+		fillTexture(aPixels.data(), nSize);
+		size_t nPixels = aPixels.size();
+		std::vector<uint8_t> aBlocks(DzBlockCompressor::GetImageBytes(eFormat, nSize, nSize));
+		size_t nBlockBytes = DzBlockCompressor::GetBlockBytes(eFormat);
+
+		double dBestMs = 0.0;
+		for (int i = 0; i < nIterations; i++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			DzBlockCompressor::EncodeImage(eFormat, aPixels.data(), nSize, nSize, nSize, aBlocks.data());
+			double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+		}
+
+		const char* sName = eFormat == DzBlockFormat::BC4 ? "bc4" : eFormat == DzBlockFormat::BC5 ? "bc5" : "bc7";
+		int nChannels = eFormat == DzBlockFormat::BC4 ? 1 : eFormat == DzBlockFormat::BC5 ? 2 : 4;
+		int nBlocksX = (nSize + 3) / 4;
+		int nMaxError = 0;
+		double dSquaredError = 0.0;
+		bool bDecoded = true;
+		for (size_t nBlock = 0; nBlock < aBlocks.size() / nBlockBytes; nBlock++) {
+			const uint8_t* pBlock = &aBlocks[nBlock * nBlockBytes];
+			uint32_t aDecoded[16];
+			uint8_t aValues[2][16];
+			if (eFormat == DzBlockFormat::BC7) {
+				bDecoded = DzBlockCompressor::DecodeBC7Block(pBlock, aDecoded) && bDecoded;
+			}
+			else {
+				DzBlockCompressor::DecodeBC4Block(pBlock, aValues[0]);
+				if (eFormat == DzBlockFormat::BC5) DzBlockCompressor::DecodeBC4Block(pBlock + 8, aValues[1]);
+			}
+			int nBlockX = (int)(nBlock % nBlocksX), nBlockY = (int)(nBlock / nBlocksX);
+			for (int p = 0; p < 16; p++) {
+				int x = nBlockX * 4 + p % 4, y = nBlockY * 4 + p / 4;
+				if (x >= nSize || y >= nSize) continue;
+				uint32_t nPixel = aPixels[(size_t)y * nSize + x];
+				for (int c = 0; c < nChannels; c++) {
+					int nExpected, nActual;
+					if (eFormat == DzBlockFormat::BC4) {
+						// the encoder's Rec.709 luminance
+						nExpected = (54 * ((nPixel >> 16) & 0xff) + 183 * ((nPixel >> 8) & 0xff) + 19 * (nPixel & 0xff) + 128) >> 8;
+						nActual = aValues[0][p];
+					}
+					else if (eFormat == DzBlockFormat::BC5) {
+						nExpected = (nPixel >> (16 - c * 8)) & 0xff;
+						nActual = aValues[c][p];
+					}
+					else {
+						int nShift = c == 3 ? 24 : 16 - c * 8;
+						nExpected = (nPixel >> nShift) & 0xff;
+						nActual = (aDecoded[p] >> nShift) & 0xff;
+					}
+					int nError = abs(nActual - nExpected);
+					if (nError > nMaxError) nMaxError = nError;
+					dSquaredError += (double)nError * nError;
+				}
+			}
+		}
+		double dMse = dSquaredError / ((double)nPixels * nChannels);
+		double dPsnr = dMse > 0.0 ? 10.0 * log10(255.0 * 255.0 / dMse) : 99.0;
+		bool bPassed = bDecoded && dPsnr >= kBlockMinPsnr;
+		printf("%-25s %6d %3d threads %10.2f %10.1f %11s  %s (max err %d, %.1f dB)\n", sName, nSize,
+			DzNativeParallel::GetNumThreads(), dBestMs, nPixels / 1000.0 / dBestMs, "",
+			bPassed ? "ok" : "FAILED", nMaxError, dPsnr);
+		fflush(stdout);
+		return bPassed;
+	}
+
+	// nPoints points on a 100 unit cube, each with 4 influences of nClusters rigid-ish cluster matrices
+	void fillSkinnedMesh(DzSkinBakeMesh& mesh, std::vector<double>& aPoints, size_t nPoints, size_t nClusters)
+	{
+		aPoints.resize(nPoints * 4);
+		for (size_t i = 0; i < nPoints; i++) {
+			for (int c = 0; c < 3; c++) {
+				aPoints[i * 4 + c] = (hashIndex(10 + c, i) >> 8) * (100.0 / 16777216.0) - 50.0;
+			}
+			aPoints[i * 4 + 3] = 1.0;
+		}
+		mesh.pPoints = aPoints.data();
+		mesh.nPoints = nPoints;
+		mesh.aClusterMatrices.resize(nClusters * 12);
+		for (size_t c = 0; c < nClusters; c++) {
+			double fAngle = c * 0.1;
+			double aMatrix[12] = { cos(fAngle), -sin(fAngle), 0.0, (double)c, sin(fAngle), cos(fAngle), 0.0, 1.0, 0.0, 0.0, 1.0 + c * 0.01, -2.0 };
+			memcpy(&mesh.aClusterMatrices[c * 12], aMatrix, sizeof(aMatrix));
+		}
+		std::vector<std::vector<int> > aClusterPoints(nClusters);
+		std::vector<std::vector<double> > aClusterWeights(nClusters);
+		for (size_t i = 0; i < nPoints; i++) {
+			double aWeights[4] = { 0.4, 0.3, 0.2, 0.1 };
+			for (int k = 0; k < 4; k++) {
+				size_t nCluster = hashIndex(20 + k, i) % nClusters;
+				aClusterPoints[nCluster].push_back((int)i);
+				aClusterWeights[nCluster].push_back(aWeights[k]);
+			}
+		}
+		mesh.aClusterOffsets.assign(1, 0);
+		mesh.aIndices.clear();
+		mesh.aWeights.clear();
+		for (size_t c = 0; c < nClusters; c++) {
+			mesh.aIndices.insert(mesh.aIndices.end(), aClusterPoints[c].begin(), aClusterPoints[c].end());
+			mesh.aWeights.insert(mesh.aWeights.end(), aClusterWeights[c].begin(), aClusterWeights[c].end());
+			mesh.aClusterOffsets.push_back((uint32_t)mesh.aIndices.size());
+		}
+	}
+
+	// accumulates each cluster's transform of the source points, then normalizes, like the FBX SDK sample
+	double verifySkinning(const DzSkinBakeMesh& mesh, const std::vector<double>& aSource)
+	{
+		std::vector<double> aSums(mesh.nPoints * 3, 0.0), aWeightSums(mesh.nPoints, 0.0);
+		for (size_t c = 0; c + 1 < mesh.aClusterOffsets.size(); c++) {
+			const double* m = &mesh.aClusterMatrices[c * 12];
+			for (uint32_t k = mesh.aClusterOffsets[c]; k < mesh.aClusterOffsets[c + 1]; k++) {
+				const double* p = &aSource[(size_t)mesh.aIndices[k] * 4];
+				double w = mesh.aWeights[k];
+				for (int r = 0; r < 3; r++) {
+					aSums[mesh.aIndices[k] * 3 + r] += w * (m[r * 4] * p[0] + m[r * 4 + 1] * p[1] + m[r * 4 + 2] * p[2] + m[r * 4 + 3]);
+				}
+				aWeightSums[mesh.aIndices[k]] += w;
+			}
+		}
+		double dMaxError = 0.0;
+		for (size_t i = 0; i < mesh.nPoints; i++) {
+			for (int r = 0; r < 3; r++) {
+				double dExpected = aSums[i * 3 + r] / aWeightSums[i];
+				double dError = fabs(mesh.pPoints[i * 4 + r] - dExpected) / (fabs(dExpected) + 1.0);
+				if (dError > dMaxError) dMaxError = dError;
+			}
+		}
+		return dMaxError;
+	}
+
+	bool benchmarkSkinning(size_t nPoints, int nIterations)
+	{
+		DzSkinBakeMesh mesh;
+		std::vector<double> aSource, aPoints;
+		fillSkinnedMesh(mesh, aSource, nPoints, 128);
+		DzCpuFeatures::SimdLevel eCurrent = DzCpuFeatures::GetSimdLevel();
+		bool bAllPassed = true;
+		double dScalarMs = 0.0;
+		for (int nLevel = DzCpuFeatures::Scalar; nLevel <= DzCpuFeatures::GetSupportedSimdLevel(); nLevel++) {
+			DzCpuFeatures::SetSimdLevel((DzCpuFeatures::SimdLevel)nLevel);
+			double dBestMs = 0.0;
+			for (int i = 0; i < nIterations; i++) {
+				aPoints = aSource;
+				std::vector<DzSkinBakeMesh> aMeshes(1, mesh);
+				aMeshes[0].pPoints = aPoints.data();
+				auto start = std::chrono::high_resolution_clock::now();
+				DzMeshKernels::BakeLinearSkinning(aMeshes);
+				double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+			}
+			if (nLevel == DzCpuFeatures::Scalar) dScalarMs = dBestMs;
+			DzSkinBakeMesh baked = mesh;
+			baked.pPoints = aPoints.data();
+			double dError = verifySkinning(baked, aSource);
+			bool bPassed = dError <= kSkinningTolerance;
+			bAllPassed = bAllPassed && bPassed;
+			printf("%-22s %8zu %-7s %3d threads %10.2f %10.1f %7.2fx  %s (max err %.2e)\n", "BakeLinearSkinning", nPoints,
+				DzCpuFeatures::GetSimdLevelName((DzCpuFeatures::SimdLevel)nLevel), DzNativeParallel::GetNumThreads(),
+				dBestMs, nPoints / 1000.0 / dBestMs, dScalarMs / dBestMs, bPassed ? "ok" : "FAILED", dError);
+			fflush(stdout);
+		}
+		DzCpuFeatures::SetSimdLevel(eCurrent);
+		return bAllPassed;
+	}
+
+	// prunes, caps at 2 influences and quantizes to 8 bits, then checks every point of the result
+	bool benchmarkSkinWeights(size_t nPoints, int nIterations)
+	{
+		DzSkinBakeMesh mesh;
+		std::vector<double> aSource;
+		fillSkinnedMesh(mesh, aSource, nPoints, 128);
+		DzSkinWeightSettings settings;
+		settings.fMinWeight = 0.15;
+		settings.nMaxInfluences = 2;
+		settings.nQuantizationBits = 8;
+		DzSkinBakeMesh optimized;
+		DzSkinWeightStats stats;
+		double dBestMs = 0.0;
+		for (int i = 0; i < nIterations; i++) {
+			optimized = mesh;
+			auto start = std::chrono::high_resolution_clock::now();
+			DzMeshKernels::OptimizeSkinWeights(optimized, settings, stats);
+			double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+		}
+
+		std::vector<int> aCounts(nPoints, 0);
+		std::vector<double> aWeightSums(nPoints, 0.0);
+		bool bPassed = true;
+		for (size_t k = 0; k < optimized.aIndices.size(); k++) {
+			double fSteps = optimized.aWeights[k] * 255.0;
+			bPassed = bPassed && fabs(fSteps - floor(fSteps + 0.5)) < 1e-9 && optimized.aWeights[k] > 0.0;
+			aCounts[optimized.aIndices[k]]++;
+			aWeightSums[optimized.aIndices[k]] += optimized.aWeights[k];
+		}
+		for (size_t i = 0; i < nPoints; i++) {
+			bPassed = bPassed && aCounts[i] >= 1 && aCounts[i] <= settings.nMaxInfluences && fabs(aWeightSums[i] - 1.0) < 1e-12;
+		}
+		bPassed = bPassed && stats.nInfluencesBefore == nPoints * 4 && stats.nInfluencesAfter == optimized.aIndices.size();
+		double dError = DzMeshKernels::MeasureSkinningDifference(mesh, optimized);
+		printf("%-22s %8zu %-7s %3d threads %10.2f %10.1f %7s  %s (%zu -> %zu influences, max offset %.2f)\n", "OptimizeSkinWeights",
+			nPoints, DzCpuFeatures::GetSimdLevelName(DzCpuFeatures::GetSimdLevel()), DzNativeParallel::GetNumThreads(),
+			dBestMs, nPoints / 1000.0 / dBestMs, "", bPassed ? "ok" : "FAILED", stats.nInfluencesBefore, stats.nInfluencesAfter, dError);
+		fflush(stdout);
+		return bPassed;
+	}
+
+	bool isPermutation(const std::vector<uint32_t>& aValues)
+	{
+		std::vector<uint8_t> aSeen(aValues.size(), 0);
+		for (size_t i = 0; i < aValues.size(); i++) {
+			if (aValues[i] >= aValues.size() || aSeen[aValues[i]]) return false;
+			aSeen[aValues[i]] = 1;
+		}
+		return true;
+	}
+
+	// nSide x nSide quads in hashed order, with a triangle fan on every 16th quad so that face sizes are mixed
+	bool benchmarkMeshOrder(size_t nSide, int nIterations)
+	{
+		std::vector<uint32_t> aShuffle(nSide * nSide);
+		for (size_t i = 0; i < aShuffle.size(); i++) {
+			aShuffle[i] = (uint32_t)i;
+		}
+		for (size_t i = aShuffle.size() - 1; i > 0; i--) {
+			std::swap(aShuffle[i], aShuffle[hashIndex(30, i) % (i + 1)]);
+		}
+		DzMeshOrder mesh;
+		mesh.nVertices = (nSide + 1) * (nSide + 1);
+		mesh.bKeepFaceSizes = true;
+		mesh.aOffsets.assign(1, 0);
+		for (size_t i = 0; i < aShuffle.size(); i++) {
+			uint32_t x = aShuffle[i] % nSide, y = aShuffle[i] / nSide;
+			uint32_t aQuad[4] = { y * (uint32_t)(nSide + 1) + x, y * (uint32_t)(nSide + 1) + x + 1,
+				(y + 1) * (uint32_t)(nSide + 1) + x + 1, (y + 1) * (uint32_t)(nSide + 1) + x };
+			if (aShuffle[i] % 16 == 0) {
+				uint32_t aTriangles[6] = { aQuad[0], aQuad[1], aQuad[2], aQuad[0], aQuad[2], aQuad[3] };
+				for (int t = 0; t < 2; t++) {
+					mesh.aCorners.insert(mesh.aCorners.end(), aTriangles + t * 3, aTriangles + t * 3 + 3);
+					mesh.aOffsets.push_back((uint32_t)mesh.aCorners.size());
+				}
+			}
+			else {
+				mesh.aCorners.insert(mesh.aCorners.end(), aQuad, aQuad + 4);
+				mesh.aOffsets.push_back((uint32_t)mesh.aCorners.size());
+			}
+		}
+
+		double dBestMs = 0.0;
+		for (int i = 0; i < nIterations; i++) {
+			std::vector<DzMeshOrder> aMeshes(1, mesh);
+			auto start = std::chrono::high_resolution_clock::now();
+			DzMeshOptimizer::OptimizeMeshOrder(aMeshes);
+			double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+			mesh.aFaceOrder.swap(aMeshes[0].aFaceOrder);
+			mesh.aVertexRemap.swap(aMeshes[0].aVertexRemap);
+		}
+		DzVertexCacheStats before = DzMeshOptimizer::AnalyzeVertexCache(mesh, false);
+		DzVertexCacheStats after = DzMeshOptimizer::AnalyzeVertexCache(mesh, true);
+		bool bPassed = isPermutation(mesh.aFaceOrder) && isPermutation(mesh.aVertexRemap) && after.getAcmr() < before.getAcmr();
+		for (size_t i = 0; i < mesh.aFaceOrder.size() && bPassed; i++) {
+			uint32_t f = mesh.aFaceOrder[i];
+			bPassed = mesh.aOffsets[f + 1] - mesh.aOffsets[f] == mesh.aOffsets[i + 1] - mesh.aOffsets[i];
+		}
+		size_t nFaces = mesh.aOffsets.size() - 1;
+		printf("%-22s %8zu %-7s %3d threads %10.2f %10.1f %7s  %s (ACMR %.3f -> %.3f, ATVR %.3f -> %.3f)\n", "OptimizeMeshOrder",
+			nFaces, "", 1, dBestMs, nFaces / 1000.0 / dBestMs, "", bPassed ? "ok" : "FAILED",
+			before.getAcmr(), after.getAcmr(), before.getAtvr(), after.getAtvr());
+		fflush(stdout);
+		return bPassed;
+	}
+
+	// nSide x nSide quads as triangle pairs on a bumpy height field.  The middle column is a UV seam (two wedges per
+	// vertex, the wedge side is kept in aWedgeSides), the upper half is a second material, the lower left quadrant is
+	// region 1 with a 25% budget.
+	bool benchmarkSimplifier(size_t nSide, int nIterations)
+	{
+		size_t nRow = nSide + 1;
+		size_t nSeam = nSide / 2;
+		std::vector<float> aPositions(nRow * nRow * 3);
+		std::vector<int> aWedgeVertices, aWedgeSides, aRegions(nRow * nRow, 0);
+		std::vector<int> aLeftWedges(nRow * nRow), aRightWedges(nRow * nRow);
+		for (size_t y = 0; y < nRow; y++) {
+			for (size_t x = 0; x < nRow; x++) {
+				size_t v = y * nRow + x;
+				aPositions[v * 3] = (float)x;
+				aPositions[v * 3 + 1] = (float)y;
+				aPositions[v * 3 + 2] = (float)(2.0 * sin(x * 0.05) * cos(y * 0.07) + (hashIndex(40, v) >> 24) * 0.0005);
+				aRegions[v] = x < nSeam && y < nSeam ? 1 : 0;
+				aLeftWedges[v] = aRightWedges[v] = (int)aWedgeVertices.size();
+				aWedgeVertices.push_back((int)v);
+				aWedgeSides.push_back(x <= nSeam ? 0 : 1);
+				if (x == nSeam) {
+					aRightWedges[v] = (int)aWedgeVertices.size();
+					aWedgeVertices.push_back((int)v);
+					aWedgeSides.push_back(1);
+				}
+			}
+		}
+		std::vector<int> aTriangles, aMaterials, aTriangleSides;
+		for (size_t y = 0; y < nSide; y++) {
+			for (size_t x = 0; x < nSide; x++) {
+				const std::vector<int>& aWedges = x < nSeam ? aLeftWedges : aRightWedges;
+				int v00 = aWedges[y * nRow + x], v10 = aWedges[y * nRow + x + 1];
+				int v01 = aWedges[(y + 1) * nRow + x], v11 = aWedges[(y + 1) * nRow + x + 1];
+				int aQuad[6] = { v00, v10, v11, v00, v11, v01 };
+				aTriangles.insert(aTriangles.end(), aQuad, aQuad + 6);
+				for (int t = 0; t < 2; t++) {
+					aMaterials.push_back(y < nSide / 2 ? 0 : 1);
+					aTriangleSides.push_back(x < nSeam ? 0 : 1);
+				}
+			}
+		}
+		size_t nTriangles = aTriangles.size() / 3;
+		size_t nRegionTriangles = 0;
+		for (size_t t = 0; t < nTriangles; t++) {
+			int nRegion = 0;
+			for (int c = 0; c < 3; c++) nRegion = std::max(nRegion, aRegions[aWedgeVertices[aTriangles[t * 3 + c]]]);
+			if (nRegion == 1) nRegionTriangles++;
+		}
+
+		DzSimplifyMesh mesh;
+		mesh.pPositions = aPositions.data();
+		mesh.nVertices = nRow * nRow;
+		mesh.pWedgeVertices = aWedgeVertices.data();
+		mesh.nWedges = aWedgeVertices.size();
+		mesh.pTriangles = aTriangles.data();
+		mesh.nTriangles = nTriangles;
+		mesh.pTriangleMaterials = aMaterials.data();
+		mesh.pVertexRegions = aRegions.data();
+		mesh.aRegionRatios.push_back(0.25f);
+		mesh.aLodTargets.push_back(nTriangles / 2 + 1);
+		mesh.aLodTargets.push_back(nTriangles / 4);
+		mesh.aLodTargets.push_back(nTriangles / 8 + 1);
+		double dBestMs = 0.0;
+		bool bPassed = true;
+		for (int i = 0; i < nIterations; i++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			bPassed = DzMeshSimplifier::Simplify(mesh);
+			double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+		}
+
+		std::string sCounts;
+		for (size_t nLod = 0; nLod < mesh.aLodTriangles.size() && bPassed; nLod++) {
+			const std::vector<int>& aLod = mesh.aLodTriangles[nLod];
+			size_t nLodTriangles = aLod.size() / 3, nLodRegionTriangles = 0;
+			bPassed = nLodTriangles == mesh.aLodTargets[nLod] && mesh.aLodSourceTriangles[nLod].size() == nLodTriangles;
+			for (size_t t = 0; t < nLodTriangles && bPassed; t++) {
+				int nSource = mesh.aLodSourceTriangles[nLod][t];
+				int nRegion = 0;
+				const float* p[3];
+				for (int c = 0; c < 3; c++) {
+					int w = aLod[t * 3 + c];
+					bPassed = bPassed && aWedgeSides[w] == aTriangleSides[nSource];
+					nRegion = std::max(nRegion, aRegions[aWedgeVertices[w]]);
+					p[c] = &aPositions[aWedgeVertices[w] * 3];
+				}
+				double fNormalZ = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[1][1] - p[0][1]) * (p[2][0] - p[0][0]);
+				bPassed = bPassed && fNormalZ > 0.0;
+				if (nRegion == 1) nLodRegionTriangles++;
+			}
+			bPassed = bPassed && nLodRegionTriangles * 4 >= nRegionTriangles;
+			char sCount[64];
+			snprintf(sCount, sizeof(sCount), "%s%zu", nLod ? " " : "", nLodTriangles);
+			sCounts += sCount;
+		}
+		bPassed = bPassed && mesh.aLodTriangles.size() == mesh.aLodTargets.size();
+		printf("%-22s %8zu %-7s %3d threads %10.2f %10.1f %7s  %s (LOD triangles %s, max error %.2e)\n", "SimplifyMesh",
+			nTriangles, "", 1, dBestMs, nTriangles / 1000.0 / dBestMs, "", bPassed ? "ok" : "FAILED", sCounts.c_str(),
+			mesh.aLodErrors.empty() ? 0.0 : mesh.aLodErrors.back());
+		fflush(stdout);
+		return bPassed;
+	}
+	// Blender's isect_ray_tri_epsilon_v3 with FLT_EPSILON, as Object.ray_cast() uses it
+	bool intersectTriangle(const float* o, const float* d, const float* p0, const float* p1, const float* p2, float& fDistance)
+	{
+		float e1[3], e2[3], p[3], s[3], q[3];
+		for (int c = 0; c < 3; c++) {
+			e1[c] = p1[c] - p0[c];
+			e2[c] = p2[c] - p0[c];
+			s[c] = o[c] - p0[c];
+		}
+		p[0] = d[1] * e2[2] - d[2] * e2[1];
+		p[1] = d[2] * e2[0] - d[0] * e2[2];
+		p[2] = d[0] * e2[1] - d[1] * e2[0];
+		float a = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (a == 0.0f) return false;
+		float f = 1.0f / a;
+		float u = f * (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]);
+		if (u < -FLT_EPSILON || u > 1.0f + FLT_EPSILON) return false;
+		q[0] = s[1] * e1[2] - s[2] * e1[1];
+		q[1] = s[2] * e1[0] - s[0] * e1[2];
+		q[2] = s[0] * e1[1] - s[1] * e1[0];
+		float v = f * (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]);
+		if (v < -FLT_EPSILON || u + v > 1.0f + FLT_EPSILON) return false;
+		fDistance = f * (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]);
+		return fDistance >= 0.0f;
+	}
+
+	// A unit sphere (open at the poles) inside a shell of radius 1.04 with a window, as quads with outward normals.
+	// The reference is remove_obscured_faces() of game_readiness_tools.py: every face, vertex, linked face and threshold
+	// casts its own ray against all triangles.
+	bool benchmarkOcclusion(size_t nLongitudes, bool bReference, int nIterations)
+	{
+		size_t nLatitudes = nLongitudes / 2;
+		std::vector<float> aPositions;
+		std::vector<int> aFaceLoopStarts, aFaceLoopCounts, aLoopVertices, aTriangles, aTriangleFaces;
+		for (int nShell = 0; nShell < 2; nShell++) {
+			float fRadius = nShell ? 1.04f : 1.0f;
+			int nFirstVertex = (int)aPositions.size() / 3;
+			for (size_t y = 0; y <= nLatitudes; y++) {
+				double fLatitude = (y / (double)nLatitudes - 0.5) * 2.6;
+				for (size_t x = 0; x < nLongitudes; x++) {
+					double fLongitude = x * 6.283185307179586 / nLongitudes;
+					aPositions.push_back((float)(fRadius * cos(fLatitude) * cos(fLongitude)));
+					aPositions.push_back((float)(fRadius * cos(fLatitude) * sin(fLongitude)));
+					aPositions.push_back((float)(fRadius * sin(fLatitude)));
+				}
+			}
+			for (size_t y = 0; y < nLatitudes; y++) {
+				for (size_t x = 0; x < nLongitudes; x++) {
+					if (nShell == 1 && x < nLongitudes / 8 && y > nLatitudes / 3 && y < nLatitudes * 2 / 3) continue;
+					int aQuad[4] = { nFirstVertex + (int)(y * nLongitudes + x), nFirstVertex + (int)(y * nLongitudes + (x + 1) % nLongitudes),
+						nFirstVertex + (int)((y + 1) * nLongitudes + (x + 1) % nLongitudes), nFirstVertex + (int)((y + 1) * nLongitudes + x) };
+					int nFace = (int)aFaceLoopStarts.size();
+					aFaceLoopStarts.push_back((int)aLoopVertices.size());
+					aFaceLoopCounts.push_back(4);
+					aLoopVertices.insert(aLoopVertices.end(), aQuad, aQuad + 4);
+					int aQuadTriangles[6] = { aQuad[0], aQuad[1], aQuad[2], aQuad[0], aQuad[2], aQuad[3] };
+					aTriangles.insert(aTriangles.end(), aQuadTriangles, aQuadTriangles + 6);
+					aTriangleFaces.push_back(nFace);
+					aTriangleFaces.push_back(nFace);
+				}
+			}
+		}
+		size_t nFaces = aFaceLoopStarts.size(), nTriangles = aTriangleFaces.size();
+		// Newell normals, as Blender computes polygon normals
+		std::vector<float> aNormals(nFaces * 3, 0.0f);
+		for (size_t f = 0; f < nFaces; f++) {
+			double n[3] = { 0.0, 0.0, 0.0 };
+			for (int k = 0; k < aFaceLoopCounts[f]; k++) {
+				const float* a = &aPositions[aLoopVertices[aFaceLoopStarts[f] + k] * 3];
+				const float* b = &aPositions[aLoopVertices[aFaceLoopStarts[f] + (k + 1) % aFaceLoopCounts[f]] * 3];
+				n[0] += (a[1] - b[1]) * (a[2] + b[2]);
+				n[1] += (a[2] - b[2]) * (a[0] + b[0]);
+				n[2] += (a[0] - b[0]) * (a[1] + b[1]);
+			}
+			double fLength = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int c = 0; c < 3 && fLength > 0.0; c++) aNormals[f * 3 + c] = (float)(n[c] / fLength);
+		}
+		const float fOffset = 0.001f;
+		const float aThresholds[3] = { 0.02f, 0.05f, 0.1f };
+
+		DzOcclusionMesh mesh;
+		mesh.pPositions = aPositions.data();
+		mesh.nVertices = aPositions.size() / 3;
+		mesh.pFaceLoopStarts = aFaceLoopStarts.data();
+		mesh.pFaceLoopCounts = aFaceLoopCounts.data();
+		mesh.pFaceNormals = aNormals.data();
+		mesh.nFaces = nFaces;
+		mesh.pLoopVertices = aLoopVertices.data();
+		mesh.nLoops = aLoopVertices.size();
+		mesh.pTriangles = aTriangles.data();
+		mesh.pTriangleFaces = aTriangleFaces.data();
+		mesh.nTriangles = nTriangles;
+		std::vector<uint8_t> aObscured;
+		DzOcclusionStats stats;
+		double dBestMs = 0.0;
+		bool bPassed = true;
+		for (int i = 0; i < nIterations; i++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			bPassed = DzMeshOcclusion::FindObscuredFaces(mesh, fOffset, aThresholds[2], aObscured, &stats);
+			double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+		}
+
+		char sSpeedup[32] = "";
+		size_t nMismatches = 0;
+		if (bReference) {
+			std::vector<std::vector<int> > aVertexFaces(mesh.nVertices);
+			for (size_t f = 0; f < nFaces; f++) {
+				for (int k = 0; k < aFaceLoopCounts[f]; k++) aVertexFaces[aLoopVertices[aFaceLoopStarts[f] + k]].push_back((int)f);
+			}
+			std::vector<uint8_t> aRemoved(nFaces, 0);
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int nThreshold = 0; nThreshold < 3; nThreshold++) {
+				for (size_t nFace = 0; nFace < nFaces; nFace++) {
+					if (aRemoved[nFace]) continue;
+					int nObscuredVertices = 0;
+					for (int k = 0; k < aFaceLoopCounts[nFace]; k++) {
+						int v = aLoopVertices[aFaceLoopStarts[nFace] + k];
+						size_t nObscuredNormals = 0;
+						for (size_t i = 0; i < aVertexFaces[v].size(); i++) {
+							const float* pNormal = &aNormals[aVertexFaces[v][i] * 3];
+							float aOrigin[3];
+							for (int c = 0; c < 3; c++) aOrigin[c] = aPositions[v * 3 + c] + pNormal[c] * fOffset;
+							int nHitFace = -1;
+							float fNearest = FLT_MAX;
+							for (size_t t = 0; t < nTriangles; t++) {
+								float fDistance;
+								if (intersectTriangle(aOrigin, pNormal, &aPositions[aTriangles[t * 3] * 3], &aPositions[aTriangles[t * 3 + 1] * 3],
+									&aPositions[aTriangles[t * 3 + 2] * 3], fDistance) && fDistance < fNearest) {
+									fNearest = fDistance;
+									nHitFace = aTriangleFaces[t];
+								}
+							}
+							if (nHitFace >= 0 && nHitFace != (int)nFace && fNearest <= aThresholds[nThreshold]) nObscuredNormals++;
+						}
+						if (nObscuredNormals == aVertexFaces[v].size()) nObscuredVertices++;
+					}
+					if (nObscuredVertices == aFaceLoopCounts[nFace]) aRemoved[nFace] = 1;
+				}
+			}
+			double dReferenceMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			for (size_t f = 0; f < nFaces && bPassed; f++) {
+				if (aRemoved[f] != aObscured[f]) nMismatches++;
+			}
+			snprintf(sSpeedup, sizeof(sSpeedup), "%.0fx", dReferenceMs / dBestMs);
+		}
+		// the inner sphere is removed except behind the window, the shell is kept
+		size_t nInnerFaces = nLongitudes * nLatitudes, nInnerRemoved = 0, nShellRemoved = 0;
+		for (size_t f = 0; f < nFaces; f++) {
+			if (aObscured[f]) (f < nInnerFaces ? nInnerRemoved : nShellRemoved)++;
+		}
+		bPassed = bPassed && nMismatches == 0 && nShellRemoved == 0 && nInnerRemoved > nInnerFaces * 3 / 4 && nInnerRemoved < nInnerFaces;
+		printf("%-22s %8zu %-7s %3d threads %10.2f %10.1f %7s  %s (%zu of %zu faces, %zu rays, %zu BVH nodes%s)\n", "FindObscuredFaces",
+			nFaces, "", DzNativeParallel::GetNumThreads(), dBestMs, nFaces / 1000.0 / dBestMs, sSpeedup, bPassed ? "ok" : "FAILED",
+			stats.nObscuredFaces, nFaces, stats.nRays, stats.nBvhNodes, bReference ? ", same faces as the reference" : "");
+		fflush(stdout);
+		return bPassed;
+	}
+	// quads of a latitude-longitude sphere between two latitudes, as Blender loops and loop triangles
+	void addSphereBand(double fRadius, size_t nLongitudes, size_t nLatitudes, double fFromLatitude, double fToLatitude,
+		std::vector<float>& aPositions, std::vector<int>& aFaceLoopStarts, std::vector<int>& aFaceLoopCounts,
+		std::vector<int>& aLoopVertices, std::vector<int>& aTriangles, std::vector<int>& aTriangleFaces)
+	{
+		for (size_t y = 0; y <= nLatitudes; y++) {
+			double fLatitude = fFromLatitude + (fToLatitude - fFromLatitude) * y / nLatitudes;
+			for (size_t x = 0; x < nLongitudes; x++) {
+				double fLongitude = x * 6.283185307179586 / nLongitudes;
+				aPositions.push_back((float)(fRadius * cos(fLatitude) * cos(fLongitude)));
+				aPositions.push_back((float)(fRadius * cos(fLatitude) * sin(fLongitude)));
+				aPositions.push_back((float)(fRadius * sin(fLatitude)));
+			}
+		}
+		for (size_t y = 0; y < nLatitudes; y++) {
+			for (size_t x = 0; x < nLongitudes; x++) {
+				int aQuad[4] = { (int)(y * nLongitudes + x), (int)(y * nLongitudes + (x + 1) % nLongitudes),
+					(int)((y + 1) * nLongitudes + (x + 1) % nLongitudes), (int)((y + 1) * nLongitudes + x) };
+				int nFace = (int)aFaceLoopStarts.size();
+				aFaceLoopStarts.push_back((int)aLoopVertices.size());
+				aFaceLoopCounts.push_back(4);
+				aLoopVertices.insert(aLoopVertices.end(), aQuad, aQuad + 4);
+				int aQuadTriangles[6] = { aQuad[0], aQuad[1], aQuad[2], aQuad[0], aQuad[2], aQuad[3] };
+				aTriangles.insert(aTriangles.end(), aQuadTriangles, aQuadTriangles + 6);
+				aTriangleFaces.push_back(nFace);
+				aTriangleFaces.push_back(nFace);
+			}
+		}
+	}
+
+	bool benchmarkClothFit(size_t nLongitudes, int nIterations)
+	{
+		// the body is a sphere with two vertex groups (east and west), the clothing a band 5% inside it with the same
+		// groups, except for a strip of a group the body does not have
+		std::vector<float> aBodyPositions, aClothPositions;
+		std::vector<int> aBodyFaceLoopStarts, aBodyFaceLoopCounts, aBodyLoopVertices, aBodyTriangles, aBodyTriangleFaces;
+		std::vector<int> aClothFaceLoopStarts, aClothFaceLoopCounts, aClothLoopVertices, aClothTriangles, aClothTriangleFaces;
+		addSphereBand(1.0, nLongitudes, nLongitudes / 2, -1.3, 1.3, aBodyPositions, aBodyFaceLoopStarts, aBodyFaceLoopCounts,
+			aBodyLoopVertices, aBodyTriangles, aBodyTriangleFaces);
+		addSphereBand(0.95, nLongitudes, nLongitudes / 4, -0.6, 0.6, aClothPositions, aClothFaceLoopStarts, aClothFaceLoopCounts,
+			aClothLoopVertices, aClothTriangles, aClothTriangleFaces);
+		auto groupOf = [&](size_t v) { return (int)((v % nLongitudes) * 2 / nLongitudes); };
+		auto isStrip = [&](size_t v) { return v % nLongitudes < nLongitudes / 16; };
+		std::vector<int> aBodyWeightVertices, aBodyWeightGroups, aClothWeightVertices, aClothWeightGroups;
+		for (size_t v = 0; v < aBodyPositions.size() / 3; v++) {
+			aBodyWeightVertices.push_back((int)v);
+			aBodyWeightGroups.push_back(groupOf(v));
+		}
+		for (size_t v = 0; v < aClothPositions.size() / 3; v++) {
+			aClothWeightVertices.push_back((int)v);
+			aClothWeightGroups.push_back(isStrip(v) ? 2 : groupOf(v));
+		}
+		std::vector<float> aBodyWeights(aBodyWeightVertices.size(), 1.0f), aClothWeights(aClothWeightVertices.size(), 1.0f);
+
+		DzFitMesh body;
+		body.pPositions = aBodyPositions.data();
+		body.nVertices = aBodyPositions.size() / 3;
+		body.pFaceLoopStarts = aBodyFaceLoopStarts.data();
+		body.pFaceLoopCounts = aBodyFaceLoopCounts.data();
+		body.nFaces = aBodyFaceLoopStarts.size();
+		body.pLoopVertices = aBodyLoopVertices.data();
+		body.nLoops = aBodyLoopVertices.size();
+		body.pTriangles = aBodyTriangles.data();
+		body.pTriangleFaces = aBodyTriangleFaces.data();
+		body.nTriangles = aBodyTriangleFaces.size();
+		body.pWeightVertices = aBodyWeightVertices.data();
+		body.pWeightGroups = aBodyWeightGroups.data();
+		body.pWeights = aBodyWeights.data();
+		body.nWeights = aBodyWeights.size();
+		DzFitMesh cloth;
+		cloth.pPositions = aClothPositions.data();
+		cloth.nVertices = aClothPositions.size() / 3;
+		cloth.pFaceLoopStarts = aClothFaceLoopStarts.data();
+		cloth.pFaceLoopCounts = aClothFaceLoopCounts.data();
+		cloth.nFaces = aClothFaceLoopStarts.size();
+		cloth.pLoopVertices = aClothLoopVertices.data();
+		cloth.nLoops = aClothLoopVertices.size();
+		cloth.pTriangles = aClothTriangles.data();
+		cloth.pTriangleFaces = aClothTriangleFaces.data();
+		cloth.nTriangles = aClothTriangleFaces.size();
+		cloth.pWeightVertices = aClothWeightVertices.data();
+		cloth.pWeightGroups = aClothWeightGroups.data();
+		cloth.pWeights = aClothWeights.data();
+		cloth.nWeights = aClothWeights.size();
+		DzFitSettings settings;
+		settings.nPass1Iterations = 20;
+		settings.nGroups = 3;
+
+		std::vector<float> aPositions;
+		std::vector<uint8_t> aTagged;
+		DzFitStats stats;
+		double dBestMs = 0.0;
+		bool bPassed = true;
+		for (int i = 0; i < nIterations; i++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			bPassed = DzClothFitter::Fit(cloth, body, settings, aPositions, aTagged, &stats);
+			double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+		}
+
+		// on the sphere within its flattening by the quads, the strip untouched
+		double fMaxChord = 1.0 - cos(3.141592653589793 / nLongitudes);
+		size_t nFitted = 0, nMisplaced = 0;
+		for (size_t v = 0; v < cloth.nVertices && bPassed; v++) {
+			const float* p = &aPositions[v * 3];
+			double fRadius = sqrt((double)p[0] * p[0] + (double)p[1] * p[1] + (double)p[2] * p[2]);
+			if (isStrip(v) ? fabs(fRadius - 0.95) > 1e-6 : fabs(fRadius - 1.0) > fMaxChord * 2.0 + 1e-5) nMisplaced++;
+			else if (!isStrip(v)) nFitted++;
+		}
+		bPassed = bPassed && nMisplaced == 0 && !stats.bAborted && stats.nFlipReverts == 0;
+		size_t nTotal = cloth.nVertices * settings.nPass1Iterations + body.nVertices * stats.nPass2Iterations;
+		printf("%-22s %8zu %-7s %3d threads %10.2f %10.1f %7s  %s (%zu of %zu vertices fitted, %d + %d iterations, %zu tagged)\n",
+			"ClothFit", cloth.nVertices, "", DzNativeParallel::GetNumThreads(), dBestMs, nTotal / 1000.0 / dBestMs, "",
+			bPassed ? "ok" : "FAILED", nFitted, cloth.nVertices, stats.nPass1Iterations, stats.nPass2Iterations, stats.nTaggedVertices);
+		fflush(stdout);
+		return bPassed;
+	}
+	bool benchmarkWeightTransfer(size_t nLongitudes, int nIterations)
+	{
+		std::vector<float> aPositions;
+		std::vector<int> aFaceLoopStarts, aFaceLoopCounts, aLoopVertices, aTriangles, aTriangleFaces;
+		addSphereBand(1.0, nLongitudes, nLongitudes / 2, -1.3, 1.3, aPositions, aFaceLoopStarts, aFaceLoopCounts, aLoopVertices,
+			aTriangles, aTriangleFaces);
+		size_t nVertices = aPositions.size() / 3, nTriangles = aTriangles.size() / 3;
+		// every vertex blends two of 8 groups around the sphere
+		std::vector<int> aWeightVertices, aWeightGroups;
+		std::vector<float> aWeights;
+		for (size_t v = 0; v < nVertices; v++) {
+			double fGroup = (v % nLongitudes) * 8.0 / nLongitudes;
+			int nGroup = (int)fGroup;
+			float fBlend = (float)(fGroup - nGroup);
+			aWeightVertices.push_back((int)v);
+			aWeightGroups.push_back(nGroup);
+			aWeights.push_back(1.0f - fBlend);
+			if (fBlend > 0.0f) {
+				aWeightVertices.push_back((int)v);
+				aWeightGroups.push_back((nGroup + 1) % 8);
+				aWeights.push_back(fBlend);
+			}
+		}
+		// 1% above every vertex and every triangle center
+		std::vector<float> aTargets;
+		for (size_t v = 0; v < nVertices; v++) {
+			for (int c = 0; c < 3; c++) aTargets.push_back(aPositions[v * 3 + c] * 1.01f);
+		}
+		for (size_t t = 0; t < nTriangles; t++) {
+			const float* p0 = &aPositions[aTriangles[t * 3] * 3];
+			const float* p1 = &aPositions[aTriangles[t * 3 + 1] * 3];
+			const float* p2 = &aPositions[aTriangles[t * 3 + 2] * 3];
+			float e1[3], e2[3], n[3];
+			for (int c = 0; c < 3; c++) {
+				e1[c] = p1[c] - p0[c];
+				e2[c] = p2[c] - p0[c];
+			}
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+			float fLength = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int c = 0; c < 3; c++) aTargets.push_back((p0[c] + p1[c] + p2[c]) / 3.0f + n[c] / fLength * 0.01f);
+		}
+		size_t nTargets = aTargets.size() / 3;
+
+		DzWeightTransferSource source;
+		source.pPositions = aPositions.data();
+		source.nVertices = nVertices;
+		source.pTriangles = aTriangles.data();
+		source.nTriangles = nTriangles;
+		source.pWeightVertices = aWeightVertices.data();
+		source.pWeightGroups = aWeightGroups.data();
+		source.pWeights = aWeights.data();
+		source.nWeights = aWeights.size();
+		DzWeightTransferSettings settings;
+		settings.nMaxInfluences = 4;
+		std::vector<int> aGroups;
+		std::vector<float> aResultWeights;
+		DzWeightTransferStats stats;
+		double dBestMs = 0.0;
+		bool bPassed = true;
+		for (int i = 0; i < nIterations; i++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			bPassed = DzWeightTransfer::Transfer(source, aTargets.data(), nTargets, settings, aGroups, aResultWeights, nullptr, &stats);
+			double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+		}
+
+		// expected weights per group of every target
+		std::vector<std::vector<float> > aVertexWeights(nVertices, std::vector<float>(8, 0.0f));
+		for (size_t i = 0; i < aWeights.size(); i++) {
+			aVertexWeights[aWeightVertices[i]][aWeightGroups[i]] += aWeights[i];
+		}
+		double fMaxError = 0.0;
+		for (size_t p = 0; p < nTargets && bPassed; p++) {
+			float aExpected[8], aActual[8] = { 0.0f };
+			for (int g = 0; g < 8; g++) {
+				if (p < nVertices) {
+					aExpected[g] = aVertexWeights[p][g];
+				}
+				else {
+					const int* pTriangle = &aTriangles[(p - nVertices) * 3];
+					aExpected[g] = (aVertexWeights[pTriangle[0]][g] + aVertexWeights[pTriangle[1]][g] + aVertexWeights[pTriangle[2]][g]) / 3.0f;
+				}
+			}
+			for (int i = 0; i < settings.nMaxInfluences; i++) {
+				if (aGroups[p * settings.nMaxInfluences + i] >= 0) aActual[aGroups[p * settings.nMaxInfluences + i]] += aResultWeights[p * settings.nMaxInfluences + i];
+			}
+			for (int g = 0; g < 8; g++) fMaxError = std::max(fMaxError, (double)fabs(aExpected[g] - aActual[g]));
+		}
+		bPassed = bPassed && stats.nUnmatchedPoints == 0 && fMaxError < 1e-4;
+		printf("%-22s %8zu %-7s %3d threads %10.2f %10.1f %7s  %s (%zu influences, largest weight error %.1e, %zu BVH nodes)\n",
+			"TransferWeights", nTargets, "", DzNativeParallel::GetNumThreads(), dBestMs, nTargets / 1000.0 / dBestMs, "",
+			bPassed ? "ok" : "FAILED", stats.nInfluences, fMaxError, stats.nBvhNodes);
+		fflush(stdout);
+		return bPassed;
+	}
+	bool benchmarkMorphDeltas(size_t nVertices, size_t nMorphs, size_t nMovedPerMorph, int nBits, int nIterations)
+	{
+		std::vector<double> aBase(nVertices * 4);
+		for (size_t i = 0; i < aBase.size(); i++) {
+			aBase[i] = (i % 4 == 3) ? 1.0 : (hashIndex(1, i) >> 8) * (100.0 / 16777216.0);
+		}
+		// every morph moves nMovedPerMorph distinct vertices by up to 0.5, listed backwards; every 50th morph is dense
+		std::vector<std::vector<double> > aPoints(nMorphs);
+		std::vector<std::vector<int> > aIndices(nMorphs);
+		std::vector<std::vector<double> > aExpected(nMorphs);
+		std::vector<std::vector<uint32_t> > aExpectedIndices(nMorphs);
+		DzMorphMesh mesh;
+		mesh.sName = "Genesis8Female.Shape";
+		mesh.pBasePoints = aBase.data();
+		mesh.nVertices = nVertices;
+		for (size_t t = 0; t < nMorphs; t++) {
+			bool bDense = t % 50 == 0;
+			size_t nStart = hashIndex(2, t) % nVertices;
+			if (bDense) aPoints[t] = aBase;
+			for (size_t k = nMovedPerMorph; k-- > 0; ) {
+				size_t v = (nStart + k * 7919) % nVertices;
+				double aDelta[3];
+				for (int c = 0; c < 3; c++) aDelta[c] = ((hashIndex(3 + (uint32_t)t, k * 3 + c) >> 8) / 16777216.0 - 0.5);
+				if (bDense) {
+					for (int c = 0; c < 3; c++) aPoints[t][v * 4 + c] += aDelta[c];
+				}
+				else {
+					aIndices[t].push_back((int)v);
+					for (int c = 0; c < 3; c++) aPoints[t].push_back(aBase[v * 4 + c] + aDelta[c]);
+					aPoints[t].push_back(1.0);
+				}
+				aExpectedIndices[t].push_back((uint32_t)v);
+				for (int c = 0; c < 3; c++) aExpected[t].push_back(aDelta[c]);
+			}
+			DzMorphTarget target;
+			target.sName = "pJCM" + std::to_string(t);
+			target.fDefaultValue = t == 1 ? 1.0f : 0.0f;
+			target.pPoints = aPoints[t].data();
+			target.pIndices = bDense ? nullptr : aIndices[t].data();
+			target.nPoints = bDense ? nVertices : nMovedPerMorph;
+			mesh.aTargets.push_back(target);
+		}
+		std::vector<DzMorphMesh> aMeshes(1, mesh);
+
+		DzMorphDeltaFile::Settings settings;
+		settings.nQuantizationBits = nBits;
+		DzMorphDeltaFile::Result result;
+		double dBestMs = 0.0;
+		bool bPassed = true;
+		for (int i = 0; i < nIterations && bPassed; i++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			bPassed = DzMorphDeltaFile::Write(kMorphPath, aMeshes, settings, result);
+			double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+		}
+
+		// deltas span at most 1 per axis
+		double fTolerance = nBits > 0 ? 0.5 / ((1u << nBits) - 1) + 1e-6 : 1e-7;
+		double fMaxError = 0.0;
+		std::vector<DzMorphDeltaMesh> aRead;
+		bPassed = bPassed && DzMorphDeltaFile::Read(kMorphPath, aRead) && aRead.size() == 1 && aRead[0].nVertices == nVertices &&
+			aRead[0].aMorphs.size() == nMorphs;
+		for (size_t t = 0; t < nMorphs && bPassed; t++) {
+			const DzMorphDeltaSet& morph = aRead[0].aMorphs[t];
+			bPassed = morph.sName == mesh.aTargets[t].sName && morph.fDefaultValue == mesh.aTargets[t].fDefaultValue &&
+				morph.aIndices.size() == nMovedPerMorph;
+			// the file lists the vertices in ascending order
+			std::vector<size_t> aOrder(nMovedPerMorph);
+			for (size_t k = 0; k < nMovedPerMorph; k++) aOrder[k] = k;
+			std::sort(aOrder.begin(), aOrder.end(), [&](size_t a, size_t b) { return aExpectedIndices[t][a] < aExpectedIndices[t][b]; });
+			for (size_t k = 0; k < nMovedPerMorph && bPassed; k++) {
+				bPassed = morph.aIndices[k] == aExpectedIndices[t][aOrder[k]];
+				for (int c = 0; c < 3; c++) {
+					fMaxError = std::max(fMaxError, fabs(morph.aDeltas[k * 3 + c] - aExpected[t][aOrder[k] * 3 + c]));
+				}
+			}
+		}
+		remove(kMorphPath);
+		bPassed = bPassed && result.nDeltas == nMorphs * nMovedPerMorph && fMaxError <= fTolerance && fMaxError <= result.fMaxError + 1e-9;
+		char sName[32];
+		snprintf(sName, sizeof(sName), "MorphDeltas %s", nBits > 0 ? (nBits == 8 ? "q8" : "q16") : "f32");
+		printf("%-22s %8zu %-7s %3d threads %10.2f %10.1f %7s  %s (%zu morphs, %zu KB file, %zu KB source, largest error %.1e)\n",
+			sName, result.nDeltas, "", DzNativeParallel::GetNumThreads(), dBestMs, result.nDeltas / 1000.0 / dBestMs, "",
+			bPassed ? "ok" : "FAILED", result.nMorphs, result.nFileBytes / 1024, result.nSourceBytes / 1024, fMaxError);
+		fflush(stdout);
+		return bPassed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int nIterations = 5;
+	bool bCodecs = true;
+	bool bMesh = true;
+	std::vector<int> aSizes;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			nIterations = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-codecs") == 0) {
+			bCodecs = false;
+		}
+		else if (strcmp(argv[i], "--no-mesh") == 0) {
+			bMesh = false;
+		}
+		else {
+			aSizes.push_back(atoi(argv[i]));
+		}
+	}
+	if (aSizes.empty()) {
+		aSizes.push_back(4096);
+		aSizes.push_back(8192);
+	}
+	if (nIterations < 1) nIterations = 1;
+
+	DzCpuFeatures::SimdLevel eSupported = DzCpuFeatures::GetSupportedSimdLevel();
+	printf("Supported SIMD level: %s\n", DzCpuFeatures::GetSimdLevelName(eSupported));
+	printf("%-22s %6s %-7s %10s %10s %8s  %s\n", "kernel", "size", "level", "best ms", "MPix/s", "speedup", "check");
+
+	bool bAllPassed = true;
+	for (size_t s = 0; s < aSizes.size(); s++) {
+		size_t nPixels = (size_t)aSizes[s] * aSizes[s];
+		Buffers buffers;
+		for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); k++) {
+			const Kernel& kernel = kKernels[k];
+			if (kernel.bFloat) {
+				buffers.aF32.resize(nPixels * kernel.nChannels);
+				if (kernel.bSecondInput) buffers.aF32Second.resize(nPixels * kernel.nChannels);
+			}
+			else {
+				buffers.aU8.resize(nPixels);
+				if (kernel.bSecondInput) buffers.aU8Second.resize(nPixels);
+			}
+
+			double dScalarMs = 0.0;
+			for (int nLevel = DzCpuFeatures::Scalar; nLevel <= eSupported; nLevel++) {
+				const DzImageKernelTable& kernels = DzImageKernels::GetKernels(nLevel);
+				double dBestMs = 0.0;
+				for (int i = 0; i < nIterations; i++) {
+					fillInputs(kernel, buffers, nPixels);
+					auto start = std::chrono::high_resolution_clock::now();
+					kernel.fnRun(kernels, buffers.aU8.data(), buffers.aU8Second.data(), buffers.aF32.data(), buffers.aF32Second.data(), nPixels);
+					double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+					if (i == 0 || dMs < dBestMs) dBestMs = dMs;
+				}
+				if (nLevel == DzCpuFeatures::Scalar) dScalarMs = dBestMs;
+
+				char sCheck[64];
+				if (nLevel == DzCpuFeatures::Scalar) {
+					snprintf(sCheck, sizeof(sCheck), "reference");
+				}
+				else {
+					double dResult = verify(kernel, buffers, nPixels);
+					bool bPassed = kernel.bFloat ? dResult <= kFloatTolerance : dResult == 0.0;
+					bAllPassed = bAllPassed && bPassed;
+					if (kernel.bFloat) {
+						snprintf(sCheck, sizeof(sCheck), "%s (max err %.2e)", bPassed ? "ok" : "FAILED", dResult);
+					}
+					else {
+						snprintf(sCheck, sizeof(sCheck), "%s (%.0f mismatches)", bPassed ? "ok" : "FAILED", dResult);
+					}
+				}
+				printf("%-22s %6d %-7s %10.2f %10.1f %7.2fx  %s\n", kernel.sName, aSizes[s],
+					DzCpuFeatures::GetSimdLevelName((DzCpuFeatures::SimdLevel)nLevel),
+					dBestMs, nPixels / 1000.0 / dBestMs, dScalarMs / dBestMs, sCheck);
+				fflush(stdout);
+			}
+		}
+	}
+
+	if (bCodecs) {
+		printf("\n%-25s %6s %11s %10s %10s %11s  %s\n", "encoder", "size", "", "best ms", "MPix/s", "file", "check");
+		for (size_t s = 0; s < aSizes.size(); s++) {
+			// encoders are much slower than the kernels, a couple of runs is enough
+			bAllPassed = benchmarkPngCodecs(aSizes[s], nIterations < 2 ? nIterations : 2) && bAllPassed;
+			bAllPassed = benchmarkBlockCompression(aSizes[s], DzBlockFormat::BC4, nIterations < 2 ? nIterations : 2) && bAllPassed;
+			bAllPassed = benchmarkBlockCompression(aSizes[s], DzBlockFormat::BC5, nIterations < 2 ? nIterations : 2) && bAllPassed;
+			bAllPassed = benchmarkBlockCompression(aSizes[s], DzBlockFormat::BC7, nIterations < 2 ? nIterations : 2) && bAllPassed;
+		}
+	}
+
+	if (bMesh) {
+		printf("\n%-22s %8s %-7s %11s %10s %10s %8s  %s\n", "mesh kernel", "points", "level", "", "best ms", "MPts/s", "speedup", "check");
+		bAllPassed = benchmarkSkinning(1000000, nIterations) && bAllPassed;
+		bAllPassed = benchmarkSkinWeights(1000000, nIterations) && bAllPassed;
+		bAllPassed = benchmarkMeshOrder(512, nIterations) && bAllPassed;
+		bAllPassed = benchmarkSimplifier(300, nIterations) && bAllPassed;
+		bAllPassed = benchmarkOcclusion(40, true, nIterations) && bAllPassed;
+		bAllPassed = benchmarkOcclusion(512, false, nIterations) && bAllPassed;
+		bAllPassed = benchmarkClothFit(64, nIterations) && bAllPassed;
+		bAllPassed = benchmarkClothFit(512, nIterations) && bAllPassed;
+		bAllPassed = benchmarkWeightTransfer(512, nIterations) && bAllPassed;
+		bAllPassed = benchmarkMorphDeltas(100000, 500, 300, 0, nIterations) && bAllPassed;
+		bAllPassed = benchmarkMorphDeltas(100000, 500, 300, 16, nIterations) && bAllPassed;
+		bAllPassed = benchmarkMorphDeltas(100000, 500, 300, 8, nIterations) && bAllPassed;
+	}
+
+	return bAllPassed ? 0 : 1;
+}
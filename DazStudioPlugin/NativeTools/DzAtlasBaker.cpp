@@ -0,0 +1,398 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "DzAtlasBaker.h"
+#include "DzNativeParallel.h"
+
+namespace
+{
+	// below this many atlas rows, starting threads costs more than it saves
+	const size_t kMinRowsPerThread = 16;
+
+	// Rec.709 luminance, used by Blender for color to float conversions
+	const float kLuminance[3] = { 0.2126f, 0.7152f, 0.0722f };
+
+	inline float clamp01(float fValue)
+	{
+		return fValue < 0.0f ? 0.0f : (fValue > 1.0f ? 1.0f : fValue);
+	}
+
+	inline float srgbToLinear(float fValue)
+	{
+		return fValue <= 0.04045f ? fValue / 12.92f : powf((fValue + 0.055f) / 1.055f, 2.4f);
+	}
+
+	inline float linearToSrgb(float fValue)
+	{
+		fValue = clamp01(fValue);
+		return fValue <= 0.0031308f ? fValue * 12.92f : 1.055f * powf(fValue, 1.0f / 2.4f) - 0.055f;
+	}
+
+	inline int wrap(int nValue, int nSize)
+	{
+		nValue %= nSize;
+		return nValue < 0 ? nValue + nSize : nValue;
+	}
+
+	void fetch(const DzAtlasSource& source, int x, int y, float* pRgba)
+	{
+		const float* pPixel = source.pPixels + ((size_t)y * source.nWidth + x) * source.nChannels;
+		switch (source.nChannels) {
+		case 1:
+			pRgba[0] = pRgba[1] = pRgba[2] = pPixel[0];
+			pRgba[3] = 1.0f;
+			break;
+		case 2:
+			pRgba[0] = pRgba[1] = pRgba[2] = pPixel[0];
+			pRgba[3] = pPixel[1];
+			break;
+		case 3:
+			pRgba[0] = pPixel[0];
+			pRgba[1] = pPixel[1];
+			pRgba[2] = pPixel[2];
+			pRgba[3] = 1.0f;
+			break;
+		default:
+			memcpy(pRgba, pPixel, 4 * sizeof(float));
+			break;
+		}
+	}
+
+	// bilinear lookup with repeat wrapping, UV (0, 0) is the bottom left corner of the first row
+	void sampleBilinear(const DzAtlasSource& source, float fU, float fV, float* pRgba)
+	{
+		float fX = fU * source.aScale[0] * source.nWidth - 0.5f;
+		float fY = fV * source.aScale[1] * source.nHeight - 0.5f;
+		float fX0 = floorf(fX);
+		float fY0 = floorf(fY);
+		float fFracX = fX - fX0;
+		float fFracY = fY - fY0;
+		int x0 = wrap((int)fX0, source.nWidth);
+		int y0 = wrap((int)fY0, source.nHeight);
+		int x1 = x0 + 1 < source.nWidth ? x0 + 1 : 0;
+		int y1 = y0 + 1 < source.nHeight ? y0 + 1 : 0;
+
+		float a00[4], a10[4], a01[4], a11[4];
+		fetch(source, x0, y0, a00);
+		fetch(source, x1, y0, a10);
+		fetch(source, x0, y1, a01);
+		fetch(source, x1, y1, a11);
+		for (int c = 0; c < 4; c++) {
+			float fBottom = a00[c] + (a10[c] - a00[c]) * fFracX;
+			float fTop = a01[c] + (a11[c] - a01[c]) * fFracX;
+			pRgba[c] = fBottom + (fTop - fBottom) * fFracY;
+		}
+	}
+}
+
+struct DzAtlasBaker::Triangle
+{
+	bool bValid;
+	int nMinX, nMaxX, nMinY, nMaxY;
+	// edge functions w = a*x + b*y + c, all >= 0 inside
+	float aEdgeA[3], aEdgeB[3], aEdgeC[3];
+	// source UV at an atlas pixel position p: aOrigin + aJacobian * (p - aPixel0)
+	float aPixel0[2];
+	float aOrigin[2];
+	float aJacobian[4];
+	// source UV frame to atlas UV frame, for tangent space normals
+	float aRotation[4];
+	int aSamples[ChannelCount];
+};
+
+DzAtlasBaker::DzAtlasBaker(int nWidth, int nHeight, int nMaxSamples) :
+	m_nWidth(std::max(nWidth, 1)),
+	m_nHeight(std::max(nHeight, 1)),
+	m_nMaxSamples(std::max(1, std::min(nMaxSamples, 8)))
+{
+	for (int i = 0; i < ChannelCount; i++) {
+		m_aTargets[i] = nullptr;
+	}
+	m_aCoverage.assign((size_t)m_nWidth * m_nHeight, 0);
+}
+
+void DzAtlasBaker::setTarget(Channel eChannel, float* pPixels)
+{
+	if (eChannel >= 0 && eChannel < ChannelCount) {
+		m_aTargets[eChannel] = pPixels;
+	}
+}
+
+size_t DzAtlasBaker::getCoveredPixels() const
+{
+	return (size_t)std::count_if(m_aCoverage.begin(), m_aCoverage.end(), [](uint8_t nValue) { return nValue != 0; });
+}
+
+void DzAtlasBaker::bakeTriangles(const float* pSourceUVs, const float* pAtlasUVs, size_t nTriangles, const DzAtlasSource* aSources)
+{
+	if (!pSourceUVs || !pAtlasUVs || !aSources || nTriangles == 0) {
+		return;
+	}
+
+	std::vector<Triangle> aTriangles(nTriangles);
+	DzNativeParallel::For(nTriangles, 4096, [&](size_t nBegin, size_t nEnd) {
+		for (size_t i = nBegin; i < nEnd; i++) {
+			const float* pSource = pSourceUVs + i * 6;
+			const float* pAtlas = pAtlasUVs + i * 6;
+			Triangle& tri = aTriangles[i];
+			tri.bValid = false;
+
+			float aPixels[6];
+			for (int v = 0; v < 3; v++) {
+				aPixels[v * 2 + 0] = pAtlas[v * 2 + 0] * m_nWidth;
+				aPixels[v * 2 + 1] = pAtlas[v * 2 + 1] * m_nHeight;
+			}
+			float fPx1 = aPixels[2] - aPixels[0], fPy1 = aPixels[3] - aPixels[1];
+			float fPx2 = aPixels[4] - aPixels[0], fPy2 = aPixels[5] - aPixels[1];
+			float fArea = fPx1 * fPy2 - fPx2 * fPy1;
+			if (fabsf(fArea) < 1e-8f) {
+				continue;
+			}
+
+			// pixel centers inside the bounding box
+			float fMinX = std::min(aPixels[0], std::min(aPixels[2], aPixels[4]));
+			float fMaxX = std::max(aPixels[0], std::max(aPixels[2], aPixels[4]));
+			float fMinY = std::min(aPixels[1], std::min(aPixels[3], aPixels[5]));
+			float fMaxY = std::max(aPixels[1], std::max(aPixels[3], aPixels[5]));
+			tri.nMinX = std::max(0, (int)ceilf(fMinX - 0.5f));
+			tri.nMaxX = std::min(m_nWidth - 1, (int)floorf(fMaxX - 0.5f));
+			tri.nMinY = std::max(0, (int)ceilf(fMinY - 0.5f));
+			tri.nMaxY = std::min(m_nHeight - 1, (int)floorf(fMaxY - 0.5f));
+			if (tri.nMinX > tri.nMaxX || tri.nMinY > tri.nMaxY) {
+				continue;
+			}
+
+			float fSign = fArea > 0.0f ? 1.0f : -1.0f;
+			for (int e = 0; e < 3; e++) {
+				const float* pA = aPixels + ((e + 1) % 3) * 2;
+				const float* pB = aPixels + ((e + 2) % 3) * 2;
+				tri.aEdgeA[e] = -(pB[1] - pA[1]) * fSign;
+				tri.aEdgeB[e] = (pB[0] - pA[0]) * fSign;
+				tri.aEdgeC[e] = ((pB[1] - pA[1]) * pA[0] - (pB[0] - pA[0]) * pA[1]) * fSign;
+			}
+
+			// source UV edges times the inverse of the atlas pixel edges
+			float fSu1 = pSource[2] - pSource[0], fSv1 = pSource[3] - pSource[1];
+			float fSu2 = pSource[4] - pSource[0], fSv2 = pSource[5] - pSource[1];
+			float fInverseArea = 1.0f / fArea;
+			tri.aJacobian[0] = (fSu1 * fPy2 - fSu2 * fPy1) * fInverseArea;
+			tri.aJacobian[1] = (fSu2 * fPx1 - fSu1 * fPx2) * fInverseArea;
+			tri.aJacobian[2] = (fSv1 * fPy2 - fSv2 * fPy1) * fInverseArea;
+			tri.aJacobian[3] = (fSv2 * fPx1 - fSv1 * fPx2) * fInverseArea;
+			tri.aPixel0[0] = aPixels[0];
+			tri.aPixel0[1] = aPixels[1];
+			tri.aOrigin[0] = pSource[0];
+			tri.aOrigin[1] = pSource[1];
+
+			// orthogonal part of the source UV to atlas UV map, a reflection for mirrored islands
+			tri.aRotation[0] = 1.0f; tri.aRotation[1] = 0.0f;
+			tri.aRotation[2] = 0.0f; tri.aRotation[3] = 1.0f;
+			float fSourceArea = fSu1 * fSv2 - fSu2 * fSv1;
+			if (fabsf(fSourceArea) > 1e-12f) {
+				float fAu1 = pAtlas[2] - pAtlas[0], fAv1 = pAtlas[3] - pAtlas[1];
+				float fAu2 = pAtlas[4] - pAtlas[0], fAv2 = pAtlas[5] - pAtlas[1];
+				float fInverseSource = 1.0f / fSourceArea;
+				float a = (fAu1 * fSv2 - fAu2 * fSv1) * fInverseSource;
+				float b = (fAu2 * fSu1 - fAu1 * fSu2) * fInverseSource;
+				float c = (fAv1 * fSv2 - fAv2 * fSv1) * fInverseSource;
+				float d = (fAv2 * fSu1 - fAv1 * fSu2) * fInverseSource;
+				if (a * d - b * c >= 0.0f) {
+					float fAngle = atan2f(c - b, a + d);
+					tri.aRotation[0] = cosf(fAngle); tri.aRotation[1] = -sinf(fAngle);
+					tri.aRotation[2] = sinf(fAngle); tri.aRotation[3] = cosf(fAngle);
+				}
+				else {
+					float fAngle = atan2f(b + c, a - d);
+					tri.aRotation[0] = cosf(fAngle); tri.aRotation[1] = sinf(fAngle);
+					tri.aRotation[2] = sinf(fAngle); tri.aRotation[3] = -cosf(fAngle);
+				}
+			}
+
+			// supersample when one atlas pixel covers more than one source texel
+			for (int c = 0; c < ChannelCount; c++) {
+				const DzAtlasSource& source = aSources[c];
+				tri.aSamples[c] = 1;
+				if (!source.pPixels || m_aTargets[c] == nullptr) {
+					continue;
+				}
+				float fTexelsU = source.nWidth * source.aScale[0];
+				float fTexelsV = source.nHeight * source.aScale[1];
+				float fFootprintX = hypotf(tri.aJacobian[0] * fTexelsU, tri.aJacobian[2] * fTexelsV);
+				float fFootprintY = hypotf(tri.aJacobian[1] * fTexelsU, tri.aJacobian[3] * fTexelsV);
+				int nSamples = (int)ceilf(std::max(fFootprintX, fFootprintY) - 0.01f);
+				tri.aSamples[c] = std::max(1, std::min(nSamples, m_nMaxSamples));
+			}
+			tri.bValid = true;
+		}
+	});
+
+	const Triangle* pTriangles = aTriangles.data();
+	DzNativeParallel::For((size_t)m_nHeight, kMinRowsPerThread, [=](size_t nBegin, size_t nEnd) {
+		bakeRows(pTriangles, nTriangles, aSources, (int)nBegin, (int)nEnd);
+	});
+}
+
+void DzAtlasBaker::bakeRows(const Triangle* aTriangles, size_t nTriangles, const DzAtlasSource* aSources, int nRowBegin, int nRowEnd)
+{
+	for (size_t i = 0; i < nTriangles; i++) {
+		const Triangle& tri = aTriangles[i];
+		if (tri.bValid == false || tri.nMaxY < nRowBegin || tri.nMinY >= nRowEnd) {
+			continue;
+		}
+		int nMinY = std::max(tri.nMinY, nRowBegin);
+		int nMaxY = std::min(tri.nMaxY, nRowEnd - 1);
+		for (int y = nMinY; y <= nMaxY; y++) {
+			float fY = y + 0.5f;
+			for (int x = tri.nMinX; x <= tri.nMaxX; x++) {
+				float fX = x + 0.5f;
+				if (tri.aEdgeA[0] * fX + tri.aEdgeB[0] * fY + tri.aEdgeC[0] < 0.0f ||
+					tri.aEdgeA[1] * fX + tri.aEdgeB[1] * fY + tri.aEdgeC[1] < 0.0f ||
+					tri.aEdgeA[2] * fX + tri.aEdgeB[2] * fY + tri.aEdgeC[2] < 0.0f) {
+					continue;
+				}
+				size_t nPixel = (size_t)y * m_nWidth + x;
+				m_aCoverage[nPixel] = 1;
+
+				float fDx = fX - tri.aPixel0[0];
+				float fDy = fY - tri.aPixel0[1];
+				float fU = tri.aOrigin[0] + tri.aJacobian[0] * fDx + tri.aJacobian[1] * fDy;
+				float fV = tri.aOrigin[1] + tri.aJacobian[2] * fDx + tri.aJacobian[3] * fDy;
+
+				for (int c = 0; c < ChannelCount; c++) {
+					float* pTarget = m_aTargets[c];
+					if (pTarget == nullptr) {
+						continue;
+					}
+					const DzAtlasSource& source = aSources[c];
+					float aValue[4];
+					// sRGB sources stay encoded when the atlas is sRGB as well
+					bool bEncoded = false;
+					if (source.pPixels) {
+						int nSamples = tri.aSamples[c];
+						if (nSamples == 1) {
+							sampleBilinear(source, fU, fV, aValue);
+						}
+						else {
+							float aSum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+							float fStep = 1.0f / nSamples;
+							for (int sy = 0; sy < nSamples; sy++) {
+								float fOffsetY = (sy + 0.5f) * fStep - 0.5f;
+								for (int sx = 0; sx < nSamples; sx++) {
+									float fOffsetX = (sx + 0.5f) * fStep - 0.5f;
+									float aSample[4];
+									sampleBilinear(source,
+										fU + tri.aJacobian[0] * fOffsetX + tri.aJacobian[1] * fOffsetY,
+										fV + tri.aJacobian[2] * fOffsetX + tri.aJacobian[3] * fOffsetY,
+										aSample);
+									for (int k = 0; k < 4; k++) aSum[k] += aSample[k];
+								}
+							}
+							float fWeight = fStep * fStep;
+							for (int k = 0; k < 4; k++) aValue[k] = aSum[k] * fWeight;
+						}
+						if (source.bAlphaOutput) {
+							aValue[0] = aValue[1] = aValue[2] = aValue[3];
+						}
+						else if (source.bSrgb) {
+							bEncoded = c != Normal && c != Roughness;
+							if (bEncoded == false) {
+								for (int k = 0; k < 3; k++) aValue[k] = srgbToLinear(aValue[k]);
+							}
+						}
+					}
+					else {
+						memcpy(aValue, source.aValue, sizeof(aValue));
+					}
+
+					float* pOut = pTarget + nPixel * 4;
+					if (c == Normal) {
+						float fNx = (aValue[0] * 2.0f - 1.0f) * source.fStrength;
+						float fNy = (aValue[1] * 2.0f - 1.0f) * source.fStrength;
+						float fNz = 1.0f + (aValue[2] * 2.0f - 2.0f) * source.fStrength;
+						float fLength = sqrtf(fNx * fNx + fNy * fNy + fNz * fNz);
+						float fInverse = fLength > 0.0f ? 1.0f / fLength : 0.0f;
+						fNx *= fInverse; fNy *= fInverse; fNz *= fInverse;
+						if (fLength == 0.0f) fNz = 1.0f;
+						float fRx = tri.aRotation[0] * fNx + tri.aRotation[1] * fNy;
+						float fRy = tri.aRotation[2] * fNx + tri.aRotation[3] * fNy;
+						pOut[0] = clamp01(fRx * 0.5f + 0.5f);
+						pOut[1] = clamp01(fRy * 0.5f + 0.5f);
+						pOut[2] = clamp01(fNz * 0.5f + 0.5f);
+					}
+					else if (c == Roughness) {
+						float fGray = linearToSrgb(aValue[0] * kLuminance[0] + aValue[1] * kLuminance[1] + aValue[2] * kLuminance[2]);
+						pOut[0] = pOut[1] = pOut[2] = fGray;
+					}
+					else if (bEncoded) {
+						for (int k = 0; k < 3; k++) pOut[k] = clamp01(aValue[k]);
+					}
+					else {
+						for (int k = 0; k < 3; k++) pOut[k] = linearToSrgb(aValue[k]);
+					}
+					pOut[3] = 1.0f;
+				}
+			}
+		}
+	}
+}
+
+void DzAtlasBaker::dilate(int nMargin)
+{
+	std::vector<uint8_t> aNextCoverage(m_aCoverage.size());
+	for (int nPass = 0; nPass < nMargin; nPass++) {
+		aNextCoverage = m_aCoverage;
+		const uint8_t* pCoverage = m_aCoverage.data();
+		uint8_t* pNextCoverage = aNextCoverage.data();
+		DzNativeParallel::For((size_t)m_nHeight, kMinRowsPerThread, [=](size_t nBegin, size_t nEnd) {
+			dilateRows(pCoverage, pNextCoverage, (int)nBegin, (int)nEnd);
+		});
+		m_aCoverage.swap(aNextCoverage);
+	}
+}
+
+// Every uncovered pixel next to a covered one becomes the average of its covered neighbours.  Only
+// uncovered pixels are written and only covered ones are read, so rows can be processed concurrently.
+void DzAtlasBaker::dilateRows(const uint8_t* pCoverage, uint8_t* pNextCoverage, int nRowBegin, int nRowEnd)
+{
+	for (int y = nRowBegin; y < nRowEnd; y++) {
+		for (int x = 0; x < m_nWidth; x++) {
+			size_t nPixel = (size_t)y * m_nWidth + x;
+			if (pCoverage[nPixel]) {
+				continue;
+			}
+			size_t aNeighbours[8];
+			int nNeighbours = 0;
+			for (int dy = -1; dy <= 1; dy++) {
+				int ny = y + dy;
+				if (ny < 0 || ny >= m_nHeight) continue;
+				for (int dx = -1; dx <= 1; dx++) {
+					int nx = x + dx;
+					if ((dx == 0 && dy == 0) || nx < 0 || nx >= m_nWidth) continue;
+					size_t nNeighbour = (size_t)ny * m_nWidth + nx;
+					if (pCoverage[nNeighbour]) {
+						aNeighbours[nNeighbours++] = nNeighbour;
+					}
+				}
+			}
+			if (nNeighbours == 0) {
+				continue;
+			}
+			pNextCoverage[nPixel] = 2;
+			float fWeight = 1.0f / nNeighbours;
+			for (int c = 0; c < ChannelCount; c++) {
+				float* pTarget = m_aTargets[c];
+				if (pTarget == nullptr) {
+					continue;
+				}
+				float aSum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (int n = 0; n < nNeighbours; n++) {
+					const float* pSource = pTarget + aNeighbours[n] * 4;
+					for (int k = 0; k < 4; k++) aSum[k] += pSource[k];
+				}
+				float* pOut = pTarget + nPixel * 4;
+				for (int k = 0; k < 4; k++) pOut[k] = aSum[k] * fWeight;
+			}
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Where one atlas channel of one material comes from: a texture, or a constant when pPixels is null
+struct DzAtlasSource
+{
+	const float* pPixels = nullptr; // interleaved float pixels, bottom row first, as in Blender's Image.pixels
+	int nWidth = 0;
+	int nHeight = 0;
+	int nChannels = 4;
+	bool bSrgb = false;             // pixels are sRGB encoded, otherwise linear
+	bool bAlphaOutput = false;      // use the texture alpha instead of its color
+	float aScale[2] = { 1.0f, 1.0f }; // UV tiling
+	float aValue[4] = { 0.0f, 0.0f, 0.0f, 1.0f }; // linear constant
+	float fStrength = 1.0f;         // normal map strength, normal channel only
+};
+
+/*****************************
+DzAtlasBaker
+
+CPU replacement for baking image-textured materials into a texture atlas.
+Every triangle is rasterized in atlas UV space and each covered pixel is
+resampled from the source textures through the triangle's source UVs, with
+bilinear filtering and up to nMaxSamples x nMaxSamples supersampling when the
+source is minified.  All channels are written in the same pass, rows are
+split across worker threads, and dilate() extends the baked islands into the
+empty atlas space afterwards.
+
+Atlas buffers use the Blender Image.pixels layout (RGBA float, bottom row
+first) and the same encoding as the Cycles bake: sRGB for the color, alpha,
+metallic and roughness atlases, raw tangent space vectors for the normal
+atlas, which are rotated from the source UV frame into the atlas UV frame.
+*****************************/
+class DzAtlasBaker
+{
+public:
+	enum Channel {
+		Diffuse,
+		Alpha,
+		Normal,
+		Metallic,
+		Roughness,
+		ChannelCount
+	};
+
+	DzAtlasBaker(int nWidth, int nHeight, int nMaxSamples);
+
+	// pPixels is owned by the caller, nullptr skips the channel
+	void setTarget(Channel eChannel, float* pPixels);
+
+	// UVs are 3 x (u, v) per triangle, aSources holds ChannelCount entries
+	void bakeTriangles(const float* pSourceUVs, const float* pAtlasUVs, size_t nTriangles, const DzAtlasSource* aSources);
+
+	// Extends the baked pixels by nMargin pixels into the uncovered area
+	void dilate(int nMargin);
+
+	size_t getCoveredPixels() const;
+
+protected:
+	struct Triangle;
+
+	void bakeRows(const Triangle* aTriangles, size_t nTriangles, const DzAtlasSource* aSources, int nRowBegin, int nRowEnd);
+	void dilateRows(const uint8_t* pCoverage, uint8_t* pNextCoverage, int nRowBegin, int nRowEnd);
+
+	int m_nWidth;
+	int m_nHeight;
+	int m_nMaxSamples;
+	float* m_aTargets[ChannelCount];
+	std::vector<uint8_t> m_aCoverage;
+};
@@ -0,0 +1,530 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "DzBlockCompression.h"
+#include "DzImageResampler.h"
+#include "DzNativeParallel.h"
+#include "DzPngStream.h"
+
+namespace
+{
+	// BC7 4 bit index interpolation weights, out of 64
+	const int kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// DXGI_FORMAT values used in the DX10 header
+	const uint32_t kDxgiBC4Unorm = 80;
+	const uint32_t kDxgiBC5Unorm = 83;
+	const uint32_t kDxgiBC7Unorm = 98;
+	const uint32_t kDxgiBC7UnormSrgb = 99;
+
+	inline int channel(uint32_t nPixel, int nChannel)
+	{
+		// R, G, B, A
+		static const int aShifts[4] = { 16, 8, 0, 24 };
+		return (int)((nPixel >> aShifts[nChannel]) & 0xff);
+	}
+
+	inline uint8_t luminance709(uint32_t nPixel)
+	{
+		// same weights as DzImageKernels::PackLuminanceChannels
+		return (uint8_t)((54 * ((nPixel >> 16) & 0xff) + 183 * ((nPixel >> 8) & 0xff) + 19 * (nPixel & 0xff) + 128) >> 8);
+	}
+
+	inline void putBits(uint8_t* pBlock, int& nBit, uint32_t nValue, int nBits)
+	{
+		for (int i = 0; i < nBits; i++, nBit++) {
+			if ((nValue >> i) & 1) {
+				pBlock[nBit >> 3] |= (uint8_t)(1 << (nBit & 7));
+			}
+		}
+	}
+
+	inline uint32_t getBits(const uint8_t* pBlock, int& nBit, int nBits)
+	{
+		uint32_t nValue = 0;
+		for (int i = 0; i < nBits; i++, nBit++) {
+			nValue |= (uint32_t)((pBlock[nBit >> 3] >> (nBit & 7)) & 1) << i;
+		}
+		return nValue;
+	}
+
+	///////////////////////////////
+	// BC4
+	///////////////////////////////
+
+	void bc4Palette(int nEndpoint0, int nEndpoint1, int aPalette[8])
+	{
+		aPalette[0] = nEndpoint0;
+		aPalette[1] = nEndpoint1;
+		if (nEndpoint0 > nEndpoint1) {
+			for (int k = 2; k < 8; k++) {
+				aPalette[k] = ((8 - k) * nEndpoint0 + (k - 1) * nEndpoint1 + 3) / 7;
+			}
+		}
+		else {
+			for (int k = 2; k < 6; k++) {
+				aPalette[k] = ((6 - k) * nEndpoint0 + (k - 1) * nEndpoint1 + 2) / 5;
+			}
+			aPalette[6] = 0;
+			aPalette[7] = 255;
+		}
+	}
+
+	void encodeBC4(const uint8_t aValues[16], uint8_t* pBlock)
+	{
+		int nMin = 255;
+		int nMax = 0;
+		for (int i = 0; i < 16; i++) {
+			nMin = std::min(nMin, (int)aValues[i]);
+			nMax = std::max(nMax, (int)aValues[i]);
+		}
+		memset(pBlock, 0, 8);
+		pBlock[0] = (uint8_t)nMax;
+		pBlock[1] = (uint8_t)nMin;
+		if (nMax == nMin) {
+			return;
+		}
+		int aPalette[8];
+		bc4Palette(nMax, nMin, aPalette);
+		int nBit = 16;
+		for (int i = 0; i < 16; i++) {
+			int nBest = 0;
+			int nBestError = 256;
+			for (int k = 0; k < 8; k++) {
+				int nError = abs(aPalette[k] - (int)aValues[i]);
+				if (nError < nBestError) {
+					nBestError = nError;
+					nBest = k;
+				}
+			}
+			putBits(pBlock, nBit, (uint32_t)nBest, 3);
+		}
+	}
+
+	///////////////////////////////
+	// BC7 mode 6
+	///////////////////////////////
+
+	struct Mode6Block
+	{
+		int aQuant[2][4]; // 7 bit endpoints
+		int aP[2];
+		uint8_t aIndices[16];
+		int64_t nError = -1;
+	};
+
+	inline void endpointColors(const Mode6Block& block, int aEndpoints[2][4])
+	{
+		for (int e = 0; e < 2; e++) {
+			for (int c = 0; c < 4; c++) {
+				aEndpoints[e][c] = (block.aQuant[e][c] << 1) | block.aP[e];
+			}
+		}
+	}
+
+	// Nearest palette entry for every pixel, estimated by projection onto the endpoint line
+	int64_t assignIndices(const int aPixels[16][4], Mode6Block& block)
+	{
+		int aEndpoints[2][4];
+		endpointColors(block, aEndpoints);
+		int aPalette[16][4];
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) {
+				aPalette[i][c] = ((64 - kWeights4[i]) * aEndpoints[0][c] + kWeights4[i] * aEndpoints[1][c] + 32) >> 6;
+			}
+		}
+		float aDirection[4];
+		float fLengthSquared = 0.0f;
+		for (int c = 0; c < 4; c++) {
+			aDirection[c] = (float)(aEndpoints[1][c] - aEndpoints[0][c]);
+			fLengthSquared += aDirection[c] * aDirection[c];
+		}
+		float fScale = fLengthSquared > 0.0f ? 15.0f / fLengthSquared : 0.0f;
+
+		int64_t nTotalError = 0;
+		for (int i = 0; i < 16; i++) {
+			float fProjection = 0.0f;
+			for (int c = 0; c < 4; c++) {
+				fProjection += (aPixels[i][c] - aEndpoints[0][c]) * aDirection[c];
+			}
+			int nEstimate = std::max(0, std::min(15, (int)(fProjection * fScale + 0.5f)));
+			int nBest = nEstimate;
+			int nBestError = -1;
+			for (int k = std::max(0, nEstimate - 1); k <= std::min(15, nEstimate + 1); k++) {
+				int nError = 0;
+				for (int c = 0; c < 4; c++) {
+					int nDelta = aPalette[k][c] - aPixels[i][c];
+					nError += nDelta * nDelta;
+				}
+				if (nBestError < 0 || nError < nBestError) {
+					nBestError = nError;
+					nBest = k;
+				}
+			}
+			block.aIndices[i] = (uint8_t)nBest;
+			nTotalError += nBestError;
+		}
+		block.nError = nTotalError;
+		return nTotalError;
+	}
+
+	// Tries the four P bit combinations for a pair of float endpoints, keeps the best in bestBlock
+	void quantizeAndAssign(const int aPixels[16][4], const float aEndpoints[2][4], Mode6Block& bestBlock)
+	{
+		for (int nPBits = 0; nPBits < 4; nPBits++) {
+			Mode6Block block;
+			for (int e = 0; e < 2; e++) {
+				block.aP[e] = (nPBits >> e) & 1;
+				for (int c = 0; c < 4; c++) {
+					int nQuant = (int)floorf((aEndpoints[e][c] - block.aP[e]) * 0.5f + 0.5f);
+					block.aQuant[e][c] = std::max(0, std::min(127, nQuant));
+				}
+			}
+			assignIndices(aPixels, block);
+			if (bestBlock.nError < 0 || block.nError < bestBlock.nError) {
+				bestBlock = block;
+			}
+		}
+	}
+
+	void encodeBC7(const uint32_t aSource[16], uint8_t* pBlock)
+	{
+		int aPixels[16][4];
+		float aMean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		int aMin[4] = { 255, 255, 255, 255 };
+		int aMax[4] = { 0, 0, 0, 0 };
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) {
+				aPixels[i][c] = channel(aSource[i], c);
+				aMean[c] += aPixels[i][c];
+				aMin[c] = std::min(aMin[c], aPixels[i][c]);
+				aMax[c] = std::max(aMax[c], aPixels[i][c]);
+			}
+		}
+		for (int c = 0; c < 4; c++) {
+			aMean[c] *= 1.0f / 16.0f;
+		}
+
+		// principal axis of the block colors by power iteration on the covariance
+		float aCovariance[4][4] = {};
+		for (int i = 0; i < 16; i++) {
+			float aDelta[4];
+			for (int c = 0; c < 4; c++) {
+				aDelta[c] = aPixels[i][c] - aMean[c];
+			}
+			for (int r = 0; r < 4; r++) {
+				for (int c = 0; c < 4; c++) {
+					aCovariance[r][c] += aDelta[r] * aDelta[c];
+				}
+			}
+		}
+		float aAxis[4];
+		for (int c = 0; c < 4; c++) {
+			aAxis[c] = (float)(aMax[c] - aMin[c]);
+		}
+		for (int nIteration = 0; nIteration < 4; nIteration++) {
+			float aNext[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int r = 0; r < 4; r++) {
+				for (int c = 0; c < 4; c++) {
+					aNext[r] += aCovariance[r][c] * aAxis[c];
+				}
+			}
+			float fLength = sqrtf(aNext[0] * aNext[0] + aNext[1] * aNext[1] + aNext[2] * aNext[2] + aNext[3] * aNext[3]);
+			if (fLength < 1e-6f) {
+				break;
+			}
+			for (int c = 0; c < 4; c++) {
+				aAxis[c] = aNext[c] / fLength;
+			}
+		}
+		float fAxisLength = sqrtf(aAxis[0] * aAxis[0] + aAxis[1] * aAxis[1] + aAxis[2] * aAxis[2] + aAxis[3] * aAxis[3]);
+
+		float aEndpoints[2][4];
+		if (fAxisLength < 1e-6f) {
+			// flat block
+			for (int c = 0; c < 4; c++) {
+				aEndpoints[0][c] = aEndpoints[1][c] = aMean[c];
+			}
+		}
+		else {
+			float fMin = 0.0f;
+			float fMax = 0.0f;
+			for (int i = 0; i < 16; i++) {
+				float fProjection = 0.0f;
+				for (int c = 0; c < 4; c++) {
+					fProjection += (aPixels[i][c] - aMean[c]) * aAxis[c] / fAxisLength;
+				}
+				fMin = std::min(fMin, fProjection);
+				fMax = std::max(fMax, fProjection);
+			}
+			for (int c = 0; c < 4; c++) {
+				float fUnit = aAxis[c] / fAxisLength;
+				aEndpoints[0][c] = std::max(0.0f, std::min(255.0f, aMean[c] + fMin * fUnit));
+				aEndpoints[1][c] = std::max(0.0f, std::min(255.0f, aMean[c] + fMax * fUnit));
+			}
+		}
+
+		Mode6Block bestBlock;
+		quantizeAndAssign(aPixels, aEndpoints, bestBlock);
+
+		// one least squares refinement of the endpoints for the chosen indices
+		if (bestBlock.nError > 0) {
+			float fA = 0.0f, fB = 0.0f, fC = 0.0f;
+			float aX0[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float aX1[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int i = 0; i < 16; i++) {
+				float fWeight = kWeights4[bestBlock.aIndices[i]] / 64.0f;
+				float fInverse = 1.0f - fWeight;
+				fA += fInverse * fInverse;
+				fB += fInverse * fWeight;
+				fC += fWeight * fWeight;
+				for (int c = 0; c < 4; c++) {
+					aX0[c] += fInverse * aPixels[i][c];
+					aX1[c] += fWeight * aPixels[i][c];
+				}
+			}
+			float fDeterminant = fA * fC - fB * fB;
+			if (fabsf(fDeterminant) > 1e-6f) {
+				float aRefined[2][4];
+				for (int c = 0; c < 4; c++) {
+					aRefined[0][c] = std::max(0.0f, std::min(255.0f, (fC * aX0[c] - fB * aX1[c]) / fDeterminant));
+					aRefined[1][c] = std::max(0.0f, std::min(255.0f, (fA * aX1[c] - fB * aX0[c]) / fDeterminant));
+				}
+				quantizeAndAssign(aPixels, aRefined, bestBlock);
+			}
+		}
+
+		// the anchor index is stored with 3 bits, so its high bit must be 0
+		if (bestBlock.aIndices[0] >= 8) {
+			for (int c = 0; c < 4; c++) {
+				std::swap(bestBlock.aQuant[0][c], bestBlock.aQuant[1][c]);
+			}
+			std::swap(bestBlock.aP[0], bestBlock.aP[1]);
+			for (int i = 0; i < 16; i++) {
+				bestBlock.aIndices[i] = (uint8_t)(15 - bestBlock.aIndices[i]);
+			}
+		}
+
+		memset(pBlock, 0, 16);
+		int nBit = 0;
+		putBits(pBlock, nBit, 1 << 6, 7);
+		for (int c = 0; c < 4; c++) {
+			putBits(pBlock, nBit, (uint32_t)bestBlock.aQuant[0][c], 7);
+			putBits(pBlock, nBit, (uint32_t)bestBlock.aQuant[1][c], 7);
+		}
+		putBits(pBlock, nBit, (uint32_t)bestBlock.aP[0], 1);
+		putBits(pBlock, nBit, (uint32_t)bestBlock.aP[1], 1);
+		putBits(pBlock, nBit, bestBlock.aIndices[0], 3);
+		for (int i = 1; i < 16; i++) {
+			putBits(pBlock, nBit, bestBlock.aIndices[i], 4);
+		}
+	}
+
+	void writeU32(std::vector<uint8_t>& aBytes, uint32_t nValue)
+	{
+		for (int i = 0; i < 4; i++) {
+			aBytes.push_back((uint8_t)(nValue >> (i * 8)));
+		}
+	}
+}
+
+size_t DzBlockCompressor::GetBlockBytes(DzBlockFormat eFormat)
+{
+	return eFormat == DzBlockFormat::BC4 ? 8 : 16;
+}
+
+size_t DzBlockCompressor::GetImageBytes(DzBlockFormat eFormat, int nWidth, int nHeight)
+{
+	return (size_t)((nWidth + 3) / 4) * ((nHeight + 3) / 4) * GetBlockBytes(eFormat);
+}
+
+void DzBlockCompressor::EncodeBlock(DzBlockFormat eFormat, const uint32_t aPixels[16], uint8_t* pBlock)
+{
+	uint8_t aValues[16];
+	switch (eFormat) {
+	case DzBlockFormat::BC4:
+		for (int i = 0; i < 16; i++) {
+			aValues[i] = luminance709(aPixels[i]);
+		}
+		encodeBC4(aValues, pBlock);
+		break;
+	case DzBlockFormat::BC5:
+		for (int nChannel = 0; nChannel < 2; nChannel++) {
+			for (int i = 0; i < 16; i++) {
+				aValues[i] = (uint8_t)channel(aPixels[i], nChannel);
+			}
+			encodeBC4(aValues, pBlock + nChannel * 8);
+		}
+		break;
+	case DzBlockFormat::BC7:
+		encodeBC7(aPixels, pBlock);
+		break;
+	}
+}
+
+void DzBlockCompressor::EncodeImage(DzBlockFormat eFormat, const uint32_t* pPixels, int nWidth, int nHeight, size_t nStride, uint8_t* pBlocks)
+{
+	int nBlocksX = (nWidth + 3) / 4;
+	int nBlocksY = (nHeight + 3) / 4;
+	size_t nBlockBytes = GetBlockBytes(eFormat);
+	DzNativeParallel::For((size_t)nBlocksY, 4, [&](size_t nBegin, size_t nEnd) {
+		uint32_t aBlock[16];
+		for (size_t nBlockY = nBegin; nBlockY < nEnd; nBlockY++) {
+			for (int nBlockX = 0; nBlockX < nBlocksX; nBlockX++) {
+				for (int y = 0; y < 4; y++) {
+					int nRow = std::min((int)nBlockY * 4 + y, nHeight - 1);
+					const uint32_t* pRow = pPixels + (size_t)nRow * nStride;
+					for (int x = 0; x < 4; x++) {
+						aBlock[y * 4 + x] = pRow[std::min(nBlockX * 4 + x, nWidth - 1)];
+					}
+				}
+				EncodeBlock(eFormat, aBlock, pBlocks + (nBlockY * nBlocksX + nBlockX) * nBlockBytes);
+			}
+		}
+	});
+}
+
+void DzBlockCompressor::DecodeBC4Block(const uint8_t* pBlock, uint8_t aValues[16])
+{
+	int aPalette[8];
+	bc4Palette(pBlock[0], pBlock[1], aPalette);
+	int nBit = 16;
+	for (int i = 0; i < 16; i++) {
+		aValues[i] = (uint8_t)aPalette[getBits(pBlock, nBit, 3)];
+	}
+}
+
+bool DzBlockCompressor::DecodeBC7Block(const uint8_t* pBlock, uint32_t aPixels[16])
+{
+	if ((pBlock[0] & 0x7f) != 0x40) {
+		return false;
+	}
+	int nBit = 7;
+	int aQuant[2][4];
+	for (int c = 0; c < 4; c++) {
+		aQuant[0][c] = (int)getBits(pBlock, nBit, 7);
+		aQuant[1][c] = (int)getBits(pBlock, nBit, 7);
+	}
+	int aP[2];
+	aP[0] = (int)getBits(pBlock, nBit, 1);
+	aP[1] = (int)getBits(pBlock, nBit, 1);
+	for (int i = 0; i < 16; i++) {
+		int nIndex = (int)getBits(pBlock, nBit, i == 0 ? 3 : 4);
+		int aColor[4];
+		for (int c = 0; c < 4; c++) {
+			int nEndpoint0 = (aQuant[0][c] << 1) | aP[0];
+			int nEndpoint1 = (aQuant[1][c] << 1) | aP[1];
+			aColor[c] = ((64 - kWeights4[nIndex]) * nEndpoint0 + kWeights4[nIndex] * nEndpoint1 + 32) >> 6;
+		}
+		aPixels[i] = ((uint32_t)aColor[3] << 24) | ((uint32_t)aColor[0] << 16) | ((uint32_t)aColor[1] << 8) | (uint32_t)aColor[2];
+	}
+	return true;
+}
+
+///////////////////////////////
+// DzDdsWriter
+///////////////////////////////
+
+int DzDdsWriter::GetMipLevelCount(int nWidth, int nHeight)
+{
+	int nLevels = 1;
+	int nSize = std::max(nWidth, nHeight);
+	while (nSize > 1) {
+		nSize >>= 1;
+		nLevels++;
+	}
+	return nLevels;
+}
+
+bool DzDdsWriter::Write(const char* sPath, const uint32_t* pPixels, int nWidth, int nHeight, size_t nStride,
+	DzBlockFormat eFormat, bool bSrgb, bool bMipmaps, Result& result)
+{
+	result = Result();
+	if (pPixels == nullptr || nWidth < 1 || nHeight < 1 || nStride < (size_t)nWidth) {
+		result.sError = "invalid image";
+		return false;
+	}
+	int nLevels = bMipmaps ? GetMipLevelCount(nWidth, nHeight) : 1;
+
+	// every mip level is reduced from the one above it in a single pass over the source rows
+	std::vector<int> aWidths;
+	std::vector<int> aHeights;
+	std::vector<std::vector<uint32_t> > aMips(nLevels - 1);
+	for (int i = 1; i < nLevels; i++) {
+		aWidths.push_back(std::max(1, nWidth >> i));
+		aHeights.push_back(std::max(1, nHeight >> i));
+		aMips[i - 1].reserve((size_t)aWidths.back() * aHeights.back());
+	}
+	DzTexturePyramid pyramid(nWidth, nHeight, aWidths, aHeights, [&](int nLevel, const uint32_t* pRow) {
+		aMips[nLevel].insert(aMips[nLevel].end(), pRow, pRow + aWidths[nLevel]);
+		return true;
+	});
+	for (int y = 0; y < nHeight && nLevels > 1; y++) {
+		pyramid.addRow(pPixels + (size_t)y * nStride);
+	}
+	size_t nMipBytes = pyramid.getMemoryBytes();
+	for (size_t i = 0; i < aMips.size(); i++) {
+		nMipBytes += aMips[i].capacity() * sizeof(uint32_t);
+	}
+
+	uint32_t nDxgiFormat = kDxgiBC7Unorm;
+	if (eFormat == DzBlockFormat::BC4) nDxgiFormat = kDxgiBC4Unorm;
+	else if (eFormat == DzBlockFormat::BC5) nDxgiFormat = kDxgiBC5Unorm;
+	else if (bSrgb) nDxgiFormat = kDxgiBC7UnormSrgb;
+
+	std::vector<uint8_t> aHeader;
+	aHeader.push_back('D'); aHeader.push_back('D'); aHeader.push_back('S'); aHeader.push_back(' ');
+	// DDS_HEADER: caps, height, width, pixel format, mipmap count and linear size are valid
+	writeU32(aHeader, 124);
+	writeU32(aHeader, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000);
+	writeU32(aHeader, (uint32_t)nHeight);
+	writeU32(aHeader, (uint32_t)nWidth);
+	writeU32(aHeader, (uint32_t)DzBlockCompressor::GetImageBytes(eFormat, nWidth, nHeight));
+	writeU32(aHeader, 0);
+	writeU32(aHeader, (uint32_t)nLevels);
+	for (int i = 0; i < 11; i++) writeU32(aHeader, 0);
+	// DDS_PIXELFORMAT with the "DX10" FourCC
+	writeU32(aHeader, 32);
+	writeU32(aHeader, 0x4);
+	writeU32(aHeader, 0x30315844);
+	for (int i = 0; i < 5; i++) writeU32(aHeader, 0);
+	// texture, plus mipmap and complex when there is a mip chain
+	writeU32(aHeader, 0x1000 | (nLevels > 1 ? 0x400000 | 0x8 : 0));
+	for (int i = 0; i < 4; i++) writeU32(aHeader, 0);
+	// DDS_HEADER_DXT10: 2D texture, one array element
+	writeU32(aHeader, nDxgiFormat);
+	writeU32(aHeader, 3);
+	writeU32(aHeader, 0);
+	writeU32(aHeader, 1);
+	writeU32(aHeader, 0);
+
+	FILE* pFile = DzOpenFileUtf8(sPath, "wb");
+	if (pFile == nullptr) {
+		result.sError = "unable to open file for writing";
+		return false;
+	}
+	bool bWritten = fwrite(aHeader.data(), 1, aHeader.size(), pFile) == aHeader.size();
+	result.nFileBytes = aHeader.size();
+	std::vector<uint8_t> aBlocks;
+	for (int nLevel = 0; nLevel < nLevels && bWritten; nLevel++) {
+		int nLevelWidth = nLevel == 0 ? nWidth : aWidths[nLevel - 1];
+		int nLevelHeight = nLevel == 0 ? nHeight : aHeights[nLevel - 1];
+		const uint32_t* pLevelPixels = nLevel == 0 ? pPixels : aMips[nLevel - 1].data();
+		size_t nLevelStride = nLevel == 0 ? nStride : (size_t)nLevelWidth;
+		aBlocks.resize(DzBlockCompressor::GetImageBytes(eFormat, nLevelWidth, nLevelHeight));
+		DzBlockCompressor::EncodeImage(eFormat, pLevelPixels, nLevelWidth, nLevelHeight, nLevelStride, aBlocks.data());
+		bWritten = fwrite(aBlocks.data(), 1, aBlocks.size(), pFile) == aBlocks.size();
+		result.nFileBytes += aBlocks.size();
+		result.nPeakBufferBytes = std::max(result.nPeakBufferBytes, nMipBytes + aBlocks.capacity());
+	}
+	if (fclose(pFile) != 0) {
+		bWritten = false;
+	}
+	if (bWritten == false) {
+		result.sError = "unable to write file";
+		return false;
+	}
+	result.nMipLevels = nLevels;
+	return true;
+}
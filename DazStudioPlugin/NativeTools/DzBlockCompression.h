@@ -0,0 +1,69 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum class DzBlockFormat
+{
+	BC4,  // one channel, Rec.709 luminance of RGB
+	BC5,  // two channels, R and G (tangent space normal maps)
+	BC7   // RGBA
+};
+
+/*****************************
+DzBlockCompressor
+
+CPU encoder for GPU block compressed textures.  Every 4x4 block is encoded
+on its own, so images are encoded in parallel across rows of blocks.  BC4
+and BC5 use the 8 value mode with min/max endpoints.  BC7 uses mode 6 only
+(one subset, RGBA endpoints with per-endpoint P bits, 4 bit indices): the
+endpoints come from the principal axis of the block colors and are refined
+once by least squares, which is a good speed/quality trade-off for a
+single mode encoder.  Pixels are 32-bit 0xAARRGGBB words, the same layout
+as QImage::Format_ARGB32.
+*****************************/
+class DzBlockCompressor
+{
+public:
+	// 8 for BC4, 16 for BC5 and BC7
+	static size_t GetBlockBytes(DzBlockFormat eFormat);
+	static size_t GetImageBytes(DzBlockFormat eFormat, int nWidth, int nHeight);
+
+	// aPixels is one 4x4 block, row by row
+	static void EncodeBlock(DzBlockFormat eFormat, const uint32_t aPixels[16], uint8_t* pBlock);
+
+	// Edge blocks of images that are not a multiple of 4 repeat the last row and column.
+	// nStride is in pixels.  pBlocks receives GetImageBytes() bytes.
+	static void EncodeImage(DzBlockFormat eFormat, const uint32_t* pPixels, int nWidth, int nHeight, size_t nStride, uint8_t* pBlocks);
+
+	// Reference decoders for the blocks written above (BC7 decodes mode 6 only)
+	static void DecodeBC4Block(const uint8_t* pBlock, uint8_t aValues[16]);
+	static bool DecodeBC7Block(const uint8_t* pBlock, uint32_t aPixels[16]);
+};
+
+/*****************************
+DzDdsWriter
+
+Writes a block compressed texture with its full mip chain to a DDS file
+with a DX10 header.  Mip levels are reduced from the level above with the
+area-average DzTexturePyramid, each level is then encoded in parallel.
+*****************************/
+class DzDdsWriter
+{
+public:
+	struct Result
+	{
+		std::string sError;
+		int nMipLevels = 0;
+		size_t nFileBytes = 0;
+		// source mip chain and encoded blocks
+		size_t nPeakBufferBytes = 0;
+	};
+
+	static int GetMipLevelCount(int nWidth, int nHeight);
+
+	// bSrgb marks BC7 color data as sRGB, it is ignored for BC4 and BC5.  sPath is UTF-8.
+	static bool Write(const char* sPath, const uint32_t* pPixels, int nWidth, int nHeight, size_t nStride,
+		DzBlockFormat eFormat, bool bSrgb, bool bMipmaps, Result& result);
+};
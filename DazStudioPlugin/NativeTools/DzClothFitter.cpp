@@ -0,0 +1,460 @@
+#include <math.h>
+#include <algorithm>
+
+#include "DzClothFitter.h"
+#include "DzTriangleBvh.h"
+#include "DzNativeParallel.h"
+
+namespace
+{
+	const size_t kMinPacketsPerThread = 256;
+	// the thresholds of the Python version
+	const double kWeightThresholdStart = 0.55;
+	const double kWeightThresholdEnd = 0.20;
+	const double kNormalThresholdStart = 0.01;
+	const double kNormalThresholdEnd = 0.99;
+	const double kPass2WeightThreshold = 0.55;
+
+	inline void normalize(float* v)
+	{
+		float fLength = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (fLength > 0.0f) {
+			for (int c = 0; c < 3; c++) v[c] /= fLength;
+		}
+	}
+
+	// the polygons around every vertex (Python's v.link_faces) and the group bits of every vertex
+	class FitMesh
+	{
+	public:
+		FitMesh(const DzFitMesh& mesh, int nGroups) : m_mesh(mesh), m_nWords((size_t)(nGroups + 63) / 64) {}
+
+		bool validate() const
+		{
+			for (size_t k = 0; k < m_mesh.nLoops; k++) {
+				if (m_mesh.pLoopVertices[k] < 0 || (size_t)m_mesh.pLoopVertices[k] >= m_mesh.nVertices) return false;
+			}
+			for (size_t f = 0; f < m_mesh.nFaces; f++) {
+				if (m_mesh.pFaceLoopStarts[f] < 0 || m_mesh.pFaceLoopCounts[f] < 0 ||
+					(size_t)m_mesh.pFaceLoopStarts[f] + m_mesh.pFaceLoopCounts[f] > m_mesh.nLoops) return false;
+			}
+			for (size_t t = 0; t < m_mesh.nTriangles; t++) {
+				if (m_mesh.pTriangleFaces[t] < 0 || (size_t)m_mesh.pTriangleFaces[t] >= m_mesh.nFaces) return false;
+				for (int c = 0; c < 3; c++) {
+					if (m_mesh.pTriangles[t * 3 + c] < 0 || (size_t)m_mesh.pTriangles[t * 3 + c] >= m_mesh.nVertices) return false;
+				}
+			}
+			for (size_t i = 0; i < m_mesh.nWeights; i++) {
+				if (m_mesh.pWeightVertices[i] < 0 || (size_t)m_mesh.pWeightVertices[i] >= m_mesh.nVertices) return false;
+				if (m_mesh.pWeightGroups[i] < 0 || (size_t)m_mesh.pWeightGroups[i] >= m_nWords * 64) return false;
+			}
+			return true;
+		}
+
+		void buildVertexFaces()
+		{
+			m_aVertexFaceOffsets.assign(m_mesh.nVertices + 1, 0);
+			for (size_t f = 0; f < m_mesh.nFaces; f++) {
+				for (int k = m_mesh.pFaceLoopStarts[f]; k < m_mesh.pFaceLoopStarts[f] + m_mesh.pFaceLoopCounts[f]; k++) {
+					m_aVertexFaceOffsets[m_mesh.pLoopVertices[k] + 1]++;
+				}
+			}
+			for (size_t v = 0; v < m_mesh.nVertices; v++) {
+				m_aVertexFaceOffsets[v + 1] += m_aVertexFaceOffsets[v];
+			}
+			m_aVertexFaces.resize(m_aVertexFaceOffsets[m_mesh.nVertices]);
+			std::vector<uint32_t> aFill(m_aVertexFaceOffsets.begin(), m_aVertexFaceOffsets.end() - 1);
+			for (size_t f = 0; f < m_mesh.nFaces; f++) {
+				for (int k = m_mesh.pFaceLoopStarts[f]; k < m_mesh.pFaceLoopStarts[f] + m_mesh.pFaceLoopCounts[f]; k++) {
+					m_aVertexFaces[aFill[m_mesh.pLoopVertices[k]]++] = (uint32_t)f;
+				}
+			}
+		}
+
+		// Newell normals, as Blender's normal_update() computes them
+		void computeFaceNormals(const float* pPositions, std::vector<float>& aNormals) const
+		{
+			aNormals.resize(m_mesh.nFaces * 3);
+			DzNativeParallel::For(m_mesh.nFaces, 4096, [&](size_t nBegin, size_t nEnd) {
+				for (size_t f = nBegin; f < nEnd; f++) {
+					float n[3] = { 0.0f, 0.0f, 0.0f };
+					int nStart = m_mesh.pFaceLoopStarts[f], nCount = m_mesh.pFaceLoopCounts[f];
+					for (int k = 0; k < nCount; k++) {
+						const float* a = pPositions + (size_t)m_mesh.pLoopVertices[nStart + k] * 3;
+						const float* b = pPositions + (size_t)m_mesh.pLoopVertices[nStart + (k + 1) % nCount] * 3;
+						n[0] += (a[1] - b[1]) * (a[2] + b[2]);
+						n[1] += (a[2] - b[2]) * (a[0] + b[0]);
+						n[2] += (a[0] - b[0]) * (a[1] + b[1]);
+					}
+					normalize(n);
+					for (int c = 0; c < 3; c++) aNormals[f * 3 + c] = n[c];
+				}
+			});
+		}
+
+		// normalized sum of the normals of the faces around every vertex
+		void computeVertexNormals(const std::vector<float>& aFaceNormals, std::vector<float>& aNormals) const
+		{
+			aNormals.assign(m_mesh.nVertices * 3, 0.0f);
+			for (size_t v = 0; v < m_mesh.nVertices; v++) {
+				float* n = &aNormals[v * 3];
+				for (uint32_t i = m_aVertexFaceOffsets[v]; i < m_aVertexFaceOffsets[v + 1]; i++) {
+					for (int c = 0; c < 3; c++) n[c] += aFaceNormals[m_aVertexFaces[i] * 3 + c];
+				}
+				normalize(n);
+			}
+		}
+
+		void buildGroupBits(double fThreshold)
+		{
+			m_aGroupBits.assign(m_mesh.nVertices * m_nWords, 0);
+			for (size_t i = 0; i < m_mesh.nWeights; i++) {
+				if ((double)m_mesh.pWeights[i] < fThreshold) continue;
+				int nGroup = m_mesh.pWeightGroups[i];
+				m_aGroupBits[m_mesh.pWeightVertices[i] * m_nWords + nGroup / 64] |= (uint64_t)1 << (nGroup % 64);
+			}
+		}
+
+		// whether vertex v of other shares a group with any vertex of face f of this mesh
+		bool sharesGroup(size_t f, const FitMesh& other, size_t v) const
+		{
+			const uint64_t* pOther = &other.m_aGroupBits[v * m_nWords];
+			for (int k = m_mesh.pFaceLoopStarts[f]; k < m_mesh.pFaceLoopStarts[f] + m_mesh.pFaceLoopCounts[f]; k++) {
+				const uint64_t* pBits = &m_aGroupBits[(size_t)m_mesh.pLoopVertices[k] * m_nWords];
+				for (size_t w = 0; w < m_nWords; w++) {
+					if (pBits[w] & pOther[w]) return true;
+				}
+			}
+			return false;
+		}
+
+		void triangleNormal(const float* pPositions, int nTriangle, float* n) const
+		{
+			const float* p0 = pPositions + (size_t)m_mesh.pTriangles[nTriangle * 3] * 3;
+			const float* p1 = pPositions + (size_t)m_mesh.pTriangles[nTriangle * 3 + 1] * 3;
+			const float* p2 = pPositions + (size_t)m_mesh.pTriangles[nTriangle * 3 + 2] * 3;
+			float e1[3], e2[3];
+			for (int c = 0; c < 3; c++) {
+				e1[c] = p1[c] - p0[c];
+				e2[c] = p2[c] - p0[c];
+			}
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+			normalize(n);
+		}
+
+		const DzFitMesh& m_mesh;
+		size_t m_nWords;
+		std::vector<uint32_t> m_aVertexFaceOffsets;
+		std::vector<uint32_t> m_aVertexFaces;
+		std::vector<uint64_t> m_aGroupBits;
+	};
+
+	// Casts one ray per vertex (a zero direction skips the vertex) in packets of consecutive vertices, in parallel
+	template <typename RayFunction>
+	void castVertexRays(const DzTriangleBvh& bvh, size_t nVertices, float fMaxDistance, bool bIgnoreOwnVertex,
+		std::vector<DzRayHit>& aHits, RayFunction fnRay)
+	{
+		const int nPacket = DzTriangleBvh::kPacketSize;
+		aHits.resize(nVertices);
+		size_t nPackets = (nVertices + nPacket - 1) / nPacket;
+		DzNativeParallel::For(nPackets, kMinPacketsPerThread, [&](size_t nBegin, size_t nEnd) {
+			float aOrigins[DzTriangleBvh::kPacketSize * 3], aDirections[DzTriangleBvh::kPacketSize * 3];
+			float aDistances[DzTriangleBvh::kPacketSize];
+			int aVertices[DzTriangleBvh::kPacketSize];
+			for (size_t nPacketIndex = nBegin; nPacketIndex < nEnd; nPacketIndex++) {
+				size_t nFirst = nPacketIndex * nPacket;
+				int nRays = (int)std::min<size_t>(nPacket, nVertices - nFirst);
+				float fPacketDistance = 0.0f;
+				for (int r = 0; r < nRays; r++) {
+					aVertices[r] = (int)(nFirst + r);
+					aDistances[r] = fMaxDistance;
+					fnRay(nFirst + r, aOrigins + r * 3, aDirections + r * 3, aDistances[r]);
+					fPacketDistance = std::max(fPacketDistance, aDistances[r]);
+				}
+				bvh.intersectPacket(aOrigins, aDirections, nRays, fPacketDistance, &aHits[nFirst], bIgnoreOwnVertex ? aVertices : nullptr);
+				for (int r = 0; r < nRays; r++) {
+					if (aHits[nFirst + r].fDistance > aDistances[r]) aHits[nFirst + r].nTriangle = -1;
+				}
+			}
+		});
+	}
+
+	class Fitter
+	{
+	public:
+		Fitter(const DzFitMesh& source, const DzFitMesh& target, const DzFitSettings& settings, std::vector<float>& aPositions,
+			std::vector<uint8_t>& aTagged, DzFitStats& stats)
+			: m_source(source, settings.nGroups), m_target(target, settings.nGroups), m_settings(settings), m_aPositions(aPositions),
+			m_aTagged(aTagged), m_stats(stats)
+		{
+		}
+
+		bool run();
+
+	private:
+		bool runPass1(int nIteration, double fWeightThreshold, double fNormalThreshold, size_t& nMoved);
+		bool runPass2(size_t& nMovedFaces);
+		void undoPokeThroughs();
+		bool undoFlips();
+
+		FitMesh m_source;
+		FitMesh m_target;
+		const DzFitSettings& m_settings;
+		std::vector<float>& m_aPositions;
+		std::vector<uint8_t>& m_aTagged;
+		DzFitStats& m_stats;
+
+		DzTriangleBvh m_targetBvh;
+		DzTriangleBvh m_sourceBvh;
+		float m_fDirection = 1.0f;
+		float m_fOffsetMultiplier = 1.0f;
+		std::vector<float> m_aOriginalNormals;
+		std::vector<float> m_aPrevious;
+		std::vector<uint8_t> m_aMoved;
+		std::vector<DzRayHit> m_aHits;
+	};
+
+	bool Fitter::run()
+	{
+		if (!m_source.validate() || !m_target.validate()) {
+			return false;
+		}
+		m_aPositions.assign(m_source.m_mesh.pPositions, m_source.m_mesh.pPositions + m_source.m_mesh.nVertices * 3);
+		m_aTagged.assign(m_source.m_mesh.nVertices, 0);
+		m_source.buildVertexFaces();
+		m_target.buildVertexFaces();
+		m_source.computeFaceNormals(m_aPositions.data(), m_aOriginalNormals);
+		m_targetBvh.build(m_target.m_mesh.pPositions, m_target.m_mesh.pTriangles, m_target.m_mesh.nTriangles);
+		m_sourceBvh.build(m_aPositions.data(), m_source.m_mesh.pTriangles, m_source.m_mesh.nTriangles);
+		if (m_settings.fFitRatio < 1.0f) {
+			m_fDirection = -1.0f;
+			m_fOffsetMultiplier = 2.0f - m_settings.fFitRatio;
+		}
+		else {
+			m_fOffsetMultiplier = m_settings.fFitRatio;
+		}
+
+		int nPass1 = std::max(m_settings.nPass1Iterations, 0);
+		double fWeightStep = nPass1 ? (kWeightThresholdEnd - kWeightThresholdStart) / nPass1 : 0.0;
+		double fNormalStep = nPass1 ? (kNormalThresholdEnd - kNormalThresholdStart) / nPass1 : 0.0;
+		double fWeightThreshold = kWeightThresholdStart, fNormalThreshold = kNormalThresholdStart;
+		int nZeros = 0;
+		for (int nIteration = 0; nIteration < nPass1; nIteration++) {
+			size_t nMoved = 0;
+			if (!runPass1(nIteration, fWeightThreshold, fNormalThreshold, nMoved)) {
+				return true;
+			}
+			fWeightThreshold += fWeightStep;
+			fNormalThreshold += fNormalStep;
+			if (nMoved == 0) {
+				if (++nZeros > 18) break;
+			}
+			else {
+				nZeros = 0;
+			}
+		}
+
+		m_source.buildGroupBits(kPass2WeightThreshold);
+		m_target.buildGroupBits(kPass2WeightThreshold);
+		for (int nIteration = 0; nIteration < m_settings.nPass2Iterations; nIteration++) {
+			size_t nMovedFaces = 0;
+			if (!runPass2(nMovedFaces)) {
+				return true;
+			}
+		}
+		return true;
+	}
+
+	bool Fitter::runPass1(int nIteration, double fWeightThreshold, double fNormalThreshold, size_t& nMoved)
+	{
+		const DzFitMesh& source = m_source.m_mesh;
+		m_aPrevious = m_aPositions;
+		std::vector<float> aFaceNormals, aNormals;
+		m_source.computeFaceNormals(m_aPositions.data(), aFaceNormals);
+		m_source.computeVertexNormals(aFaceNormals, aNormals);
+		m_source.buildGroupBits(fWeightThreshold);
+		m_target.buildGroupBits(fWeightThreshold);
+
+		castVertexRays(m_targetBvh, source.nVertices, m_settings.fDistanceCutoff, false, m_aHits,
+			[&](size_t v, float* pOrigin, float* pDirection, float&) {
+			bool bLocked = m_aTagged[v] && m_settings.bLockTaggedVertices;
+			for (int c = 0; c < 3; c++) {
+				pOrigin[c] = m_aPositions[v * 3 + c];
+				pDirection[c] = bLocked ? 0.0f : aNormals[v * 3 + c] * m_fDirection;
+			}
+		});
+
+		// every vertex only reads its own position, so the moves can be applied in parallel as well
+		m_aMoved.assign(source.nVertices, 0);
+		float fMinSame = (float)(1.0 - fNormalThreshold);
+		DzNativeParallel::For(source.nVertices, 4096, [&](size_t nBegin, size_t nEnd) {
+			for (size_t v = nBegin; v < nEnd; v++) {
+				const DzRayHit& hit = m_aHits[v];
+				if (hit.nTriangle < 0) continue;
+				if (!m_target.sharesGroup((size_t)m_target.m_mesh.pTriangleFaces[hit.nTriangle], m_source, v)) continue;
+				float aFaceNormal[3];
+				m_target.triangleNormal(m_target.m_mesh.pPositions, hit.nTriangle, aFaceNormal);
+				const float* pNormal = &aNormals[v * 3];
+				float fDot = aFaceNormal[0] * pNormal[0] + aFaceNormal[1] * pNormal[1] + aFaceNormal[2] * pNormal[2];
+				// facing away or not facing the same way closely enough
+				if (fDot < -1.0f + 0.9f || !(fDot > fMinSame)) continue;
+				for (int c = 0; c < 3; c++) {
+					float fHit = m_aPrevious[v * 3 + c] + pNormal[c] * m_fDirection * hit.fDistance;
+					m_aPositions[v * 3 + c] += (fHit - m_aPrevious[v * 3 + c]) * m_fOffsetMultiplier;
+				}
+				m_aMoved[v] = 1;
+			}
+		});
+
+		if (m_settings.bCheckSelfPokeThrough) {
+			undoPokeThroughs();
+		}
+		if (!undoFlips()) {
+			return false;
+		}
+		nMoved = 0;
+		for (size_t v = 0; v < source.nVertices; v++) {
+			nMoved += m_aMoved[v];
+		}
+		m_stats.nMovedVertices += nMoved;
+		m_stats.nPass1Iterations = nIteration + 1;
+		return true;
+	}
+
+	bool Fitter::runPass2(size_t& nMovedFaces)
+	{
+		const DzFitMesh& source = m_source.m_mesh;
+		const DzFitMesh& target = m_target.m_mesh;
+		m_aPrevious = m_aPositions;
+		m_sourceBvh.refit(m_aPositions.data());
+		std::vector<float> aFaceNormals, aNormals;
+		m_target.computeFaceNormals(target.pPositions, aFaceNormals);
+		m_target.computeVertexNormals(aFaceNormals, aNormals);
+
+		castVertexRays(m_sourceBvh, target.nVertices, m_settings.fDistanceCutoff, false, m_aHits,
+			[&](size_t v, float* pOrigin, float* pDirection, float&) {
+			for (int c = 0; c < 3; c++) {
+				pOrigin[c] = target.pPositions[v * 3 + c];
+				pDirection[c] = -aNormals[v * 3 + c] * m_fDirection;
+			}
+		});
+
+		// the first body vertex that hits a clothing face moves it, so the moves are applied in vertex order
+		m_aMoved.assign(source.nVertices, 0);
+		std::vector<uint8_t> aFaceMoved(source.nFaces, 0);
+		nMovedFaces = 0;
+		for (size_t v = 0; v < target.nVertices; v++) {
+			const DzRayHit& hit = m_aHits[v];
+			if (hit.nTriangle < 0) continue;
+			size_t nFace = (size_t)source.pTriangleFaces[hit.nTriangle];
+			if (!m_source.sharesGroup(nFace, m_target, v)) continue;
+			float aFaceNormal[3];
+			m_source.triangleNormal(m_aPrevious.data(), hit.nTriangle, aFaceNormal);
+			const float* pNormal = &aNormals[v * 3];
+			float fDot = aFaceNormal[0] * pNormal[0] + aFaceNormal[1] * pNormal[1] + aFaceNormal[2] * pNormal[2];
+			if (fDot < -1.0f + 1.0f || !(fDot > 1.0f - 0.01f) || aFaceMoved[nFace]) continue;
+			float aOffset[3];
+			for (int c = 0; c < 3; c++) {
+				// the body vertex minus the hit location
+				aOffset[c] = pNormal[c] * m_fDirection * hit.fDistance;
+			}
+			for (int k = source.pFaceLoopStarts[nFace]; k < source.pFaceLoopStarts[nFace] + source.pFaceLoopCounts[nFace]; k++) {
+				int s = source.pLoopVertices[k];
+				if (m_aTagged[s] || m_aMoved[s]) continue;
+				for (int c = 0; c < 3; c++) m_aPositions[s * 3 + c] += aOffset[c] * m_fOffsetMultiplier;
+				m_aMoved[s] = 1;
+			}
+			aFaceMoved[nFace] = 1;
+			nMovedFaces++;
+		}
+
+		if (m_settings.bCheckSelfPokeThrough) {
+			undoPokeThroughs();
+		}
+		if (!undoFlips()) {
+			return false;
+		}
+		m_stats.nMovedFaces += nMovedFaces;
+		m_stats.nPass2Iterations++;
+		return true;
+	}
+
+	// a moved vertex whose path crosses another clothing face was pushed through the clothing itself
+	void Fitter::undoPokeThroughs()
+	{
+		const DzFitMesh& source = m_source.m_mesh;
+		m_sourceBvh.refit(m_aPrevious.data());
+		std::vector<DzRayHit> aHits;
+		castVertexRays(m_sourceBvh, source.nVertices, 0.0f, true, aHits,
+			[&](size_t v, float* pOrigin, float* pDirection, float& fDistance) {
+			float fLength = 0.0f;
+			for (int c = 0; c < 3; c++) {
+				pOrigin[c] = m_aPrevious[v * 3 + c];
+				pDirection[c] = m_aMoved[v] ? m_aPositions[v * 3 + c] - m_aPrevious[v * 3 + c] : 0.0f;
+				fLength += pDirection[c] * pDirection[c];
+			}
+			fLength = sqrtf(fLength);
+			for (int c = 0; c < 3 && fLength > 0.0f; c++) pDirection[c] /= fLength;
+			fDistance = fLength;
+		});
+		for (size_t v = 0; v < source.nVertices; v++) {
+			if (aHits[v].nTriangle < 0) continue;
+			for (int c = 0; c < 3; c++) m_aPositions[v * 3 + c] = m_aPrevious[v * 3 + c];
+			m_aMoved[v] = 0;
+			m_aTagged[v] = 1;
+			m_stats.nPokeThroughReverts++;
+		}
+	}
+
+	// moves that flipped a face are undone, returns false if a face is still flipped
+	bool Fitter::undoFlips()
+	{
+		const DzFitMesh& source = m_source.m_mesh;
+		std::vector<float> aNormals;
+		for (int nCheck = 0; nCheck < 2; nCheck++) {
+			m_source.computeFaceNormals(m_aPositions.data(), aNormals);
+			bool bFlipped = false;
+			for (size_t f = 0; f < source.nFaces; f++) {
+				const float* n = &aNormals[f * 3];
+				const float* o = &m_aOriginalNormals[f * 3];
+				if (n[0] * o[0] + n[1] * o[1] + n[2] * o[2] >= 0.0f) continue;
+				bFlipped = true;
+				if (nCheck == 1) break;
+				for (int k = source.pFaceLoopStarts[f]; k < source.pFaceLoopStarts[f] + source.pFaceLoopCounts[f]; k++) {
+					int v = source.pLoopVertices[k];
+					for (int c = 0; c < 3; c++) m_aPositions[v * 3 + c] = m_aPrevious[v * 3 + c];
+					m_aMoved[v] = 0;
+					m_aTagged[v] = 1;
+				}
+				m_stats.nFlipReverts++;
+			}
+			if (!bFlipped) {
+				return true;
+			}
+		}
+		// still flipped, keep the previous iteration
+		m_aPositions = m_aPrevious;
+		m_stats.bAborted = true;
+		return false;
+	}
+}
+
+bool DzClothFitter::Fit(const DzFitMesh& source, const DzFitMesh& target, const DzFitSettings& settings,
+	std::vector<float>& aPositions, std::vector<uint8_t>& aTagged, DzFitStats* pStats)
+{
+	DzFitStats stats;
+	Fitter fitter(source, target, settings, aPositions, aTagged, stats);
+	if (!fitter.run()) {
+		return false;
+	}
+	stats.nTaggedVertices = 0;
+	for (size_t v = 0; v < aTagged.size(); v++) {
+		stats.nTaggedVertices += aTagged[v];
+	}
+	if (pStats) {
+		*pStats = stats;
+	}
+	return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// One mesh in Blender's layout: polygons as loop ranges, the loop triangles with their polygons, and the vertex group
+// weights as (vertex, group, weight) entries, with the groups numbered the same on the clothing and the body
+struct DzFitMesh
+{
+	const float* pPositions = nullptr;    // xyz per vertex
+	size_t nVertices = 0;
+	const int* pFaceLoopStarts = nullptr;
+	const int* pFaceLoopCounts = nullptr;
+	size_t nFaces = 0;
+	const int* pLoopVertices = nullptr;
+	size_t nLoops = 0;
+	const int* pTriangles = nullptr;      // 3 vertices per triangle
+	const int* pTriangleFaces = nullptr;
+	size_t nTriangles = 0;
+	const int* pWeightVertices = nullptr;
+	const int* pWeightGroups = nullptr;
+	const float* pWeights = nullptr;
+	size_t nWeights = 0;
+};
+
+struct DzFitSettings
+{
+	float fFitRatio = 1.0f;
+	float fDistanceCutoff = 10.0f;
+	int nPass1Iterations = 200;
+	int nPass2Iterations = 5;
+	// tagged vertices (moves undone because they flipped a face or poked through) are not moved again by pass 1
+	bool bLockTaggedVertices = true;
+	bool bCheckSelfPokeThrough = true;
+	int nGroups = 0;
+};
+
+struct DzFitStats
+{
+	int nPass1Iterations = 0;
+	int nPass2Iterations = 0;
+	size_t nMovedVertices = 0;
+	size_t nMovedFaces = 0;
+	size_t nFlipReverts = 0;
+	size_t nPokeThroughReverts = 0;
+	size_t nTaggedVertices = 0;
+	bool bAborted = false;
+};
+
+/*****************************
+DzClothFitter
+
+Clothing auto-fit of the Game Readiness tools (autofit_mesh in
+game_readiness_tools.py), on DzTriangleBvh ray casts instead of Python
+Object.ray_cast() calls.
+
+Pass 1 moves every clothing vertex along its normal onto the body, if the
+body face it hits shares a vertex group with it and faces the same way;
+the vertex group weight and normal thresholds relax a little with every
+iteration.  Pass 2 casts from the body vertices back onto the clothing and
+moves the clothing faces they hit.  After every iteration, moves that
+flipped a face or pushed a vertex through another part of the clothing
+are undone and their vertices tagged.  If a face is still flipped, the fit
+stops with the positions of the previous iteration.
+
+The vertex groups of both meshes are compared as bitsets, rebuilt when
+the weight threshold changes.  The rays of each iteration are cast in
+parallel, only pass 2 applies its moves in vertex order.
+*****************************/
+class DzClothFitter
+{
+public:
+	// aPositions receives the fitted clothing positions, aTagged 1 for every tagged vertex.
+	// Returns false on invalid input (indices out of range).
+	static bool Fit(const DzFitMesh& source, const DzFitMesh& target, const DzFitSettings& settings,
+		std::vector<float>& aPositions, std::vector<uint8_t>& aTagged, DzFitStats* pStats = nullptr);
+};
@@ -0,0 +1,144 @@
+#include <string.h>
+
+#include "DzContentHash.h"
+
+namespace
+{
+	const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+	const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+	const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+	const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+	const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+	inline uint64_t rotl(uint64_t nValue, int nBits)
+	{
+		return (nValue << nBits) | (nValue >> (64 - nBits));
+	}
+
+	// little endian loads regardless of alignment
+	inline uint64_t read64(const uint8_t* p)
+	{
+		return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+			((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+	}
+
+	inline uint32_t read32(const uint8_t* p)
+	{
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	inline uint64_t round(uint64_t nAccumulator, uint64_t nInput)
+	{
+		nAccumulator += nInput * kPrime2;
+		nAccumulator = rotl(nAccumulator, 31);
+		return nAccumulator * kPrime1;
+	}
+
+	inline uint64_t mergeRound(uint64_t nAccumulator, uint64_t nValue)
+	{
+		nAccumulator ^= round(0, nValue);
+		return nAccumulator * kPrime1 + kPrime4;
+	}
+
+	inline void processStripe(uint64_t* aAccumulators, const uint8_t* p)
+	{
+		aAccumulators[0] = round(aAccumulators[0], read64(p));
+		aAccumulators[1] = round(aAccumulators[1], read64(p + 8));
+		aAccumulators[2] = round(aAccumulators[2], read64(p + 16));
+		aAccumulators[3] = round(aAccumulators[3], read64(p + 24));
+	}
+}
+
+DzContentHash::DzContentHash(uint64_t nSeed)
+{
+	reset(nSeed);
+}
+
+void DzContentHash::reset(uint64_t nSeed)
+{
+	m_nSeed = nSeed;
+	m_aAccumulators[0] = nSeed + kPrime1 + kPrime2;
+	m_aAccumulators[1] = nSeed + kPrime2;
+	m_aAccumulators[2] = nSeed;
+	m_aAccumulators[3] = nSeed - kPrime1;
+	m_nBufferSize = 0;
+	m_nTotalSize = 0;
+}
+
+void DzContentHash::update(const void* pData, size_t nSize)
+{
+	const uint8_t* p = (const uint8_t*)pData;
+	m_nTotalSize += nSize;
+
+	if (m_nBufferSize + nSize < 32) {
+		memcpy(m_aBuffer + m_nBufferSize, p, nSize);
+		m_nBufferSize += nSize;
+		return;
+	}
+	if (m_nBufferSize > 0) {
+		size_t nFill = 32 - m_nBufferSize;
+		memcpy(m_aBuffer + m_nBufferSize, p, nFill);
+		processStripe(m_aAccumulators, m_aBuffer);
+		p += nFill;
+		nSize -= nFill;
+		m_nBufferSize = 0;
+	}
+	while (nSize >= 32) {
+		processStripe(m_aAccumulators, p);
+		p += 32;
+		nSize -= 32;
+	}
+	if (nSize > 0) {
+		memcpy(m_aBuffer, p, nSize);
+		m_nBufferSize = nSize;
+	}
+}
+
+uint64_t DzContentHash::finish() const
+{
+	uint64_t nHash;
+	if (m_nTotalSize >= 32) {
+		const uint64_t* a = m_aAccumulators;
+		nHash = rotl(a[0], 1) + rotl(a[1], 7) + rotl(a[2], 12) + rotl(a[3], 18);
+		nHash = mergeRound(nHash, a[0]);
+		nHash = mergeRound(nHash, a[1]);
+		nHash = mergeRound(nHash, a[2]);
+		nHash = mergeRound(nHash, a[3]);
+	}
+	else {
+		nHash = m_nSeed + kPrime5;
+	}
+	nHash += m_nTotalSize;
+
+	const uint8_t* p = m_aBuffer;
+	const uint8_t* pEnd = m_aBuffer + m_nBufferSize;
+	while (p + 8 <= pEnd) {
+		nHash ^= round(0, read64(p));
+		nHash = rotl(nHash, 27) * kPrime1 + kPrime4;
+		p += 8;
+	}
+	if (p + 4 <= pEnd) {
+		nHash ^= (uint64_t)read32(p) * kPrime1;
+		nHash = rotl(nHash, 23) * kPrime2 + kPrime3;
+		p += 4;
+	}
+	while (p < pEnd) {
+		nHash ^= (*p) * kPrime5;
+		nHash = rotl(nHash, 11) * kPrime1;
+		p++;
+	}
+
+	nHash ^= nHash >> 33;
+	nHash *= kPrime2;
+	nHash ^= nHash >> 29;
+	nHash *= kPrime3;
+	nHash ^= nHash >> 32;
+	return nHash;
+}
+
+uint64_t DzContentHash::Hash(const void* pData, size_t nSize, uint64_t nSeed)
+{
+	DzContentHash hash(nSeed);
+	hash.update(pData, nSize);
+	return hash.finish();
+}
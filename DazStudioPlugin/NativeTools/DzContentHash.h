@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************
+DzContentHash
+
+Streaming 64-bit XXH64 hash, used to find texture files with identical
+contents.  Runs at memory bandwidth, so hashing is limited by file reads.
+Data is pushed with update() in pieces of any size, finish() returns the
+hash of everything pushed so far and can be called more than once.
+*****************************/
+class DzContentHash
+{
+public:
+	DzContentHash(uint64_t nSeed = 0);
+
+	void reset(uint64_t nSeed = 0);
+	void update(const void* pData, size_t nSize);
+	uint64_t finish() const;
+
+	static uint64_t Hash(const void* pData, size_t nSize, uint64_t nSeed = 0);
+
+protected:
+	uint64_t m_aAccumulators[4];
+	uint8_t m_aBuffer[32];
+	size_t m_nBufferSize = 0;
+	uint64_t m_nTotalSize = 0;
+	uint64_t m_nSeed = 0;
+};
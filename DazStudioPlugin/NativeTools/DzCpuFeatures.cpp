@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "DzCpuFeatures.h"
+#include "DzImageKernels.h"
+
+#if DZ_NATIVETOOLS_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+#if DZ_NATIVETOOLS_X86
+	void cpuid(int nLeaf, int nSubLeaf, unsigned int aRegisters[4])
+	{
+#if defined(_MSC_VER)
+		int aInfo[4];
+		__cpuidex(aInfo, nLeaf, nSubLeaf);
+		for (int i = 0; i < 4; i++) aRegisters[i] = (unsigned int)aInfo[i];
+#else
+		__cpuid_count(nLeaf, nSubLeaf, aRegisters[0], aRegisters[1], aRegisters[2], aRegisters[3]);
+#endif
+	}
+
+	unsigned long long xgetbv0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int nEax, nEdx;
+		__asm__ volatile("xgetbv" : "=a"(nEax), "=d"(nEdx) : "c"(0));
+		return ((unsigned long long)nEdx << 32) | nEax;
+#endif
+	}
+#endif
+
+	DzCpuFeatures::SimdLevel detectSimdLevel()
+	{
+#if DZ_NATIVETOOLS_X86
+		unsigned int aRegisters[4];
+		cpuid(0, 0, aRegisters);
+		unsigned int nMaxLeaf = aRegisters[0];
+		if (nMaxLeaf < 1) {
+			return DzCpuFeatures::Scalar;
+		}
+		cpuid(1, 0, aRegisters);
+		bool bSSE41 = (aRegisters[2] & (1u << 19)) != 0;
+		bool bOSXSAVE = (aRegisters[2] & (1u << 27)) != 0;
+		bool bAVX = (aRegisters[2] & (1u << 28)) != 0;
+		bool bFMA = (aRegisters[2] & (1u << 12)) != 0;
+		if (bSSE41 == false) {
+			return DzCpuFeatures::Scalar;
+		}
+		// AVX state must be enabled by the OS, not just supported by the CPU
+		if (nMaxLeaf >= 7 && bOSXSAVE && bAVX && bFMA && (xgetbv0() & 0x6) == 0x6) {
+			cpuid(7, 0, aRegisters);
+			bool bAVX2 = (aRegisters[1] & (1u << 5)) != 0;
+			if (bAVX2) {
+				return DzCpuFeatures::AVX2;
+			}
+		}
+		return DzCpuFeatures::SSE41;
+#else
+		return DzCpuFeatures::Scalar;
+#endif
+	}
+
+	DzCpuFeatures::SimdLevel initialSimdLevel()
+	{
+		DzCpuFeatures::SimdLevel eLevel = DzCpuFeatures::GetSupportedSimdLevel();
+		const char* sOverride = getenv("DZ_NATIVETOOLS_SIMD");
+		DzCpuFeatures::SimdLevel eOverride;
+		if (sOverride && DzCpuFeatures::ParseSimdLevelName(sOverride, eOverride) && eOverride < eLevel) {
+			eLevel = eOverride;
+		}
+		return eLevel;
+	}
+
+	std::atomic<int>& currentSimdLevel()
+	{
+		static std::atomic<int> nLevel(initialSimdLevel());
+		return nLevel;
+	}
+}
+
+DzCpuFeatures::SimdLevel DzCpuFeatures::GetSupportedSimdLevel()
+{
+	static SimdLevel eSupported = detectSimdLevel();
+	return eSupported;
+}
+
+DzCpuFeatures::SimdLevel DzCpuFeatures::GetSimdLevel()
+{
+	return (SimdLevel)currentSimdLevel().load();
+}
+
+DzCpuFeatures::SimdLevel DzCpuFeatures::SetSimdLevel(SimdLevel eLevel)
+{
+	if (eLevel > GetSupportedSimdLevel()) {
+		eLevel = GetSupportedSimdLevel();
+	}
+	currentSimdLevel().store(eLevel);
+	return eLevel;
+}
+
+const char* DzCpuFeatures::GetSimdLevelName(SimdLevel eLevel)
+{
+	switch (eLevel) {
+	case AVX2:
+		return "avx2";
+	case SSE41:
+		return "sse4.1";
+	default:
+		return "scalar";
+	}
+}
+
+bool DzCpuFeatures::ParseSimdLevelName(const char* sName, SimdLevel& eLevel)
+{
+	if (sName == nullptr) {
+		return false;
+	}
+	if (strcmp(sName, "avx2") == 0) {
+		eLevel = AVX2;
+	}
+	else if (strcmp(sName, "sse4.1") == 0 || strcmp(sName, "sse41") == 0) {
+		eLevel = SSE41;
+	}
+	else if (strcmp(sName, "scalar") == 0) {
+		eLevel = Scalar;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
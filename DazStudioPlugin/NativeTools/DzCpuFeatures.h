@@ -0,0 +1,30 @@
+#pragma once
+
+/*****************************
+DzCpuFeatures
+
+Runtime detection of the SIMD instruction sets used by the native kernels.
+The level used can be lowered for testing and benchmarking, either with
+setSimdLevel() or with the DZ_NATIVETOOLS_SIMD environment variable
+("scalar", "sse4.1" or "avx2").
+*****************************/
+class DzCpuFeatures
+{
+public:
+	enum SimdLevel {
+		Scalar = 0,
+		SSE41 = 1,
+		AVX2 = 2
+	};
+
+	// Highest level supported by this CPU and operating system
+	static SimdLevel GetSupportedSimdLevel();
+	// Level currently used by the kernel dispatch
+	static SimdLevel GetSimdLevel();
+	// Returns the level actually set, which is never higher than the supported level
+	static SimdLevel SetSimdLevel(SimdLevel eLevel);
+
+	static const char* GetSimdLevelName(SimdLevel eLevel);
+	// Returns false if sName is not a known level
+	static bool ParseSimdLevelName(const char* sName, SimdLevel& eLevel);
+};
@@ -0,0 +1,895 @@
+#include <string.h>
+#include <algorithm>
+#include <queue>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "DzDeflate.h"
+
+namespace
+{
+	const int kWindowSize = 32768;
+	const int kWindowMask = kWindowSize - 1;
+	const int kMinMatch = 3;
+	const int kMaxMatch = 258;
+	const int kMinLookahead = kMaxMatch + kMinMatch + 1;
+	const int kHashBits = 15;
+	const int kHashSize = 1 << kHashBits;
+	const size_t kMaxTokensPerBlock = 16384;
+	const size_t kOutputChunk = 65536;
+	const size_t kInputChunk = 65536;
+	const int kFastBits = 10;
+
+	const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	// per compression level: hash chain length, match length that stops the search, index every matched position
+	struct LevelSettings {
+		int nMaxChain;
+		int nNiceMatch;
+		bool bIndexMatches;
+	};
+	const LevelSettings kLevels[10] = {
+		{ 0, 0, false },
+		{ 4, 16, false },
+		{ 8, 32, false },
+		{ 16, 32, false },
+		{ 32, 64, true },
+		{ 64, 128, true },
+		{ 128, 128, true },
+		{ 256, 258, true },
+		{ 1024, 258, true },
+		{ 4096, 258, true },
+	};
+	const uint8_t kCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	struct CodeTables
+	{
+		uint8_t aLengthCode[kMaxMatch + 1];
+		uint8_t aDistanceCode[kWindowSize + 1];
+		uint32_t aCrc[256];
+
+		CodeTables()
+		{
+			for (int nCode = 0; nCode < 29; nCode++) {
+				int nEnd = nCode == 28 ? kMaxMatch + 1 : kLengthBase[nCode + 1];
+				for (int nLength = kLengthBase[nCode]; nLength < nEnd; nLength++) {
+					aLengthCode[nLength] = (uint8_t)nCode;
+				}
+			}
+			// 258 has its own code even though 227 + 31 would also cover it
+			aLengthCode[kMaxMatch] = 28;
+			for (int nCode = 0; nCode < 30; nCode++) {
+				int nEnd = nCode == 29 ? kWindowSize + 1 : kDistanceBase[nCode + 1];
+				for (int nDistance = kDistanceBase[nCode]; nDistance < nEnd; nDistance++) {
+					aDistanceCode[nDistance] = (uint8_t)nCode;
+				}
+			}
+			for (uint32_t n = 0; n < 256; n++) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++) {
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				aCrc[n] = c;
+			}
+		}
+	};
+
+	const CodeTables& getCodeTables()
+	{
+		static const CodeTables oTables;
+		return oTables;
+	}
+
+	inline int countTrailingZeros(uint64_t nValue)
+	{
+#if defined(_MSC_VER)
+		unsigned long nIndex;
+		_BitScanForward64(&nIndex, nValue);
+		return (int)nIndex;
+#else
+		return __builtin_ctzll(nValue);
+#endif
+	}
+
+	// number of equal leading bytes, compared 8 bytes at a time (little-endian)
+	inline int matchLength(const uint8_t* pA, const uint8_t* pB, int nMaxLength)
+	{
+		int nLength = 0;
+		while (nLength + 8 <= nMaxLength) {
+			uint64_t nA, nB;
+			memcpy(&nA, pA + nLength, 8);
+			memcpy(&nB, pB + nLength, 8);
+			uint64_t nDifference = nA ^ nB;
+			if (nDifference != 0) {
+				return nLength + (countTrailingZeros(nDifference) >> 3);
+			}
+			nLength += 8;
+		}
+		while (nLength < nMaxLength && pA[nLength] == pB[nLength]) {
+			nLength++;
+		}
+		return nLength;
+	}
+
+	uint32_t reverseBits(uint32_t nCode, int nLength)
+	{
+		uint32_t nResult = 0;
+		for (int i = 0; i < nLength; i++) {
+			nResult = (nResult << 1) | (nCode & 1);
+			nCode >>= 1;
+		}
+		return nResult;
+	}
+
+	// Huffman code lengths limited to nMaxLength.  Frequencies are halved until the tree fits.
+	void buildCodeLengths(const uint32_t* pFrequencies, int nSymbols, int nMaxLength, uint8_t* pLengths)
+	{
+		std::vector<uint32_t> aFrequencies(pFrequencies, pFrequencies + nSymbols);
+		memset(pLengths, 0, nSymbols);
+		for (;;) {
+			std::vector<int> aUsed;
+			for (int i = 0; i < nSymbols; i++) {
+				if (aFrequencies[i] > 0) aUsed.push_back(i);
+			}
+			if (aUsed.empty()) {
+				return;
+			}
+			if (aUsed.size() == 1) {
+				pLengths[aUsed[0]] = 1;
+				return;
+			}
+			int nLeaves = (int)aUsed.size();
+			std::vector<int> aParent(nLeaves * 2 - 1, -1);
+			typedef std::pair<uint64_t, int> Node;
+			std::priority_queue<Node, std::vector<Node>, std::greater<Node> > queue;
+			for (int i = 0; i < nLeaves; i++) {
+				queue.push(Node(aFrequencies[aUsed[i]], i));
+			}
+			int nNext = nLeaves;
+			while (queue.size() > 1) {
+				Node a = queue.top(); queue.pop();
+				Node b = queue.top(); queue.pop();
+				aParent[a.second] = nNext;
+				aParent[b.second] = nNext;
+				queue.push(Node(a.first + b.first, nNext));
+				nNext++;
+			}
+			// parents are always created after their children, so depths resolve from the root down
+			std::vector<int> aDepth(nNext, 0);
+			int nMaxDepth = 0;
+			for (int nNode = nNext - 2; nNode >= 0; nNode--) {
+				aDepth[nNode] = aDepth[aParent[nNode]] + 1;
+				if (nNode < nLeaves) nMaxDepth = std::max(nMaxDepth, aDepth[nNode]);
+			}
+			if (nMaxDepth <= nMaxLength) {
+				for (int i = 0; i < nLeaves; i++) {
+					pLengths[aUsed[i]] = (uint8_t)aDepth[i];
+				}
+				return;
+			}
+			for (int i = 0; i < nLeaves; i++) {
+				aFrequencies[aUsed[i]] = (aFrequencies[aUsed[i]] + 1) / 2;
+			}
+		}
+	}
+
+	// Canonical codes, bit-reversed for the LSB-first deflate bit order
+	void buildCodes(const uint8_t* pLengths, int nSymbols, uint32_t* pCodes)
+	{
+		int aCount[16] = { 0 };
+		for (int i = 0; i < nSymbols; i++) aCount[pLengths[i]]++;
+		aCount[0] = 0;
+		uint32_t aNextCode[16] = { 0 };
+		uint32_t nCode = 0;
+		for (int nBits = 1; nBits < 16; nBits++) {
+			nCode = (nCode + aCount[nBits - 1]) << 1;
+			aNextCode[nBits] = nCode;
+		}
+		for (int i = 0; i < nSymbols; i++) {
+			int nLength = pLengths[i];
+			pCodes[i] = nLength ? reverseBits(aNextCode[nLength]++, nLength) : 0;
+		}
+	}
+}
+
+uint32_t DzCrc32(uint32_t nCrc, const uint8_t* pData, size_t nSize)
+{
+	const uint32_t* pTable = getCodeTables().aCrc;
+	nCrc = ~nCrc;
+	for (size_t i = 0; i < nSize; i++) {
+		nCrc = pTable[(nCrc ^ pData[i]) & 0xff] ^ (nCrc >> 8);
+	}
+	return ~nCrc;
+}
+
+uint32_t DzAdler32(uint32_t nAdler, const uint8_t* pData, size_t nSize)
+{
+	uint32_t nA = nAdler & 0xffff;
+	uint32_t nB = nAdler >> 16;
+	while (nSize > 0) {
+		// 5552 is the largest block that can not overflow 32 bits before the modulo
+		size_t nBlock = std::min(nSize, (size_t)5552);
+		nSize -= nBlock;
+		for (size_t i = 0; i < nBlock; i++) {
+			nA += pData[i];
+			nB += nA;
+		}
+		pData += nBlock;
+		nA %= 65521;
+		nB %= 65521;
+	}
+	return (nB << 16) | nA;
+}
+
+uint32_t DzAdler32Combine(uint32_t nAdler1, uint32_t nAdler2, uint64_t nSize2)
+{
+	const uint32_t nBase = 65521;
+	uint32_t nRemainder = (uint32_t)(nSize2 % nBase);
+	uint32_t nA = nAdler1 & 0xffff;
+	uint32_t nB = (nRemainder * nA) % nBase;
+	nA += (nAdler2 & 0xffff) + nBase - 1;
+	nB += (nAdler1 >> 16) + (nAdler2 >> 16) + nBase - nRemainder;
+	if (nA >= nBase) nA -= nBase;
+	if (nA >= nBase) nA -= nBase;
+	if (nB >= nBase * 2) nB -= nBase * 2;
+	if (nB >= nBase) nB -= nBase;
+	return (nB << 16) | nA;
+}
+
+///////////////////////////////
+// DzDeflater
+///////////////////////////////
+
+DzDeflater::DzDeflater(OutputFunction fnOutput, int nLevel) :
+	m_fnOutput(fnOutput),
+	m_aWindow(kWindowSize * 2),
+	m_aHead(kHashSize, -1),
+	m_aPrev(kWindowSize, -1)
+{
+	const LevelSettings& level = kLevels[std::max(0, std::min(9, nLevel))];
+	m_nMaxChain = level.nMaxChain;
+	m_nNiceMatch = level.nNiceMatch;
+	m_bIndexMatches = level.bIndexMatches;
+	m_aTokens.reserve(kMaxTokensPerBlock);
+	m_aOutput.reserve(kOutputChunk + 1024);
+}
+
+void DzDeflater::setSegment(bool bLastSegment)
+{
+	m_bSegment = true;
+	m_bLastSegment = bLastSegment;
+	m_bHeaderWritten = true;
+}
+
+void DzDeflater::setDictionary(const uint8_t* pData, size_t nSize)
+{
+	if (nSize > (size_t)kWindowSize) {
+		pData += nSize - kWindowSize;
+		nSize = kWindowSize;
+	}
+	memcpy(m_aWindow.data(), pData, nSize);
+	m_nWindowEnd = nSize;
+	if (m_nMaxChain > 0) {
+		for (size_t i = 0; i < nSize; i++) {
+			insertHash(i);
+		}
+	}
+	m_nPos = nSize;
+}
+
+size_t DzDeflater::getMemoryBytes() const
+{
+	return m_aWindow.capacity() + (m_aHead.capacity() + m_aPrev.capacity()) * sizeof(int32_t) +
+		m_aTokens.capacity() * sizeof(Token) + m_aOutput.capacity();
+}
+
+void DzDeflater::write(const uint8_t* pData, size_t nSize)
+{
+	if (m_bHeaderWritten == false) {
+		// CMF: deflate with a 32K window, FLG: default compression, check bits
+		m_aOutput.push_back(0x78);
+		m_aOutput.push_back(0x9c);
+		m_bHeaderWritten = true;
+	}
+	m_nAdler = DzAdler32(m_nAdler, pData, nSize);
+	while (nSize > 0) {
+		if (m_nWindowEnd == m_aWindow.size()) {
+			compress(false);
+			slideWindow();
+		}
+		size_t nCopy = std::min(nSize, m_aWindow.size() - m_nWindowEnd);
+		memcpy(m_aWindow.data() + m_nWindowEnd, pData, nCopy);
+		m_nWindowEnd += nCopy;
+		pData += nCopy;
+		nSize -= nCopy;
+	}
+}
+
+void DzDeflater::finish()
+{
+	if (m_bFinished) {
+		return;
+	}
+	if (m_bHeaderWritten == false) {
+		write(nullptr, 0);
+	}
+	compress(true);
+	if (m_bSegment) {
+		emitBlock(m_bLastSegment);
+		if (m_bLastSegment == false) {
+			// empty stored block, the sync flush marker that byte-aligns the end of the segment
+			writeBits(0, 3);
+			flushBits();
+			m_aOutput.push_back(0x00);
+			m_aOutput.push_back(0x00);
+			m_aOutput.push_back(0xff);
+			m_aOutput.push_back(0xff);
+		}
+		flushBits();
+		flushOutput();
+		m_bFinished = true;
+		return;
+	}
+	emitBlock(true);
+	flushBits();
+	m_aOutput.push_back((uint8_t)(m_nAdler >> 24));
+	m_aOutput.push_back((uint8_t)(m_nAdler >> 16));
+	m_aOutput.push_back((uint8_t)(m_nAdler >> 8));
+	m_aOutput.push_back((uint8_t)m_nAdler);
+	flushOutput();
+	m_bFinished = true;
+}
+
+void DzDeflater::slideWindow()
+{
+	if (m_nPos < (size_t)kWindowSize) {
+		return;
+	}
+	memmove(m_aWindow.data(), m_aWindow.data() + kWindowSize, m_nWindowEnd - kWindowSize);
+	m_nWindowEnd -= kWindowSize;
+	m_nPos -= kWindowSize;
+	for (size_t i = 0; i < m_aHead.size(); i++) {
+		m_aHead[i] = m_aHead[i] >= kWindowSize ? m_aHead[i] - kWindowSize : -1;
+	}
+	for (size_t i = 0; i < m_aPrev.size(); i++) {
+		m_aPrev[i] = m_aPrev[i] >= kWindowSize ? m_aPrev[i] - kWindowSize : -1;
+	}
+}
+
+inline static uint32_t hashAt(const uint8_t* p)
+{
+	return (((uint32_t)p[0] << 10) ^ ((uint32_t)p[1] << 5) ^ p[2]) & (kHashSize - 1);
+}
+
+void DzDeflater::insertHash(size_t nPos)
+{
+	if (nPos + kMinMatch > m_nWindowEnd) {
+		return;
+	}
+	uint32_t nHash = hashAt(m_aWindow.data() + nPos);
+	m_aPrev[nPos & kWindowMask] = m_aHead[nHash];
+	m_aHead[nHash] = (int32_t)nPos;
+}
+
+int DzDeflater::findMatch(size_t nPos, int& nDistance)
+{
+	size_t nAvailable = m_nWindowEnd - nPos;
+	if (nAvailable < (size_t)kMinMatch) {
+		return 0;
+	}
+	int nMaxLength = (int)std::min(nAvailable, (size_t)kMaxMatch);
+	const uint8_t* pCurrent = m_aWindow.data() + nPos;
+	int32_t nCandidate = m_aHead[hashAt(pCurrent)];
+	int nBestLength = 0;
+	int nChain = m_nMaxChain;
+	while (nCandidate >= 0 && nChain-- > 0) {
+		if ((int32_t)nPos - nCandidate > kWindowSize) {
+			break;
+		}
+		const uint8_t* pCandidate = m_aWindow.data() + nCandidate;
+		if (pCandidate[nBestLength] == pCurrent[nBestLength] && pCandidate[0] == pCurrent[0] && pCandidate[1] == pCurrent[1]) {
+			int nLength = matchLength(pCandidate, pCurrent, nMaxLength);
+			if (nLength > nBestLength) {
+				nBestLength = nLength;
+				nDistance = (int)(nPos - nCandidate);
+				if (nLength >= nMaxLength || nLength >= m_nNiceMatch) {
+					break;
+				}
+			}
+		}
+		int32_t nNext = m_aPrev[nCandidate & kWindowMask];
+		if (nNext >= nCandidate) {
+			break;
+		}
+		nCandidate = nNext;
+	}
+	return nBestLength >= kMinMatch ? nBestLength : 0;
+}
+
+void DzDeflater::compress(bool bFlush)
+{
+	for (;;) {
+		size_t nAvailable = m_nWindowEnd - m_nPos;
+		if (nAvailable == 0 || (!bFlush && nAvailable < (size_t)kMinLookahead)) {
+			break;
+		}
+		int nDistance = 0;
+		int nLength = m_nMaxChain > 0 ? findMatch(m_nPos, nDistance) : 0;
+		Token token;
+		if (nLength > 0) {
+			token.nLiteralOrLength = (uint16_t)nLength;
+			token.nDistance = (uint16_t)nDistance;
+			int nIndexed = m_bIndexMatches ? nLength : 1;
+			for (int i = 0; i < nIndexed; i++) {
+				insertHash(m_nPos + i);
+			}
+			m_nPos += nLength;
+		}
+		else {
+			token.nLiteralOrLength = m_aWindow[m_nPos];
+			token.nDistance = 0;
+			if (m_nMaxChain > 0) {
+				insertHash(m_nPos);
+			}
+			m_nPos++;
+		}
+		m_aTokens.push_back(token);
+		if (m_aTokens.size() >= kMaxTokensPerBlock) {
+			emitBlock(false);
+		}
+	}
+}
+
+void DzDeflater::emitBlock(bool bFinal)
+{
+	const CodeTables& tables = getCodeTables();
+
+	uint32_t aLiteralFrequencies[286] = { 0 };
+	uint32_t aDistanceFrequencies[30] = { 0 };
+	for (size_t i = 0; i < m_aTokens.size(); i++) {
+		const Token& token = m_aTokens[i];
+		if (token.nDistance == 0) {
+			aLiteralFrequencies[token.nLiteralOrLength]++;
+		}
+		else {
+			aLiteralFrequencies[257 + tables.aLengthCode[token.nLiteralOrLength]]++;
+			aDistanceFrequencies[tables.aDistanceCode[token.nDistance]]++;
+		}
+	}
+	aLiteralFrequencies[256] = 1;
+	// at least two codes in each tree keeps every decoder happy
+	if (aLiteralFrequencies[0] == 0) aLiteralFrequencies[0] = 1;
+	int nUsedDistances = 0;
+	for (int i = 0; i < 30; i++) nUsedDistances += aDistanceFrequencies[i] ? 1 : 0;
+	if (nUsedDistances < 2) {
+		if (aDistanceFrequencies[0] == 0) aDistanceFrequencies[0] = 1;
+		else aDistanceFrequencies[1] = 1;
+	}
+
+	uint8_t aLiteralLengths[286];
+	uint8_t aDistanceLengths[30];
+	buildCodeLengths(aLiteralFrequencies, 286, 15, aLiteralLengths);
+	buildCodeLengths(aDistanceFrequencies, 30, 15, aDistanceLengths);
+	uint32_t aLiteralCodes[286];
+	uint32_t aDistanceCodes[30];
+	buildCodes(aLiteralLengths, 286, aLiteralCodes);
+	buildCodes(aDistanceLengths, 30, aDistanceCodes);
+
+	int nLiteralCount = 286;
+	while (nLiteralCount > 257 && aLiteralLengths[nLiteralCount - 1] == 0) nLiteralCount--;
+	int nDistanceCount = 30;
+	while (nDistanceCount > 1 && aDistanceLengths[nDistanceCount - 1] == 0) nDistanceCount--;
+
+	// run-length encode the combined code length sequence with symbols 16, 17 and 18
+	std::vector<uint8_t> aAllLengths(aLiteralLengths, aLiteralLengths + nLiteralCount);
+	aAllLengths.insert(aAllLengths.end(), aDistanceLengths, aDistanceLengths + nDistanceCount);
+	std::vector<std::pair<uint8_t, uint8_t> > aRunSymbols; // symbol, extra bits value
+	uint32_t aCodeLengthFrequencies[19] = { 0 };
+	for (size_t i = 0; i < aAllLengths.size();) {
+		uint8_t nLength = aAllLengths[i];
+		size_t nRun = 1;
+		while (i + nRun < aAllLengths.size() && aAllLengths[i + nRun] == nLength) nRun++;
+		if (nLength == 0 && nRun >= 3) {
+			size_t nTake = std::min(nRun, (size_t)138);
+			if (nTake >= 11) aRunSymbols.push_back(std::make_pair((uint8_t)18, (uint8_t)(nTake - 11)));
+			else aRunSymbols.push_back(std::make_pair((uint8_t)17, (uint8_t)(nTake - 3)));
+			i += nTake;
+		}
+		else if (nLength != 0 && nRun >= 4) {
+			aRunSymbols.push_back(std::make_pair(nLength, (uint8_t)0));
+			size_t nTake = std::min(nRun - 1, (size_t)6);
+			aRunSymbols.push_back(std::make_pair((uint8_t)16, (uint8_t)(nTake - 3)));
+			i += 1 + nTake;
+		}
+		else {
+			aRunSymbols.push_back(std::make_pair(nLength, (uint8_t)0));
+			i++;
+		}
+	}
+	for (size_t i = 0; i < aRunSymbols.size(); i++) {
+		aCodeLengthFrequencies[aRunSymbols[i].first]++;
+	}
+	uint8_t aCodeLengthLengths[19];
+	uint32_t aCodeLengthCodes[19];
+	buildCodeLengths(aCodeLengthFrequencies, 19, 7, aCodeLengthLengths);
+	buildCodes(aCodeLengthLengths, 19, aCodeLengthCodes);
+	int nCodeLengthCount = 19;
+	while (nCodeLengthCount > 4 && aCodeLengthLengths[kCodeLengthOrder[nCodeLengthCount - 1]] == 0) nCodeLengthCount--;
+
+	writeBits(bFinal ? 1 : 0, 1);
+	writeBits(2, 2);
+	writeBits(nLiteralCount - 257, 5);
+	writeBits(nDistanceCount - 1, 5);
+	writeBits(nCodeLengthCount - 4, 4);
+	for (int i = 0; i < nCodeLengthCount; i++) {
+		writeBits(aCodeLengthLengths[kCodeLengthOrder[i]], 3);
+	}
+	for (size_t i = 0; i < aRunSymbols.size(); i++) {
+		uint8_t nSymbol = aRunSymbols[i].first;
+		writeBits(aCodeLengthCodes[nSymbol], aCodeLengthLengths[nSymbol]);
+		if (nSymbol == 16) writeBits(aRunSymbols[i].second, 2);
+		else if (nSymbol == 17) writeBits(aRunSymbols[i].second, 3);
+		else if (nSymbol == 18) writeBits(aRunSymbols[i].second, 7);
+	}
+
+	for (size_t i = 0; i < m_aTokens.size(); i++) {
+		const Token& token = m_aTokens[i];
+		if (token.nDistance == 0) {
+			writeBits(aLiteralCodes[token.nLiteralOrLength], aLiteralLengths[token.nLiteralOrLength]);
+			continue;
+		}
+		int nLengthCode = tables.aLengthCode[token.nLiteralOrLength];
+		writeBits(aLiteralCodes[257 + nLengthCode], aLiteralLengths[257 + nLengthCode]);
+		if (kLengthExtra[nLengthCode]) {
+			writeBits(token.nLiteralOrLength - kLengthBase[nLengthCode], kLengthExtra[nLengthCode]);
+		}
+		int nDistanceCode = tables.aDistanceCode[token.nDistance];
+		writeBits(aDistanceCodes[nDistanceCode], aDistanceLengths[nDistanceCode]);
+		if (kDistanceExtra[nDistanceCode]) {
+			writeBits(token.nDistance - kDistanceBase[nDistanceCode], kDistanceExtra[nDistanceCode]);
+		}
+	}
+	writeBits(aLiteralCodes[256], aLiteralLengths[256]);
+	m_aTokens.clear();
+
+	if (m_aOutput.size() >= kOutputChunk) {
+		flushOutput();
+	}
+}
+
+void DzDeflater::writeBits(uint32_t nBits, int nCount)
+{
+	m_nBitBuffer |= (uint64_t)nBits << m_nBitCount;
+	m_nBitCount += nCount;
+	while (m_nBitCount >= 8) {
+		m_aOutput.push_back((uint8_t)m_nBitBuffer);
+		m_nBitBuffer >>= 8;
+		m_nBitCount -= 8;
+	}
+}
+
+void DzDeflater::flushBits()
+{
+	if (m_nBitCount > 0) {
+		m_aOutput.push_back((uint8_t)m_nBitBuffer);
+	}
+	m_nBitBuffer = 0;
+	m_nBitCount = 0;
+}
+
+void DzDeflater::flushOutput()
+{
+	if (m_aOutput.empty() == false) {
+		m_fnOutput(m_aOutput.data(), m_aOutput.size());
+		m_aOutput.clear();
+	}
+}
+
+///////////////////////////////
+// DzInflater
+///////////////////////////////
+
+DzInflater::DzInflater(InputFunction fnInput) :
+	m_fnInput(fnInput),
+	m_aInput(kInputChunk),
+	m_aWindow(kWindowSize)
+{
+}
+
+size_t DzInflater::getMemoryBytes() const
+{
+	return m_aInput.capacity() + m_aWindow.capacity() +
+		(m_oLiteralTable.aFast.capacity() + m_oLiteralTable.aSymbols.capacity() +
+			m_oDistanceTable.aFast.capacity() + m_oDistanceTable.aSymbols.capacity()) * sizeof(uint16_t);
+}
+
+bool DzInflater::needBits(int nCount)
+{
+	while (m_nBitCount < nCount) {
+		if (m_nInputPos == m_nInputSize) {
+			if (m_bInputEnd) {
+				return false;
+			}
+			m_nInputSize = m_fnInput(m_aInput.data(), m_aInput.size());
+			m_nInputPos = 0;
+			if (m_nInputSize == 0) {
+				m_bInputEnd = true;
+				return false;
+			}
+		}
+		// refill as much as fits, so that most calls return without touching the input
+		while (m_nBitCount <= 56 && m_nInputPos < m_nInputSize) {
+			m_nBitBuffer |= (uint64_t)m_aInput[m_nInputPos++] << m_nBitCount;
+			m_nBitCount += 8;
+		}
+	}
+	return true;
+}
+
+uint32_t DzInflater::getBits(int nCount)
+{
+	if (nCount == 0) {
+		return 0;
+	}
+	if (needBits(nCount) == false) {
+		m_bError = true;
+		return 0;
+	}
+	uint32_t nValue = (uint32_t)(m_nBitBuffer & ((1ull << nCount) - 1));
+	m_nBitBuffer >>= nCount;
+	m_nBitCount -= nCount;
+	return nValue;
+}
+
+bool DzInflater::buildTable(HuffmanTable& table, const uint8_t* pLengths, int nSymbols)
+{
+	memset(table.aCount, 0, sizeof(table.aCount));
+	for (int i = 0; i < nSymbols; i++) {
+		table.aCount[pLengths[i]]++;
+	}
+	table.aCount[0] = 0;
+	int nLeft = 1;
+	for (int nLength = 1; nLength < 16; nLength++) {
+		nLeft <<= 1;
+		nLeft -= table.aCount[nLength];
+		if (nLeft < 0) {
+			return false; // over-subscribed
+		}
+	}
+	uint16_t aOffsets[16];
+	aOffsets[1] = 0;
+	for (int nLength = 1; nLength < 15; nLength++) {
+		aOffsets[nLength + 1] = aOffsets[nLength] + table.aCount[nLength];
+	}
+	table.aSymbols.assign(nSymbols, 0);
+	for (int i = 0; i < nSymbols; i++) {
+		if (pLengths[i] != 0) {
+			table.aSymbols[aOffsets[pLengths[i]]++] = (uint16_t)i;
+		}
+	}
+
+	table.aFast.assign(1 << kFastBits, 0);
+	uint32_t nCode = 0;
+	int nIndex = 0;
+	for (int nLength = 1; nLength <= kFastBits; nLength++) {
+		for (int i = 0; i < table.aCount[nLength]; i++) {
+			uint32_t nReversed = reverseBits(nCode, nLength);
+			uint16_t nEntry = (uint16_t)((table.aSymbols[nIndex] << 4) | nLength);
+			for (uint32_t nFill = nReversed; nFill < (1u << kFastBits); nFill += (1u << nLength)) {
+				table.aFast[nFill] = nEntry;
+			}
+			nCode++;
+			nIndex++;
+		}
+		nCode <<= 1;
+	}
+	return true;
+}
+
+int DzInflater::decodeSymbol(const HuffmanTable& table)
+{
+	needBits(kFastBits); // may come up short at the end of the stream, which is fine for short codes
+	uint16_t nEntry = table.aFast[m_nBitBuffer & ((1u << kFastBits) - 1)];
+	int nEntryLength = nEntry & 0xf;
+	if (nEntry != 0 && nEntryLength <= m_nBitCount) {
+		m_nBitBuffer >>= nEntryLength;
+		m_nBitCount -= nEntryLength;
+		return nEntry >> 4;
+	}
+	// canonical decode one bit at a time for long codes
+	int nCode = 0;
+	int nFirst = 0;
+	int nIndex = 0;
+	for (int nLength = 1; nLength < 16; nLength++) {
+		nCode |= (int)getBits(1);
+		if (m_bError) {
+			return -1;
+		}
+		int nCount = table.aCount[nLength];
+		if (nCode - nCount < nFirst) {
+			return table.aSymbols[nIndex + (nCode - nFirst)];
+		}
+		nIndex += nCount;
+		nFirst += nCount;
+		nFirst <<= 1;
+		nCode <<= 1;
+	}
+	m_bError = true;
+	return -1;
+}
+
+bool DzInflater::readDynamicTables()
+{
+	int nLiteralCount = (int)getBits(5) + 257;
+	int nDistanceCount = (int)getBits(5) + 1;
+	int nCodeLengthCount = (int)getBits(4) + 4;
+	if (m_bError || nLiteralCount > 286 || nDistanceCount > 30) {
+		return false;
+	}
+	uint8_t aCodeLengthLengths[19] = { 0 };
+	for (int i = 0; i < nCodeLengthCount; i++) {
+		aCodeLengthLengths[kCodeLengthOrder[i]] = (uint8_t)getBits(3);
+	}
+	HuffmanTable codeLengthTable;
+	if (m_bError || buildTable(codeLengthTable, aCodeLengthLengths, 19) == false) {
+		return false;
+	}
+	uint8_t aLengths[286 + 30] = { 0 };
+	int nTotal = nLiteralCount + nDistanceCount;
+	for (int i = 0; i < nTotal;) {
+		int nSymbol = decodeSymbol(codeLengthTable);
+		if (nSymbol < 0) {
+			return false;
+		}
+		if (nSymbol < 16) {
+			aLengths[i++] = (uint8_t)nSymbol;
+			continue;
+		}
+		int nRepeat = 0;
+		uint8_t nValue = 0;
+		if (nSymbol == 16) {
+			if (i == 0) return false;
+			nValue = aLengths[i - 1];
+			nRepeat = 3 + (int)getBits(2);
+		}
+		else if (nSymbol == 17) {
+			nRepeat = 3 + (int)getBits(3);
+		}
+		else {
+			nRepeat = 11 + (int)getBits(7);
+		}
+		if (m_bError || i + nRepeat > nTotal) {
+			return false;
+		}
+		while (nRepeat-- > 0) aLengths[i++] = nValue;
+	}
+	if (aLengths[256] == 0) {
+		return false;
+	}
+	return buildTable(m_oLiteralTable, aLengths, nLiteralCount) &&
+		buildTable(m_oDistanceTable, aLengths + nLiteralCount, nDistanceCount);
+}
+
+bool DzInflater::readBlockHeader()
+{
+	m_bFinalBlock = getBits(1) != 0;
+	uint32_t nType = getBits(2);
+	if (m_bError) {
+		return false;
+	}
+	if (nType == 0) {
+		// stored: skip to the byte boundary, then LEN and NLEN
+		getBits(m_nBitCount & 7);
+		uint32_t nLength = getBits(16);
+		uint32_t nInverse = getBits(16);
+		if (m_bError || (nLength ^ 0xffff) != nInverse) {
+			return false;
+		}
+		m_nStoredRemaining = nLength;
+		m_eState = Stored;
+		return true;
+	}
+	if (nType == 1) {
+		uint8_t aLengths[288 + 30];
+		for (int i = 0; i < 144; i++) aLengths[i] = 8;
+		for (int i = 144; i < 256; i++) aLengths[i] = 9;
+		for (int i = 256; i < 280; i++) aLengths[i] = 7;
+		for (int i = 280; i < 288; i++) aLengths[i] = 8;
+		for (int i = 288; i < 288 + 30; i++) aLengths[i] = 5;
+		if (buildTable(m_oLiteralTable, aLengths, 288) == false || buildTable(m_oDistanceTable, aLengths + 288, 30) == false) {
+			return false;
+		}
+		m_eState = Huffman;
+		return true;
+	}
+	if (nType == 2 && readDynamicTables()) {
+		m_eState = Huffman;
+		return true;
+	}
+	return false;
+}
+
+inline void DzInflater::outputByte(uint8_t nByte, uint8_t* pBuffer, size_t& nProduced)
+{
+	m_aWindow[m_nWindowPos & kWindowMask] = nByte;
+	m_nWindowPos++;
+	pBuffer[nProduced++] = nByte;
+}
+
+size_t DzInflater::read(uint8_t* pBuffer, size_t nSize)
+{
+	size_t nProduced = 0;
+	while (nProduced < nSize && m_bError == false) {
+		if (m_nCopyLength > 0) {
+			while (m_nCopyLength > 0 && nProduced < nSize) {
+				outputByte(m_aWindow[(m_nWindowPos - m_nCopyDistance) & kWindowMask], pBuffer, nProduced);
+				m_nCopyLength--;
+			}
+			continue;
+		}
+		if (m_eState == ZlibHeader) {
+			uint32_t nCmf = getBits(8);
+			uint32_t nFlg = getBits(8);
+			if (m_bError || (nCmf & 0x0f) != 8 || ((nCmf << 8) | nFlg) % 31 != 0 || (nFlg & 0x20)) {
+				m_bError = true;
+				break;
+			}
+			m_eState = BlockHeader;
+		}
+		else if (m_eState == BlockHeader) {
+			if (readBlockHeader() == false) {
+				m_bError = true;
+			}
+		}
+		else if (m_eState == Stored) {
+			while (m_nStoredRemaining > 0 && nProduced < nSize) {
+				uint8_t nByte = (uint8_t)getBits(8);
+				if (m_bError) break;
+				outputByte(nByte, pBuffer, nProduced);
+				m_nStoredRemaining--;
+			}
+			if (m_nStoredRemaining == 0) {
+				m_eState = m_bFinalBlock ? Done : BlockHeader;
+			}
+		}
+		else if (m_eState == Huffman) {
+			int nSymbol = decodeSymbol(m_oLiteralTable);
+			if (nSymbol < 0) {
+				m_bError = true;
+			}
+			else if (nSymbol < 256) {
+				outputByte((uint8_t)nSymbol, pBuffer, nProduced);
+			}
+			else if (nSymbol == 256) {
+				m_eState = m_bFinalBlock ? Done : BlockHeader;
+			}
+			else {
+				int nLengthCode = nSymbol - 257;
+				if (nLengthCode >= 29) {
+					m_bError = true;
+					break;
+				}
+				int nLength = kLengthBase[nLengthCode] + (int)getBits(kLengthExtra[nLengthCode]);
+				int nDistanceCode = decodeSymbol(m_oDistanceTable);
+				if (nDistanceCode < 0 || nDistanceCode >= 30) {
+					m_bError = true;
+					break;
+				}
+				int nDistance = kDistanceBase[nDistanceCode] + (int)getBits(kDistanceExtra[nDistanceCode]);
+				if (m_bError || (size_t)nDistance > m_nWindowPos) {
+					m_bError = true;
+					break;
+				}
+				m_nCopyLength = nLength;
+				m_nCopyDistance = nDistance;
+			}
+		}
+		else {
+			break;
+		}
+	}
+	return nProduced;
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+uint32_t DzCrc32(uint32_t nCrc, const uint8_t* pData, size_t nSize);
+uint32_t DzAdler32(uint32_t nAdler, const uint8_t* pData, size_t nSize);
+// Adler-32 of two consecutive pieces from the checksums of each piece
+uint32_t DzAdler32Combine(uint32_t nAdler1, uint32_t nAdler2, uint64_t nSize2);
+
+/*****************************
+DzDeflater
+
+Streaming zlib (RFC 1950/1951) compressor: 32K window LZ77 with hash chains and
+dynamic Huffman blocks.  Input is pushed with write(), compressed bytes are
+handed to fnOutput as they become available, so memory use is fixed
+regardless of the stream length.
+
+The compression level trades speed for size like zlib's: 0 is Huffman coding
+only, 1-3 search short hash chains and only index the start of each match,
+6 is the default and 9 searches the longest chains.  In segment mode the
+output is raw deflate without the zlib header and trailer, and a segment that
+is not the last one ends on a byte boundary, so that segments compressed
+independently (in parallel) can be concatenated into one stream.
+*****************************/
+class DzDeflater
+{
+public:
+	typedef std::function<void(const uint8_t* pData, size_t nSize)> OutputFunction;
+
+	DzDeflater(OutputFunction fnOutput, int nLevel = 6);
+
+	// Raw deflate output for one piece of a larger stream, must be called before the first write
+	void setSegment(bool bLastSegment);
+	// Lets matches refer to the last 32K of data preceding this segment, must be called before the first write
+	void setDictionary(const uint8_t* pData, size_t nSize);
+
+	void write(const uint8_t* pData, size_t nSize);
+	// Compresses any buffered input and writes the final block and zlib trailer
+	void finish();
+
+	// Adler-32 of the data written so far
+	uint32_t getAdler() const { return m_nAdler; }
+
+	size_t getMemoryBytes() const;
+
+protected:
+	struct Token {
+		uint16_t nLiteralOrLength;
+		uint16_t nDistance; // 0 for literals
+	};
+
+	void compress(bool bFlush);
+	void slideWindow();
+	void insertHash(size_t nPos);
+	int findMatch(size_t nPos, int& nDistance);
+	void emitBlock(bool bFinal);
+	void writeBits(uint32_t nBits, int nCount);
+	void flushBits();
+	void flushOutput();
+
+	OutputFunction m_fnOutput;
+	std::vector<uint8_t> m_aWindow;
+	std::vector<int32_t> m_aHead;
+	std::vector<int32_t> m_aPrev;
+	size_t m_nWindowEnd = 0;
+	size_t m_nPos = 0;
+	int m_nMaxChain = 128;
+	int m_nNiceMatch = 128;
+	bool m_bIndexMatches = true;
+	bool m_bSegment = false;
+	bool m_bLastSegment = true;
+
+	std::vector<Token> m_aTokens;
+	uint32_t m_nAdler = 1;
+	bool m_bHeaderWritten = false;
+	bool m_bFinished = false;
+
+	uint64_t m_nBitBuffer = 0;
+	int m_nBitCount = 0;
+	std::vector<uint8_t> m_aOutput;
+};
+
+/*****************************
+DzInflater
+
+Streaming zlib decompressor.  Compressed bytes are pulled from fnInput on
+demand, decompressed bytes are returned by read() in caller-sized pieces,
+so only the 32K history window is kept in memory.
+*****************************/
+class DzInflater
+{
+public:
+	// Returns the number of bytes copied into pBuffer, 0 at end of input
+	typedef std::function<size_t(uint8_t* pBuffer, size_t nSize)> InputFunction;
+
+	DzInflater(InputFunction fnInput);
+
+	// Returns the number of bytes produced.  Less than nSize means end of stream or error.
+	size_t read(uint8_t* pBuffer, size_t nSize);
+	bool hasError() const { return m_bError; }
+	bool isFinished() const { return m_eState == Done; }
+
+	size_t getMemoryBytes() const;
+
+protected:
+	enum State {
+		ZlibHeader,
+		BlockHeader,
+		Stored,
+		Huffman,
+		Done
+	};
+
+	struct HuffmanTable {
+		// fast lookup: (symbol << 4) | length for codes up to kFastBits long, 0 if longer
+		std::vector<uint16_t> aFast;
+		uint16_t aCount[16];
+		std::vector<uint16_t> aSymbols;
+	};
+
+	bool needBits(int nCount);
+	uint32_t getBits(int nCount);
+	bool buildTable(HuffmanTable& table, const uint8_t* pLengths, int nSymbols);
+	int decodeSymbol(const HuffmanTable& table);
+	bool readBlockHeader();
+	bool readDynamicTables();
+	void outputByte(uint8_t nByte, uint8_t* pBuffer, size_t& nProduced);
+
+	InputFunction m_fnInput;
+	std::vector<uint8_t> m_aInput;
+	size_t m_nInputPos = 0;
+	size_t m_nInputSize = 0;
+	bool m_bInputEnd = false;
+
+	uint64_t m_nBitBuffer = 0;
+	int m_nBitCount = 0;
+
+	State m_eState = ZlibHeader;
+	bool m_bFinalBlock = false;
+	bool m_bError = false;
+	size_t m_nStoredRemaining = 0;
+	int m_nCopyLength = 0;
+	int m_nCopyDistance = 0;
+
+	HuffmanTable m_oLiteralTable;
+	HuffmanTable m_oDistanceTable;
+
+	std::vector<uint8_t> m_aWindow;
+	size_t m_nWindowPos = 0;
+};
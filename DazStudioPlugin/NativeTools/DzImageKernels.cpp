@@ -0,0 +1,291 @@
+#include <math.h>
+#include <algorithm>
+
+#include "DzImageKernels.h"
+#include "DzCpuFeatures.h"
+
+namespace
+{
+	inline uint32_t meanRgb(uint32_t nPixel)
+	{
+		uint32_t nSum = ((nPixel >> 16) & 0xff) + ((nPixel >> 8) & 0xff) + (nPixel & 0xff);
+		// round(nSum / 3), exact for nSum <= 765, and the same formula the SIMD kernels use
+		return ((nSum + 1) * 21846) >> 16;
+	}
+
+	inline uint32_t luminance709(uint32_t nPixel)
+	{
+		// round(0.2126 R + 0.7152 G + 0.0722 B), weights in 1/256 summing to 256
+		return (54 * ((nPixel >> 16) & 0xff) + 183 * ((nPixel >> 8) & 0xff) + 19 * (nPixel & 0xff) + 128) >> 8;
+	}
+
+	inline uint32_t multiplyChannel(uint32_t nA, uint32_t nB)
+	{
+		// round(nA * nB / 255)
+		uint32_t nProduct = nA * nB + 128;
+		return (nProduct + (nProduct >> 8)) >> 8;
+	}
+
+	void combineColorAndAlphaScalar(uint32_t* pDst, const uint32_t* pColor, const uint32_t* pAlpha, size_t nPixels)
+	{
+		for (size_t i = 0; i < nPixels; i++) {
+			pDst[i] = (pColor[i] & 0x00ffffff) | (meanRgb(pAlpha[i]) << 24);
+		}
+	}
+
+	void multiplyByColorScalar(uint32_t* pPixels, size_t nPixels, uint32_t nColor)
+	{
+		uint32_t nR = (nColor >> 16) & 0xff;
+		uint32_t nG = (nColor >> 8) & 0xff;
+		uint32_t nB = nColor & 0xff;
+		for (size_t i = 0; i < nPixels; i++) {
+			uint32_t nPixel = pPixels[i];
+			pPixels[i] = (nPixel & 0xff000000) |
+				(multiplyChannel((nPixel >> 16) & 0xff, nR) << 16) |
+				(multiplyChannel((nPixel >> 8) & 0xff, nG) << 8) |
+				multiplyChannel(nPixel & 0xff, nB);
+		}
+	}
+
+	inline void lookupRgb(uint32_t* pPixels, size_t nPixels, const uint8_t* pTable)
+	{
+		for (size_t i = 0; i < nPixels; i++) {
+			uint32_t nPixel = pPixels[i];
+			pPixels[i] = (nPixel & 0xff000000) |
+				((uint32_t)pTable[(nPixel >> 16) & 0xff] << 16) |
+				((uint32_t)pTable[(nPixel >> 8) & 0xff] << 8) |
+				(uint32_t)pTable[nPixel & 0xff];
+		}
+	}
+
+	// A 256 entry table beats any arithmetic for 8-bit input, so every SIMD level uses these
+	void srgbToLinearScalar(uint32_t* pPixels, size_t nPixels)
+	{
+		lookupRgb(pPixels, nPixels, DzImageKernels::GetSrgbToLinearTable());
+	}
+
+	void linearToSrgbScalar(uint32_t* pPixels, size_t nPixels)
+	{
+		lookupRgb(pPixels, nPixels, DzImageKernels::GetLinearToSrgbTable());
+	}
+
+	void intensityToAlphaF32Scalar(float* pDst, const float* pSrc, size_t nPixels)
+	{
+		const float fOneThird = 1.0f / 3.0f;
+		for (size_t i = 0; i < nPixels; i++) {
+			const float* pPixel = pSrc + i * 4;
+			pDst[i * 4 + 3] = (pPixel[0] + pPixel[1] + pPixel[2]) * fOneThird;
+		}
+	}
+
+	template <float (*fnConvert)(float)>
+	void convertF32Scalar(float* pData, size_t nPixels, int nChannels)
+	{
+		bool bHasAlpha = (nChannels == 2 || nChannels == 4);
+		int nColorChannels = bHasAlpha ? nChannels - 1 : nChannels;
+		for (size_t i = 0; i < nPixels; i++) {
+			float* pPixel = pData + i * nChannels;
+			for (int c = 0; c < nColorChannels; c++) {
+				pPixel[c] = fnConvert(pPixel[c]);
+			}
+		}
+	}
+
+	bool fillTable(uint8_t* pTable, float (*fnConvert)(float))
+	{
+		for (int i = 0; i < 256; i++) {
+			float fValue = fnConvert(i / 255.0f) * 255.0f + 0.5f;
+			pTable[i] = (uint8_t)(fValue < 0.0f ? 0 : fValue > 255.0f ? 255 : fValue);
+		}
+		return true;
+	}
+}
+
+float DzImageKernels::SrgbToLinearScalar(float fValue)
+{
+	if (fValue <= 0.04045f) {
+		return fValue / 12.92f;
+	}
+	return powf((fValue + 0.055f) / 1.055f, 2.4f);
+}
+
+float DzImageKernels::LinearToSrgbScalar(float fValue)
+{
+	if (fValue <= 0.0031308f) {
+		return fValue * 12.92f;
+	}
+	return 1.055f * powf(fValue, 1.0f / 2.4f) - 0.055f;
+}
+
+const uint8_t* DzImageKernels::GetSrgbToLinearTable()
+{
+	static uint8_t aTable[256];
+	static bool bFilled = fillTable(aTable, SrgbToLinearScalar);
+	(void)bFilled;
+	return aTable;
+}
+
+const uint8_t* DzImageKernels::GetLinearToSrgbTable()
+{
+	static uint8_t aTable[256];
+	static bool bFilled = fillTable(aTable, LinearToSrgbScalar);
+	(void)bFilled;
+	return aTable;
+}
+
+const DzImageKernelTable& DzGetScalarKernels()
+{
+	static const DzImageKernelTable oTable = {
+		combineColorAndAlphaScalar,
+		multiplyByColorScalar,
+		srgbToLinearScalar,
+		linearToSrgbScalar,
+		intensityToAlphaF32Scalar,
+		convertF32Scalar<DzImageKernels::SrgbToLinearScalar>,
+		convertF32Scalar<DzImageKernels::LinearToSrgbScalar>
+	};
+	return oTable;
+}
+
+const DzImageKernelTable& DzImageKernels::GetKernels(int nSimdLevel)
+{
+#if DZ_NATIVETOOLS_X86
+	if (nSimdLevel >= DzCpuFeatures::AVX2) {
+		return DzGetAVX2Kernels();
+	}
+	if (nSimdLevel >= DzCpuFeatures::SSE41) {
+		return DzGetSSE41Kernels();
+	}
+#endif
+	return DzGetScalarKernels();
+}
+
+const DzImageKernelTable& DzImageKernels::GetKernels()
+{
+	return GetKernels(DzCpuFeatures::GetSimdLevel());
+}
+
+void DzImageKernels::CombineColorAndAlpha(uint32_t* pDst, const uint32_t* pColor, const uint32_t* pAlpha, size_t nPixels)
+{
+	GetKernels().CombineColorAndAlpha(pDst, pColor, pAlpha, nPixels);
+}
+
+void DzImageKernels::IntensityToAlpha(uint32_t* pDst, const uint32_t* pSrc, size_t nPixels)
+{
+	GetKernels().CombineColorAndAlpha(pDst, pDst, pSrc, nPixels);
+}
+
+void DzImageKernels::PackLuminanceChannels(uint32_t* pDst, const uint32_t* const apSources[3], const uint8_t aConstants[3], size_t nPixels)
+{
+	const uint32_t* pRed = apSources[0];
+	const uint32_t* pGreen = apSources[1];
+	const uint32_t* pBlue = apSources[2];
+	uint32_t nRed = aConstants[0];
+	uint32_t nGreen = aConstants[1];
+	uint32_t nBlue = aConstants[2];
+	// the destination may alias any source, every source pixel is read before the destination pixel is written
+	for (size_t i = 0; i < nPixels; i++) {
+		if (pRed) nRed = luminance709(pRed[i]);
+		if (pGreen) nGreen = luminance709(pGreen[i]);
+		if (pBlue) nBlue = luminance709(pBlue[i]);
+		pDst[i] = 0xff000000 | (nRed << 16) | (nGreen << 8) | nBlue;
+	}
+}
+
+void DzImageKernels::AccumulateStatistics(const uint32_t* pPixels, size_t nPixels, DzImageStatistics& stats)
+{
+	uint32_t aMin[4] = { stats.aMin[0], stats.aMin[1], stats.aMin[2], stats.aMin[3] };
+	uint32_t aMax[4] = { stats.aMax[0], stats.aMax[1], stats.aMax[2], stats.aMax[3] };
+	uint32_t nMaxChroma = stats.nMaxChroma;
+	// 32 bit sums cannot overflow within a block of 2^24 pixels
+	const size_t kBlockPixels = (size_t)1 << 24;
+	for (size_t nBlock = 0; nBlock < nPixels; nBlock += kBlockPixels) {
+		size_t nEnd = nBlock + kBlockPixels < nPixels ? nBlock + kBlockPixels : nPixels;
+		uint32_t aSum[4] = { 0, 0, 0, 0 };
+		for (size_t i = nBlock; i < nEnd; i++) {
+			uint32_t nPixel = pPixels[i];
+			uint32_t aValues[4] = { (nPixel >> 16) & 0xff, (nPixel >> 8) & 0xff, nPixel & 0xff, nPixel >> 24 };
+			for (int c = 0; c < 4; c++) {
+				aMin[c] = aValues[c] < aMin[c] ? aValues[c] : aMin[c];
+				aMax[c] = aValues[c] > aMax[c] ? aValues[c] : aMax[c];
+				aSum[c] += aValues[c];
+			}
+			uint32_t nLow = std::min(aValues[0], std::min(aValues[1], aValues[2]));
+			uint32_t nHigh = std::max(aValues[0], std::max(aValues[1], aValues[2]));
+			nMaxChroma = nHigh - nLow > nMaxChroma ? nHigh - nLow : nMaxChroma;
+		}
+		for (int c = 0; c < 4; c++) {
+			stats.aSum[c] += aSum[c];
+		}
+	}
+	for (int c = 0; c < 4; c++) {
+		stats.aMin[c] = (uint8_t)aMin[c];
+		stats.aMax[c] = (uint8_t)aMax[c];
+	}
+	stats.nMaxChroma = (uint8_t)nMaxChroma;
+	stats.nPixels += nPixels;
+}
+
+void DzImageKernels::MultiplyByColor(uint32_t* pPixels, size_t nPixels, uint32_t nColor)
+{
+	GetKernels().MultiplyByColor(pPixels, nPixels, nColor);
+}
+
+void DzImageKernels::SrgbToLinear(uint32_t* pPixels, size_t nPixels)
+{
+	GetKernels().SrgbToLinear(pPixels, nPixels);
+}
+
+void DzImageKernels::LinearToSrgb(uint32_t* pPixels, size_t nPixels)
+{
+	GetKernels().LinearToSrgb(pPixels, nPixels);
+}
+
+void DzImageKernels::IntensityToAlphaF32(float* pDst, const float* pSrc, size_t nPixels)
+{
+	GetKernels().IntensityToAlphaF32(pDst, pSrc, nPixels);
+}
+
+void DzImageKernels::SrgbToLinearF32(float* pData, size_t nPixels, int nChannels)
+{
+	if (nChannels < 1 || nChannels > 4) {
+		return;
+	}
+	GetKernels().SrgbToLinearF32(pData, nPixels, nChannels);
+}
+
+void DzImageKernels::LinearToSrgbF32(float* pData, size_t nPixels, int nChannels)
+{
+	if (nChannels < 1 || nChannels > 4) {
+		return;
+	}
+	GetKernels().LinearToSrgbF32(pData, nPixels, nChannels);
+}
+
+///////////////////////////////
+// DzImageStatistics
+///////////////////////////////
+
+void DzImageStatistics::merge(const DzImageStatistics& other)
+{
+	for (int c = 0; c < 4; c++) {
+		aMin[c] = std::min(aMin[c], other.aMin[c]);
+		aMax[c] = std::max(aMax[c], other.aMax[c]);
+		aSum[c] += other.aSum[c];
+	}
+	nPixels += other.nPixels;
+	nMaxChroma = std::max(nMaxChroma, other.nMaxChroma);
+}
+
+bool DzImageStatistics::isConstant(int nTolerance) const
+{
+	if (nPixels == 0) {
+		return false;
+	}
+	for (int c = 0; c < 4; c++) {
+		if (aMax[c] - aMin[c] > nTolerance) {
+			return false;
+		}
+	}
+	return true;
+}
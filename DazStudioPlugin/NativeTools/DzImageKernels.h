@@ -0,0 +1,94 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DZ_NATIVETOOLS_X86 1
+#else
+#define DZ_NATIVETOOLS_X86 0
+#endif
+
+// Function table for one SIMD level.  Pixels are 32-bit 0xAARRGGBB words,
+// the same layout as QImage::Format_ARGB32.  Float images are interleaved,
+// the same layout as Blender's Image.pixels.
+struct DzImageKernelTable
+{
+	void (*CombineColorAndAlpha)(uint32_t* pDst, const uint32_t* pColor, const uint32_t* pAlpha, size_t nPixels);
+	void (*MultiplyByColor)(uint32_t* pPixels, size_t nPixels, uint32_t nColor);
+	void (*SrgbToLinear)(uint32_t* pPixels, size_t nPixels);
+	void (*LinearToSrgb)(uint32_t* pPixels, size_t nPixels);
+	void (*IntensityToAlphaF32)(float* pDst, const float* pSrc, size_t nPixels);
+	void (*SrgbToLinearF32)(float* pData, size_t nPixels, int nChannels);
+	void (*LinearToSrgbF32)(float* pData, size_t nPixels, int nChannels);
+};
+
+// Per channel statistics of 8-bit pixels, channels in R, G, B, A order.  Partial results of
+// strips or threads are combined with merge().
+struct DzImageStatistics
+{
+	uint8_t aMin[4] = { 255, 255, 255, 255 };
+	uint8_t aMax[4] = { 0, 0, 0, 0 };
+	uint64_t aSum[4] = { 0, 0, 0, 0 };
+	uint64_t nPixels = 0;
+	// largest difference between the R, G and B of one pixel
+	uint8_t nMaxChroma = 0;
+
+	void merge(const DzImageStatistics& other);
+	double getMean(int nChannel) const { return nPixels ? (double)aSum[nChannel] / nPixels : 0.0; }
+	bool usesAlpha() const { return nPixels > 0 && aMin[3] < 255; }
+	bool isGrayscale(int nTolerance) const { return nMaxChroma <= nTolerance; }
+	// every channel, alpha included, stays within nTolerance of its minimum
+	bool isConstant(int nTolerance) const;
+};
+
+/*****************************
+DzImageKernels
+
+Per-pixel texture operations with SSE4.1 and AVX2 implementations chosen at
+runtime (see DzCpuFeatures) and a scalar fallback.  Every kernel is
+single-threaded; callers parallelize across images or rows.
+
+The 8-bit kernels return exactly the same result at every SIMD level.  The
+float sRGB conversions use a polynomial pow() at the SIMD levels, which stays
+within 2e-6 of the scalar result for values in [0,1].
+*****************************/
+class DzImageKernels
+{
+public:
+	// Color RGB from pColor, alpha = mean(R,G,B) of pAlpha.  Any of the buffers may alias.
+	static void CombineColorAndAlpha(uint32_t* pDst, const uint32_t* pColor, const uint32_t* pAlpha, size_t nPixels);
+	// Alpha of pDst = mean(R,G,B) of pSrc
+	static void IntensityToAlpha(uint32_t* pDst, const uint32_t* pSrc, size_t nPixels);
+	// Multiplies RGB by the RGB of nColor (0xRRGGBB), rounding to nearest.  Alpha is preserved.
+	static void MultiplyByColor(uint32_t* pPixels, size_t nPixels, uint32_t nColor);
+	// R, G and B of pDst = Rec.709 luminance of apSources[0], [1] and [2], or aConstants[i] where apSources[i] is null.
+	// Alpha is 255.  Used to pack occlusion, roughness and metallic maps into one texture.
+	static void PackLuminanceChannels(uint32_t* pDst, const uint32_t* const apSources[3], const uint8_t aConstants[3], size_t nPixels);
+	// Adds nPixels pixels to stats
+	static void AccumulateStatistics(const uint32_t* pPixels, size_t nPixels, DzImageStatistics& stats);
+	// 8-bit RGB conversions, alpha is preserved
+	static void SrgbToLinear(uint32_t* pPixels, size_t nPixels);
+	static void LinearToSrgb(uint32_t* pPixels, size_t nPixels);
+
+	// Float RGBA: alpha of pDst = mean(R,G,B) of pSrc
+	static void IntensityToAlphaF32(float* pDst, const float* pSrc, size_t nPixels);
+	// Float conversions on 1 to 4 interleaved channels.  With 2 or 4 channels the last one is alpha and is preserved.
+	static void SrgbToLinearF32(float* pData, size_t nPixels, int nChannels);
+	static void LinearToSrgbF32(float* pData, size_t nPixels, int nChannels);
+
+	// Table for the current SIMD level, or for a specific one (falls back to scalar if not compiled in)
+	static const DzImageKernelTable& GetKernels();
+	static const DzImageKernelTable& GetKernels(int nSimdLevel);
+
+	static float SrgbToLinearScalar(float fValue);
+	static float LinearToSrgbScalar(float fValue);
+	static const uint8_t* GetSrgbToLinearTable();
+	static const uint8_t* GetLinearToSrgbTable();
+};
+
+// Implemented in the per-instruction-set translation units
+const DzImageKernelTable& DzGetScalarKernels();
+#if DZ_NATIVETOOLS_X86
+const DzImageKernelTable& DzGetSSE41Kernels();
+const DzImageKernelTable& DzGetAVX2Kernels();
+#endif
@@ -0,0 +1,175 @@
+// Compiled with AVX2 and FMA enabled (see CMakeLists.txt).  Only called when DzCpuFeatures reports AVX2.
+#include "DzImageKernels.h"
+
+#if DZ_NATIVETOOLS_X86
+#include <immintrin.h>
+
+namespace
+{
+	void combineColorAndAlphaAVX2(uint32_t* pDst, const uint32_t* pColor, const uint32_t* pAlpha, size_t nPixels)
+	{
+		const __m256i vByteMask = _mm256_set1_epi32(0xff);
+		const __m256i vRgbMask = _mm256_set1_epi32(0x00ffffff);
+		const __m256i vOne = _mm256_set1_epi32(1);
+		const __m256i vOneThird = _mm256_set1_epi32(21846);
+		size_t i = 0;
+		for (; i + 8 <= nPixels; i += 8) {
+			__m256i vColor = _mm256_loadu_si256((const __m256i*)(pColor + i));
+			__m256i vAlpha = _mm256_loadu_si256((const __m256i*)(pAlpha + i));
+			__m256i vSum = _mm256_add_epi32(
+				_mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(vAlpha, 16), vByteMask), _mm256_and_si256(_mm256_srli_epi32(vAlpha, 8), vByteMask)),
+				_mm256_and_si256(vAlpha, vByteMask));
+			__m256i vMean = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_add_epi32(vSum, vOne), vOneThird), 16);
+			__m256i vResult = _mm256_or_si256(_mm256_and_si256(vColor, vRgbMask), _mm256_slli_epi32(vMean, 24));
+			_mm256_storeu_si256((__m256i*)(pDst + i), vResult);
+		}
+		DzGetScalarKernels().CombineColorAndAlpha(pDst + i, pColor + i, pAlpha + i, nPixels - i);
+	}
+
+	inline __m256i multiplyChannels(__m256i vValues, __m256i vFactors)
+	{
+		const __m256i vHalf = _mm256_set1_epi16(128);
+		__m256i vProduct = _mm256_add_epi16(_mm256_mullo_epi16(vValues, vFactors), vHalf);
+		return _mm256_srli_epi16(_mm256_add_epi16(vProduct, _mm256_srli_epi16(vProduct, 8)), 8);
+	}
+
+	void multiplyByColorAVX2(uint32_t* pPixels, size_t nPixels, uint32_t nColor)
+	{
+		// little endian ARGB32 is B,G,R,A in memory, alpha is multiplied by 255 to keep it unchanged
+		const __m256i vFactors = _mm256_setr_epi16(
+			(short)(nColor & 0xff), (short)((nColor >> 8) & 0xff), (short)((nColor >> 16) & 0xff), 255,
+			(short)(nColor & 0xff), (short)((nColor >> 8) & 0xff), (short)((nColor >> 16) & 0xff), 255,
+			(short)(nColor & 0xff), (short)((nColor >> 8) & 0xff), (short)((nColor >> 16) & 0xff), 255,
+			(short)(nColor & 0xff), (short)((nColor >> 8) & 0xff), (short)((nColor >> 16) & 0xff), 255);
+		const __m256i vZero = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 8 <= nPixels; i += 8) {
+			__m256i vPixels = _mm256_loadu_si256((const __m256i*)(pPixels + i));
+			__m256i vLow = multiplyChannels(_mm256_unpacklo_epi8(vPixels, vZero), vFactors);
+			__m256i vHigh = multiplyChannels(_mm256_unpackhi_epi8(vPixels, vZero), vFactors);
+			_mm256_storeu_si256((__m256i*)(pPixels + i), _mm256_packus_epi16(vLow, vHigh));
+		}
+		DzGetScalarKernels().MultiplyByColor(pPixels + i, nPixels - i, nColor);
+	}
+
+	void intensityToAlphaF32AVX2(float* pDst, const float* pSrc, size_t nPixels)
+	{
+		const __m256 vOneThird = _mm256_set1_ps(1.0f / 3.0f);
+		size_t i = 0;
+		// two pixels per register, one per 128-bit lane
+		for (; i + 2 <= nPixels; i += 2) {
+			__m256 vSrc = _mm256_loadu_ps(pSrc + i * 4);
+			// lane 0 = (R + G) + B, the same order as the scalar kernel
+			__m256 vSum = _mm256_add_ps(_mm256_add_ps(vSrc, _mm256_permute_ps(vSrc, _MM_SHUFFLE(3, 0, 2, 1))), _mm256_permute_ps(vSrc, _MM_SHUFFLE(3, 1, 0, 2)));
+			__m256 vMean = _mm256_mul_ps(vSum, vOneThird);
+			__m256 vDst = _mm256_loadu_ps(pDst + i * 4);
+			_mm256_storeu_ps(pDst + i * 4, _mm256_blend_ps(vDst, _mm256_permute_ps(vMean, 0), 0x88));
+		}
+		DzGetScalarKernels().IntensityToAlphaF32(pDst + i * 4, pSrc + i * 4, nPixels - i);
+	}
+
+	// log2(x) for x > 0, normalized mantissa in [sqrt(0.5), sqrt(2)) and an atanh series
+	inline __m256 log2AVX2(__m256 vX)
+	{
+		__m256i vBits = _mm256_castps_si256(vX);
+		__m256i vExponent = _mm256_sub_epi32(_mm256_srli_epi32(vBits, 23), _mm256_set1_epi32(127));
+		__m256 vMantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(vBits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+		__m256 vAbove = _mm256_cmp_ps(vMantissa, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+		vMantissa = _mm256_blendv_ps(vMantissa, _mm256_mul_ps(vMantissa, _mm256_set1_ps(0.5f)), vAbove);
+		vExponent = _mm256_sub_epi32(vExponent, _mm256_castps_si256(vAbove));
+		__m256 vT = _mm256_div_ps(_mm256_sub_ps(vMantissa, _mm256_set1_ps(1.0f)), _mm256_add_ps(vMantissa, _mm256_set1_ps(1.0f)));
+		__m256 vT2 = _mm256_mul_ps(vT, vT);
+		// 2 / (k * ln(2)) for k = 1, 3, 5, 7, 9
+		__m256 vPoly = _mm256_set1_ps(0.32059889f);
+		vPoly = _mm256_fmadd_ps(vPoly, vT2, _mm256_set1_ps(0.41219858f));
+		vPoly = _mm256_fmadd_ps(vPoly, vT2, _mm256_set1_ps(0.57707802f));
+		vPoly = _mm256_fmadd_ps(vPoly, vT2, _mm256_set1_ps(0.96179669f));
+		vPoly = _mm256_fmadd_ps(vPoly, vT2, _mm256_set1_ps(2.88539008f));
+		return _mm256_add_ps(_mm256_cvtepi32_ps(vExponent), _mm256_mul_ps(vPoly, vT));
+	}
+
+	// 2^x, split into an integer power and a Taylor series on [-0.5, 0.5]
+	inline __m256 exp2AVX2(__m256 vX)
+	{
+		vX = _mm256_min_ps(_mm256_max_ps(vX, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(127.0f));
+		__m256 vWhole = _mm256_round_ps(vX, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256 vFraction = _mm256_sub_ps(vX, vWhole);
+		// (ln 2)^k / k! for k = 6 .. 0
+		__m256 vPoly = _mm256_set1_ps(1.5403530e-4f);
+		vPoly = _mm256_fmadd_ps(vPoly, vFraction, _mm256_set1_ps(1.3333558e-3f));
+		vPoly = _mm256_fmadd_ps(vPoly, vFraction, _mm256_set1_ps(9.6181291e-3f));
+		vPoly = _mm256_fmadd_ps(vPoly, vFraction, _mm256_set1_ps(5.5504109e-2f));
+		vPoly = _mm256_fmadd_ps(vPoly, vFraction, _mm256_set1_ps(2.4022651e-1f));
+		vPoly = _mm256_fmadd_ps(vPoly, vFraction, _mm256_set1_ps(6.9314718e-1f));
+		vPoly = _mm256_fmadd_ps(vPoly, vFraction, _mm256_set1_ps(1.0f));
+		__m256i vScale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(vWhole), _mm256_set1_epi32(127)), 23);
+		return _mm256_mul_ps(vPoly, _mm256_castsi256_ps(vScale));
+	}
+
+	inline __m256 srgbToLinearAVX2(__m256 vX)
+	{
+		__m256 vLinear = _mm256_div_ps(vX, _mm256_set1_ps(12.92f));
+		__m256 vBase = _mm256_div_ps(_mm256_add_ps(vX, _mm256_set1_ps(0.055f)), _mm256_set1_ps(1.055f));
+		vBase = _mm256_max_ps(vBase, _mm256_set1_ps(1e-30f));
+		__m256 vCurve = exp2AVX2(_mm256_mul_ps(log2AVX2(vBase), _mm256_set1_ps(2.4f)));
+		return _mm256_blendv_ps(vCurve, vLinear, _mm256_cmp_ps(vX, _mm256_set1_ps(0.04045f), _CMP_LE_OQ));
+	}
+
+	inline __m256 linearToSrgbAVX2(__m256 vX)
+	{
+		__m256 vLinear = _mm256_mul_ps(vX, _mm256_set1_ps(12.92f));
+		__m256 vBase = _mm256_max_ps(vX, _mm256_set1_ps(1e-30f));
+		__m256 vCurve = exp2AVX2(_mm256_mul_ps(log2AVX2(vBase), _mm256_set1_ps(1.0f / 2.4f)));
+		vCurve = _mm256_sub_ps(_mm256_mul_ps(vCurve, _mm256_set1_ps(1.055f)), _mm256_set1_ps(0.055f));
+		return _mm256_blendv_ps(vCurve, vLinear, _mm256_cmp_ps(vX, _mm256_set1_ps(0.0031308f), _CMP_LE_OQ));
+	}
+
+	template <__m256 (*fnConvert)(__m256), float (*fnConvertScalar)(float), int nAlphaMask>
+	void convertF32AVX2(float* pData, size_t nPixels, int nChannels)
+	{
+		size_t nValues = nPixels * nChannels;
+		size_t i = 0;
+		for (; i + 8 <= nValues; i += 8) {
+			__m256 vValues = _mm256_loadu_ps(pData + i);
+			_mm256_storeu_ps(pData + i, _mm256_blend_ps(fnConvert(vValues), vValues, nAlphaMask));
+		}
+		bool bHasAlpha = (nAlphaMask != 0);
+		for (; i < nValues; i++) {
+			if (bHasAlpha && (int)(i % nChannels) == nChannels - 1) {
+				continue;
+			}
+			pData[i] = fnConvertScalar(pData[i]);
+		}
+	}
+
+	template <__m256 (*fnConvert)(__m256), float (*fnConvertScalar)(float)>
+	void convertChannelsF32AVX2(float* pData, size_t nPixels, int nChannels)
+	{
+		// every 8-value block starts on a pixel boundary for 1, 2 and 4 channels, so the alpha lanes are fixed
+		if (nChannels == 4) {
+			convertF32AVX2<fnConvert, fnConvertScalar, 0x88>(pData, nPixels, nChannels);
+		}
+		else if (nChannels == 2) {
+			convertF32AVX2<fnConvert, fnConvertScalar, 0xaa>(pData, nPixels, nChannels);
+		}
+		else {
+			convertF32AVX2<fnConvert, fnConvertScalar, 0x0>(pData, nPixels, nChannels);
+		}
+	}
+}
+
+const DzImageKernelTable& DzGetAVX2Kernels()
+{
+	static const DzImageKernelTable oTable = {
+		combineColorAndAlphaAVX2,
+		multiplyByColorAVX2,
+		DzGetScalarKernels().SrgbToLinear,
+		DzGetScalarKernels().LinearToSrgb,
+		intensityToAlphaF32AVX2,
+		convertChannelsF32AVX2<srgbToLinearAVX2, DzImageKernels::SrgbToLinearScalar>,
+		convertChannelsF32AVX2<linearToSrgbAVX2, DzImageKernels::LinearToSrgbScalar>
+	};
+	return oTable;
+}
+
+#endif
@@ -0,0 +1,170 @@
+// Compiled with SSE4.1 enabled (see CMakeLists.txt).  Only called when DzCpuFeatures reports SSE4.1.
+#include "DzImageKernels.h"
+
+#if DZ_NATIVETOOLS_X86
+#include <smmintrin.h>
+
+namespace
+{
+	void combineColorAndAlphaSSE41(uint32_t* pDst, const uint32_t* pColor, const uint32_t* pAlpha, size_t nPixels)
+	{
+		const __m128i vByteMask = _mm_set1_epi32(0xff);
+		const __m128i vRgbMask = _mm_set1_epi32(0x00ffffff);
+		const __m128i vOne = _mm_set1_epi32(1);
+		const __m128i vOneThird = _mm_set1_epi32(21846);
+		size_t i = 0;
+		for (; i + 4 <= nPixels; i += 4) {
+			__m128i vColor = _mm_loadu_si128((const __m128i*)(pColor + i));
+			__m128i vAlpha = _mm_loadu_si128((const __m128i*)(pAlpha + i));
+			__m128i vSum = _mm_add_epi32(
+				_mm_add_epi32(_mm_and_si128(_mm_srli_epi32(vAlpha, 16), vByteMask), _mm_and_si128(_mm_srli_epi32(vAlpha, 8), vByteMask)),
+				_mm_and_si128(vAlpha, vByteMask));
+			__m128i vMean = _mm_srli_epi32(_mm_mullo_epi32(_mm_add_epi32(vSum, vOne), vOneThird), 16);
+			__m128i vResult = _mm_or_si128(_mm_and_si128(vColor, vRgbMask), _mm_slli_epi32(vMean, 24));
+			_mm_storeu_si128((__m128i*)(pDst + i), vResult);
+		}
+		DzGetScalarKernels().CombineColorAndAlpha(pDst + i, pColor + i, pAlpha + i, nPixels - i);
+	}
+
+	inline __m128i multiplyChannels(__m128i vValues, __m128i vFactors)
+	{
+		const __m128i vHalf = _mm_set1_epi16(128);
+		__m128i vProduct = _mm_add_epi16(_mm_mullo_epi16(vValues, vFactors), vHalf);
+		return _mm_srli_epi16(_mm_add_epi16(vProduct, _mm_srli_epi16(vProduct, 8)), 8);
+	}
+
+	void multiplyByColorSSE41(uint32_t* pPixels, size_t nPixels, uint32_t nColor)
+	{
+		// little endian ARGB32 is B,G,R,A in memory, alpha is multiplied by 255 to keep it unchanged
+		const __m128i vFactors = _mm_setr_epi16(
+			(short)(nColor & 0xff), (short)((nColor >> 8) & 0xff), (short)((nColor >> 16) & 0xff), 255,
+			(short)(nColor & 0xff), (short)((nColor >> 8) & 0xff), (short)((nColor >> 16) & 0xff), 255);
+		const __m128i vZero = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= nPixels; i += 4) {
+			__m128i vPixels = _mm_loadu_si128((const __m128i*)(pPixels + i));
+			__m128i vLow = multiplyChannels(_mm_unpacklo_epi8(vPixels, vZero), vFactors);
+			__m128i vHigh = multiplyChannels(_mm_unpackhi_epi8(vPixels, vZero), vFactors);
+			_mm_storeu_si128((__m128i*)(pPixels + i), _mm_packus_epi16(vLow, vHigh));
+		}
+		DzGetScalarKernels().MultiplyByColor(pPixels + i, nPixels - i, nColor);
+	}
+
+	void intensityToAlphaF32SSE41(float* pDst, const float* pSrc, size_t nPixels)
+	{
+		const __m128 vOneThird = _mm_set1_ps(1.0f / 3.0f);
+		for (size_t i = 0; i < nPixels; i++) {
+			__m128 vSrc = _mm_loadu_ps(pSrc + i * 4);
+			// lane 0 = (R + G) + B, the same order as the scalar kernel
+			__m128 vSum = _mm_add_ps(_mm_add_ps(vSrc, _mm_shuffle_ps(vSrc, vSrc, _MM_SHUFFLE(3, 0, 2, 1))), _mm_shuffle_ps(vSrc, vSrc, _MM_SHUFFLE(3, 1, 0, 2)));
+			__m128 vMean = _mm_mul_ps(vSum, vOneThird);
+			__m128 vDst = _mm_loadu_ps(pDst + i * 4);
+			_mm_storeu_ps(pDst + i * 4, _mm_blend_ps(vDst, _mm_shuffle_ps(vMean, vMean, 0), 0x8));
+		}
+	}
+
+	// log2(x) for x > 0, normalized mantissa in [sqrt(0.5), sqrt(2)) and an atanh series
+	inline __m128 log2SSE41(__m128 vX)
+	{
+		__m128i vBits = _mm_castps_si128(vX);
+		__m128i vExponent = _mm_sub_epi32(_mm_srli_epi32(vBits, 23), _mm_set1_epi32(127));
+		__m128 vMantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(vBits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+		__m128 vAbove = _mm_cmpgt_ps(vMantissa, _mm_set1_ps(1.41421356f));
+		vMantissa = _mm_blendv_ps(vMantissa, _mm_mul_ps(vMantissa, _mm_set1_ps(0.5f)), vAbove);
+		vExponent = _mm_sub_epi32(vExponent, _mm_castps_si128(vAbove));
+		__m128 vT = _mm_div_ps(_mm_sub_ps(vMantissa, _mm_set1_ps(1.0f)), _mm_add_ps(vMantissa, _mm_set1_ps(1.0f)));
+		__m128 vT2 = _mm_mul_ps(vT, vT);
+		// 2 / (k * ln(2)) for k = 1, 3, 5, 7, 9
+		__m128 vPoly = _mm_set1_ps(0.32059889f);
+		vPoly = _mm_add_ps(_mm_mul_ps(vPoly, vT2), _mm_set1_ps(0.41219858f));
+		vPoly = _mm_add_ps(_mm_mul_ps(vPoly, vT2), _mm_set1_ps(0.57707802f));
+		vPoly = _mm_add_ps(_mm_mul_ps(vPoly, vT2), _mm_set1_ps(0.96179669f));
+		vPoly = _mm_add_ps(_mm_mul_ps(vPoly, vT2), _mm_set1_ps(2.88539008f));
+		return _mm_add_ps(_mm_cvtepi32_ps(vExponent), _mm_mul_ps(vPoly, vT));
+	}
+
+	// 2^x, split into an integer power and a Taylor series on [-0.5, 0.5]
+	inline __m128 exp2SSE41(__m128 vX)
+	{
+		vX = _mm_min_ps(_mm_max_ps(vX, _mm_set1_ps(-126.0f)), _mm_set1_ps(127.0f));
+		__m128 vWhole = _mm_round_ps(vX, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m128 vFraction = _mm_sub_ps(vX, vWhole);
+		// (ln 2)^k / k! for k = 6 .. 0
+		__m128 vPoly = _mm_set1_ps(1.5403530e-4f);
+		vPoly = _mm_add_ps(_mm_mul_ps(vPoly, vFraction), _mm_set1_ps(1.3333558e-3f));
+		vPoly = _mm_add_ps(_mm_mul_ps(vPoly, vFraction), _mm_set1_ps(9.6181291e-3f));
+		vPoly = _mm_add_ps(_mm_mul_ps(vPoly, vFraction), _mm_set1_ps(5.5504109e-2f));
+		vPoly = _mm_add_ps(_mm_mul_ps(vPoly, vFraction), _mm_set1_ps(2.4022651e-1f));
+		vPoly = _mm_add_ps(_mm_mul_ps(vPoly, vFraction), _mm_set1_ps(6.9314718e-1f));
+		vPoly = _mm_add_ps(_mm_mul_ps(vPoly, vFraction), _mm_set1_ps(1.0f));
+		__m128i vScale = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(vWhole), _mm_set1_epi32(127)), 23);
+		return _mm_mul_ps(vPoly, _mm_castsi128_ps(vScale));
+	}
+
+	inline __m128 srgbToLinearSSE41(__m128 vX)
+	{
+		__m128 vLinear = _mm_div_ps(vX, _mm_set1_ps(12.92f));
+		__m128 vBase = _mm_div_ps(_mm_add_ps(vX, _mm_set1_ps(0.055f)), _mm_set1_ps(1.055f));
+		vBase = _mm_max_ps(vBase, _mm_set1_ps(1e-30f));
+		__m128 vCurve = exp2SSE41(_mm_mul_ps(log2SSE41(vBase), _mm_set1_ps(2.4f)));
+		return _mm_blendv_ps(vCurve, vLinear, _mm_cmple_ps(vX, _mm_set1_ps(0.04045f)));
+	}
+
+	inline __m128 linearToSrgbSSE41(__m128 vX)
+	{
+		__m128 vLinear = _mm_mul_ps(vX, _mm_set1_ps(12.92f));
+		__m128 vBase = _mm_max_ps(vX, _mm_set1_ps(1e-30f));
+		__m128 vCurve = exp2SSE41(_mm_mul_ps(log2SSE41(vBase), _mm_set1_ps(1.0f / 2.4f)));
+		vCurve = _mm_sub_ps(_mm_mul_ps(vCurve, _mm_set1_ps(1.055f)), _mm_set1_ps(0.055f));
+		return _mm_blendv_ps(vCurve, vLinear, _mm_cmple_ps(vX, _mm_set1_ps(0.0031308f)));
+	}
+
+	template <__m128 (*fnConvert)(__m128), float (*fnConvertScalar)(float), int nAlphaMask>
+	void convertF32SSE41(float* pData, size_t nPixels, int nChannels)
+	{
+		size_t nValues = nPixels * nChannels;
+		size_t i = 0;
+		for (; i + 4 <= nValues; i += 4) {
+			__m128 vValues = _mm_loadu_ps(pData + i);
+			_mm_storeu_ps(pData + i, _mm_blend_ps(fnConvert(vValues), vValues, nAlphaMask));
+		}
+		bool bHasAlpha = (nAlphaMask != 0);
+		for (; i < nValues; i++) {
+			if (bHasAlpha && (int)(i % nChannels) == nChannels - 1) {
+				continue;
+			}
+			pData[i] = fnConvertScalar(pData[i]);
+		}
+	}
+
+	template <__m128 (*fnConvert)(__m128), float (*fnConvertScalar)(float)>
+	void convertChannelsF32SSE41(float* pData, size_t nPixels, int nChannels)
+	{
+		// every 4-value block starts on a pixel boundary for 1, 2 and 4 channels, so the alpha lanes are fixed
+		if (nChannels == 4) {
+			convertF32SSE41<fnConvert, fnConvertScalar, 0x8>(pData, nPixels, nChannels);
+		}
+		else if (nChannels == 2) {
+			convertF32SSE41<fnConvert, fnConvertScalar, 0xa>(pData, nPixels, nChannels);
+		}
+		else {
+			convertF32SSE41<fnConvert, fnConvertScalar, 0x0>(pData, nPixels, nChannels);
+		}
+	}
+}
+
+const DzImageKernelTable& DzGetSSE41Kernels()
+{
+	static const DzImageKernelTable oTable = {
+		combineColorAndAlphaSSE41,
+		multiplyByColorSSE41,
+		DzGetScalarKernels().SrgbToLinear,
+		DzGetScalarKernels().LinearToSrgb,
+		intensityToAlphaF32SSE41,
+		convertChannelsF32SSE41<srgbToLinearSSE41, DzImageKernels::SrgbToLinearScalar>,
+		convertChannelsF32SSE41<linearToSrgbSSE41, DzImageKernels::LinearToSrgbScalar>
+	};
+	return oTable;
+}
+
+#endif
@@ -0,0 +1,186 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "DzImageResampler.h"
+
+namespace
+{
+	inline uint32_t roundToByte(float fValue)
+	{
+		int nValue = (int)(fValue + 0.5f);
+		return (uint32_t)(nValue < 0 ? 0 : (nValue > 255 ? 255 : nValue));
+	}
+}
+
+DzStripResampler::DzStripResampler(int nSourceWidth, int nSourceHeight, int nTargetWidth, int nTargetHeight) :
+	m_nSourceWidth(nSourceWidth),
+	m_nSourceHeight(nSourceHeight),
+	m_nTargetWidth(nTargetWidth),
+	m_nTargetHeight(nTargetHeight)
+{
+	m_dScaleY = (double)nSourceHeight / nTargetHeight;
+
+	// horizontal footprint of every target column, with fractional edge weights
+	double dScaleX = (double)nSourceWidth / nTargetWidth;
+	m_aSpans.resize(nTargetWidth);
+	for (int x = 0; x < nTargetWidth; x++) {
+		double dBegin = x * dScaleX;
+		double dEnd = std::min((x + 1) * dScaleX, (double)nSourceWidth);
+		int nBegin = (int)floor(dBegin);
+		int nEnd = std::min((int)ceil(dEnd), nSourceWidth);
+		Span& span = m_aSpans[x];
+		span.nBegin = nBegin;
+		span.nCount = nEnd - nBegin;
+		span.nWeightOffset = m_aWeights.size();
+		for (int i = nBegin; i < nEnd; i++) {
+			double dOverlap = std::min((double)i + 1, dEnd) - std::max((double)i, dBegin);
+			m_aWeights.push_back((float)(dOverlap / dScaleX));
+		}
+	}
+	m_aHorizontal.assign((size_t)nTargetWidth * 4, 0.0f);
+	m_aAccumulator.assign((size_t)nTargetWidth * 4, 0.0f);
+}
+
+size_t DzStripResampler::getMemoryBytes() const
+{
+	return m_aSpans.capacity() * sizeof(Span) + (m_aWeights.capacity() + m_aHorizontal.capacity() + m_aAccumulator.capacity()) * sizeof(float) +
+		m_aFinishedRows.size() * m_nTargetWidth * sizeof(uint32_t);
+}
+
+void DzStripResampler::addRow(const uint32_t* pSourceRow)
+{
+	if (m_nTargetRow >= m_nTargetHeight) {
+		return;
+	}
+
+	// premultiplied horizontal pass: r*a, g*a, b*a, a
+	float* pHorizontal = m_aHorizontal.data();
+	for (int x = 0; x < m_nTargetWidth; x++) {
+		const Span& span = m_aSpans[x];
+		const float* pWeights = m_aWeights.data() + span.nWeightOffset;
+		float fR = 0.0f, fG = 0.0f, fB = 0.0f, fA = 0.0f;
+		for (int i = 0; i < span.nCount; i++) {
+			uint32_t nPixel = pSourceRow[span.nBegin + i];
+			float fWeightedAlpha = pWeights[i] * (float)(nPixel >> 24);
+			fR += fWeightedAlpha * (float)((nPixel >> 16) & 0xff);
+			fG += fWeightedAlpha * (float)((nPixel >> 8) & 0xff);
+			fB += fWeightedAlpha * (float)(nPixel & 0xff);
+			fA += fWeightedAlpha;
+		}
+		pHorizontal[x * 4 + 0] = fR;
+		pHorizontal[x * 4 + 1] = fG;
+		pHorizontal[x * 4 + 2] = fB;
+		pHorizontal[x * 4 + 3] = fA;
+	}
+
+	// a source row can straddle the boundary between two target rows
+	double dRowBegin = m_nSourceRow;
+	double dRowEnd = m_nSourceRow + 1.0;
+	bool bLastSourceRow = m_nSourceRow + 1 >= m_nSourceHeight;
+	m_nSourceRow++;
+	size_t nValues = m_aAccumulator.size();
+	while (m_nTargetRow < m_nTargetHeight) {
+		double dTargetBegin = m_nTargetRow * m_dScaleY;
+		double dTargetEnd = (m_nTargetRow + 1) * m_dScaleY;
+		double dOverlap = std::min(dRowEnd, dTargetEnd) - std::max(dRowBegin, dTargetBegin);
+		if (dOverlap > 0.0) {
+			float fWeight = (float)(dOverlap / m_dScaleY);
+			for (size_t i = 0; i < nValues; i++) {
+				m_aAccumulator[i] += fWeight * pHorizontal[i];
+			}
+		}
+		if (bLastSourceRow == false && dRowEnd < dTargetEnd - 1e-9) {
+			break;
+		}
+		finishRow();
+		if (bLastSourceRow == false && dRowEnd <= dTargetEnd + 1e-9) {
+			break;
+		}
+	}
+}
+
+void DzStripResampler::finishRow()
+{
+	std::vector<uint32_t> aRow(m_nTargetWidth);
+	const float* pAccumulator = m_aAccumulator.data();
+	for (int x = 0; x < m_nTargetWidth; x++) {
+		float fA = pAccumulator[x * 4 + 3];
+		if (fA <= 0.0f) {
+			aRow[x] = 0;
+			continue;
+		}
+		float fInverse = 1.0f / fA;
+		aRow[x] = (roundToByte(fA) << 24) |
+			(roundToByte(pAccumulator[x * 4 + 0] * fInverse) << 16) |
+			(roundToByte(pAccumulator[x * 4 + 1] * fInverse) << 8) |
+			roundToByte(pAccumulator[x * 4 + 2] * fInverse);
+	}
+	m_aFinishedRows.push_back(aRow);
+	std::fill(m_aAccumulator.begin(), m_aAccumulator.end(), 0.0f);
+	m_nTargetRow++;
+}
+
+void DzStripResampler::takeRow(uint32_t* pTargetRow)
+{
+	if (m_aFinishedRows.empty()) {
+		return;
+	}
+	memcpy(pTargetRow, m_aFinishedRows.front().data(), m_nTargetWidth * sizeof(uint32_t));
+	m_aFinishedRows.pop_front();
+}
+
+DzTexturePyramid::DzTexturePyramid(int nSourceWidth, int nSourceHeight, const std::vector<int>& aLevelWidths, const std::vector<int>& aLevelHeights,
+	RowFunction fnRow) :
+	m_fnRow(fnRow)
+{
+	int nInputWidth = nSourceWidth;
+	int nInputHeight = nSourceHeight;
+	size_t nLevels = std::min(aLevelWidths.size(), aLevelHeights.size());
+	for (size_t i = 0; i < nLevels; i++) {
+		// only downscaling, a level that is not smaller than its input ends the pyramid
+		int nWidth = aLevelWidths[i];
+		int nHeight = aLevelHeights[i];
+		if (nWidth < 1 || nHeight < 1 || nWidth > nInputWidth || nHeight > nInputHeight) {
+			break;
+		}
+		m_aResamplers.emplace_back(new DzStripResampler(nInputWidth, nInputHeight, nWidth, nHeight));
+		m_aRows.emplace_back(nWidth);
+		nInputWidth = nWidth;
+		nInputHeight = nHeight;
+	}
+}
+
+bool DzTexturePyramid::addRow(const uint32_t* pSourceRow)
+{
+	if (m_aResamplers.empty()) {
+		return true;
+	}
+	return pushRow(0, pSourceRow);
+}
+
+bool DzTexturePyramid::pushRow(int nLevel, const uint32_t* pRow)
+{
+	DzStripResampler& resampler = *m_aResamplers[nLevel];
+	resampler.addRow(pRow);
+	while (resampler.hasRow()) {
+		uint32_t* pLevelRow = m_aRows[nLevel].data();
+		resampler.takeRow(pLevelRow);
+		if (m_fnRow(nLevel, pLevelRow) == false) {
+			return false;
+		}
+		if (nLevel + 1 < (int)m_aResamplers.size() && pushRow(nLevel + 1, pLevelRow) == false) {
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t DzTexturePyramid::getMemoryBytes() const
+{
+	size_t nBytes = 0;
+	for (size_t i = 0; i < m_aResamplers.size(); i++) {
+		nBytes += m_aResamplers[i]->getMemoryBytes() + m_aRows[i].capacity() * sizeof(uint32_t);
+	}
+	return nBytes;
+}
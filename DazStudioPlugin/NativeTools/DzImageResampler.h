@@ -0,0 +1,82 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*****************************
+DzStripResampler
+
+Streaming area-average downscaler for ARGB32 rows.  Source rows are pushed in
+order with addRow(), finished target rows are taken with takeRow() as soon as
+every source row they cover has been seen, so only one row of accumulators is
+kept regardless of the image height.  Averaging is done on premultiplied
+values so that transparent pixels do not bleed their color.
+*****************************/
+class DzStripResampler
+{
+public:
+	DzStripResampler(int nSourceWidth, int nSourceHeight, int nTargetWidth, int nTargetHeight);
+
+	void addRow(const uint32_t* pSourceRow);
+	bool hasRow() const { return m_aFinishedRows.empty() == false; }
+	void takeRow(uint32_t* pTargetRow);
+
+	size_t getMemoryBytes() const;
+
+protected:
+	struct Span {
+		int nBegin;
+		int nCount;
+		size_t nWeightOffset;
+	};
+
+	void finishRow();
+
+	int m_nSourceWidth;
+	int m_nSourceHeight;
+	int m_nTargetWidth;
+	int m_nTargetHeight;
+	double m_dScaleY;
+
+	std::vector<Span> m_aSpans;
+	std::vector<float> m_aWeights;
+	std::vector<float> m_aHorizontal;
+	std::vector<float> m_aAccumulator;
+	int m_nSourceRow = 0;
+	int m_nTargetRow = 0;
+	std::deque<std::vector<uint32_t> > m_aFinishedRows;
+};
+
+/*****************************
+DzTexturePyramid
+
+Produces several downscaled levels of one image in a single pass over its
+rows.  Levels are ordered largest first and each one is reduced from the
+rows of the level above it, so every resampler reads the smallest input
+possible and only one row per level is kept.  Finished rows are handed to
+fnRow with the index of their level, as soon as they are complete.
+*****************************/
+class DzTexturePyramid
+{
+public:
+	// Returning false stops the pyramid, addRow() then returns false
+	typedef std::function<bool(int nLevel, const uint32_t* pRow)> RowFunction;
+
+	DzTexturePyramid(int nSourceWidth, int nSourceHeight, const std::vector<int>& aLevelWidths, const std::vector<int>& aLevelHeights,
+		RowFunction fnRow);
+
+	bool addRow(const uint32_t* pSourceRow);
+	int getNumLevels() const { return (int)m_aResamplers.size(); }
+
+	size_t getMemoryBytes() const;
+
+protected:
+	bool pushRow(int nLevel, const uint32_t* pRow);
+
+	std::vector<std::unique_ptr<DzStripResampler> > m_aResamplers;
+	std::vector<std::vector<uint32_t> > m_aRows;
+	RowFunction m_fnRow;
+};
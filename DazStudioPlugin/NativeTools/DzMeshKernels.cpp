@@ -0,0 +1,433 @@
+#include <math.h>
+#include <algorithm>
+
+#include "DzMeshKernels.h"
+#include "DzCpuFeatures.h"
+#include "DzNativeParallel.h"
+
+namespace
+{
+	// points blended together, small enough for their matrices to stay in L1/L2
+	const size_t kBlockPoints = 256;
+	// points per parallel work item
+	const size_t kWorkItemPoints = 16 * kBlockPoints;
+	// points regrouped together, their slices of the per-point influence arrays fit in L2
+	const size_t kGroupTilePoints = 8192;
+
+	void blendClusterScalar(double* pBlended, double* pWeightSums, const double* pColumns, const int* pIndices, const double* pWeights,
+		size_t nInfluences, size_t nBase)
+	{
+		for (size_t k = 0; k < nInfluences; k++) {
+			double fWeight = pWeights[k];
+			if (fWeight == 0.0) {
+				continue;
+			}
+			size_t i = pIndices[k] - nBase;
+			double* pPointBlended = pBlended + i * 16;
+			for (int e = 0; e < 16; e++) {
+				pPointBlended[e] += pColumns[e] * fWeight;
+			}
+			pWeightSums[i] += fWeight;
+		}
+	}
+
+	void applyBlendedScalar(double* pPoints, const double* pBlended, const double* pWeightSums, size_t nPoints, bool bNormalize)
+	{
+		for (size_t i = 0; i < nPoints; i++) {
+			double fWeightSum = pWeightSums[i];
+			if (fWeightSum == 0.0) {
+				continue;
+			}
+			const double* pPointBlended = pBlended + i * 16;
+			double* pPoint = pPoints + i * 4;
+			double fX = pPoint[0], fY = pPoint[1], fZ = pPoint[2];
+			double aResult[3];
+			for (int r = 0; r < 3; r++) {
+				aResult[r] = pPointBlended[r] * fX + pPointBlended[4 + r] * fY + pPointBlended[8 + r] * fZ + pPointBlended[12 + r];
+			}
+			if (bNormalize) {
+				for (int r = 0; r < 3; r++) {
+					pPoint[r] = aResult[r] / fWeightSum;
+				}
+			}
+			else {
+				double fRest = 1.0 - fWeightSum;
+				for (int r = 0; r < 3; r++) {
+					pPoint[r] = aResult[r] + pPoint[r] * fRest;
+				}
+			}
+		}
+	}
+
+	// The influences of every cluster in ascending point order, and the cluster matrices in the column layout of
+	// DzMeshKernelTable.  Points the arrays of the mesh unless a cluster had to be sorted.
+	struct ClusterInfluences
+	{
+		size_t nClusters = 0;
+		const int* pIndices = nullptr;
+		const double* pWeights = nullptr;
+		std::vector<int> aSortedIndices;
+		std::vector<double> aSortedWeights;
+		std::vector<double> aColumnMatrices;
+	};
+
+	void sortInfluences(const DzSkinBakeMesh& mesh, ClusterInfluences& influences)
+	{
+		influences.nClusters = mesh.aClusterOffsets.empty() ? 0 : mesh.aClusterOffsets.size() - 1;
+		influences.nClusters = std::min(influences.nClusters, mesh.aClusterMatrices.size() / 12);
+		influences.pIndices = mesh.aIndices.data();
+		influences.pWeights = mesh.aWeights.data();
+		for (size_t c = 0; c < influences.nClusters; c++) {
+			uint32_t nBegin = mesh.aClusterOffsets[c], nEnd = mesh.aClusterOffsets[c + 1];
+			if (std::is_sorted(mesh.aIndices.begin() + nBegin, mesh.aIndices.begin() + nEnd)) {
+				continue;
+			}
+			if (influences.aSortedIndices.empty()) {
+				influences.aSortedIndices = mesh.aIndices;
+				influences.aSortedWeights = mesh.aWeights;
+				influences.pIndices = influences.aSortedIndices.data();
+				influences.pWeights = influences.aSortedWeights.data();
+			}
+			// stable, so the influences of a point repeated in a cluster keep their order
+			std::vector<std::pair<int, double> > aPairs;
+			for (uint32_t k = nBegin; k < nEnd; k++) {
+				aPairs.push_back(std::make_pair(mesh.aIndices[k], mesh.aWeights[k]));
+			}
+			std::stable_sort(aPairs.begin(), aPairs.end(), [](const std::pair<int, double>& a, const std::pair<int, double>& b) {
+				return a.first < b.first;
+			});
+			for (uint32_t k = nBegin; k < nEnd; k++) {
+				influences.aSortedIndices[k] = aPairs[k - nBegin].first;
+				influences.aSortedWeights[k] = aPairs[k - nBegin].second;
+			}
+		}
+
+		influences.aColumnMatrices.assign(influences.nClusters * 16, 0.0);
+		for (size_t c = 0; c < influences.nClusters; c++) {
+			for (int r = 0; r < 3; r++) {
+				for (int nColumn = 0; nColumn < 4; nColumn++) {
+					influences.aColumnMatrices[c * 16 + nColumn * 4 + r] = mesh.aClusterMatrices[c * 12 + r * 4 + nColumn];
+				}
+			}
+		}
+	}
+
+	// Bakes the points [nBegin, nEnd) of one mesh a block at a time
+	void bakeWorkItem(const DzSkinBakeMesh& mesh, const ClusterInfluences& influences, size_t nBegin, size_t nEnd,
+		const DzMeshKernelTable& kernels)
+	{
+		std::vector<uint32_t> aCursors(influences.nClusters);
+		for (size_t c = 0; c < influences.nClusters; c++) {
+			const int* pClusterBegin = influences.pIndices + mesh.aClusterOffsets[c];
+			const int* pClusterEnd = influences.pIndices + mesh.aClusterOffsets[c + 1];
+			aCursors[c] = (uint32_t)(std::lower_bound(pClusterBegin, pClusterEnd, (int)nBegin) - influences.pIndices);
+		}
+		std::vector<double> aBlended(kBlockPoints * 16);
+		double aWeightSums[kBlockPoints];
+		for (size_t nBlock = nBegin; nBlock < nEnd; nBlock += kBlockPoints) {
+			size_t nBlockEnd = std::min(nEnd, nBlock + kBlockPoints);
+			std::fill(aBlended.begin(), aBlended.begin() + (nBlockEnd - nBlock) * 16, 0.0);
+			std::fill(aWeightSums, aWeightSums + (nBlockEnd - nBlock), 0.0);
+			for (size_t c = 0; c < influences.nClusters; c++) {
+				uint32_t k = aCursors[c];
+				uint32_t nClusterEnd = mesh.aClusterOffsets[c + 1];
+				while (k < nClusterEnd && (size_t)influences.pIndices[k] < nBlockEnd) {
+					k++;
+				}
+				if (k > aCursors[c]) {
+					kernels.BlendCluster(aBlended.data(), aWeightSums, &influences.aColumnMatrices[c * 16], influences.pIndices + aCursors[c],
+						influences.pWeights + aCursors[c], k - aCursors[c], nBlock);
+				}
+				aCursors[c] = k;
+			}
+			kernels.ApplyBlended(mesh.pPoints + nBlock * 4, aBlended.data(), aWeightSums, nBlockEnd - nBlock, mesh.bNormalize);
+		}
+	}
+
+	// cluster influences regrouped per point: point p uses aClusters/aWeights[aOffsets[p], aOffsets[p + 1])
+	struct PointInfluences
+	{
+		std::vector<uint32_t> aOffsets;
+		std::vector<uint32_t> aClusters;
+		std::vector<double> aWeights;
+	};
+
+	// Calls fnVisit(c, k, nIndex) for every usable influence of the points in [nBegin, nEnd), cluster by cluster.
+	// Without bAscending the whole mesh is scanned, and the range must cover every point.
+	template<typename Visitor>
+	void visitInfluences(const DzSkinBakeMesh& mesh, size_t nClusters, bool bAscending, size_t nBegin, size_t nEnd, Visitor fnVisit)
+	{
+		for (size_t c = 0; c < nClusters; c++) {
+			const int* pBegin = mesh.aIndices.data() + mesh.aClusterOffsets[c];
+			const int* pEnd = mesh.aIndices.data() + mesh.aClusterOffsets[c + 1];
+			const int* pIndex = bAscending ? std::lower_bound(pBegin, pEnd, (int)nBegin) : pBegin;
+			for (; pIndex < pEnd; pIndex++) {
+				int nIndex = *pIndex;
+				if (bAscending && (size_t)nIndex >= nEnd) {
+					break;
+				}
+				size_t k = pIndex - mesh.aIndices.data();
+				if (nIndex >= 0 && (size_t)nIndex < mesh.nPoints && mesh.aWeights[k] != 0.0) {
+					fnVisit(c, k, (size_t)nIndex);
+				}
+			}
+		}
+	}
+
+	// Regroups the influences per point, in cluster order.  The FBX SDK lists the points of a cluster in ascending
+	// order, which lets the points be regrouped in parallel tiles that only touch their own slice of the per-point
+	// arrays, so the slices stay in cache instead of every influence missing it.
+	void groupInfluences(const DzSkinBakeMesh& mesh, PointInfluences& influences)
+	{
+		size_t nClusters = mesh.aClusterOffsets.empty() ? 0 : mesh.aClusterOffsets.size() - 1;
+		nClusters = std::min(nClusters, mesh.aClusterMatrices.size() / 12);
+		bool bAscending = true;
+		for (size_t c = 0; c < nClusters && bAscending; c++) {
+			bAscending = std::is_sorted(mesh.aIndices.begin() + mesh.aClusterOffsets[c], mesh.aIndices.begin() + mesh.aClusterOffsets[c + 1]);
+		}
+		size_t nTilePoints = bAscending ? kGroupTilePoints : std::max(mesh.nPoints, (size_t)1);
+		size_t nTiles = (mesh.nPoints + nTilePoints - 1) / nTilePoints;
+
+		influences.aOffsets.assign(mesh.nPoints + 1, 0);
+		DzNativeParallel::For(nTiles, 1, [&](size_t nTileBegin, size_t nTileEnd) {
+			for (size_t t = nTileBegin; t < nTileEnd; t++) {
+				size_t nBegin = t * nTilePoints;
+				visitInfluences(mesh, nClusters, bAscending, nBegin, std::min(mesh.nPoints, nBegin + nTilePoints),
+					[&](size_t, size_t, size_t nIndex) { influences.aOffsets[nIndex + 1]++; });
+			}
+		});
+		for (size_t p = 0; p < mesh.nPoints; p++) {
+			influences.aOffsets[p + 1] += influences.aOffsets[p];
+		}
+		influences.aClusters.resize(influences.aOffsets[mesh.nPoints]);
+		influences.aWeights.resize(influences.aOffsets[mesh.nPoints]);
+		DzNativeParallel::For(nTiles, 1, [&](size_t nTileBegin, size_t nTileEnd) {
+			for (size_t t = nTileBegin; t < nTileEnd; t++) {
+				size_t nBegin = t * nTilePoints;
+				size_t nEnd = std::min(mesh.nPoints, nBegin + nTilePoints);
+				std::vector<uint32_t> aCursors(influences.aOffsets.begin() + nBegin, influences.aOffsets.begin() + nEnd);
+				visitInfluences(mesh, nClusters, bAscending, nBegin, nEnd, [&](size_t c, size_t k, size_t nIndex) {
+					uint32_t nSlot = aCursors[nIndex - nBegin]++;
+					influences.aClusters[nSlot] = (uint32_t)c;
+					influences.aWeights[nSlot] = mesh.aWeights[k];
+				});
+			}
+		});
+	}
+
+	struct Influence
+	{
+		uint32_t nCluster;
+		double fWeight;
+	};
+
+	// strongest first, the lower cluster index first between equal weights so the result does not depend on the input order
+	inline bool isStronger(const Influence& a, const Influence& b)
+	{
+		return a.fWeight > b.fWeight || (a.fWeight == b.fWeight && a.nCluster < b.nCluster);
+	}
+
+	// Reduces the influences of one point in place and returns how many are kept
+	size_t optimizePoint(Influence* pInfluences, size_t nCount, const DzSkinWeightSettings& settings)
+	{
+		std::sort(pInfluences, pInfluences + nCount, isStronger);
+		double fWeightSum = 0.0;
+		for (size_t k = 0; k < nCount; k++) {
+			fWeightSum += pInfluences[k].fWeight;
+		}
+		size_t nKept = nCount;
+		while (nKept > 1 && pInfluences[nKept - 1].fWeight < settings.fMinWeight) {
+			nKept--;
+		}
+		if (settings.nMaxInfluences > 0 && nKept > (size_t)settings.nMaxInfluences) {
+			nKept = settings.nMaxInfluences;
+		}
+		double fKeptSum = 0.0;
+		for (size_t k = 0; k < nKept; k++) {
+			fKeptSum += pInfluences[k].fWeight;
+		}
+		if (fKeptSum <= 0.0) {
+			return nKept;
+		}
+		double fScale = fWeightSum / fKeptSum;
+		for (size_t k = 0; k < nKept; k++) {
+			pInfluences[k].fWeight *= fScale;
+		}
+
+		if (settings.nQuantizationBits > 0) {
+			const int64_t nSteps = ((int64_t)1 << settings.nQuantizationBits) - 1;
+			int64_t aSteps[64];
+			double aRemainders[64];
+			nKept = std::min(nKept, (size_t)64);
+			int64_t nUsed = 0;
+			for (size_t k = 0; k < nKept; k++) {
+				double fSteps = pInfluences[k].fWeight / fWeightSum * nSteps;
+				aSteps[k] = (int64_t)fSteps;
+				aRemainders[k] = fSteps - aSteps[k];
+				nUsed += aSteps[k];
+			}
+			// the steps lost by rounding down go to the largest remainders
+			for (int64_t nLeft = nSteps - nUsed; nLeft > 0; nLeft--) {
+				size_t nBest = 0;
+				for (size_t k = 1; k < nKept; k++) {
+					if (aRemainders[k] > aRemainders[nBest]) nBest = k;
+				}
+				aSteps[nBest]++;
+				aRemainders[nBest] = -1.0;
+			}
+			size_t nNonZero = 0;
+			for (size_t k = 0; k < nKept; k++) {
+				if (aSteps[k] > 0) {
+					pInfluences[nNonZero].nCluster = pInfluences[k].nCluster;
+					pInfluences[nNonZero].fWeight = (double)aSteps[k] / nSteps * fWeightSum;
+					nNonZero++;
+				}
+			}
+			nKept = nNonZero;
+		}
+		return nKept;
+	}
+
+	struct WorkItem
+	{
+		size_t nMesh;
+		size_t nBegin;
+		size_t nEnd;
+	};
+}
+
+const DzMeshKernelTable& DzGetScalarMeshKernels()
+{
+	static const DzMeshKernelTable oTable = {
+		blendClusterScalar,
+		applyBlendedScalar
+	};
+	return oTable;
+}
+
+const DzMeshKernelTable& DzMeshKernels::GetKernels(int nSimdLevel)
+{
+#if DZ_NATIVETOOLS_X86
+	if (nSimdLevel >= DzCpuFeatures::AVX2) {
+		return DzGetAVX2MeshKernels();
+	}
+	if (nSimdLevel >= DzCpuFeatures::SSE41) {
+		return DzGetSSE41MeshKernels();
+	}
+#endif
+	return DzGetScalarMeshKernels();
+}
+
+const DzMeshKernelTable& DzMeshKernels::GetKernels()
+{
+	return GetKernels(DzCpuFeatures::GetSimdLevel());
+}
+
+void DzMeshKernels::BakeLinearSkinning(std::vector<DzSkinBakeMesh>& aMeshes)
+{
+	std::vector<ClusterInfluences> aInfluences(aMeshes.size());
+	DzNativeParallel::For(aMeshes.size(), 1, [&](size_t nBegin, size_t nEnd) {
+		for (size_t m = nBegin; m < nEnd; m++) {
+			sortInfluences(aMeshes[m], aInfluences[m]);
+		}
+	});
+
+	// one list of equally sized work items over all meshes, so that one large figure mesh and many small
+	// accessory meshes are both spread over every thread
+	std::vector<WorkItem> aWorkItems;
+	for (size_t m = 0; m < aMeshes.size(); m++) {
+		if (aMeshes[m].pPoints == nullptr) {
+			continue;
+		}
+		for (size_t nBegin = 0; nBegin < aMeshes[m].nPoints; nBegin += kWorkItemPoints) {
+			WorkItem item = { m, nBegin, std::min(aMeshes[m].nPoints, nBegin + kWorkItemPoints) };
+			aWorkItems.push_back(item);
+		}
+	}
+
+	const DzMeshKernelTable& kernels = GetKernels();
+	DzNativeParallel::For(aWorkItems.size(), 1, [&](size_t nBegin, size_t nEnd) {
+		for (size_t w = nBegin; w < nEnd; w++) {
+			const WorkItem& item = aWorkItems[w];
+			bakeWorkItem(aMeshes[item.nMesh], aInfluences[item.nMesh], item.nBegin, item.nEnd, kernels);
+		}
+	});
+}
+
+void DzMeshKernels::OptimizeSkinWeights(DzSkinBakeMesh& mesh, const DzSkinWeightSettings& settings, DzSkinWeightStats& stats)
+{
+	PointInfluences influences;
+	groupInfluences(mesh, influences);
+	stats.nInfluencesBefore = mesh.aIndices.size();
+
+	// every point is reduced in its own slots, then the kept influences are regrouped per cluster
+	std::vector<Influence> aInfluences(influences.aClusters.size());
+	for (size_t k = 0; k < aInfluences.size(); k++) {
+		aInfluences[k].nCluster = influences.aClusters[k];
+		aInfluences[k].fWeight = influences.aWeights[k];
+	}
+	std::vector<uint32_t> aKept(mesh.nPoints, 0);
+	DzNativeParallel::For(mesh.nPoints, 4096, [&](size_t nBegin, size_t nEnd) {
+		for (size_t p = nBegin; p < nEnd; p++) {
+			uint32_t nOffset = influences.aOffsets[p];
+			aKept[p] = (uint32_t)optimizePoint(&aInfluences[nOffset], influences.aOffsets[p + 1] - nOffset, settings);
+		}
+	});
+
+	size_t nClusters = mesh.aClusterOffsets.empty() ? 0 : mesh.aClusterOffsets.size() - 1;
+	std::vector<uint32_t> aClusterOffsets(nClusters + 1, 0);
+	stats.nMaxInfluencesBefore = 0;
+	stats.nMaxInfluencesAfter = 0;
+	stats.nPointsChanged = 0;
+	for (size_t p = 0; p < mesh.nPoints; p++) {
+		uint32_t nCount = influences.aOffsets[p + 1] - influences.aOffsets[p];
+		stats.nMaxInfluencesBefore = std::max(stats.nMaxInfluencesBefore, (int)nCount);
+		stats.nMaxInfluencesAfter = std::max(stats.nMaxInfluencesAfter, (int)aKept[p]);
+		if (aKept[p] < nCount) stats.nPointsChanged++;
+		for (uint32_t k = 0; k < aKept[p]; k++) {
+			aClusterOffsets[aInfluences[influences.aOffsets[p] + k].nCluster + 1]++;
+		}
+	}
+	for (size_t c = 0; c < nClusters; c++) {
+		aClusterOffsets[c + 1] += aClusterOffsets[c];
+	}
+	std::vector<int> aIndices(aClusterOffsets[nClusters]);
+	std::vector<double> aWeights(aClusterOffsets[nClusters]);
+	std::vector<uint32_t> aCursors(aClusterOffsets.begin(), aClusterOffsets.end() - 1);
+	for (size_t p = 0; p < mesh.nPoints; p++) {
+		for (uint32_t k = 0; k < aKept[p]; k++) {
+			const Influence& influence = aInfluences[influences.aOffsets[p] + k];
+			uint32_t nSlot = aCursors[influence.nCluster]++;
+			aIndices[nSlot] = (int)p;
+			aWeights[nSlot] = influence.fWeight;
+		}
+	}
+	if (nClusters > 0) {
+		mesh.aClusterOffsets.swap(aClusterOffsets);
+	}
+	mesh.aIndices.swap(aIndices);
+	mesh.aWeights.swap(aWeights);
+	stats.nInfluencesAfter = mesh.aIndices.size();
+}
+
+double DzMeshKernels::MeasureSkinningDifference(const DzSkinBakeMesh& mesh, const DzSkinBakeMesh& other)
+{
+	std::vector<double> aPoints(mesh.pPoints, mesh.pPoints + mesh.nPoints * 4);
+	std::vector<double> aOtherPoints(aPoints);
+	std::vector<DzSkinBakeMesh> aMeshes(2, mesh);
+	aMeshes[0].pPoints = aPoints.data();
+	aMeshes[1].pPoints = aOtherPoints.data();
+	aMeshes[1].aClusterOffsets = other.aClusterOffsets;
+	aMeshes[1].aIndices = other.aIndices;
+	aMeshes[1].aWeights = other.aWeights;
+	BakeLinearSkinning(aMeshes);
+
+	double fMaxDistanceSquared = 0.0;
+	for (size_t p = 0; p < mesh.nPoints; p++) {
+		double fDX = aPoints[p * 4] - aOtherPoints[p * 4];
+		double fDY = aPoints[p * 4 + 1] - aOtherPoints[p * 4 + 1];
+		double fDZ = aPoints[p * 4 + 2] - aOtherPoints[p * 4 + 2];
+		fMaxDistanceSquared = std::max(fMaxDistanceSquared, fDX * fDX + fDY * fDY + fDZ * fDZ);
+	}
+	return sqrt(fMaxDistanceSquared);
+}
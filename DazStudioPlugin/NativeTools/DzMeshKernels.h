@@ -0,0 +1,111 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DZ_NATIVETOOLS_X86 1
+#else
+#define DZ_NATIVETOOLS_X86 0
+#endif
+
+// Function table for one SIMD level.  Matrices are affine 3x4, stored as 4 columns padded to 4 values:
+// pColumns[col * 4 + row], the fourth value of every column is 0.
+struct DzMeshKernelTable
+{
+	// Adds the cluster matrix pColumns times pWeights[k] to the blended matrix (16 values) of point pIndices[k] - nBase,
+	// and pWeights[k] to its weight sum.  Zero weights are skipped.
+	void (*BlendCluster)(double* pBlended, double* pWeightSums, const double* pColumns, const int* pIndices, const double* pWeights,
+		size_t nInfluences, size_t nBase);
+	// Transforms nPoints points (x, y, z, w each) by their blended matrices, then divides by the weight sum (bNormalize)
+	// or adds 1 - weight sum of the unskinned position.  Points without weights are not moved.
+	void (*ApplyBlended)(double* pPoints, const double* pBlended, const double* pWeightSums, size_t nPoints, bool bNormalize);
+};
+
+// Linear blend skinning of one mesh, in the layout of the FBX SDK skin clusters
+struct DzSkinBakeMesh
+{
+	// x, y, z, w per point (an FbxVector4 array), x, y and z are baked in place
+	double* pPoints = nullptr;
+	size_t nPoints = 0;
+	// 12 values per cluster, the deformation of the cluster from its bind pose to the baked pose
+	std::vector<double> aClusterMatrices;
+	// influences of cluster c are aIndices/aWeights[aClusterOffsets[c], aClusterOffsets[c + 1])
+	std::vector<uint32_t> aClusterOffsets;
+	std::vector<int> aIndices;
+	std::vector<double> aWeights;
+	// true divides by the weight sum (FbxCluster::eNormalize), false keeps 1 - weight sum of the unskinned
+	// position (FbxCluster::eTotalOne).  Points without weights are never moved.
+	bool bNormalize = true;
+};
+
+// Skin weight reduction, applied per point in this order.  0 turns a step off.
+struct DzSkinWeightSettings
+{
+	// influences below this weight are removed, the largest influence of a point is always kept
+	double fMinWeight = 0.0;
+	// the largest influences of every point are kept
+	int nMaxInfluences = 0;
+	// weights are rounded to multiples of the point's weight sum / (2^bits - 1), 8 or 16
+	int nQuantizationBits = 0;
+};
+
+struct DzSkinWeightStats
+{
+	size_t nInfluencesBefore = 0;
+	size_t nInfluencesAfter = 0;
+	int nMaxInfluencesBefore = 0;
+	int nMaxInfluencesAfter = 0;
+	// points that lost at least one influence
+	size_t nPointsChanged = 0;
+};
+
+/*****************************
+DzMeshKernels
+
+Vertex operations for the FBX post-processing, with SSE4.1 and AVX2
+implementations chosen at runtime (see DzCpuFeatures) and a scalar fallback.
+Positions stay in double precision like the FBX SDK.  The AVX2 kernels use
+fused multiply-add, so they can differ from the scalar result in the last
+bits (within 1e-12 relative to the coordinate magnitude).
+
+BakeLinearSkinning() gives the same result as the linear deformation of the
+FBX SDK ViewScene sample (ComputeLinearDeformation), which bakes a pose into
+the control points: each point is transformed by the weighted sum of its
+cluster matrices.  The points of all meshes are processed in parallel
+blocks: every cluster adds its matrix, held in SIMD registers, to the
+blended matrices of its points in the block (BlendCluster), then the block
+is transformed (ApplyBlended).  Each cluster is walked in ascending point
+order, the order the FBX SDK writes; a cluster in any other order is
+sorted first.
+
+OptimizeSkinWeights() prunes, caps and quantizes the influences of every
+point in parallel.  The kept weights of a point are rescaled to its
+original weight sum, so normalized weights stay normalized.  Quantized
+weights use the largest remainder method, so the quantized weights of a
+point still add up to exactly 2^bits - 1 steps.
+*****************************/
+class DzMeshKernels
+{
+public:
+	// Bakes every mesh, meshes are independent and may be processed concurrently
+	static void BakeLinearSkinning(std::vector<DzSkinBakeMesh>& aMeshes);
+
+	// Rewrites the influences of mesh (its cluster matrices and points are not used).  Within each cluster the
+	// influences are sorted by point index.
+	static void OptimizeSkinWeights(DzSkinBakeMesh& mesh, const DzSkinWeightSettings& settings, DzSkinWeightStats& stats);
+	// Largest distance between the points of mesh skinned with its own weights and with the weights of other,
+	// both with the cluster matrices of mesh.  The points of mesh are not modified.
+	static double MeasureSkinningDifference(const DzSkinBakeMesh& mesh, const DzSkinBakeMesh& other);
+
+	// Table for the current SIMD level, or for a specific one (falls back to scalar if not compiled in)
+	static const DzMeshKernelTable& GetKernels();
+	static const DzMeshKernelTable& GetKernels(int nSimdLevel);
+};
+
+// Implemented in the per-instruction-set translation units
+const DzMeshKernelTable& DzGetScalarMeshKernels();
+#if DZ_NATIVETOOLS_X86
+const DzMeshKernelTable& DzGetSSE41MeshKernels();
+const DzMeshKernelTable& DzGetAVX2MeshKernels();
+#endif
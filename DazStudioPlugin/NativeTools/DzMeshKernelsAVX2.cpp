@@ -0,0 +1,66 @@
+// Compiled with AVX2 and FMA enabled (see CMakeLists.txt).  Only called when DzCpuFeatures reports AVX2.
+#include "DzMeshKernels.h"
+
+#if DZ_NATIVETOOLS_X86
+#include <immintrin.h>
+
+// One register per column: blending an influence is 4 fused multiply-adds, transforming a point 3
+namespace
+{
+	void blendClusterAVX2(double* pBlended, double* pWeightSums, const double* pColumns, const int* pIndices, const double* pWeights,
+		size_t nInfluences, size_t nBase)
+	{
+		__m256d aColumns[4];
+		for (int j = 0; j < 4; j++) {
+			aColumns[j] = _mm256_loadu_pd(pColumns + j * 4);
+		}
+		for (size_t k = 0; k < nInfluences; k++) {
+			double fWeight = pWeights[k];
+			if (fWeight == 0.0) {
+				continue;
+			}
+			size_t i = pIndices[k] - nBase;
+			double* pPointBlended = pBlended + i * 16;
+			__m256d vWeight = _mm256_set1_pd(fWeight);
+			for (int j = 0; j < 4; j++) {
+				_mm256_storeu_pd(pPointBlended + j * 4, _mm256_fmadd_pd(aColumns[j], vWeight, _mm256_loadu_pd(pPointBlended + j * 4)));
+			}
+			pWeightSums[i] += fWeight;
+		}
+	}
+
+	void applyBlendedAVX2(double* pPoints, const double* pBlended, const double* pWeightSums, size_t nPoints, bool bNormalize)
+	{
+		const __m256i vXYZMask = _mm256_set_epi64x(0, -1, -1, -1);
+		for (size_t i = 0; i < nPoints; i++) {
+			double fWeightSum = pWeightSums[i];
+			if (fWeightSum == 0.0) {
+				continue;
+			}
+			const double* pPointBlended = pBlended + i * 16;
+			double* pPoint = pPoints + i * 4;
+			__m256d vResult = _mm256_fmadd_pd(_mm256_loadu_pd(pPointBlended), _mm256_set1_pd(pPoint[0]), _mm256_loadu_pd(pPointBlended + 12));
+			vResult = _mm256_fmadd_pd(_mm256_loadu_pd(pPointBlended + 4), _mm256_set1_pd(pPoint[1]), vResult);
+			vResult = _mm256_fmadd_pd(_mm256_loadu_pd(pPointBlended + 8), _mm256_set1_pd(pPoint[2]), vResult);
+			if (bNormalize) {
+				vResult = _mm256_div_pd(vResult, _mm256_set1_pd(fWeightSum));
+			}
+			else {
+				vResult = _mm256_fmadd_pd(_mm256_loadu_pd(pPoint), _mm256_set1_pd(1.0 - fWeightSum), vResult);
+			}
+			// w is left as it is
+			_mm256_maskstore_pd(pPoint, vXYZMask, vResult);
+		}
+	}
+}
+
+const DzMeshKernelTable& DzGetAVX2MeshKernels()
+{
+	static const DzMeshKernelTable oTable = {
+		blendClusterAVX2,
+		applyBlendedAVX2
+	};
+	return oTable;
+}
+
+#endif
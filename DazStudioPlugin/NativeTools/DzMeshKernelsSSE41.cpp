@@ -0,0 +1,79 @@
+// Compiled with SSE4.1 enabled (see CMakeLists.txt).  Only called when DzCpuFeatures reports SSE4.1.
+#include "DzMeshKernels.h"
+
+#if DZ_NATIVETOOLS_X86
+#include <smmintrin.h>
+
+// Rows 0-1 and 2-3 of each column are one register.  The operations are in the same order as in the scalar kernels,
+// so the results are identical.
+namespace
+{
+	void blendClusterSSE41(double* pBlended, double* pWeightSums, const double* pColumns, const int* pIndices, const double* pWeights,
+		size_t nInfluences, size_t nBase)
+	{
+		__m128d aColumns[8];
+		for (int j = 0; j < 8; j++) {
+			aColumns[j] = _mm_loadu_pd(pColumns + j * 2);
+		}
+		for (size_t k = 0; k < nInfluences; k++) {
+			double fWeight = pWeights[k];
+			if (fWeight == 0.0) {
+				continue;
+			}
+			size_t i = pIndices[k] - nBase;
+			double* pPointBlended = pBlended + i * 16;
+			__m128d vWeight = _mm_set1_pd(fWeight);
+			for (int j = 0; j < 8; j++) {
+				_mm_storeu_pd(pPointBlended + j * 2, _mm_add_pd(_mm_loadu_pd(pPointBlended + j * 2), _mm_mul_pd(aColumns[j], vWeight)));
+			}
+			pWeightSums[i] += fWeight;
+		}
+	}
+
+	void applyBlendedSSE41(double* pPoints, const double* pBlended, const double* pWeightSums, size_t nPoints, bool bNormalize)
+	{
+		for (size_t i = 0; i < nPoints; i++) {
+			double fWeightSum = pWeightSums[i];
+			if (fWeightSum == 0.0) {
+				continue;
+			}
+			const double* pPointBlended = pBlended + i * 16;
+			double* pPoint = pPoints + i * 4;
+			__m128d vX = _mm_set1_pd(pPoint[0]);
+			__m128d vY = _mm_set1_pd(pPoint[1]);
+			__m128d vZ = _mm_set1_pd(pPoint[2]);
+			__m128d vXY = _mm_mul_pd(_mm_loadu_pd(pPointBlended), vX);
+			vXY = _mm_add_pd(vXY, _mm_mul_pd(_mm_loadu_pd(pPointBlended + 4), vY));
+			vXY = _mm_add_pd(vXY, _mm_mul_pd(_mm_loadu_pd(pPointBlended + 8), vZ));
+			vXY = _mm_add_pd(vXY, _mm_loadu_pd(pPointBlended + 12));
+			__m128d vZW = _mm_mul_pd(_mm_loadu_pd(pPointBlended + 2), vX);
+			vZW = _mm_add_pd(vZW, _mm_mul_pd(_mm_loadu_pd(pPointBlended + 6), vY));
+			vZW = _mm_add_pd(vZW, _mm_mul_pd(_mm_loadu_pd(pPointBlended + 10), vZ));
+			vZW = _mm_add_pd(vZW, _mm_loadu_pd(pPointBlended + 14));
+			if (bNormalize) {
+				__m128d vWeightSum = _mm_set1_pd(fWeightSum);
+				vXY = _mm_div_pd(vXY, vWeightSum);
+				vZW = _mm_div_pd(vZW, vWeightSum);
+			}
+			else {
+				__m128d vRest = _mm_set1_pd(1.0 - fWeightSum);
+				vXY = _mm_add_pd(vXY, _mm_mul_pd(_mm_loadu_pd(pPoint), vRest));
+				vZW = _mm_add_pd(vZW, _mm_mul_pd(_mm_load_sd(pPoint + 2), vRest));
+			}
+			// w is left as it is
+			_mm_storeu_pd(pPoint, vXY);
+			_mm_store_sd(pPoint + 2, vZW);
+		}
+	}
+}
+
+const DzMeshKernelTable& DzGetSSE41MeshKernels()
+{
+	static const DzMeshKernelTable oTable = {
+		blendClusterSSE41,
+		applyBlendedSSE41
+	};
+	return oTable;
+}
+
+#endif
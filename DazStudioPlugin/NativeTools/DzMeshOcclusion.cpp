@@ -0,0 +1,98 @@
+#include <algorithm>
+
+#include "DzMeshOcclusion.h"
+#include "DzTriangleBvh.h"
+#include "DzNativeParallel.h"
+
+namespace
+{
+	// a packet is a few hundred triangle tests, so threads need a good number of vertices each
+	const size_t kMinVerticesPerThread = 2048;
+}
+
+bool DzMeshOcclusion::FindObscuredFaces(const DzOcclusionMesh& mesh, float fOffset, float fThreshold, std::vector<uint8_t>& aObscured,
+	DzOcclusionStats* pStats)
+{
+	aObscured.assign(mesh.nFaces, 0);
+	for (size_t k = 0; k < mesh.nLoops; k++) {
+		if (mesh.pLoopVertices[k] < 0 || (size_t)mesh.pLoopVertices[k] >= mesh.nVertices) return false;
+	}
+	std::vector<int> aLoopFaces(mesh.nLoops, -1);
+	for (size_t f = 0; f < mesh.nFaces; f++) {
+		int nStart = mesh.pFaceLoopStarts[f], nCount = mesh.pFaceLoopCounts[f];
+		if (nStart < 0 || nCount < 0 || (size_t)nStart + nCount > mesh.nLoops) return false;
+		for (int k = nStart; k < nStart + nCount; k++) aLoopFaces[k] = (int)f;
+	}
+	for (size_t t = 0; t < mesh.nTriangles; t++) {
+		if (mesh.pTriangleFaces[t] < 0 || (size_t)mesh.pTriangleFaces[t] >= mesh.nFaces) return false;
+		for (int c = 0; c < 3; c++) {
+			if (mesh.pTriangles[t * 3 + c] < 0 || (size_t)mesh.pTriangles[t * 3 + c] >= mesh.nVertices) return false;
+		}
+	}
+
+	DzTriangleBvh bvh;
+	bvh.build(mesh.pPositions, mesh.pTriangles, mesh.nTriangles);
+
+	// the loops around every vertex, one ray each (Python's v.link_faces)
+	std::vector<uint32_t> aVertexLoopOffsets(mesh.nVertices + 1, 0);
+	for (size_t k = 0; k < mesh.nLoops; k++) {
+		if (aLoopFaces[k] >= 0) aVertexLoopOffsets[mesh.pLoopVertices[k] + 1]++;
+	}
+	for (size_t v = 0; v < mesh.nVertices; v++) {
+		aVertexLoopOffsets[v + 1] += aVertexLoopOffsets[v];
+	}
+	std::vector<uint32_t> aVertexLoops(aVertexLoopOffsets[mesh.nVertices]);
+	std::vector<uint32_t> aFill(aVertexLoopOffsets.begin(), aVertexLoopOffsets.end() - 1);
+	for (size_t k = 0; k < mesh.nLoops; k++) {
+		if (aLoopFaces[k] >= 0) aVertexLoops[aFill[mesh.pLoopVertices[k]]++] = (uint32_t)k;
+	}
+
+	// face hit by the ray of every vertex loop within the threshold, -1 for none
+	std::vector<int> aRayHitFaces(aVertexLoops.size(), -1);
+	DzNativeParallel::For(mesh.nVertices, kMinVerticesPerThread, [&](size_t nBegin, size_t nEnd) {
+		float aOrigins[DzTriangleBvh::kPacketSize * 3], aDirections[DzTriangleBvh::kPacketSize * 3];
+		DzRayHit aHits[DzTriangleBvh::kPacketSize];
+		for (size_t v = nBegin; v < nEnd; v++) {
+			const float* pVertex = mesh.pPositions + v * 3;
+			for (uint32_t nFirst = aVertexLoopOffsets[v]; nFirst < aVertexLoopOffsets[v + 1]; nFirst += DzTriangleBvh::kPacketSize) {
+				int nRays = (int)std::min<uint32_t>(DzTriangleBvh::kPacketSize, aVertexLoopOffsets[v + 1] - nFirst);
+				for (int r = 0; r < nRays; r++) {
+					const float* pNormal = mesh.pFaceNormals + (size_t)aLoopFaces[aVertexLoops[nFirst + r]] * 3;
+					for (int c = 0; c < 3; c++) {
+						aOrigins[r * 3 + c] = pVertex[c] + pNormal[c] * fOffset;
+						aDirections[r * 3 + c] = pNormal[c];
+					}
+				}
+				bvh.intersectPacket(aOrigins, aDirections, nRays, fThreshold, aHits);
+				for (int r = 0; r < nRays; r++) {
+					aRayHitFaces[nFirst + r] = aHits[r].nTriangle >= 0 ? mesh.pTriangleFaces[aHits[r].nTriangle] : -1;
+				}
+			}
+		}
+	});
+
+	// a ray that hits the face being tested itself does not obscure it
+	size_t nObscured = 0;
+	for (size_t f = 0; f < mesh.nFaces; f++) {
+		bool bObscured = true;
+		for (int k = mesh.pFaceLoopStarts[f]; k < mesh.pFaceLoopStarts[f] + mesh.pFaceLoopCounts[f] && bObscured; k++) {
+			int v = mesh.pLoopVertices[k];
+			for (uint32_t i = aVertexLoopOffsets[v]; i < aVertexLoopOffsets[v + 1]; i++) {
+				if (aRayHitFaces[i] < 0 || aRayHitFaces[i] == (int)f) {
+					bObscured = false;
+					break;
+				}
+			}
+		}
+		if (bObscured && mesh.pFaceLoopCounts[f] > 0) {
+			aObscured[f] = 1;
+			nObscured++;
+		}
+	}
+	if (pStats) {
+		pStats->nRays = aVertexLoops.size();
+		pStats->nBvhNodes = bvh.getNodeCount();
+		pStats->nObscuredFaces = nObscured;
+	}
+	return true;
+}
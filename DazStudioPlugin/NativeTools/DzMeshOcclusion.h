@@ -0,0 +1,51 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// One mesh in Blender's layout: polygons as loop ranges, plus the triangulation the ray casts hit
+// (Mesh.loop_triangles) with the polygon of every triangle
+struct DzOcclusionMesh
+{
+	const float* pPositions = nullptr;        // xyz per vertex
+	size_t nVertices = 0;
+	const int* pFaceLoopStarts = nullptr;
+	const int* pFaceLoopCounts = nullptr;
+	const float* pFaceNormals = nullptr;      // normalized, xyz per face
+	size_t nFaces = 0;
+	const int* pLoopVertices = nullptr;
+	size_t nLoops = 0;
+	const int* pTriangles = nullptr;          // 3 vertices per triangle
+	const int* pTriangleFaces = nullptr;
+	size_t nTriangles = 0;
+};
+
+struct DzOcclusionStats
+{
+	size_t nRays = 0;
+	size_t nBvhNodes = 0;
+	size_t nObscuredFaces = 0;
+};
+
+/*****************************
+DzMeshOcclusion
+
+Hidden surface removal of the Game Readiness tools (remove_obscured_faces
+in game_readiness_tools.py), on a DzTriangleBvh instead of one Python
+Object.ray_cast() per face, vertex and linked face.
+
+Every vertex casts one ray along the normal of each face around it, from
+fOffset above the vertex.  A face is obscured when, for all of its
+vertices, every one of those rays hits another face within fThreshold.
+Each ray is cast once instead of once per face and threshold: a larger
+threshold only removes more faces, so the Python loop over increasing
+thresholds ends with the faces of the largest one.  The rays of one vertex
+are traversed as a packet, and the vertices are split across threads.
+*****************************/
+class DzMeshOcclusion
+{
+public:
+	// aObscured receives 1 for every face to remove.  Returns false on invalid input (indices out of range).
+	static bool FindObscuredFaces(const DzOcclusionMesh& mesh, float fOffset, float fThreshold, std::vector<uint8_t>& aObscured,
+		DzOcclusionStats* pStats = nullptr);
+};
@@ -0,0 +1,217 @@
+#include <math.h>
+#include <algorithm>
+
+#include "DzMeshOptimizer.h"
+#include "DzNativeParallel.h"
+
+namespace
+{
+	const int kOptimizerCacheSize = 32;
+	const uint32_t kUnassigned = 0xFFFFFFFFu;
+
+	// Forsyth's vertex score, the vertices of the last emitted face all get the same cache score
+	float vertexScore(int nCachePosition, uint32_t nRemainingFaces, int nLastFaceSize)
+	{
+		if (nRemainingFaces == 0) {
+			return -1.0f;
+		}
+		float fScore = 0.0f;
+		if (nCachePosition >= 0) {
+			if (nCachePosition < nLastFaceSize) {
+				fScore = 0.75f;
+			}
+			else {
+				float fScale = 1.0f / (kOptimizerCacheSize - nLastFaceSize);
+				fScore = powf(1.0f - (nCachePosition - nLastFaceSize) * fScale, 1.5f);
+			}
+		}
+		// faces that finish off a vertex are preferred, so that no lonely faces are left behind
+		return fScore + 2.0f / sqrtf((float)nRemainingFaces);
+	}
+
+	// faces of each size keep the positions they had, in the optimized order
+	void keepFaceSizes(DzMeshOrder& mesh)
+	{
+		size_t nFaces = mesh.aOffsets.size() - 1;
+		std::vector<std::vector<uint32_t> > aSlots;
+		for (size_t f = 0; f < nFaces; f++) {
+			uint32_t nSize = mesh.aOffsets[f + 1] - mesh.aOffsets[f];
+			if (nSize >= aSlots.size()) aSlots.resize(nSize + 1);
+			aSlots[nSize].push_back((uint32_t)f);
+		}
+		std::vector<size_t> aNextSlot(aSlots.size(), 0);
+		std::vector<uint32_t> aFaceOrder(nFaces);
+		for (size_t i = 0; i < nFaces; i++) {
+			uint32_t nFace = mesh.aFaceOrder[i];
+			uint32_t nSize = mesh.aOffsets[nFace + 1] - mesh.aOffsets[nFace];
+			aFaceOrder[aSlots[nSize][aNextSlot[nSize]++]] = nFace;
+		}
+		mesh.aFaceOrder.swap(aFaceOrder);
+	}
+}
+
+void DzMeshOptimizer::OptimizeFaceOrder(DzMeshOrder& mesh)
+{
+	size_t nFaces = mesh.aOffsets.empty() ? 0 : mesh.aOffsets.size() - 1;
+	size_t nVertices = mesh.nVertices;
+	mesh.aFaceOrder.clear();
+	mesh.aFaceOrder.reserve(nFaces);
+	if (nFaces == 0) {
+		return;
+	}
+
+	// faces using each vertex, the faces not emitted yet are kept at the start of each range
+	std::vector<uint32_t> aVertexFaceOffsets(nVertices + 1, 0);
+	for (size_t k = 0; k < mesh.aCorners.size(); k++) {
+		aVertexFaceOffsets[mesh.aCorners[k] + 1]++;
+	}
+	for (size_t v = 0; v < nVertices; v++) {
+		aVertexFaceOffsets[v + 1] += aVertexFaceOffsets[v];
+	}
+	std::vector<uint32_t> aVertexFaces(mesh.aCorners.size());
+	std::vector<uint32_t> aRemaining(nVertices, 0);
+	for (size_t f = 0; f < nFaces; f++) {
+		for (uint32_t k = mesh.aOffsets[f]; k < mesh.aOffsets[f + 1]; k++) {
+			uint32_t v = mesh.aCorners[k];
+			aVertexFaces[aVertexFaceOffsets[v] + aRemaining[v]++] = (uint32_t)f;
+		}
+	}
+
+	std::vector<int> aCachePositions(nVertices, -1);
+	std::vector<float> aVertexScores(nVertices);
+	for (size_t v = 0; v < nVertices; v++) {
+		aVertexScores[v] = vertexScore(-1, aRemaining[v], 0);
+	}
+	std::vector<float> aFaceScores(nFaces, 0.0f);
+	int nBest = 0;
+	for (size_t f = 0; f < nFaces; f++) {
+		for (uint32_t k = mesh.aOffsets[f]; k < mesh.aOffsets[f + 1]; k++) {
+			aFaceScores[f] += aVertexScores[mesh.aCorners[k]];
+		}
+		if (aFaceScores[f] > aFaceScores[nBest]) nBest = (int)f;
+	}
+
+	std::vector<uint8_t> aEmitted(nFaces, 0);
+	std::vector<uint32_t> aStamps(nVertices, 0);
+	std::vector<uint32_t> aCache, aNewCache;
+	size_t nCursor = 0;
+	for (uint32_t nStep = 1; nStep <= nFaces; nStep++) {
+		if (nBest < 0) {
+			// nothing in the cache is used anymore, continue with the next face in the original order
+			while (aEmitted[nCursor]) nCursor++;
+			nBest = (int)nCursor;
+		}
+		mesh.aFaceOrder.push_back((uint32_t)nBest);
+		aEmitted[nBest] = 1;
+
+		aNewCache.clear();
+		for (uint32_t k = mesh.aOffsets[nBest]; k < mesh.aOffsets[nBest + 1]; k++) {
+			uint32_t v = mesh.aCorners[k];
+			uint32_t* pFaces = &aVertexFaces[aVertexFaceOffsets[v]];
+			uint32_t nLast = --aRemaining[v];
+			for (uint32_t j = 0; j <= nLast; j++) {
+				if (pFaces[j] == (uint32_t)nBest) {
+					std::swap(pFaces[j], pFaces[nLast]);
+					break;
+				}
+			}
+			if (aStamps[v] != nStep) {
+				aStamps[v] = nStep;
+				aNewCache.push_back(v);
+			}
+		}
+		int nFaceSize = (int)aNewCache.size();
+		for (size_t i = 0; i < aCache.size(); i++) {
+			if (aStamps[aCache[i]] != nStep) aNewCache.push_back(aCache[i]);
+		}
+
+		// rescore everything that is in the cache or just fell out of it
+		for (size_t i = 0; i < aNewCache.size(); i++) {
+			uint32_t v = aNewCache[i];
+			aCachePositions[v] = i < (size_t)kOptimizerCacheSize ? (int)i : -1;
+			float fScore = vertexScore(aCachePositions[v], aRemaining[v], nFaceSize);
+			float fDelta = fScore - aVertexScores[v];
+			aVertexScores[v] = fScore;
+			const uint32_t* pFaces = &aVertexFaces[aVertexFaceOffsets[v]];
+			for (uint32_t j = 0; j < aRemaining[v]; j++) {
+				aFaceScores[pFaces[j]] += fDelta;
+			}
+		}
+		if (aNewCache.size() > (size_t)kOptimizerCacheSize) {
+			aNewCache.resize(kOptimizerCacheSize);
+		}
+		aCache.swap(aNewCache);
+
+		nBest = -1;
+		float fBestScore = 0.0f;
+		for (size_t i = 0; i < aCache.size(); i++) {
+			uint32_t v = aCache[i];
+			const uint32_t* pFaces = &aVertexFaces[aVertexFaceOffsets[v]];
+			for (uint32_t j = 0; j < aRemaining[v]; j++) {
+				if (nBest < 0 || aFaceScores[pFaces[j]] > fBestScore) {
+					nBest = (int)pFaces[j];
+					fBestScore = aFaceScores[nBest];
+				}
+			}
+		}
+	}
+
+	if (mesh.bKeepFaceSizes) {
+		keepFaceSizes(mesh);
+	}
+}
+
+void DzMeshOptimizer::OptimizeVertexOrder(DzMeshOrder& mesh)
+{
+	size_t nFaces = mesh.aOffsets.empty() ? 0 : mesh.aOffsets.size() - 1;
+	mesh.aVertexRemap.assign(mesh.nVertices, kUnassigned);
+	uint32_t nNext = 0;
+	for (size_t i = 0; i < nFaces; i++) {
+		size_t f = mesh.aFaceOrder.empty() ? i : mesh.aFaceOrder[i];
+		for (uint32_t k = mesh.aOffsets[f]; k < mesh.aOffsets[f + 1]; k++) {
+			uint32_t v = mesh.aCorners[k];
+			if (mesh.aVertexRemap[v] == kUnassigned) mesh.aVertexRemap[v] = nNext++;
+		}
+	}
+	for (size_t v = 0; v < mesh.nVertices; v++) {
+		if (mesh.aVertexRemap[v] == kUnassigned) mesh.aVertexRemap[v] = nNext++;
+	}
+}
+
+void DzMeshOptimizer::OptimizeMeshOrder(std::vector<DzMeshOrder>& aMeshes)
+{
+	DzNativeParallel::For(aMeshes.size(), 1, [&](size_t nBegin, size_t nEnd) {
+		for (size_t m = nBegin; m < nEnd; m++) {
+			OptimizeFaceOrder(aMeshes[m]);
+			OptimizeVertexOrder(aMeshes[m]);
+		}
+	});
+}
+
+DzVertexCacheStats DzMeshOptimizer::AnalyzeVertexCache(const DzMeshOrder& mesh, bool bOptimized, int nCacheSize)
+{
+	DzVertexCacheStats stats;
+	size_t nFaces = mesh.aOffsets.empty() ? 0 : mesh.aOffsets.size() - 1;
+	// a vertex is in the FIFO while fewer than nCacheSize misses happened since it was loaded
+	std::vector<size_t> aLoadedAt(mesh.nVertices, 0);
+	std::vector<uint8_t> aUsed(mesh.nVertices, 0);
+	for (size_t i = 0; i < nFaces; i++) {
+		size_t f = bOptimized && mesh.aFaceOrder.size() == nFaces ? mesh.aFaceOrder[i] : i;
+		uint32_t nBegin = mesh.aOffsets[f];
+		for (uint32_t k = nBegin + 1; k + 1 < mesh.aOffsets[f + 1]; k++) {
+			uint32_t aTriangle[3] = { mesh.aCorners[nBegin], mesh.aCorners[k], mesh.aCorners[k + 1] };
+			for (int c = 0; c < 3; c++) {
+				uint32_t v = aTriangle[c];
+				if (aUsed[v] == 0 || stats.nCacheMisses - aLoadedAt[v] >= (size_t)nCacheSize) {
+					aLoadedAt[v] = stats.nCacheMisses++;
+					if (aUsed[v] == 0) {
+						aUsed[v] = 1;
+						stats.nVertices++;
+					}
+				}
+			}
+			stats.nTriangles++;
+		}
+	}
+	return stats;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Faces of one mesh in the FbxMesh polygon layout: face f uses the vertices aCorners[aOffsets[f], aOffsets[f + 1]),
+// every corner must be below nVertices
+struct DzMeshOrder
+{
+	std::vector<uint32_t> aOffsets;
+	std::vector<uint32_t> aCorners;
+	size_t nVertices = 0;
+	// faces are only moved to the positions of faces with the same corner count, for meshes whose polygon
+	// sizes cannot be changed in place (FbxMesh::SetPolygonVertex)
+	bool bKeepFaceSizes = false;
+
+	// results: the face at position i is aFaceOrder[i], vertex v becomes aVertexRemap[v]
+	std::vector<uint32_t> aFaceOrder;
+	std::vector<uint32_t> aVertexRemap;
+};
+
+struct DzVertexCacheStats
+{
+	size_t nTriangles = 0;
+	size_t nVertices = 0;
+	size_t nCacheMisses = 0;
+
+	// average cache miss ratio, vertex shader runs per triangle (0.5 to 3)
+	double getAcmr() const { return nTriangles ? (double)nCacheMisses / nTriangles : 0.0; }
+	// average transform to vertex ratio, vertex shader runs per used vertex (1 is optimal)
+	double getAtvr() const { return nVertices ? (double)nCacheMisses / nVertices : 0.0; }
+};
+
+/*****************************
+DzMeshOptimizer
+
+Reorders the faces and vertices of meshes for the GPU post-transform vertex
+cache and for vertex fetch locality.
+
+OptimizeFaceOrder() is Tom Forsyth's linear-speed vertex cache optimization
+extended to polygons: every vertex is scored by its position in a simulated
+32 entry LRU cache and by how many faces still use it, and the face with the
+highest vertex score sum is emitted next.  OptimizeVertexOrder() then numbers
+the vertices by their first use in that face order, unused vertices last in
+their original order.  OptimizeMeshOrder() does both for all meshes in
+parallel.
+
+AnalyzeVertexCache() simulates a 16 entry FIFO cache over the faces split
+into triangle fans, the usual ACMR/ATVR measurement.
+*****************************/
+class DzMeshOptimizer
+{
+public:
+	static void OptimizeFaceOrder(DzMeshOrder& mesh);
+	static void OptimizeVertexOrder(DzMeshOrder& mesh);
+	static void OptimizeMeshOrder(std::vector<DzMeshOrder>& aMeshes);
+
+	// bOptimized uses aFaceOrder, otherwise the original face order
+	static DzVertexCacheStats AnalyzeVertexCache(const DzMeshOrder& mesh, bool bOptimized, int nCacheSize = 16);
+};
@@ -0,0 +1,506 @@
+#include <math.h>
+#include <algorithm>
+
+#include "DzMeshSimplifier.h"
+#include "DzNativeParallel.h"
+
+namespace
+{
+	// border and seam quadrics weigh more than the surface, so those curves keep their shape
+	const double kBorderWeight = 10.0;
+	const double kMinNormalCosine = 0.5;
+
+	// symmetric 4x4 error quadric and the triangle area it was built from
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+		double fArea = 0;
+
+		void addPlane(const double* n, double d, double fWeight)
+		{
+			a00 += fWeight * n[0] * n[0]; a01 += fWeight * n[0] * n[1]; a02 += fWeight * n[0] * n[2]; a03 += fWeight * n[0] * d;
+			a11 += fWeight * n[1] * n[1]; a12 += fWeight * n[1] * n[2]; a13 += fWeight * n[1] * d;
+			a22 += fWeight * n[2] * n[2]; a23 += fWeight * n[2] * d;
+			a33 += fWeight * d * d;
+			fArea += fWeight;
+		}
+
+		void add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03; a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23; a33 += q.a33; fArea += q.fArea;
+		}
+
+		double evaluate(const double* p) const
+		{
+			double x = p[0], y = p[1], z = p[2];
+			double fError = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+				+ a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+				+ a22 * z * z + 2 * a23 * z + a33;
+			return fError > 0.0 ? fError : 0.0;
+		}
+	};
+
+	inline void subtract(const double* a, const double* b, double* r) { r[0] = a[0] - b[0]; r[1] = a[1] - b[1]; r[2] = a[2] - b[2]; }
+	inline void cross(const double* a, const double* b, double* r)
+	{
+		r[0] = a[1] * b[2] - a[2] * b[1];
+		r[1] = a[2] * b[0] - a[0] * b[2];
+		r[2] = a[0] * b[1] - a[1] * b[0];
+	}
+	inline double dot(const double* a, const double* b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+	struct EdgeRef
+	{
+		uint32_t a, b;  // a < b
+		uint32_t nTriangle;
+		bool operator<(const EdgeRef& other) const
+		{
+			return a < other.a || (a == other.a && (b < other.b || (b == other.b && nTriangle < other.nTriangle)));
+		}
+	};
+
+	struct Collapse
+	{
+		double fCost;
+		double fError;
+		uint32_t nFrom, nTo;
+		bool operator<(const Collapse& other) const
+		{
+			return fCost < other.fCost || (fCost == other.fCost && (nFrom < other.nFrom || (nFrom == other.nFrom && nTo < other.nTo)));
+		}
+	};
+
+	class Simplifier
+	{
+	public:
+		explicit Simplifier(DzSimplifyMesh& mesh) : m_mesh(mesh) {}
+
+		bool run();
+
+	protected:
+		uint32_t vertexOf(uint32_t nWedge) const { return (uint32_t)m_mesh.pWedgeVertices[nWedge]; }
+		uint32_t cornerVertex(uint32_t nTriangle, int c) const { return vertexOf(m_aTriangles[nTriangle * 3 + c]); }
+		int findCorner(uint32_t nTriangle, uint32_t nVertex) const
+		{
+			for (int c = 0; c < 3; c++) {
+				if (cornerVertex(nTriangle, c) == nVertex) return c;
+			}
+			return -1;
+		}
+		void compact();
+		void buildAdjacency();
+		void classifyEdges(bool bAddBorderQuadrics);
+		bool isAttributeEdge(uint32_t a, uint32_t b) const;
+		size_t runPass(size_t nTarget, bool bAllowOvershoot);
+		bool tryCollapse(const Collapse& collapse, size_t nTarget, bool bAllowOvershoot);
+		double attributeDistance(uint32_t a, uint32_t b) const;
+
+		DzSimplifyMesh& m_mesh;
+		std::vector<double> m_aPositions;
+		std::vector<Quadric> m_aQuadrics;
+		std::vector<uint32_t> m_aTriangles;
+		std::vector<int> m_aTriangleMaterials;
+		std::vector<int> m_aTriangleRegions;
+		std::vector<int> m_aTriangleSources;
+		std::vector<uint8_t> m_aTriangleAlive;
+		std::vector<size_t> m_aRegionCounts;
+		std::vector<size_t> m_aRegionTargets;
+		size_t m_nTriangles = 0;
+		double m_fMaxError = 0.0;
+
+		// per pass
+		std::vector<uint32_t> m_aVertexTriangleOffsets;
+		std::vector<uint32_t> m_aVertexTriangles;
+		std::vector<uint8_t> m_aLocked;
+		std::vector<uint8_t> m_aAttributeEdgeCounts;
+		std::vector<uint64_t> m_aAttributeEdges;
+		std::vector<uint32_t> m_aTouched;
+		uint32_t m_nPass = 0;
+	};
+
+	bool Simplifier::run()
+	{
+		DzSimplifyMesh& mesh = m_mesh;
+		mesh.aLodTriangles.clear();
+		mesh.aLodSourceTriangles.clear();
+		mesh.aLodErrors.clear();
+		for (size_t w = 0; w < mesh.nWedges; w++) {
+			if (mesh.pWedgeVertices[w] < 0 || (size_t)mesh.pWedgeVertices[w] >= mesh.nVertices) return false;
+		}
+		for (size_t k = 0; k < mesh.nTriangles * 3; k++) {
+			if (mesh.pTriangles[k] < 0 || (size_t)mesh.pTriangles[k] >= mesh.nWedges) return false;
+		}
+
+		// positions relative to the mesh size, so errors and attribute weights do not depend on the scene scale
+		double aMin[3] = { 0, 0, 0 }, aMax[3] = { 0, 0, 0 };
+		for (size_t v = 0; v < mesh.nVertices; v++) {
+			for (int c = 0; c < 3; c++) {
+				double f = mesh.pPositions[v * 3 + c];
+				if (v == 0 || f < aMin[c]) aMin[c] = f;
+				if (v == 0 || f > aMax[c]) aMax[c] = f;
+			}
+		}
+		double fExtent = std::max(aMax[0] - aMin[0], std::max(aMax[1] - aMin[1], aMax[2] - aMin[2]));
+		double fScale = fExtent > 0.0 ? 1.0 / fExtent : 1.0;
+		m_aPositions.resize(mesh.nVertices * 3);
+		for (size_t v = 0; v < mesh.nVertices; v++) {
+			for (int c = 0; c < 3; c++) {
+				m_aPositions[v * 3 + c] = (mesh.pPositions[v * 3 + c] - aMin[c]) * fScale;
+			}
+		}
+
+		m_aTriangles.assign(mesh.pTriangles, mesh.pTriangles + mesh.nTriangles * 3);
+		m_aTriangleMaterials.assign(mesh.nTriangles, 0);
+		m_aTriangleRegions.assign(mesh.nTriangles, 0);
+		m_aTriangleSources.resize(mesh.nTriangles);
+		m_aTriangleAlive.assign(mesh.nTriangles, 1);
+		m_aRegionCounts.assign(mesh.aRegionRatios.size() + 1, 0);
+		m_aQuadrics.assign(mesh.nVertices, Quadric());
+		for (size_t t = 0; t < mesh.nTriangles; t++) {
+			if (mesh.pTriangleMaterials) m_aTriangleMaterials[t] = mesh.pTriangleMaterials[t];
+			m_aTriangleSources[t] = (int)t;
+			int nRegion = 0;
+			for (int c = 0; c < 3; c++) {
+				uint32_t v = cornerVertex((uint32_t)t, c);
+				if (mesh.pVertexRegions) nRegion = std::max(nRegion, mesh.pVertexRegions[v]);
+			}
+			m_aTriangleRegions[t] = nRegion < (int)m_aRegionCounts.size() ? nRegion : 0;
+			m_aRegionCounts[m_aTriangleRegions[t]]++;
+
+			const double* p0 = &m_aPositions[cornerVertex((uint32_t)t, 0) * 3];
+			const double* p1 = &m_aPositions[cornerVertex((uint32_t)t, 1) * 3];
+			const double* p2 = &m_aPositions[cornerVertex((uint32_t)t, 2) * 3];
+			double e1[3], e2[3], n[3];
+			subtract(p1, p0, e1);
+			subtract(p2, p0, e2);
+			cross(e1, e2, n);
+			double fLength = sqrt(dot(n, n));
+			if (fLength <= 0.0) continue;
+			for (int c = 0; c < 3; c++) n[c] /= fLength;
+			Quadric q;
+			q.addPlane(n, -dot(n, p0), fLength * 0.5);
+			for (int c = 0; c < 3; c++) {
+				m_aQuadrics[cornerVertex((uint32_t)t, c)].add(q);
+			}
+		}
+		m_aRegionTargets.assign(m_aRegionCounts.size(), 0);
+		for (size_t r = 1; r < m_aRegionCounts.size(); r++) {
+			double fRatio = std::min(1.0, std::max(0.0, (double)mesh.aRegionRatios[r - 1]));
+			m_aRegionTargets[r] = (size_t)ceil(m_aRegionCounts[r] * fRatio);
+		}
+		m_nTriangles = mesh.nTriangles;
+		m_aTouched.assign(mesh.nVertices, 0);
+
+		for (size_t nLod = 0; nLod < mesh.aLodTargets.size(); nLod++) {
+			size_t nTarget = mesh.aLodTargets[nLod];
+			while (m_nTriangles > nTarget) {
+				if (runPass(nTarget, false) == 0 && runPass(nTarget, true) == 0) {
+					break;
+				}
+			}
+			compact();
+			mesh.aLodTriangles.push_back(std::vector<int>(m_aTriangles.begin(), m_aTriangles.end()));
+			mesh.aLodSourceTriangles.push_back(m_aTriangleSources);
+			mesh.aLodErrors.push_back(sqrt(m_fMaxError));
+		}
+		return true;
+	}
+
+	void Simplifier::compact()
+	{
+		size_t nKept = 0;
+		for (size_t t = 0; t < m_aTriangleAlive.size(); t++) {
+			if (m_aTriangleAlive[t] == 0) continue;
+			for (int c = 0; c < 3; c++) m_aTriangles[nKept * 3 + c] = m_aTriangles[t * 3 + c];
+			m_aTriangleMaterials[nKept] = m_aTriangleMaterials[t];
+			m_aTriangleRegions[nKept] = m_aTriangleRegions[t];
+			m_aTriangleSources[nKept] = m_aTriangleSources[t];
+			nKept++;
+		}
+		m_aTriangles.resize(nKept * 3);
+		m_aTriangleMaterials.resize(nKept);
+		m_aTriangleRegions.resize(nKept);
+		m_aTriangleSources.resize(nKept);
+		m_aTriangleAlive.assign(nKept, 1);
+		m_nTriangles = nKept;
+	}
+
+	void Simplifier::buildAdjacency()
+	{
+		size_t nVertices = m_mesh.nVertices;
+		m_aVertexTriangleOffsets.assign(nVertices + 1, 0);
+		for (size_t k = 0; k < m_aTriangles.size(); k++) {
+			m_aVertexTriangleOffsets[vertexOf(m_aTriangles[k]) + 1]++;
+		}
+		for (size_t v = 0; v < nVertices; v++) {
+			m_aVertexTriangleOffsets[v + 1] += m_aVertexTriangleOffsets[v];
+		}
+		m_aVertexTriangles.resize(m_aTriangles.size());
+		std::vector<uint32_t> aCursors(m_aVertexTriangleOffsets.begin(), m_aVertexTriangleOffsets.end() - 1);
+		for (size_t k = 0; k < m_aTriangles.size(); k++) {
+			m_aVertexTriangles[aCursors[vertexOf(m_aTriangles[k])]++] = (uint32_t)(k / 3);
+		}
+	}
+
+	inline uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+	}
+
+	bool Simplifier::isAttributeEdge(uint32_t a, uint32_t b) const
+	{
+		return std::binary_search(m_aAttributeEdges.begin(), m_aAttributeEdges.end(), edgeKey(a, b));
+	}
+
+	void Simplifier::classifyEdges(bool bAddBorderQuadrics)
+	{
+		std::vector<EdgeRef> aEdges;
+		aEdges.reserve(m_aTriangles.size());
+		for (uint32_t t = 0; t < (uint32_t)m_nTriangles; t++) {
+			for (int c = 0; c < 3; c++) {
+				uint32_t a = cornerVertex(t, c), b = cornerVertex(t, (c + 1) % 3);
+				EdgeRef edge = { std::min(a, b), std::max(a, b), t };
+				aEdges.push_back(edge);
+			}
+		}
+		std::sort(aEdges.begin(), aEdges.end());
+
+		m_aLocked.assign(m_mesh.nVertices, 0);
+		m_aAttributeEdgeCounts.assign(m_mesh.nVertices, 0);
+		m_aAttributeEdges.clear();
+		for (size_t i = 0; i < aEdges.size();) {
+			size_t j = i + 1;
+			while (j < aEdges.size() && aEdges[j].a == aEdges[i].a && aEdges[j].b == aEdges[i].b) j++;
+			uint32_t a = aEdges[i].a, b = aEdges[i].b;
+			bool bAttribute = false;
+			if (j - i > 2) {
+				m_aLocked[a] = m_aLocked[b] = 1;
+			}
+			else if (j - i == 1) {
+				bAttribute = true;
+			}
+			else {
+				uint32_t t1 = aEdges[i].nTriangle, t2 = aEdges[i + 1].nTriangle;
+				bAttribute = m_aTriangleMaterials[t1] != m_aTriangleMaterials[t2]
+					|| m_aTriangles[t1 * 3 + findCorner(t1, a)] != m_aTriangles[t2 * 3 + findCorner(t2, a)]
+					|| m_aTriangles[t1 * 3 + findCorner(t1, b)] != m_aTriangles[t2 * 3 + findCorner(t2, b)];
+			}
+			if (bAttribute) {
+				m_aAttributeEdges.push_back(edgeKey(a, b));
+				if (m_aAttributeEdgeCounts[a] < 255) m_aAttributeEdgeCounts[a]++;
+				if (m_aAttributeEdgeCounts[b] < 255) m_aAttributeEdgeCounts[b]++;
+				if (bAddBorderQuadrics) {
+					// plane through the edge, perpendicular to the triangle, so the curve resists moving sideways
+					uint32_t t = aEdges[i].nTriangle;
+					const double* pA = &m_aPositions[a * 3];
+					const double* pB = &m_aPositions[b * 3];
+					double e[3], e1[3], e2[3], n[3], p[3];
+					subtract(pB, pA, e);
+					subtract(&m_aPositions[cornerVertex(t, 1) * 3], &m_aPositions[cornerVertex(t, 0) * 3], e1);
+					subtract(&m_aPositions[cornerVertex(t, 2) * 3], &m_aPositions[cornerVertex(t, 0) * 3], e2);
+					cross(e1, e2, n);
+					cross(e, n, p);
+					double fLength = sqrt(dot(p, p));
+					if (fLength > 0.0) {
+						for (int c = 0; c < 3; c++) p[c] /= fLength;
+						Quadric q;
+						q.addPlane(p, -dot(p, pA), kBorderWeight * dot(e, e));
+						q.fArea = 0.0;
+						m_aQuadrics[a].add(q);
+						m_aQuadrics[b].add(q);
+					}
+				}
+			}
+			i = j;
+		}
+	}
+
+	double Simplifier::attributeDistance(uint32_t a, uint32_t b) const
+	{
+		if (m_mesh.pVertexAttributes == nullptr || m_mesh.nAttributes <= 0) {
+			return 0.0;
+		}
+		const float* pA = m_mesh.pVertexAttributes + (size_t)a * m_mesh.nAttributes;
+		const float* pB = m_mesh.pVertexAttributes + (size_t)b * m_mesh.nAttributes;
+		double fDistance = 0.0;
+		for (int i = 0; i < m_mesh.nAttributes; i++) {
+			double d = (double)pA[i] - pB[i];
+			fDistance += d * d;
+		}
+		return fDistance;
+	}
+
+	size_t Simplifier::runPass(size_t nTarget, bool bAllowOvershoot)
+	{
+		compact();
+		buildAdjacency();
+		classifyEdges(m_nPass == 0);
+		m_nPass++;
+
+		std::vector<Collapse> aCollapses;
+		aCollapses.reserve(m_aTriangles.size());
+		for (uint32_t t = 0; t < (uint32_t)m_nTriangles; t++) {
+			for (int c = 0; c < 3; c++) {
+				uint32_t u = cornerVertex(t, c), v = cornerVertex(t, (c + 1) % 3);
+				bool bAttribute = isAttributeEdge(u, v);
+				// interior edges once, from the triangle where they go up; border edges only have one triangle
+				if (u > v && bAttribute == false) continue;
+				for (int nDirection = 0; nDirection < 2; nDirection++) {
+					uint32_t nFrom = nDirection ? v : u, nTo = nDirection ? u : v;
+					if (m_aLocked[nFrom]) continue;
+					uint8_t nCurves = m_aAttributeEdgeCounts[nFrom];
+					if (nCurves != 0 && (nCurves != 2 || bAttribute == false)) continue;
+					const Quadric& q = m_aQuadrics[nFrom];
+					double fError = q.evaluate(&m_aPositions[nTo * 3]);
+					Collapse collapse;
+					collapse.fError = q.fArea > 0.0 ? fError / q.fArea : fError;
+					collapse.fCost = fError + m_mesh.fAttributeWeight * attributeDistance(nFrom, nTo) * q.fArea;
+					collapse.nFrom = nFrom;
+					collapse.nTo = nTo;
+					aCollapses.push_back(collapse);
+				}
+			}
+		}
+		std::sort(aCollapses.begin(), aCollapses.end());
+		// seams show up once per side
+		aCollapses.erase(std::unique(aCollapses.begin(), aCollapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.nFrom == b.nFrom && a.nTo == b.nTo;
+		}), aCollapses.end());
+
+		size_t nCollapsed = 0;
+		for (size_t i = 0; i < aCollapses.size() && m_nTriangles > nTarget; i++) {
+			if (tryCollapse(aCollapses[i], nTarget, bAllowOvershoot)) {
+				nCollapsed++;
+				if (bAllowOvershoot) break;
+			}
+		}
+		return nCollapsed;
+	}
+
+	bool Simplifier::tryCollapse(const Collapse& collapse, size_t nTarget, bool bAllowOvershoot)
+	{
+		uint32_t u = collapse.nFrom, v = collapse.nTo;
+		if (m_aTouched[u] == m_nPass || m_aTouched[v] == m_nPass) {
+			return false;
+		}
+
+		// triangles on the edge disappear, the wedges of u map to the wedges of v on the same side
+		std::vector<size_t> aRemovedPerRegion(m_aRegionCounts.size(), 0);
+		size_t nRemoved = 0;
+		uint32_t aWedgeFrom[8], aWedgeTo[8];
+		int nWedgeMaps = 0;
+		uint32_t nBegin = m_aVertexTriangleOffsets[u], nEnd = m_aVertexTriangleOffsets[u + 1];
+		for (uint32_t k = nBegin; k < nEnd; k++) {
+			uint32_t t = m_aVertexTriangles[k];
+			int cv = findCorner(t, v);
+			if (cv < 0) continue;
+			uint32_t wu = m_aTriangles[t * 3 + findCorner(t, u)], wv = m_aTriangles[t * 3 + cv];
+			int m = 0;
+			while (m < nWedgeMaps && aWedgeFrom[m] != wu) m++;
+			if (m < nWedgeMaps) {
+				if (aWedgeTo[m] != wv) return false;
+			}
+			else {
+				if (nWedgeMaps == 8) return false;
+				aWedgeFrom[nWedgeMaps] = wu;
+				aWedgeTo[nWedgeMaps] = wv;
+				nWedgeMaps++;
+			}
+			nRemoved++;
+			aRemovedPerRegion[m_aTriangleRegions[t]]++;
+		}
+		if (nRemoved == 0) {
+			return false;
+		}
+		if (m_nTriangles - std::min(nRemoved, m_nTriangles) < nTarget && bAllowOvershoot == false) {
+			return false;
+		}
+		for (size_t r = 1; r < m_aRegionCounts.size(); r++) {
+			if (aRemovedPerRegion[r] > 0 && m_aRegionCounts[r] - aRemovedPerRegion[r] < m_aRegionTargets[r]) return false;
+		}
+
+		// link condition: u and v may only share the neighbors of the removed triangles, otherwise the collapse pinches the surface
+		std::vector<uint32_t> aNeighbors;
+		for (uint32_t k = nBegin; k < nEnd; k++) {
+			for (int c = 0; c < 3; c++) aNeighbors.push_back(cornerVertex(m_aVertexTriangles[k], c));
+		}
+		std::sort(aNeighbors.begin(), aNeighbors.end());
+		aNeighbors.erase(std::unique(aNeighbors.begin(), aNeighbors.end()), aNeighbors.end());
+		std::vector<uint32_t> aShared;
+		for (uint32_t k = m_aVertexTriangleOffsets[v]; k < m_aVertexTriangleOffsets[v + 1]; k++) {
+			for (int c = 0; c < 3; c++) {
+				uint32_t w = cornerVertex(m_aVertexTriangles[k], c);
+				if (w != u && w != v && std::binary_search(aNeighbors.begin(), aNeighbors.end(), w)) aShared.push_back(w);
+			}
+		}
+		std::sort(aShared.begin(), aShared.end());
+		if ((size_t)(std::unique(aShared.begin(), aShared.end()) - aShared.begin()) != nRemoved) {
+			return false;
+		}
+
+		// every other triangle of u needs a mapped wedge and must not flip
+		for (uint32_t k = nBegin; k < nEnd; k++) {
+			uint32_t t = m_aVertexTriangles[k];
+			if (findCorner(t, v) >= 0) continue;
+			int cu = findCorner(t, u);
+			uint32_t wu = m_aTriangles[t * 3 + cu];
+			int m = 0;
+			while (m < nWedgeMaps && aWedgeFrom[m] != wu) m++;
+			if (m == nWedgeMaps) return false;
+
+			const double* p[3] = { &m_aPositions[cornerVertex(t, 0) * 3], &m_aPositions[cornerVertex(t, 1) * 3], &m_aPositions[cornerVertex(t, 2) * 3] };
+			double e1[3], e2[3], nOld[3], nNew[3];
+			subtract(p[1], p[0], e1);
+			subtract(p[2], p[0], e2);
+			cross(e1, e2, nOld);
+			p[cu] = &m_aPositions[v * 3];
+			subtract(p[1], p[0], e1);
+			subtract(p[2], p[0], e2);
+			cross(e1, e2, nNew);
+			// more than 60 degrees of rotation is a flip or a sliver standing on its edge
+			double fCosine = dot(nOld, nNew);
+			if (fCosine <= 0.0 || fCosine * fCosine < kMinNormalCosine * kMinNormalCosine * dot(nOld, nOld) * dot(nNew, nNew)) return false;
+		}
+
+		// apply, and lock the neighborhood for the rest of the pass
+		for (uint32_t k = nBegin; k < nEnd; k++) {
+			uint32_t t = m_aVertexTriangles[k];
+			for (int c = 0; c < 3; c++) m_aTouched[cornerVertex(t, c)] = m_nPass;
+			if (findCorner(t, v) >= 0) {
+				m_aTriangleAlive[t] = 0;
+				continue;
+			}
+			int cu = findCorner(t, u);
+			uint32_t wu = m_aTriangles[t * 3 + cu];
+			for (int m = 0; m < nWedgeMaps; m++) {
+				if (aWedgeFrom[m] == wu) m_aTriangles[t * 3 + cu] = aWedgeTo[m];
+			}
+		}
+		m_aQuadrics[v].add(m_aQuadrics[u]);
+		m_nTriangles -= std::min(nRemoved, m_nTriangles);
+		for (size_t r = 0; r < m_aRegionCounts.size(); r++) {
+			m_aRegionCounts[r] -= aRemovedPerRegion[r];
+		}
+		m_fMaxError = std::max(m_fMaxError, collapse.fError);
+		return true;
+	}
+}
+
+bool DzMeshSimplifier::Simplify(DzSimplifyMesh& mesh)
+{
+	Simplifier simplifier(mesh);
+	return simplifier.run();
+}
+
+void DzMeshSimplifier::SimplifyMeshes(std::vector<DzSimplifyMesh>& aMeshes, std::vector<bool>& aResults)
+{
+	std::vector<uint8_t> aSucceeded(aMeshes.size(), 0);
+	// one mesh per work item, the largest meshes dominate anyway
+	DzNativeParallel::For(aMeshes.size(), 1, [&](size_t nBegin, size_t nEnd) {
+		for (size_t m = nBegin; m < nEnd; m++) {
+			aSucceeded[m] = Simplify(aMeshes[m]) ? 1 : 0;
+		}
+	});
+	aResults.assign(aSucceeded.begin(), aSucceeded.end());
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// One mesh to simplify.  Triangles index wedges, the distinct (vertex, UV...) combinations of the mesh corners, and every
+// wedge belongs to one position vertex, so UV seams are the edges where the two triangles use different wedges.
+struct DzSimplifyMesh
+{
+	const float* pPositions = nullptr;      // xyz per vertex
+	size_t nVertices = 0;
+	const int* pWedgeVertices = nullptr;    // vertex of every wedge
+	size_t nWedges = 0;
+	const int* pTriangles = nullptr;        // 3 wedges per triangle
+	size_t nTriangles = 0;
+	const int* pTriangleMaterials = nullptr;  // optional, edges between materials are kept like seams
+
+	// optional per vertex attributes (for example skin weights), collapses between vertices with different attributes
+	// cost fAttributeWeight * squared attribute distance, against squared distances relative to the mesh size
+	const float* pVertexAttributes = nullptr;
+	int nAttributes = 0;
+	float fAttributeWeight = 0.01f;
+
+	// optional region per vertex (0 = none); a triangle belongs to the highest region of its vertices, and region r > 0
+	// keeps at least aRegionRatios[r - 1] of its triangles
+	const int* pVertexRegions = nullptr;
+	std::vector<float> aRegionRatios;
+
+	// triangle counts of the LODs, largest first
+	std::vector<size_t> aLodTargets;
+
+	// results per LOD: 3 wedges per triangle, the input triangle each one comes from (for its material or face data),
+	// and the largest collapse error relative to the mesh size
+	std::vector<std::vector<int> > aLodTriangles;
+	std::vector<std::vector<int> > aLodSourceTriangles;
+	std::vector<double> aLodErrors;
+};
+
+/*****************************
+DzMeshSimplifier
+
+Quadric error metric simplifier (Garland and Heckbert) that produces a whole
+LOD chain in one run, replacing the Decimate modifier ratio search of the
+Game Readiness tools.
+
+Vertices are only removed by half-edge collapses, so every LOD reuses the
+original vertices and wedges and keeps their positions, UVs and weights.
+Each pass classifies the edges, sorts the allowed collapses by their error
+and applies the cheapest ones whose neighborhoods do not overlap, so that
+a pass never works on stale data.  Open borders, UV seams and material
+borders are only simplified along themselves, with extra quadrics that
+keep their shape; vertices where such curves meet or where the mesh is not
+manifold are never removed.  Collapses that flip a triangle are rejected.
+Collapses stop exactly at each LOD target: when one triangle is left to
+remove, only border collapses are taken, unless no other collapse exists.
+If no collapse is possible, the LOD keeps more triangles than its target.
+
+SimplifyMeshes() simplifies the meshes in parallel.
+*****************************/
+class DzMeshSimplifier
+{
+public:
+	// Returns false on invalid input (indices out of range)
+	static bool Simplify(DzSimplifyMesh& mesh);
+	static void SimplifyMeshes(std::vector<DzSimplifyMesh>& aMeshes, std::vector<bool>& aResults);
+};
@@ -0,0 +1,321 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "DzMorphDeltas.h"
+#include "DzNativeParallel.h"
+#include "DzPngStream.h"
+
+namespace
+{
+	const char kMagic[8] = { 'D', 'Z', 'M', 'O', 'R', 'P', 'H', 'S' };
+	// a dense morph of a figure is a pass over every vertex
+	const size_t kMinMorphsPerThread = 4;
+
+	void writeU32(std::vector<uint8_t>& aBytes, uint32_t nValue)
+	{
+		for (int i = 0; i < 4; i++) aBytes.push_back((uint8_t)(nValue >> (i * 8)));
+	}
+
+	void writeF32(std::vector<uint8_t>& aBytes, float fValue)
+	{
+		uint32_t nValue;
+		memcpy(&nValue, &fValue, 4);
+		writeU32(aBytes, nValue);
+	}
+
+	void pad(std::vector<uint8_t>& aBytes)
+	{
+		while (aBytes.size() % 4 != 0) aBytes.push_back(0);
+	}
+
+	void writeString(std::vector<uint8_t>& aBytes, const std::string& sValue)
+	{
+		writeU32(aBytes, (uint32_t)sValue.size());
+		aBytes.insert(aBytes.end(), sValue.begin(), sValue.end());
+		pad(aBytes);
+	}
+
+	struct EncodedMorph
+	{
+		std::vector<uint8_t> aBytes;
+		size_t nDeltas = 0;
+		double fMaxError = 0.0;
+		bool bValid = true;
+	};
+
+	struct MovedVertex
+	{
+		uint32_t nIndex;
+		double aDelta[3];
+		bool operator<(const MovedVertex& other) const { return nIndex < other.nIndex; }
+	};
+
+	void encodeMorph(const DzMorphMesh& mesh, const DzMorphTarget& target, const DzMorphDeltaFile::Settings& settings, EncodedMorph& encoded)
+	{
+		std::vector<MovedVertex> aMoved;
+		for (size_t k = 0; k < target.nPoints; k++) {
+			size_t v = k;
+			if (target.pIndices) {
+				if (target.pIndices[k] < 0) {
+					encoded.bValid = false;
+					return;
+				}
+				v = (size_t)target.pIndices[k];
+			}
+			if (v >= mesh.nVertices) {
+				encoded.bValid = false;
+				return;
+			}
+			MovedVertex moved;
+			moved.nIndex = (uint32_t)v;
+			double fLargest = 0.0;
+			for (int c = 0; c < 3; c++) {
+				moved.aDelta[c] = target.pPoints[k * 4 + c] - mesh.pBasePoints[v * 4 + c];
+				fLargest = std::max(fLargest, fabs(moved.aDelta[c]));
+			}
+			if (fLargest > settings.fThreshold) aMoved.push_back(moved);
+		}
+		if (target.pIndices) {
+			// FBX targets are in any order, a vertex listed twice keeps its first delta
+			std::stable_sort(aMoved.begin(), aMoved.end());
+			aMoved.erase(std::unique(aMoved.begin(), aMoved.end(), [](const MovedVertex& a, const MovedVertex& b) { return a.nIndex == b.nIndex; }), aMoved.end());
+		}
+		encoded.nDeltas = aMoved.size();
+
+		float aOffset[3] = { 0.0f, 0.0f, 0.0f };
+		float aScale[3] = { 1.0f, 1.0f, 1.0f };
+		const int nBits = settings.nQuantizationBits;
+		if (nBits > 0) {
+			const double fSteps = (double)((1u << nBits) - 1);
+			for (int c = 0; c < 3; c++) {
+				double fMin = 0.0, fMax = 0.0;
+				for (size_t i = 0; i < aMoved.size(); i++) {
+					fMin = i == 0 ? aMoved[i].aDelta[c] : std::min(fMin, aMoved[i].aDelta[c]);
+					fMax = i == 0 ? aMoved[i].aDelta[c] : std::max(fMax, aMoved[i].aDelta[c]);
+				}
+				aOffset[c] = (float)fMin;
+				aScale[c] = (float)((fMax - fMin) / fSteps);
+			}
+		}
+
+		std::vector<uint8_t>& aBytes = encoded.aBytes;
+		aBytes.reserve(64 + target.sName.size() + aMoved.size() * (nBits > 0 ? 4 + nBits * 3 / 8 : 16));
+		writeString(aBytes, target.sName);
+		writeF32(aBytes, target.fDefaultValue);
+		writeU32(aBytes, (uint32_t)aMoved.size());
+		writeU32(aBytes, (uint32_t)nBits);
+		for (int c = 0; c < 3; c++) writeF32(aBytes, aOffset[c]);
+		for (int c = 0; c < 3; c++) writeF32(aBytes, aScale[c]);
+		for (size_t i = 0; i < aMoved.size(); i++) writeU32(aBytes, aMoved[i].nIndex);
+		for (size_t i = 0; i < aMoved.size(); i++) {
+			for (int c = 0; c < 3; c++) {
+				const double fDelta = aMoved[i].aDelta[c];
+				float fDecoded;
+				if (nBits == 0) {
+					fDecoded = (float)fDelta;
+					writeF32(aBytes, fDecoded);
+				}
+				else {
+					const uint32_t nMax = (1u << nBits) - 1;
+					uint32_t q = 0;
+					if (aScale[c] > 0.0f) {
+						double fStep = (fDelta - aOffset[c]) / aScale[c];
+						q = (uint32_t)std::min((double)nMax, std::max(0.0, floor(fStep + 0.5)));
+					}
+					// decoded in float, as numpy does in Blender
+					fDecoded = aOffset[c] + (float)q * aScale[c];
+					aBytes.push_back((uint8_t)q);
+					if (nBits == 16) aBytes.push_back((uint8_t)(q >> 8));
+				}
+				encoded.fMaxError = std::max(encoded.fMaxError, fabs((double)fDecoded - fDelta));
+			}
+		}
+		pad(aBytes);
+	}
+
+	class Reader
+	{
+	public:
+		Reader(const std::vector<uint8_t>& aBytes) : m_aBytes(aBytes), m_nPos(0), m_bValid(true) {}
+
+		bool isValid() const { return m_bValid; }
+
+		const uint8_t* take(size_t nBytes)
+		{
+			size_t nPadded = (nBytes + 3) & ~(size_t)3;
+			if (m_bValid == false || nPadded > m_aBytes.size() - m_nPos) {
+				m_bValid = false;
+				return nullptr;
+			}
+			const uint8_t* pData = m_aBytes.data() + m_nPos;
+			m_nPos += nPadded;
+			return pData;
+		}
+
+		uint32_t readU32()
+		{
+			const uint8_t* p = take(4);
+			return p ? (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24) : 0;
+		}
+
+		float readF32()
+		{
+			uint32_t nValue = readU32();
+			float fValue;
+			memcpy(&fValue, &nValue, 4);
+			return fValue;
+		}
+
+		std::string readString()
+		{
+			uint32_t nLength = readU32();
+			const uint8_t* p = take(nLength);
+			return p ? std::string((const char*)p, nLength) : std::string();
+		}
+
+	private:
+		const std::vector<uint8_t>& m_aBytes;
+		size_t m_nPos;
+		bool m_bValid;
+	};
+}
+
+bool DzMorphDeltaFile::Write(const char* sPath, const std::vector<DzMorphMesh>& aMeshes, const Settings& settings, Result& result)
+{
+	result = Result();
+	if (settings.nQuantizationBits != 0 && settings.nQuantizationBits != 8 && settings.nQuantizationBits != 16) {
+		result.sError = "quantization bits must be 0, 8 or 16";
+		return false;
+	}
+
+	std::vector<std::pair<size_t, size_t>> aTargets;
+	for (size_t m = 0; m < aMeshes.size(); m++) {
+		for (size_t t = 0; t < aMeshes[m].aTargets.size(); t++) {
+			aTargets.push_back(std::make_pair(m, t));
+		}
+	}
+	std::vector<EncodedMorph> aEncoded(aTargets.size());
+	DzNativeParallel::For(aTargets.size(), kMinMorphsPerThread, [&](size_t nBegin, size_t nEnd) {
+		for (size_t i = nBegin; i < nEnd; i++) {
+			const DzMorphMesh& mesh = aMeshes[aTargets[i].first];
+			encodeMorph(mesh, mesh.aTargets[aTargets[i].second], settings, aEncoded[i]);
+		}
+	});
+	for (size_t i = 0; i < aTargets.size(); i++) {
+		if (aEncoded[i].bValid == false) {
+			result.sError = "morph \"" + aMeshes[aTargets[i].first].aTargets[aTargets[i].second].sName + "\" has vertex indices out of range";
+			return false;
+		}
+	}
+
+	FILE* pFile = DzOpenFileUtf8(sPath, "wb");
+	if (pFile == nullptr) {
+		result.sError = "unable to open file for writing";
+		return false;
+	}
+	std::vector<uint8_t> aHeader(kMagic, kMagic + 8);
+	writeU32(aHeader, kVersion);
+	writeU32(aHeader, (uint32_t)aMeshes.size());
+	bool bWritten = fwrite(aHeader.data(), 1, aHeader.size(), pFile) == aHeader.size();
+	result.nFileBytes = aHeader.size();
+	size_t i = 0;
+	for (size_t m = 0; m < aMeshes.size() && bWritten; m++) {
+		const DzMorphMesh& mesh = aMeshes[m];
+		aHeader.clear();
+		writeString(aHeader, mesh.sName);
+		writeU32(aHeader, (uint32_t)mesh.nVertices);
+		writeU32(aHeader, (uint32_t)mesh.aTargets.size());
+		bWritten = fwrite(aHeader.data(), 1, aHeader.size(), pFile) == aHeader.size();
+		result.nFileBytes += aHeader.size();
+		for (size_t t = 0; t < mesh.aTargets.size() && bWritten; t++, i++) {
+			const EncodedMorph& encoded = aEncoded[i];
+			bWritten = fwrite(encoded.aBytes.data(), 1, encoded.aBytes.size(), pFile) == encoded.aBytes.size();
+			result.nFileBytes += encoded.aBytes.size();
+			result.nMorphs++;
+			result.nDeltas += encoded.nDeltas;
+			result.nSourceBytes += mesh.aTargets[t].nPoints * (mesh.aTargets[t].pIndices ? 3 * 8 + 4 : 3 * 8);
+			result.fMaxError = std::max(result.fMaxError, encoded.fMaxError);
+		}
+	}
+	if (fclose(pFile) != 0) {
+		bWritten = false;
+	}
+	if (bWritten == false) {
+		result.sError = "unable to write file";
+		return false;
+	}
+	return true;
+}
+
+bool DzMorphDeltaFile::Read(const char* sPath, std::vector<DzMorphDeltaMesh>& aMeshes)
+{
+	aMeshes.clear();
+	FILE* pFile = DzOpenFileUtf8(sPath, "rb");
+	if (pFile == nullptr) {
+		return false;
+	}
+	std::vector<uint8_t> aBytes;
+	uint8_t aBuffer[65536];
+	size_t nRead;
+	while ((nRead = fread(aBuffer, 1, sizeof(aBuffer), pFile)) > 0) {
+		aBytes.insert(aBytes.end(), aBuffer, aBuffer + nRead);
+	}
+	fclose(pFile);
+
+	Reader reader(aBytes);
+	const uint8_t* pMagic = reader.take(8);
+	if (pMagic == nullptr || memcmp(pMagic, kMagic, 8) != 0 || reader.readU32() != kVersion) {
+		return false;
+	}
+	uint32_t nMeshes = reader.readU32();
+	for (uint32_t m = 0; m < nMeshes && reader.isValid(); m++) {
+		DzMorphDeltaMesh mesh;
+		mesh.sName = reader.readString();
+		mesh.nVertices = reader.readU32();
+		uint32_t nMorphs = reader.readU32();
+		for (uint32_t t = 0; t < nMorphs && reader.isValid(); t++) {
+			DzMorphDeltaSet morph;
+			morph.sName = reader.readString();
+			morph.fDefaultValue = reader.readF32();
+			uint32_t nDeltas = reader.readU32();
+			uint32_t nBits = reader.readU32();
+			float aOffset[3], aScale[3];
+			for (int c = 0; c < 3; c++) aOffset[c] = reader.readF32();
+			for (int c = 0; c < 3; c++) aScale[c] = reader.readF32();
+			if (nBits != 0 && nBits != 8 && nBits != 16) {
+				return false;
+			}
+			const uint8_t* pIndices = reader.take((size_t)nDeltas * 4);
+			const uint8_t* pValues = reader.take((size_t)nDeltas * 3 * (nBits == 0 ? 4 : nBits / 8));
+			if (pIndices == nullptr || pValues == nullptr) {
+				return false;
+			}
+			morph.aIndices.resize(nDeltas);
+			morph.aDeltas.resize((size_t)nDeltas * 3);
+			for (uint32_t k = 0; k < nDeltas; k++) {
+				const uint8_t* p = pIndices + k * 4;
+				morph.aIndices[k] = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+				if (morph.aIndices[k] >= mesh.nVertices) {
+					return false;
+				}
+			}
+			for (size_t k = 0; k < (size_t)nDeltas * 3; k++) {
+				int c = (int)(k % 3);
+				if (nBits == 0) {
+					uint32_t nValue = (uint32_t)pValues[k * 4] | ((uint32_t)pValues[k * 4 + 1] << 8) |
+						((uint32_t)pValues[k * 4 + 2] << 16) | ((uint32_t)pValues[k * 4 + 3] << 24);
+					memcpy(&morph.aDeltas[k], &nValue, 4);
+				}
+				else {
+					uint32_t q = nBits == 8 ? pValues[k] : (uint32_t)pValues[k * 2] | ((uint32_t)pValues[k * 2 + 1] << 8);
+					morph.aDeltas[k] = aOffset[c] + (float)q * aScale[c];
+				}
+			}
+			mesh.aMorphs.push_back(morph);
+		}
+		aMeshes.push_back(mesh);
+	}
+	return reader.isValid();
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// One morph target as absolute positions, xyzw doubles as in FbxVector4.  With pIndices the positions are sparse and
+// paired with the indices, otherwise there is one position per base vertex.
+struct DzMorphTarget
+{
+	std::string sName;
+	float fDefaultValue = 0.0f;
+	const double* pPoints = nullptr;
+	const int* pIndices = nullptr;
+	size_t nPoints = 0;
+};
+
+struct DzMorphMesh
+{
+	std::string sName;
+	const double* pBasePoints = nullptr;  // xyzw per vertex
+	size_t nVertices = 0;
+	std::vector<DzMorphTarget> aTargets;
+};
+
+// A morph as read back from the file: its moved vertices in ascending order and their xyz deltas
+struct DzMorphDeltaSet
+{
+	std::string sName;
+	float fDefaultValue = 0.0f;
+	std::vector<uint32_t> aIndices;
+	std::vector<float> aDeltas;
+};
+
+struct DzMorphDeltaMesh
+{
+	std::string sName;
+	uint32_t nVertices = 0;
+	std::vector<DzMorphDeltaSet> aMorphs;
+};
+
+/*****************************
+DzMorphDeltaFile
+
+Binary sidecar for the morphs of an FBX export (the "_morphs.bin" file
+next to the FBX, read by load_sparse_morphs() in blender_tools.py).  Every
+morph keeps only the vertices it moves, as ascending vertex indices and
+xyz deltas from the base mesh.  The deltas are floats, or 8 or 16 bit
+values quantized to the per-axis range of the morph, which bounds the
+error to half a step of that range.
+
+All values are little-endian and 4-byte aligned, strings are a uint32 byte
+count and UTF-8 bytes padded to 4:
+    "DZMORPHS", uint32 version, uint32 mesh count
+    per mesh:  string name, uint32 vertex count, uint32 morph count
+    per morph: string name, float default value, uint32 delta count,
+               uint32 bits (0 = float), float offset[3], float scale[3],
+               uint32 indices[count], deltas[count * 3] padded to 4
+Quantized deltas decode as offset + value * scale.  The morphs are
+encoded in parallel and written in order.
+*****************************/
+class DzMorphDeltaFile
+{
+public:
+	static const uint32_t kVersion = 1;
+
+	struct Settings
+	{
+		// vertices that move less than this on every axis are left out
+		double fThreshold = 1e-5;
+		// 0 stores float deltas, 8 or 16 quantize them
+		int nQuantizationBits = 0;
+	};
+
+	struct Result
+	{
+		std::string sError;
+		size_t nMorphs = 0;
+		size_t nDeltas = 0;
+		// the morph targets as given: 3 doubles per point, plus an index for sparse targets
+		size_t nSourceBytes = 0;
+		size_t nFileBytes = 0;
+		// largest difference between a stored and an exact delta component
+		double fMaxError = 0.0;
+	};
+
+	// sPath is UTF-8.  Fails on other quantization bits and indices out of range.
+	static bool Write(const char* sPath, const std::vector<DzMorphMesh>& aMeshes, const Settings& settings, Result& result);
+	static bool Read(const char* sPath, std::vector<DzMorphDeltaMesh>& aMeshes);
+};
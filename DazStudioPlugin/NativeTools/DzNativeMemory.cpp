@@ -0,0 +1,91 @@
+#include "DzNativeMemory.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+// version 2 maps GetProcessMemoryInfo to the kernel32 export, so no psapi.lib is needed
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/sysctl.h>
+#endif
+#endif
+
+uint64_t DzNativeMemory::GetPeakResidentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE) {
+		return 0;
+	}
+	return (uint64_t)counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#if defined(__APPLE__)
+	return (uint64_t)usage.ru_maxrss;
+#else
+	// kilobytes on Linux
+	return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+uint64_t DzNativeMemory::GetAvailablePhysicalBytes()
+{
+#if defined(_WIN32)
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	if (GlobalMemoryStatusEx(&status) == FALSE) {
+		return 0;
+	}
+	return (uint64_t)status.ullAvailPhys;
+#elif defined(__APPLE__)
+	vm_statistics64_data_t vmStats;
+	mach_msg_type_number_t nCount = HOST_VM_INFO64_COUNT;
+	if (host_statistics64(mach_host_self(), HOST_VM_INFO64, (host_info64_t)&vmStats, &nCount) != KERN_SUCCESS) {
+		return 0;
+	}
+	return ((uint64_t)vmStats.free_count + vmStats.inactive_count) * (uint64_t)sysconf(_SC_PAGESIZE);
+#else
+	long nPages = sysconf(_SC_AVPHYS_PAGES);
+	long nPageSize = sysconf(_SC_PAGESIZE);
+	if (nPages <= 0 || nPageSize <= 0) {
+		return 0;
+	}
+	return (uint64_t)nPages * (uint64_t)nPageSize;
+#endif
+}
+
+uint64_t DzNativeMemory::GetTotalPhysicalBytes()
+{
+#if defined(_WIN32)
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	if (GlobalMemoryStatusEx(&status) == FALSE) {
+		return 0;
+	}
+	return (uint64_t)status.ullTotalPhys;
+#elif defined(__APPLE__)
+	uint64_t nBytes = 0;
+	size_t nSize = sizeof(nBytes);
+	if (sysctlbyname("hw.memsize", &nBytes, &nSize, nullptr, 0) != 0) {
+		return 0;
+	}
+	return nBytes;
+#else
+	long nPages = sysconf(_SC_PHYS_PAGES);
+	long nPageSize = sysconf(_SC_PAGESIZE);
+	if (nPages <= 0 || nPageSize <= 0) {
+		return 0;
+	}
+	return (uint64_t)nPages * (uint64_t)nPageSize;
+#endif
+}
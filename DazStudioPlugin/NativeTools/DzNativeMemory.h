@@ -0,0 +1,21 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************
+DzNativeMemory
+
+Process and system memory statistics for the texture job reports and the
+texture memory budget.
+*****************************/
+class DzNativeMemory
+{
+public:
+	// Peak resident set size (working set on Windows) of the whole process, 0 if unknown
+	static uint64_t GetPeakResidentBytes();
+	// Physical memory available to new allocations without paging (free plus reclaimable file cache where
+	// the OS reports it), 0 if unknown
+	static uint64_t GetAvailablePhysicalBytes();
+	// Installed physical memory, 0 if unknown
+	static uint64_t GetTotalPhysicalBytes();
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <stddef.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/*****************************
+DzNativeParallel
+
+Minimal parallel-for over an index range.  The range is cut into one
+contiguous chunk per thread; ranges smaller than nMinChunk run on the
+calling thread.
+*****************************/
+class DzNativeParallel
+{
+public:
+	static int GetNumThreads()
+	{
+		int nThreads = NumThreadsSetting();
+		if (nThreads <= 0) {
+			nThreads = (int)std::thread::hardware_concurrency();
+		}
+		return nThreads > 0 ? nThreads : 1;
+	}
+
+	static void SetNumThreads(int nThreads) { NumThreadsSetting() = nThreads; }
+
+	// fnBody(nBegin, nEnd) is called once per chunk
+	template <typename Function>
+	static void For(size_t nCount, size_t nMinChunk, Function fnBody)
+	{
+		size_t nThreads = (size_t)GetNumThreads();
+		if (nMinChunk < 1) nMinChunk = 1;
+		nThreads = std::min(nThreads, nCount / nMinChunk);
+		if (nThreads <= 1) {
+			fnBody((size_t)0, nCount);
+			return;
+		}
+		size_t nChunk = (nCount + nThreads - 1) / nThreads;
+		std::vector<std::thread> aWorkers;
+		aWorkers.reserve(nThreads - 1);
+		for (size_t t = 1; t < nThreads; t++) {
+			size_t nBegin = t * nChunk;
+			size_t nEnd = std::min(nCount, nBegin + nChunk);
+			if (nBegin >= nEnd) break;
+			aWorkers.push_back(std::thread(fnBody, nBegin, nEnd));
+		}
+		fnBody((size_t)0, std::min(nCount, nChunk));
+		for (size_t t = 0; t < aWorkers.size(); t++) {
+			aWorkers[t].join();
+		}
+	}
+
+private:
+	static int& NumThreadsSetting()
+	{
+		static int nThreads = 0;
+		return nThreads;
+	}
+};
@@ -0,0 +1,369 @@
+#include "DzNativeTools.h"
+#include "DzImageKernels.h"
+#include "DzCpuFeatures.h"
+#include "DzNativeParallel.h"
+#include "DzAtlasBaker.h"
+#include "DzUVPacker.h"
+#include "DzMeshSimplifier.h"
+#include "DzMeshOcclusion.h"
+#include "DzClothFitter.h"
+#include "DzWeightTransfer.h"
+#include "DzPngStream.h"
+
+#include <algorithm>
+#include <vector>
+
+struct DzNativeAtlas
+{
+	DzNativeAtlas(int nWidth, int nHeight, int nMaxSamples) : oBaker(nWidth, nHeight, nMaxSamples) {}
+	DzAtlasBaker oBaker;
+};
+
+namespace
+{
+	// below this many pixels, starting threads costs more than it saves
+	const size_t kMinPixelsPerThread = 256 * 1024;
+
+	// same as Blender's unit_float_to_uchar_clamp
+	inline uint32_t floatToByte(float fValue)
+	{
+		return fValue <= 0.0f ? 0 : (fValue > 1.0f - 0.5f / 255.0f ? 255 : (uint32_t)(255.0f * fValue + 0.5f));
+	}
+}
+
+int dznative_get_api_version(void)
+{
+	return DZ_NATIVETOOLS_API_VERSION;
+}
+
+const char* dznative_get_simd_level(void)
+{
+	return DzCpuFeatures::GetSimdLevelName(DzCpuFeatures::GetSimdLevel());
+}
+
+const char* dznative_set_simd_level(const char* sLevel)
+{
+	DzCpuFeatures::SimdLevel eLevel;
+	if (DzCpuFeatures::ParseSimdLevelName(sLevel, eLevel)) {
+		DzCpuFeatures::SetSimdLevel(eLevel);
+	}
+	return dznative_get_simd_level();
+}
+
+void dznative_set_num_threads(int nThreads)
+{
+	DzNativeParallel::SetNumThreads(nThreads);
+}
+
+void dznative_combine_color_and_alpha_u8(uint32_t* pDst, const uint32_t* pColor, const uint32_t* pAlpha, size_t nPixels)
+{
+	if (!pDst || !pColor || !pAlpha) return;
+	DzNativeParallel::For(nPixels, kMinPixelsPerThread, [=](size_t nBegin, size_t nEnd) {
+		DzImageKernels::CombineColorAndAlpha(pDst + nBegin, pColor + nBegin, pAlpha + nBegin, nEnd - nBegin);
+	});
+}
+
+void dznative_multiply_by_color_u8(uint32_t* pPixels, size_t nPixels, uint32_t nColor)
+{
+	if (!pPixels) return;
+	DzNativeParallel::For(nPixels, kMinPixelsPerThread, [=](size_t nBegin, size_t nEnd) {
+		DzImageKernels::MultiplyByColor(pPixels + nBegin, nEnd - nBegin, nColor);
+	});
+}
+
+void dznative_srgb_to_linear_u8(uint32_t* pPixels, size_t nPixels)
+{
+	if (!pPixels) return;
+	DzNativeParallel::For(nPixels, kMinPixelsPerThread, [=](size_t nBegin, size_t nEnd) {
+		DzImageKernels::SrgbToLinear(pPixels + nBegin, nEnd - nBegin);
+	});
+}
+
+void dznative_linear_to_srgb_u8(uint32_t* pPixels, size_t nPixels)
+{
+	if (!pPixels) return;
+	DzNativeParallel::For(nPixels, kMinPixelsPerThread, [=](size_t nBegin, size_t nEnd) {
+		DzImageKernels::LinearToSrgb(pPixels + nBegin, nEnd - nBegin);
+	});
+}
+
+void dznative_intensity_to_alpha_f32(float* pDst, const float* pSrc, size_t nPixels)
+{
+	if (!pDst || !pSrc) return;
+	DzNativeParallel::For(nPixels, kMinPixelsPerThread, [=](size_t nBegin, size_t nEnd) {
+		DzImageKernels::IntensityToAlphaF32(pDst + nBegin * 4, pSrc + nBegin * 4, nEnd - nBegin);
+	});
+}
+
+void dznative_srgb_to_linear_f32(float* pData, size_t nPixels, int nChannels)
+{
+	if (!pData || nChannels < 1 || nChannels > 4) return;
+	DzNativeParallel::For(nPixels, kMinPixelsPerThread, [=](size_t nBegin, size_t nEnd) {
+		DzImageKernels::SrgbToLinearF32(pData + nBegin * nChannels, nEnd - nBegin, nChannels);
+	});
+}
+
+void dznative_linear_to_srgb_f32(float* pData, size_t nPixels, int nChannels)
+{
+	if (!pData || nChannels < 1 || nChannels > 4) return;
+	DzNativeParallel::For(nPixels, kMinPixelsPerThread, [=](size_t nBegin, size_t nEnd) {
+		DzImageKernels::LinearToSrgbF32(pData + nBegin * nChannels, nEnd - nBegin, nChannels);
+	});
+}
+
+DzNativeAtlas* dznative_atlas_create(int nWidth, int nHeight, int nMaxSamples)
+{
+	if (nWidth <= 0 || nHeight <= 0) return nullptr;
+	return new DzNativeAtlas(nWidth, nHeight, nMaxSamples);
+}
+
+void dznative_atlas_destroy(DzNativeAtlas* pAtlas)
+{
+	delete pAtlas;
+}
+
+void dznative_atlas_set_target(DzNativeAtlas* pAtlas, int nChannel, float* pPixels)
+{
+	if (!pAtlas) return;
+	pAtlas->oBaker.setTarget((DzAtlasBaker::Channel)nChannel, pPixels);
+}
+
+void dznative_atlas_bake(DzNativeAtlas* pAtlas, const float* pSourceUVs, const float* pAtlasUVs, size_t nTriangles, const DzNativeAtlasSource* aSources)
+{
+	if (!pAtlas || !aSources) return;
+	DzAtlasSource aBakerSources[DzAtlasBaker::ChannelCount];
+	for (int i = 0; i < DzAtlasBaker::ChannelCount; i++) {
+		const DzNativeAtlasSource& source = aSources[i];
+		DzAtlasSource& bakerSource = aBakerSources[i];
+		if (source.pPixels && source.nWidth > 0 && source.nHeight > 0 && source.nChannels >= 1 && source.nChannels <= 4) {
+			bakerSource.pPixels = source.pPixels;
+			bakerSource.nWidth = source.nWidth;
+			bakerSource.nHeight = source.nHeight;
+			bakerSource.nChannels = source.nChannels;
+		}
+		bakerSource.bSrgb = source.bSrgb != 0;
+		bakerSource.bAlphaOutput = source.bAlphaOutput != 0;
+		for (int k = 0; k < 2; k++) bakerSource.aScale[k] = source.aScale[k];
+		for (int k = 0; k < 4; k++) bakerSource.aValue[k] = source.aValue[k];
+		bakerSource.fStrength = source.fStrength;
+	}
+	pAtlas->oBaker.bakeTriangles(pSourceUVs, pAtlasUVs, nTriangles, aBakerSources);
+}
+
+void dznative_atlas_dilate(DzNativeAtlas* pAtlas, int nMargin)
+{
+	if (!pAtlas) return;
+	pAtlas->oBaker.dilate(nMargin);
+}
+
+size_t dznative_atlas_get_covered_pixels(const DzNativeAtlas* pAtlas)
+{
+	return pAtlas ? pAtlas->oBaker.getCoveredPixels() : 0;
+}
+
+int dznative_pack_uv_islands(const int* pFaceLoopStarts, const int* pFaceLoopCounts, size_t nFaces,
+	const int* pLoopVertices, const float* pLoopUVs, size_t nLoops, const float* pFaceDensities,
+	int nAtlasSize, float fMarginPixels, int bRotate, float* pOutUVs, float* pCoverage)
+{
+	DzUVPackSettings settings;
+	settings.nAtlasSize = nAtlasSize;
+	settings.fMarginPixels = fMarginPixels;
+	settings.bRotate = bRotate != 0;
+	DzUVPacker packer(settings);
+	if (packer.pack(pFaceLoopStarts, pFaceLoopCounts, nFaces, pLoopVertices, pLoopUVs, nLoops, pFaceDensities, pOutUVs) == false) {
+		return -1;
+	}
+	if (pCoverage) {
+		*pCoverage = (float)packer.getCoverage();
+	}
+	return packer.getIslandCount();
+}
+
+int dznative_simplify_meshes(DzNativeSimplifyMesh* aMeshes, size_t nMeshes)
+{
+	std::vector<DzSimplifyMesh> aSimplifyMeshes(nMeshes);
+	for (size_t m = 0; m < nMeshes; m++) {
+		const DzNativeSimplifyMesh& source = aMeshes[m];
+		DzSimplifyMesh& mesh = aSimplifyMeshes[m];
+		mesh.pPositions = source.pPositions;
+		mesh.nVertices = source.nVertices;
+		mesh.pWedgeVertices = source.pWedgeVertices;
+		mesh.nWedges = source.nWedges;
+		mesh.pTriangles = source.pTriangles;
+		mesh.nTriangles = source.nTriangles;
+		mesh.pTriangleMaterials = source.pTriangleMaterials;
+		mesh.pVertexAttributes = source.pVertexAttributes;
+		mesh.nAttributes = source.pVertexAttributes ? source.nAttributes : 0;
+		mesh.fAttributeWeight = source.fAttributeWeight;
+		mesh.pVertexRegions = source.pVertexRegions;
+		if (source.pRegionRatios) {
+			mesh.aRegionRatios.assign(source.pRegionRatios, source.pRegionRatios + source.nRegions);
+		}
+		for (int l = 0; l < source.nLods; l++) {
+			mesh.aLodTargets.push_back(source.pLodTargets[l] > 0 ? (size_t)source.pLodTargets[l] : 0);
+		}
+	}
+	std::vector<bool> aResults;
+	DzMeshSimplifier::SimplifyMeshes(aSimplifyMeshes, aResults);
+
+	int nFailed = 0;
+	for (size_t m = 0; m < nMeshes; m++) {
+		const DzNativeSimplifyMesh& target = aMeshes[m];
+		const DzSimplifyMesh& mesh = aSimplifyMeshes[m];
+		for (int l = 0; l < target.nLods; l++) {
+			if (aResults[m] == false || (size_t)l >= mesh.aLodTriangles.size()) {
+				target.pOutTriangleCounts[l] = -1;
+				target.pOutErrors[l] = 0.0f;
+				continue;
+			}
+			const std::vector<int>& aTriangles = mesh.aLodTriangles[l];
+			const std::vector<int>& aSources = mesh.aLodSourceTriangles[l];
+			std::copy(aTriangles.begin(), aTriangles.end(), target.pOutTriangles + (size_t)l * target.nTriangles * 3);
+			std::copy(aSources.begin(), aSources.end(), target.pOutSourceTriangles + (size_t)l * target.nTriangles);
+			target.pOutTriangleCounts[l] = (int)aSources.size();
+			target.pOutErrors[l] = (float)mesh.aLodErrors[l];
+		}
+		if (aResults[m] == false) nFailed++;
+	}
+	return nFailed;
+}
+
+int dznative_find_obscured_faces(const float* pPositions, size_t nVertices, const int* pFaceLoopStarts,
+	const int* pFaceLoopCounts, const float* pFaceNormals, size_t nFaces, const int* pLoopVertices, size_t nLoops,
+	const int* pTriangleVertices, const int* pTriangleFaces, size_t nTriangles, float fOffset, float fThreshold, uint8_t* pOutObscured)
+{
+	DzOcclusionMesh mesh;
+	mesh.pPositions = pPositions;
+	mesh.nVertices = nVertices;
+	mesh.pFaceLoopStarts = pFaceLoopStarts;
+	mesh.pFaceLoopCounts = pFaceLoopCounts;
+	mesh.pFaceNormals = pFaceNormals;
+	mesh.nFaces = nFaces;
+	mesh.pLoopVertices = pLoopVertices;
+	mesh.nLoops = nLoops;
+	mesh.pTriangles = pTriangleVertices;
+	mesh.pTriangleFaces = pTriangleFaces;
+	mesh.nTriangles = nTriangles;
+	std::vector<uint8_t> aObscured;
+	DzOcclusionStats stats;
+	if (DzMeshOcclusion::FindObscuredFaces(mesh, fOffset, fThreshold, aObscured, &stats) == false) {
+		return -1;
+	}
+	std::copy(aObscured.begin(), aObscured.end(), pOutObscured);
+	return (int)stats.nObscuredFaces;
+}
+
+namespace
+{
+	DzFitMesh toFitMesh(const DzNativeFitMesh& source)
+	{
+		DzFitMesh mesh;
+		mesh.pPositions = source.pPositions;
+		mesh.nVertices = source.nVertices;
+		mesh.pFaceLoopStarts = source.pFaceLoopStarts;
+		mesh.pFaceLoopCounts = source.pFaceLoopCounts;
+		mesh.nFaces = source.nFaces;
+		mesh.pLoopVertices = source.pLoopVertices;
+		mesh.nLoops = source.nLoops;
+		mesh.pTriangles = source.pTriangleVertices;
+		mesh.pTriangleFaces = source.pTriangleFaces;
+		mesh.nTriangles = source.nTriangles;
+		mesh.pWeightVertices = source.pWeightVertices;
+		mesh.pWeightGroups = source.pWeightGroups;
+		mesh.pWeights = source.pWeights;
+		mesh.nWeights = source.pWeights ? source.nWeights : 0;
+		return mesh;
+	}
+}
+
+int dznative_autofit_mesh(const DzNativeFitMesh* pSource, const DzNativeFitMesh* pTarget, int nGroups,
+	float fFitRatio, float fDistanceCutoff, int nPass1Iterations, int nPass2Iterations, int bLockTaggedVertices,
+	int bCheckSelfPokeThrough, float* pOutPositions, uint8_t* pOutTagged, int* pOutStats)
+{
+	if (pSource == nullptr || pTarget == nullptr || nGroups < 0) {
+		return -1;
+	}
+	DzFitSettings settings;
+	settings.fFitRatio = fFitRatio;
+	settings.fDistanceCutoff = fDistanceCutoff;
+	settings.nPass1Iterations = nPass1Iterations;
+	settings.nPass2Iterations = nPass2Iterations;
+	settings.bLockTaggedVertices = bLockTaggedVertices != 0;
+	settings.bCheckSelfPokeThrough = bCheckSelfPokeThrough != 0;
+	settings.nGroups = nGroups;
+	std::vector<float> aPositions;
+	std::vector<uint8_t> aTagged;
+	DzFitStats stats;
+	if (DzClothFitter::Fit(toFitMesh(*pSource), toFitMesh(*pTarget), settings, aPositions, aTagged, &stats) == false) {
+		return -1;
+	}
+	std::copy(aPositions.begin(), aPositions.end(), pOutPositions);
+	std::copy(aTagged.begin(), aTagged.end(), pOutTagged);
+	if (pOutStats) {
+		pOutStats[0] = stats.nPass1Iterations;
+		pOutStats[1] = stats.nPass2Iterations;
+		pOutStats[2] = (int)stats.nFlipReverts;
+		pOutStats[3] = (int)stats.nPokeThroughReverts;
+		pOutStats[4] = (int)stats.nMovedFaces;
+		pOutStats[5] = stats.bAborted ? 1 : 0;
+	}
+	return (int)stats.nTaggedVertices;
+}
+
+int dznative_transfer_weights(const float* pSourcePositions, size_t nSourceVertices, const int* pSourceTriangles,
+	size_t nSourceTriangles, const int* pWeightVertices, const int* pWeightGroups, const float* pWeights, size_t nWeights,
+	const float* pTargetPositions, size_t nTargetPoints, float fMaxDistance, int nMaxInfluences, float fMinWeight,
+	int* pOutGroups, float* pOutWeights)
+{
+	if (nMaxInfluences < 1) {
+		return -1;
+	}
+	DzWeightTransferSource source;
+	source.pPositions = pSourcePositions;
+	source.nVertices = nSourceVertices;
+	source.pTriangles = pSourceTriangles;
+	source.nTriangles = nSourceTriangles;
+	source.pWeightVertices = pWeightVertices;
+	source.pWeightGroups = pWeightGroups;
+	source.pWeights = pWeights;
+	source.nWeights = pWeights ? nWeights : 0;
+	DzWeightTransferSettings settings;
+	settings.fMaxDistance = fMaxDistance;
+	settings.nMaxInfluences = nMaxInfluences;
+	settings.fMinWeight = fMinWeight;
+	std::vector<int> aGroups;
+	std::vector<float> aWeights;
+	DzWeightTransferStats stats;
+	if (DzWeightTransfer::Transfer(source, pTargetPositions, nTargetPoints, settings, aGroups, aWeights, nullptr, &stats) == false) {
+		return -1;
+	}
+	std::copy(aGroups.begin(), aGroups.end(), pOutGroups);
+	std::copy(aWeights.begin(), aWeights.end(), pOutWeights);
+	return (int)stats.nUnmatchedPoints;
+}
+
+int dznative_write_png_f32(const char* sPath, const float* pPixels, int nWidth, int nHeight, int nChannels,
+	int bAlpha, int nCompressionLevel)
+{
+	if (!sPath || !pPixels || nWidth <= 0 || nHeight <= 0 || nChannels < 1 || nChannels > 4) return -1;
+	std::vector<uint32_t> aPixels((size_t)nWidth * nHeight);
+	DzNativeParallel::For((size_t)nHeight, 16, [&](size_t nBegin, size_t nEnd) {
+		for (size_t y = nBegin; y < nEnd; y++) {
+			// PNG rows are top row first
+			const float* pSource = pPixels + ((size_t)nHeight - 1 - y) * nWidth * nChannels;
+			uint32_t* pTarget = aPixels.data() + y * nWidth;
+			for (int x = 0; x < nWidth; x++) {
+				const float* p = pSource + (size_t)x * nChannels;
+				uint32_t nR = floatToByte(p[0]);
+				uint32_t nG = nChannels >= 3 ? floatToByte(p[1]) : nR;
+				uint32_t nB = nChannels >= 3 ? floatToByte(p[2]) : nR;
+				uint32_t nA = nChannels == 4 ? floatToByte(p[3]) : (nChannels == 2 ? floatToByte(p[1]) : 255);
+				pTarget[x] = (nA << 24) | (nR << 16) | (nG << 8) | nB;
+			}
+		}
+	});
+	DzPngWriteSettings settings;
+	settings.nCompressionLevel = nCompressionLevel;
+	std::string sError;
+	return DzPngImageWriter::Write(sPath, aPixels.data(), nWidth, nHeight, nWidth, bAlpha != 0, settings, sError) ? 0 : -1;
+}
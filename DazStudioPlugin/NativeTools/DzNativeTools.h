@@ -0,0 +1,160 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************
+DzNativeTools C API
+
+Plain C entry points for the dzblendernative shared library, which is loaded
+by the Blender scripts through ctypes (see native_tools.py).  Buffers are
+owned by the caller.  Large buffers are split across worker threads.
+*****************************/
+
+#if defined(DZ_NATIVETOOLS_SHARED)
+#if defined(_WIN32)
+#define DZ_NATIVETOOLS_API __declspec(dllexport)
+#else
+#define DZ_NATIVETOOLS_API __attribute__((visibility("default")))
+#endif
+#else
+#define DZ_NATIVETOOLS_API
+#endif
+
+// Bump whenever an exported signature changes, native_tools.py refuses to load other versions
+#define DZ_NATIVETOOLS_API_VERSION 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+DZ_NATIVETOOLS_API int dznative_get_api_version(void);
+// "scalar", "sse4.1" or "avx2"
+DZ_NATIVETOOLS_API const char* dznative_get_simd_level(void);
+// Returns the level actually used, which is never higher than what the CPU supports
+DZ_NATIVETOOLS_API const char* dznative_set_simd_level(const char* sLevel);
+// 0 = one thread per core
+DZ_NATIVETOOLS_API void dznative_set_num_threads(int nThreads);
+
+// 8-bit ARGB32 pixels (0xAARRGGBB words)
+DZ_NATIVETOOLS_API void dznative_combine_color_and_alpha_u8(uint32_t* pDst, const uint32_t* pColor, const uint32_t* pAlpha, size_t nPixels);
+DZ_NATIVETOOLS_API void dznative_multiply_by_color_u8(uint32_t* pPixels, size_t nPixels, uint32_t nColor);
+DZ_NATIVETOOLS_API void dznative_srgb_to_linear_u8(uint32_t* pPixels, size_t nPixels);
+DZ_NATIVETOOLS_API void dznative_linear_to_srgb_u8(uint32_t* pPixels, size_t nPixels);
+
+// Interleaved float pixels, as in Blender's Image.pixels
+DZ_NATIVETOOLS_API void dznative_intensity_to_alpha_f32(float* pDst, const float* pSrc, size_t nPixels);
+DZ_NATIVETOOLS_API void dznative_srgb_to_linear_f32(float* pData, size_t nPixels, int nChannels);
+DZ_NATIVETOOLS_API void dznative_linear_to_srgb_f32(float* pData, size_t nPixels, int nChannels);
+
+// Texture atlas baker, see DzAtlasBaker.h.  Channels: 0 diffuse, 1 alpha, 2 normal, 3 metallic, 4 roughness
+typedef struct DzNativeAtlas DzNativeAtlas;
+typedef struct DzNativeAtlasSource
+{
+	const float* pPixels;   // NULL = constant aValue
+	int nWidth;
+	int nHeight;
+	int nChannels;
+	int bSrgb;
+	int bAlphaOutput;
+	float aScale[2];
+	float aValue[4];
+	float fStrength;
+} DzNativeAtlasSource;
+
+DZ_NATIVETOOLS_API DzNativeAtlas* dznative_atlas_create(int nWidth, int nHeight, int nMaxSamples);
+DZ_NATIVETOOLS_API void dznative_atlas_destroy(DzNativeAtlas* pAtlas);
+// pPixels is RGBA float, nWidth * nHeight * 4, and must stay alive until the atlas is destroyed
+DZ_NATIVETOOLS_API void dznative_atlas_set_target(DzNativeAtlas* pAtlas, int nChannel, float* pPixels);
+// aSources holds one entry per channel
+DZ_NATIVETOOLS_API void dznative_atlas_bake(DzNativeAtlas* pAtlas, const float* pSourceUVs, const float* pAtlasUVs, size_t nTriangles, const DzNativeAtlasSource* aSources);
+DZ_NATIVETOOLS_API void dznative_atlas_dilate(DzNativeAtlas* pAtlas, int nMargin);
+DZ_NATIVETOOLS_API size_t dznative_atlas_get_covered_pixels(const DzNativeAtlas* pAtlas);
+
+// UV island packer, see DzUVPacker.h.  Faces are loop ranges as in Blender's Mesh, pFaceDensities may be NULL.
+// Returns the number of islands, or -1 on invalid input.  pCoverage (optional) receives the covered fraction of the unit square.
+DZ_NATIVETOOLS_API int dznative_pack_uv_islands(const int* pFaceLoopStarts, const int* pFaceLoopCounts, size_t nFaces,
+	const int* pLoopVertices, const float* pLoopUVs, size_t nLoops, const float* pFaceDensities,
+	int nAtlasSize, float fMarginPixels, int bRotate, float* pOutUVs, float* pCoverage);
+
+// LOD chain simplifier, see DzMeshSimplifier.h.  Triangles index wedges, every wedge belongs to one vertex.
+// pTriangleMaterials, pVertexAttributes and pVertexRegions may be NULL.  The outputs hold nTriangles entries per LOD:
+// LOD l writes pOutTriangleCounts[l] triangles to pOutTriangles + l * nTriangles * 3, their input triangles to
+// pOutSourceTriangles + l * nTriangles, and its largest error relative to the mesh size to pOutErrors[l].
+typedef struct DzNativeSimplifyMesh
+{
+	const float* pPositions;
+	size_t nVertices;
+	const int* pWedgeVertices;
+	size_t nWedges;
+	const int* pTriangles;
+	size_t nTriangles;
+	const int* pTriangleMaterials;
+	const float* pVertexAttributes;
+	int nAttributes;
+	float fAttributeWeight;
+	const int* pVertexRegions;   // 0 = none, region r keeps at least pRegionRatios[r - 1] of its triangles
+	const float* pRegionRatios;
+	int nRegions;
+	const int* pLodTargets;      // triangle counts, largest first
+	int nLods;
+	int* pOutTriangles;
+	int* pOutSourceTriangles;
+	int* pOutTriangleCounts;
+	float* pOutErrors;
+} DzNativeSimplifyMesh;
+
+// Simplifies the meshes in parallel.  Returns the number of meshes with invalid input, their triangle counts are set to -1.
+DZ_NATIVETOOLS_API int dznative_simplify_meshes(DzNativeSimplifyMesh* aMeshes, size_t nMeshes);
+
+// Hidden surface removal, see DzMeshOcclusion.h.  Faces are loop ranges as in Blender's Mesh with normalized face normals,
+// the triangles (3 vertices each) and their faces are Blender's loop triangles.  pOutObscured receives 1 for every face
+// to remove.  Returns the number of those faces, or -1 on invalid input.
+DZ_NATIVETOOLS_API int dznative_find_obscured_faces(const float* pPositions, size_t nVertices, const int* pFaceLoopStarts,
+	const int* pFaceLoopCounts, const float* pFaceNormals, size_t nFaces, const int* pLoopVertices, size_t nLoops,
+	const int* pTriangleVertices, const int* pTriangleFaces, size_t nTriangles, float fOffset, float fThreshold, uint8_t* pOutObscured);
+
+// Clothing auto-fit, see DzClothFitter.h.  Faces and triangles as for dznative_find_obscured_faces, the vertex group
+// weights are (vertex, group, weight) entries with groups below nGroups, numbered the same on both meshes.
+typedef struct DzNativeFitMesh
+{
+	const float* pPositions;
+	size_t nVertices;
+	const int* pFaceLoopStarts;
+	const int* pFaceLoopCounts;
+	size_t nFaces;
+	const int* pLoopVertices;
+	size_t nLoops;
+	const int* pTriangleVertices;
+	const int* pTriangleFaces;
+	size_t nTriangles;
+	const int* pWeightVertices;
+	const int* pWeightGroups;
+	const float* pWeights;
+	size_t nWeights;
+} DzNativeFitMesh;
+
+// Fits pSource (the clothing) onto pTarget (the body).  pOutPositions receives the fitted clothing positions, pOutTagged 1
+// for every vertex whose move was undone.  pOutStats (optional) receives 6 values: the pass 1 and pass 2 iterations run,
+// the faces flipped and the vertices poked through by a move, the faces moved by pass 2 and 1 if the fit stopped at a
+// flipped face.  Returns the number of tagged vertices, or -1 on invalid input.
+DZ_NATIVETOOLS_API int dznative_autofit_mesh(const DzNativeFitMesh* pSource, const DzNativeFitMesh* pTarget, int nGroups,
+	float fFitRatio, float fDistanceCutoff, int nPass1Iterations, int nPass2Iterations, int bLockTaggedVertices,
+	int bCheckSelfPokeThrough, float* pOutPositions, uint8_t* pOutTagged, int* pOutStats);
+
+// Closest point weight transfer, see DzWeightTransfer.h.  The weights are (vertex, group, weight) entries of the source
+// vertices.  pOutGroups and pOutWeights receive nMaxInfluences entries per target point, largest first, unused entries
+// have group -1.  fMaxDistance 0 = no limit.  Returns the number of points without weights, or -1 on invalid input.
+DZ_NATIVETOOLS_API int dznative_transfer_weights(const float* pSourcePositions, size_t nSourceVertices, const int* pSourceTriangles,
+	size_t nSourceTriangles, const int* pWeightVertices, const int* pWeightGroups, const float* pWeights, size_t nWeights,
+	const float* pTargetPositions, size_t nTargetPoints, float fMaxDistance, int nMaxInfluences, float fMinWeight,
+	int* pOutGroups, float* pOutWeights);
+
+// Parallel PNG encoder, see DzPngImageWriter.  pPixels are Blender Image.pixels (float, bottom row first, nChannels 1-4),
+// converted to 8 bits with Blender's rounding, so a byte image is written with exactly its own pixels.
+// bAlpha writes RGBA instead of RGB.  nCompressionLevel 0 (fastest) to 9 (smallest).  Returns 0 on success.
+DZ_NATIVETOOLS_API int dznative_write_png_f32(const char* sPath, const float* pPixels, int nWidth, int nHeight, int nChannels,
+	int bAlpha, int nCompressionLevel);
+
+#ifdef __cplusplus
+}
+#endif
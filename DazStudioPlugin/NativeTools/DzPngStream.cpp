@@ -0,0 +1,696 @@
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "DzPngStream.h"
+#include "DzNativeParallel.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace
+{
+	const uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	const size_t kImageDataChunkSize = 65536;
+	const size_t kSegmentBytes = 1024 * 1024;
+	const size_t kDictionaryBytes = 32768;
+	// segments per thread in each batch of DzPngImageWriter
+	const size_t kSegmentsPerThread = 2;
+
+	inline uint32_t readBigEndian32(const uint8_t* p)
+	{
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+	}
+
+	inline void writeBigEndian32(uint8_t* p, uint32_t nValue)
+	{
+		p[0] = (uint8_t)(nValue >> 24);
+		p[1] = (uint8_t)(nValue >> 16);
+		p[2] = (uint8_t)(nValue >> 8);
+		p[3] = (uint8_t)nValue;
+	}
+
+	inline uint8_t paethPredictor(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = abs(p - a);
+		int pb = abs(p - b);
+		int pc = abs(p - c);
+		if (pa <= pb && pa <= pc) return (uint8_t)a;
+		if (pb <= pc) return (uint8_t)b;
+		return (uint8_t)c;
+	}
+
+	inline uint32_t absResidual(int nResidual)
+	{
+		return (uint32_t)abs((int)(int8_t)(uint8_t)nResidual);
+	}
+
+	// x = current, a = left, b = up, c = up-left
+	inline void addResiduals(int x, int a, int b, int c, uint64_t* pSums)
+	{
+		pSums[0] += absResidual(x);
+		pSums[1] += absResidual(x - a);
+		pSums[2] += absResidual(x - b);
+		pSums[3] += absResidual(x - ((a + b) >> 1));
+		pSums[4] += absResidual(x - paethPredictor(a, b, c));
+	}
+
+	void filterRow(int nFilter, const uint8_t* pRow, const uint8_t* pPrior, size_t nRowBytes, size_t nBpp, uint8_t* pOut)
+	{
+		switch (nFilter) {
+		case 0:
+			memcpy(pOut, pRow, nRowBytes);
+			break;
+		case 1:
+			memcpy(pOut, pRow, nBpp);
+			for (size_t i = nBpp; i < nRowBytes; i++) pOut[i] = (uint8_t)(pRow[i] - pRow[i - nBpp]);
+			break;
+		case 2:
+			for (size_t i = 0; i < nRowBytes; i++) pOut[i] = (uint8_t)(pRow[i] - pPrior[i]);
+			break;
+		case 3:
+			for (size_t i = 0; i < nBpp; i++) pOut[i] = (uint8_t)(pRow[i] - (pPrior[i] >> 1));
+			for (size_t i = nBpp; i < nRowBytes; i++) pOut[i] = (uint8_t)(pRow[i] - ((pRow[i - nBpp] + pPrior[i]) >> 1));
+			break;
+		default:
+			for (size_t i = 0; i < nBpp; i++) pOut[i] = (uint8_t)(pRow[i] - pPrior[i]);
+			for (size_t i = nBpp; i < nRowBytes; i++) pOut[i] = (uint8_t)(pRow[i] - paethPredictor(pRow[i - nBpp], pPrior[i], pPrior[i - nBpp]));
+			break;
+		}
+	}
+
+	// ARGB32 words to RGB or RGBA bytes
+	void unpackRow(const uint32_t* pSource, int nWidth, size_t nBpp, uint8_t* pRow)
+	{
+		for (int x = 0; x < nWidth; x++) {
+			uint32_t nPixel = pSource[x];
+			uint8_t* p = pRow + (size_t)x * nBpp;
+			p[0] = (uint8_t)(nPixel >> 16);
+			p[1] = (uint8_t)(nPixel >> 8);
+			p[2] = (uint8_t)nPixel;
+			if (nBpp == 4) p[3] = (uint8_t)(nPixel >> 24);
+		}
+	}
+
+	// Writes the filter type byte and the row filtered with the smallest sum of absolute signed residuals
+	void encodeRow(const uint8_t* pRow, const uint8_t* pPrior, size_t nRowBytes, size_t nBpp, uint8_t* pFiltered)
+	{
+		uint64_t aSums[5] = { 0, 0, 0, 0, 0 };
+		for (size_t i = 0; i < nBpp; i++) {
+			addResiduals(pRow[i], 0, pPrior[i], 0, aSums);
+		}
+		for (size_t i = nBpp; i < nRowBytes; i++) {
+			addResiduals(pRow[i], pRow[i - nBpp], pPrior[i], pPrior[i - nBpp], aSums);
+		}
+		int nBestFilter = 0;
+		for (int nFilter = 1; nFilter < 5; nFilter++) {
+			if (aSums[nFilter] < aSums[nBestFilter]) nBestFilter = nFilter;
+		}
+		pFiltered[0] = (uint8_t)nBestFilter;
+		filterRow(nBestFilter, pRow, pPrior, nRowBytes, nBpp, pFiltered + 1);
+	}
+
+	bool writePngChunk(FILE* pFile, const char* sType, const uint8_t* pData, size_t nSize)
+	{
+		uint8_t aHeader[8];
+		writeBigEndian32(aHeader, (uint32_t)nSize);
+		memcpy(aHeader + 4, sType, 4);
+		uint32_t nCrc = DzCrc32(0, aHeader + 4, 4);
+		if (nSize > 0) {
+			nCrc = DzCrc32(nCrc, pData, nSize);
+		}
+		uint8_t aCrc[4];
+		writeBigEndian32(aCrc, nCrc);
+		return fwrite(aHeader, 1, 8, pFile) == 8 &&
+			(nSize == 0 || fwrite(pData, 1, nSize, pFile) == nSize) &&
+			fwrite(aCrc, 1, 4, pFile) == 4;
+	}
+
+	bool writePngHeader(FILE* pFile, int nWidth, int nHeight, bool bAlpha)
+	{
+		uint8_t aHeader[13];
+		writeBigEndian32(aHeader, (uint32_t)nWidth);
+		writeBigEndian32(aHeader + 4, (uint32_t)nHeight);
+		aHeader[8] = 8;
+		aHeader[9] = bAlpha ? 6 : 2;
+		aHeader[10] = 0;
+		aHeader[11] = 0;
+		aHeader[12] = 0;
+		return fwrite(kPngSignature, 1, 8, pFile) == 8 && writePngChunk(pFile, "IHDR", aHeader, sizeof(aHeader));
+	}
+}
+
+FILE* DzOpenFileUtf8(const char* sPath, const char* sMode)
+{
+#if defined(_WIN32)
+	wchar_t sWidePath[4096];
+	wchar_t sWideMode[16];
+	if (MultiByteToWideChar(CP_UTF8, 0, sPath, -1, sWidePath, 4096) == 0 ||
+		MultiByteToWideChar(CP_UTF8, 0, sMode, -1, sWideMode, 16) == 0) {
+		return nullptr;
+	}
+	return _wfopen(sWidePath, sWideMode);
+#else
+	return fopen(sPath, sMode);
+#endif
+}
+
+///////////////////////////////
+// DzPngStripReader
+///////////////////////////////
+
+DzPngStripReader::DzPngStripReader()
+{
+}
+
+DzPngStripReader::~DzPngStripReader()
+{
+	close();
+}
+
+void DzPngStripReader::close()
+{
+	if (m_pFile) {
+		fclose(m_pFile);
+		m_pFile = nullptr;
+	}
+	m_pInflater.reset();
+}
+
+bool DzPngStripReader::fail(const std::string& sError)
+{
+	m_sError = sError;
+	close();
+	return false;
+}
+
+size_t DzPngStripReader::getMemoryBytes() const
+{
+	return (m_pInflater ? m_pInflater->getMemoryBytes() : 0) + m_aCurrentRow.capacity() + m_aPreviousRow.capacity();
+}
+
+bool DzPngStripReader::readChunkHeader(uint32_t& nLength, char sType[5])
+{
+	uint8_t aHeader[8];
+	if (fread(aHeader, 1, 8, m_pFile) != 8) {
+		return false;
+	}
+	nLength = readBigEndian32(aHeader);
+	memcpy(sType, aHeader + 4, 4);
+	sType[4] = 0;
+	return nLength < 0x80000000u;
+}
+
+bool DzPngStripReader::IsStreamable(const char* sPath)
+{
+	FILE* pFile = DzOpenFileUtf8(sPath, "rb");
+	if (pFile == nullptr) {
+		return false;
+	}
+	// signature, IHDR length and type, then the 13 IHDR bytes; interlace is the last one
+	uint8_t aHeader[8 + 8 + 13];
+	bool bResult = fread(aHeader, 1, sizeof(aHeader), pFile) == sizeof(aHeader) &&
+		memcmp(aHeader, kPngSignature, 8) == 0 &&
+		memcmp(aHeader + 12, "IHDR", 4) == 0 &&
+		aHeader[16 + 12] == 0;
+	fclose(pFile);
+	return bResult;
+}
+
+bool DzPngStripReader::open(const char* sPath)
+{
+	close();
+	m_sError.clear();
+	m_nRowsRead = 0;
+	m_bHasTransparency = false;
+	m_bImageDataEnd = false;
+	m_nWidth = 0;
+	m_nHeight = 0;
+	for (int i = 0; i < 256; i++) {
+		m_aPalette[i] = 0xff000000u;
+	}
+
+	m_pFile = DzOpenFileUtf8(sPath, "rb");
+	if (m_pFile == nullptr) {
+		return fail(std::string("unable to open file: ") + sPath);
+	}
+	uint8_t aSignature[8];
+	if (fread(aSignature, 1, 8, m_pFile) != 8 || memcmp(aSignature, kPngSignature, 8) != 0) {
+		return fail("not a PNG file");
+	}
+
+	for (;;) {
+		uint32_t nLength = 0;
+		char sType[5];
+		if (readChunkHeader(nLength, sType) == false) {
+			return fail("truncated PNG file");
+		}
+		if (strcmp(sType, "IDAT") == 0) {
+			if (m_nWidth == 0) {
+				return fail("missing IHDR chunk");
+			}
+			m_nChunkRemaining = nLength;
+			break;
+		}
+		if (strcmp(sType, "IEND") == 0) {
+			return fail("no image data");
+		}
+		if (strcmp(sType, "IHDR") != 0 && strcmp(sType, "PLTE") != 0 && strcmp(sType, "tRNS") != 0) {
+			if (fseek(m_pFile, (long)nLength + 4, SEEK_CUR) != 0) {
+				return fail("truncated PNG file");
+			}
+			continue;
+		}
+
+		std::vector<uint8_t> aData(nLength + 4);
+		if (fread(aData.data(), 1, aData.size(), m_pFile) != aData.size()) {
+			return fail("truncated PNG file");
+		}
+		if (strcmp(sType, "IHDR") == 0) {
+			if (nLength != 13) {
+				return fail("invalid IHDR chunk");
+			}
+			uint32_t nWidth = readBigEndian32(&aData[0]);
+			uint32_t nHeight = readBigEndian32(&aData[4]);
+			m_nBitDepth = aData[8];
+			m_nColorType = aData[9];
+			if (nWidth == 0 || nHeight == 0 || nWidth > (1u << 24) || nHeight > (1u << 24)) {
+				return fail("invalid image size");
+			}
+			if (aData[12] != 0) {
+				return fail("interlaced PNG files are not supported");
+			}
+			m_nWidth = (int)nWidth;
+			m_nHeight = (int)nHeight;
+			switch (m_nColorType) {
+			case 0: m_nChannels = 1; break;
+			case 2: m_nChannels = 3; break;
+			case 3: m_nChannels = 1; break;
+			case 4: m_nChannels = 2; break;
+			case 6: m_nChannels = 4; break;
+			default: return fail("invalid color type");
+			}
+			bool bValidDepth = (m_nBitDepth == 8) ||
+				(m_nBitDepth == 16 && m_nColorType != 3) ||
+				((m_nBitDepth == 1 || m_nBitDepth == 2 || m_nBitDepth == 4) && (m_nColorType == 0 || m_nColorType == 3));
+			if (bValidDepth == false) {
+				return fail("invalid bit depth");
+			}
+		}
+		else if (strcmp(sType, "PLTE") == 0) {
+			for (uint32_t i = 0; i < nLength / 3 && i < 256; i++) {
+				m_aPalette[i] = 0xff000000u | ((uint32_t)aData[i * 3] << 16) | ((uint32_t)aData[i * 3 + 1] << 8) | aData[i * 3 + 2];
+			}
+		}
+		else if (strcmp(sType, "tRNS") == 0) {
+			if (m_nColorType == 3) {
+				for (uint32_t i = 0; i < nLength && i < 256; i++) {
+					m_aPalette[i] = ((uint32_t)aData[i] << 24) | (m_aPalette[i] & 0x00ffffffu);
+				}
+				m_bHasTransparency = true;
+			}
+			else if (m_nColorType == 0 && nLength >= 2) {
+				m_aTransparentColor[0] = (uint16_t)((aData[0] << 8) | aData[1]);
+				m_bHasTransparency = true;
+			}
+			else if (m_nColorType == 2 && nLength >= 6) {
+				for (int i = 0; i < 3; i++) {
+					m_aTransparentColor[i] = (uint16_t)((aData[i * 2] << 8) | aData[i * 2 + 1]);
+				}
+				m_bHasTransparency = true;
+			}
+		}
+	}
+
+	size_t nBitsPerPixel = (size_t)m_nChannels * m_nBitDepth;
+	m_nRowBytes = ((size_t)m_nWidth * nBitsPerPixel + 7) / 8;
+	m_nPixelBytes = std::max((size_t)1, nBitsPerPixel / 8);
+	// one leading byte for the filter type
+	m_aCurrentRow.assign(m_nRowBytes + 1, 0);
+	m_aPreviousRow.assign(m_nRowBytes + 1, 0);
+	m_pInflater.reset(new DzInflater([this](uint8_t* pBuffer, size_t nSize) { return readImageData(pBuffer, nSize); }));
+
+	return true;
+}
+
+size_t DzPngStripReader::readImageData(uint8_t* pBuffer, size_t nSize)
+{
+	size_t nTotal = 0;
+	while (nTotal < nSize && m_bImageDataEnd == false) {
+		if (m_nChunkRemaining == 0) {
+			// skip the CRC, image data may continue in the next chunk
+			uint32_t nLength = 0;
+			char sType[5];
+			if (fseek(m_pFile, 4, SEEK_CUR) != 0 || readChunkHeader(nLength, sType) == false || strcmp(sType, "IDAT") != 0) {
+				m_bImageDataEnd = true;
+				break;
+			}
+			m_nChunkRemaining = nLength;
+			continue;
+		}
+		size_t nRead = fread(pBuffer + nTotal, 1, std::min(nSize - nTotal, (size_t)m_nChunkRemaining), m_pFile);
+		if (nRead == 0) {
+			m_bImageDataEnd = true;
+			break;
+		}
+		nTotal += nRead;
+		m_nChunkRemaining -= (uint32_t)nRead;
+	}
+	return nTotal;
+}
+
+int DzPngStripReader::readRows(uint32_t* pPixels, int nRows)
+{
+	if (m_pInflater == nullptr) {
+		return 0;
+	}
+	int nDecoded = 0;
+	while (nDecoded < nRows && m_nRowsRead < m_nHeight) {
+		size_t nSize = m_nRowBytes + 1;
+		if (m_pInflater->read(m_aCurrentRow.data(), nSize) != nSize) {
+			fail(m_pInflater->hasError() ? "corrupt image data" : "truncated image data");
+			break;
+		}
+		uint8_t* pRow = m_aCurrentRow.data() + 1;
+		const uint8_t* pPrior = m_aPreviousRow.data() + 1;
+		size_t nBpp = m_nPixelBytes;
+		switch (m_aCurrentRow[0]) {
+		case 0:
+			break;
+		case 1:
+			for (size_t i = nBpp; i < m_nRowBytes; i++) pRow[i] = (uint8_t)(pRow[i] + pRow[i - nBpp]);
+			break;
+		case 2:
+			for (size_t i = 0; i < m_nRowBytes; i++) pRow[i] = (uint8_t)(pRow[i] + pPrior[i]);
+			break;
+		case 3:
+			for (size_t i = 0; i < nBpp; i++) pRow[i] = (uint8_t)(pRow[i] + (pPrior[i] >> 1));
+			for (size_t i = nBpp; i < m_nRowBytes; i++) pRow[i] = (uint8_t)(pRow[i] + ((pRow[i - nBpp] + pPrior[i]) >> 1));
+			break;
+		case 4:
+			for (size_t i = 0; i < nBpp; i++) pRow[i] = (uint8_t)(pRow[i] + pPrior[i]);
+			for (size_t i = nBpp; i < m_nRowBytes; i++) pRow[i] = (uint8_t)(pRow[i] + paethPredictor(pRow[i - nBpp], pPrior[i], pPrior[i - nBpp]));
+			break;
+		default:
+			fail("invalid row filter");
+			return nDecoded;
+		}
+		convertRow(pRow, pPixels + (size_t)nDecoded * m_nWidth);
+		std::swap(m_aCurrentRow, m_aPreviousRow);
+		nDecoded++;
+		m_nRowsRead++;
+	}
+	return nDecoded;
+}
+
+void DzPngStripReader::convertRow(const uint8_t* pRow, uint32_t* pPixels)
+{
+	int nWidth = m_nWidth;
+	if (m_nBitDepth < 8) {
+		int nMask = (1 << m_nBitDepth) - 1;
+		int nScale = 255 / nMask;
+		for (int x = 0; x < nWidth; x++) {
+			int nBit = x * m_nBitDepth;
+			int nValue = (pRow[nBit >> 3] >> (8 - m_nBitDepth - (nBit & 7))) & nMask;
+			if (m_nColorType == 3) {
+				pPixels[x] = m_aPalette[nValue];
+			}
+			else {
+				uint32_t nGray = (uint32_t)(nValue * nScale);
+				uint32_t nAlpha = (m_bHasTransparency && nValue == m_aTransparentColor[0]) ? 0 : 0xff;
+				pPixels[x] = (nAlpha << 24) | (nGray << 16) | (nGray << 8) | nGray;
+			}
+		}
+		return;
+	}
+
+	// 16-bit samples keep their high byte, transparency keys compare the full sample
+	int nStep = m_nBitDepth / 8;
+	for (int x = 0; x < nWidth; x++) {
+		const uint8_t* p = pRow + (size_t)x * m_nChannels * nStep;
+		uint32_t nR, nG, nB, nA = 0xff;
+		switch (m_nColorType) {
+		case 0:
+			nR = nG = nB = p[0];
+			if (m_bHasTransparency) {
+				uint32_t nSample = nStep == 2 ? (p[0] << 8) | p[1] : p[0];
+				if (nSample == m_aTransparentColor[0]) nA = 0;
+			}
+			break;
+		case 2:
+			nR = p[0];
+			nG = p[nStep];
+			nB = p[nStep * 2];
+			if (m_bHasTransparency) {
+				bool bMatch = true;
+				for (int c = 0; c < 3; c++) {
+					uint32_t nSample = nStep == 2 ? (p[c * 2] << 8) | p[c * 2 + 1] : p[c];
+					bMatch = bMatch && nSample == m_aTransparentColor[c];
+				}
+				if (bMatch) nA = 0;
+			}
+			break;
+		case 3:
+			pPixels[x] = m_aPalette[p[0]];
+			continue;
+		case 4:
+			nR = nG = nB = p[0];
+			nA = p[nStep];
+			break;
+		default:
+			nR = p[0];
+			nG = p[nStep];
+			nB = p[nStep * 2];
+			nA = p[nStep * 3];
+			break;
+		}
+		pPixels[x] = (nA << 24) | (nR << 16) | (nG << 8) | nB;
+	}
+}
+
+///////////////////////////////
+// DzPngStripWriter
+///////////////////////////////
+
+DzPngStripWriter::DzPngStripWriter()
+{
+}
+
+DzPngStripWriter::~DzPngStripWriter()
+{
+	if (m_pFile) {
+		fclose(m_pFile);
+		m_pFile = nullptr;
+	}
+}
+
+bool DzPngStripWriter::fail(const std::string& sError)
+{
+	m_sError = sError;
+	if (m_pFile) {
+		fclose(m_pFile);
+		m_pFile = nullptr;
+	}
+	return false;
+}
+
+size_t DzPngStripWriter::getMemoryBytes() const
+{
+	return (m_pDeflater ? m_pDeflater->getMemoryBytes() : 0) + m_aImageData.capacity() +
+		m_aCurrentRow.capacity() + m_aPreviousRow.capacity() + m_aFilteredRows.capacity();
+}
+
+bool DzPngStripWriter::open(const char* sPath, int nWidth, int nHeight, bool bAlpha, int nCompressionLevel)
+{
+	m_sError.clear();
+	m_bWriteError = false;
+	m_nRowsWritten = 0;
+	if (nWidth <= 0 || nHeight <= 0) {
+		return fail("invalid image size");
+	}
+	m_pFile = DzOpenFileUtf8(sPath, "wb");
+	if (m_pFile == nullptr) {
+		return fail(std::string("unable to open file for writing: ") + sPath);
+	}
+	m_nWidth = nWidth;
+	m_nHeight = nHeight;
+	m_nChannels = bAlpha ? 4 : 3;
+
+	if (writePngHeader(m_pFile, nWidth, nHeight, bAlpha) == false) {
+		m_bWriteError = true;
+	}
+
+	size_t nRowBytes = (size_t)nWidth * m_nChannels;
+	m_aCurrentRow.assign(nRowBytes, 0);
+	m_aPreviousRow.assign(nRowBytes, 0);
+	m_aFilteredRows.assign(nRowBytes + 1, 0);
+	m_aImageData.clear();
+	m_aImageData.reserve(kImageDataChunkSize + 4096);
+	m_pDeflater.reset(new DzDeflater([this](const uint8_t* pData, size_t nSize) { writeImageData(pData, nSize); }, nCompressionLevel));
+
+	return m_bWriteError ? fail("write error") : true;
+}
+
+bool DzPngStripWriter::writeRows(const uint32_t* pPixels, int nRows)
+{
+	if (m_pFile == nullptr || m_nRowsWritten + nRows > m_nHeight) {
+		return fail("too many rows written");
+	}
+	size_t nRowBytes = m_aCurrentRow.size();
+	size_t nBpp = (size_t)m_nChannels;
+	for (int y = 0; y < nRows; y++) {
+		unpackRow(pPixels + (size_t)y * m_nWidth, m_nWidth, nBpp, m_aCurrentRow.data());
+		encodeRow(m_aCurrentRow.data(), m_aPreviousRow.data(), nRowBytes, nBpp, m_aFilteredRows.data());
+		m_pDeflater->write(m_aFilteredRows.data(), nRowBytes + 1);
+		std::swap(m_aCurrentRow, m_aPreviousRow);
+		m_nRowsWritten++;
+	}
+	return m_bWriteError ? fail("write error") : true;
+}
+
+bool DzPngStripWriter::close()
+{
+	if (m_pFile == nullptr) {
+		return false;
+	}
+	if (m_nRowsWritten != m_nHeight) {
+		return fail("not all rows were written");
+	}
+	m_pDeflater->finish();
+	flushImageData();
+	writeChunk("IEND", nullptr, 0);
+	bool bResult = m_bWriteError == false;
+	if (fclose(m_pFile) != 0) {
+		bResult = false;
+	}
+	m_pFile = nullptr;
+	m_pDeflater.reset();
+	if (bResult == false) {
+		m_sError = "write error";
+	}
+	return bResult;
+}
+
+void DzPngStripWriter::writeChunk(const char* sType, const uint8_t* pData, size_t nSize)
+{
+	if (writePngChunk(m_pFile, sType, pData, nSize) == false) {
+		m_bWriteError = true;
+	}
+}
+
+void DzPngStripWriter::writeImageData(const uint8_t* pData, size_t nSize)
+{
+	m_aImageData.insert(m_aImageData.end(), pData, pData + nSize);
+	if (m_aImageData.size() >= kImageDataChunkSize) {
+		flushImageData();
+	}
+}
+
+void DzPngStripWriter::flushImageData()
+{
+	if (m_aImageData.empty() == false) {
+		writeChunk("IDAT", m_aImageData.data(), m_aImageData.size());
+		m_aImageData.clear();
+	}
+}
+
+///////////////////////////////
+// DzPngImageWriter
+///////////////////////////////
+
+bool DzPngImageWriter::Write(const char* sPath, const uint32_t* pPixels, int nWidth, int nHeight, size_t nStride, bool bAlpha,
+	const DzPngWriteSettings& settings, std::string& sError)
+{
+	if (pPixels == nullptr || nWidth <= 0 || nHeight <= 0 || nStride < (size_t)nWidth) {
+		sError = "invalid image";
+		return false;
+	}
+	size_t nBpp = bAlpha ? 4 : 3;
+	size_t nRowBytes = (size_t)nWidth * nBpp;
+	size_t nSegmentRows = settings.nSegmentRows > 0 ? (size_t)settings.nSegmentRows : std::max((size_t)8, kSegmentBytes / (nRowBytes + 1));
+	size_t nSegments = ((size_t)nHeight + nSegmentRows - 1) / nSegmentRows;
+	// rows before a segment whose filtered bytes cover the 32K dictionary
+	size_t nDictionaryRows = (kDictionaryBytes + nRowBytes) / (nRowBytes + 1);
+
+	FILE* pFile = DzOpenFileUtf8(sPath, "wb");
+	if (pFile == nullptr) {
+		sError = std::string("unable to open file for writing: ") + sPath;
+		return false;
+	}
+	bool bWriteOk = writePngHeader(pFile, nWidth, nHeight, bAlpha);
+	// CMF: deflate with a 32K window, FLG: default compression, check bits
+	const uint8_t aZlibHeader[2] = { 0x78, 0x9c };
+	bWriteOk = bWriteOk && writePngChunk(pFile, "IDAT", aZlibHeader, 2);
+
+	struct Segment {
+		std::vector<uint8_t> aOutput;
+		uint32_t nAdler = 1;
+		size_t nSize = 0;
+	};
+	size_t nBatchSize = (size_t)DzNativeParallel::GetNumThreads() * kSegmentsPerThread;
+	std::vector<Segment> aBatch(std::min(nBatchSize, nSegments));
+	uint32_t nAdler = 1;
+	for (size_t nBatchBegin = 0; nBatchBegin < nSegments && bWriteOk; nBatchBegin += aBatch.size()) {
+		size_t nBatchCount = std::min(aBatch.size(), nSegments - nBatchBegin);
+		DzNativeParallel::For(nBatchCount, 1, [&](size_t nBegin, size_t nEnd) {
+			std::vector<uint8_t> aRows[2] = { std::vector<uint8_t>(nRowBytes, 0), std::vector<uint8_t>(nRowBytes, 0) };
+			std::vector<uint8_t> aFiltered;
+			for (size_t nIndex = nBegin; nIndex < nEnd; nIndex++) {
+				size_t nSegment = nBatchBegin + nIndex;
+				size_t nFirstRow = nSegment * nSegmentRows;
+				size_t nEndRow = std::min((size_t)nHeight, nFirstRow + nSegmentRows);
+				// the dictionary rows are filtered again, which gives the same bytes as in the previous segment
+				size_t nStartRow = nFirstRow > nDictionaryRows ? nFirstRow - nDictionaryRows : 0;
+				aFiltered.resize((nEndRow - nStartRow) * (nRowBytes + 1));
+				int nCurrent = 0;
+				if (nStartRow > 0) {
+					unpackRow(pPixels + (nStartRow - 1) * nStride, nWidth, nBpp, aRows[1].data());
+				}
+				else {
+					std::fill(aRows[1].begin(), aRows[1].end(), (uint8_t)0);
+				}
+				for (size_t y = nStartRow; y < nEndRow; y++) {
+					unpackRow(pPixels + y * nStride, nWidth, nBpp, aRows[nCurrent].data());
+					encodeRow(aRows[nCurrent].data(), aRows[1 - nCurrent].data(), nRowBytes, nBpp, aFiltered.data() + (y - nStartRow) * (nRowBytes + 1));
+					nCurrent = 1 - nCurrent;
+				}
+
+				Segment& segment = aBatch[nIndex];
+				segment.aOutput.clear();
+				DzDeflater deflater([&segment](const uint8_t* pData, size_t nSize) {
+					segment.aOutput.insert(segment.aOutput.end(), pData, pData + nSize);
+				}, settings.nCompressionLevel);
+				deflater.setSegment(nSegment + 1 == nSegments);
+				size_t nDictionarySize = (nFirstRow - nStartRow) * (nRowBytes + 1);
+				if (nDictionarySize > 0) {
+					deflater.setDictionary(aFiltered.data(), nDictionarySize);
+				}
+				segment.nSize = aFiltered.size() - nDictionarySize;
+				deflater.write(aFiltered.data() + nDictionarySize, segment.nSize);
+				deflater.finish();
+				segment.nAdler = deflater.getAdler();
+			}
+		});
+		for (size_t nIndex = 0; nIndex < nBatchCount && bWriteOk; nIndex++) {
+			Segment& segment = aBatch[nIndex];
+			nAdler = DzAdler32Combine(nAdler, segment.nAdler, segment.nSize);
+			bWriteOk = writePngChunk(pFile, "IDAT", segment.aOutput.data(), segment.aOutput.size());
+		}
+	}
+
+	uint8_t aAdler[4];
+	writeBigEndian32(aAdler, nAdler);
+	bWriteOk = bWriteOk && writePngChunk(pFile, "IDAT", aAdler, 4);
+	bWriteOk = bWriteOk && writePngChunk(pFile, "IEND", nullptr, 0);
+	if (fclose(pFile) != 0) {
+		bWriteOk = false;
+	}
+	if (bWriteOk == false) {
+		sError = "write error";
+	}
+	return bWriteOk;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DzDeflate.h"
+
+// fopen() with a UTF-8 path on every platform
+FILE* DzOpenFileUtf8(const char* sPath, const char* sMode);
+
+/*****************************
+DzPngStripReader
+
+Decodes a non-interlaced PNG a few rows at a time.  Every color type and bit
+depth is accepted and converted to 8-bit ARGB32 (0xAARRGGBB words, the same
+layout as QImage::Format_ARGB32).  Only the inflate window and two scanlines
+are kept in memory.
+*****************************/
+class DzPngStripReader
+{
+public:
+	DzPngStripReader();
+	~DzPngStripReader();
+
+	bool open(const char* sPath);
+	void close();
+
+	int getWidth() const { return m_nWidth; }
+	int getHeight() const { return m_nHeight; }
+	bool hasAlpha() const { return m_nColorType == 4 || m_nColorType == 6 || m_bHasTransparency; }
+	const std::string& getErrorString() const { return m_sError; }
+	size_t getMemoryBytes() const;
+
+	// Decodes up to nRows rows into pPixels (getWidth() pixels per row).  Returns the number of rows decoded.
+	int readRows(uint32_t* pPixels, int nRows);
+
+	// True for PNG files this reader can decode, ie. not interlaced
+	static bool IsStreamable(const char* sPath);
+
+protected:
+	bool fail(const std::string& sError);
+	bool readChunkHeader(uint32_t& nLength, char sType[5]);
+	size_t readImageData(uint8_t* pBuffer, size_t nSize);
+	void convertRow(const uint8_t* pRow, uint32_t* pPixels);
+
+	FILE* m_pFile = nullptr;
+	std::string m_sError;
+	int m_nWidth = 0;
+	int m_nHeight = 0;
+	int m_nBitDepth = 0;
+	int m_nColorType = 0;
+	int m_nChannels = 0;
+	size_t m_nRowBytes = 0;
+	size_t m_nPixelBytes = 0;
+	int m_nRowsRead = 0;
+
+	uint32_t m_aPalette[256];
+	bool m_bHasTransparency = false;
+	uint16_t m_aTransparentColor[3];
+
+	uint32_t m_nChunkRemaining = 0;
+	bool m_bImageDataEnd = false;
+	std::unique_ptr<DzInflater> m_pInflater;
+	std::vector<uint8_t> m_aCurrentRow;
+	std::vector<uint8_t> m_aPreviousRow;
+};
+
+/*****************************
+DzPngStripWriter
+
+Encodes an 8-bit RGB or RGBA PNG a few rows at a time from ARGB32 rows
+on the calling thread.
+Each row gets the PNG filter with the smallest sum of absolute differences
+and the compressed stream is written out in 64K IDAT chunks as it is produced.
+*****************************/
+class DzPngStripWriter
+{
+public:
+	DzPngStripWriter();
+	~DzPngStripWriter();
+
+	// nCompressionLevel 0 (fastest) to 9 (smallest), see DzDeflater
+	bool open(const char* sPath, int nWidth, int nHeight, bool bAlpha, int nCompressionLevel = 6);
+	bool writeRows(const uint32_t* pPixels, int nRows);
+	// Writes the remaining data and the IEND chunk.  Fails if fewer rows than the height were written.
+	bool close();
+
+	const std::string& getErrorString() const { return m_sError; }
+	size_t getMemoryBytes() const;
+
+protected:
+	bool fail(const std::string& sError);
+	void writeChunk(const char* sType, const uint8_t* pData, size_t nSize);
+	void writeImageData(const uint8_t* pData, size_t nSize);
+	void flushImageData();
+
+	FILE* m_pFile = nullptr;
+	std::string m_sError;
+	bool m_bWriteError = false;
+	int m_nWidth = 0;
+	int m_nHeight = 0;
+	int m_nChannels = 0;
+	int m_nRowsWritten = 0;
+
+	std::unique_ptr<DzDeflater> m_pDeflater;
+	std::vector<uint8_t> m_aImageData;
+	std::vector<uint8_t> m_aCurrentRow;
+	std::vector<uint8_t> m_aPreviousRow;
+	std::vector<uint8_t> m_aFilteredRows;
+};
+
+struct DzPngWriteSettings
+{
+	int nCompressionLevel = 6;  // 0 (fastest) to 9 (smallest), see DzDeflater
+	int nSegmentRows = 0;       // rows per independently compressed segment, 0 = about 1 MB per segment
+};
+
+/*****************************
+DzPngImageWriter
+
+Encodes a whole image that is already in memory, as a faster PNG encoder
+for large (8K) textures.  The rows are cut into segments that are filtered
+and compressed in parallel, each segment is primed with the last 32K of the
+previous one so the compression ratio stays close to a serial encoder, and
+the raw deflate segments are joined into one zlib stream.  Rows use the same
+filter selection as DzPngStripWriter.  Segments are processed in batches of
+a few per thread, so that only the compressed output of one batch is held in
+memory at a time.
+*****************************/
+class DzPngImageWriter
+{
+public:
+	// pPixels holds nHeight rows of ARGB32 words, top row first, nStride words apart
+	static bool Write(const char* sPath, const uint32_t* pPixels, int nWidth, int nHeight, size_t nStride, bool bAlpha,
+		const DzPngWriteSettings& settings, std::string& sError);
+};
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "DzTextureStream.h"
+#include "DzPngStream.h"
+#include "DzImageResampler.h"
+#include "DzImageKernels.h"
+
+namespace
+{
+	// inflate input and window, two 16-bit RGBA scanlines
+	size_t estimateReaderBytes(int nWidth)
+	{
+		return 128 * 1024 + (size_t)nWidth * 8 * 2;
+	}
+
+	// deflate window, hash chains, tokens and output, three 8-bit RGBA scanlines
+	size_t estimateWriterBytes(int nWidth)
+	{
+		return 640 * 1024 + (size_t)nWidth * 4 * 3;
+	}
+
+	bool fail(DzTextureStreamResult& result, const std::string& sError)
+	{
+		result.sError = sError;
+		return false;
+	}
+}
+
+bool DzTextureStream::CanStream(const char* sPath)
+{
+	return DzPngStripReader::IsStreamable(sPath);
+}
+
+size_t DzTextureStream::EstimateBufferBytes(int nSourceWidth, int nTargetWidth, int nStripRows, bool bAlphaSource)
+{
+	size_t nStripBytes = (size_t)nSourceWidth * nStripRows * sizeof(uint32_t);
+	size_t nBytes = estimateReaderBytes(nSourceWidth) + nStripBytes;
+	if (bAlphaSource) {
+		nBytes += estimateReaderBytes(nSourceWidth) + nStripBytes;
+	}
+	nBytes += estimateWriterBytes(nTargetWidth);
+	if (nTargetWidth != nSourceWidth) {
+		nBytes += (size_t)nTargetWidth * 4 * sizeof(float) * 2 + (size_t)nSourceWidth * sizeof(float) * 2;
+	}
+	return nBytes;
+}
+
+size_t DzTextureStream::EstimateLevelBytes(int nInputWidth, int nLevelWidth)
+{
+	return estimateWriterBytes(nLevelWidth) + (size_t)nLevelWidth * 4 * sizeof(float) * 2 + (size_t)nInputWidth * sizeof(float) * 2 +
+		(size_t)nLevelWidth * sizeof(uint32_t);
+}
+
+bool DzTextureStream::Run(const DzTextureStreamJob& job, DzTextureStreamResult& result)
+{
+	result = DzTextureStreamResult();
+
+	DzPngStripReader colorReader;
+	if (colorReader.open(job.sColorPath.c_str()) == false) {
+		return fail(result, job.sColorPath + ": " + colorReader.getErrorString());
+	}
+	int nWidth = colorReader.getWidth();
+	int nHeight = colorReader.getHeight();
+	result.nSourceWidth = nWidth;
+	result.nSourceHeight = nHeight;
+
+	DzPngStripReader alphaReader;
+	bool bAlphaSource = job.sAlphaPath.empty() == false;
+	if (bAlphaSource) {
+		if (alphaReader.open(job.sAlphaPath.c_str()) == false) {
+			return fail(result, job.sAlphaPath + ": " + alphaReader.getErrorString());
+		}
+		if (alphaReader.getWidth() != nWidth || alphaReader.getHeight() != nHeight) {
+			return fail(result, job.sAlphaPath + ": cutout map size does not match the color map");
+		}
+	}
+
+	int nTargetWidth = job.nTargetWidth > 0 ? job.nTargetWidth : nWidth;
+	int nTargetHeight = job.nTargetHeight > 0 ? job.nTargetHeight : nHeight;
+	if (nTargetWidth > nWidth || nTargetHeight > nHeight) {
+		return fail(result, "upscaling is not supported");
+	}
+	result.bHasAlpha = bAlphaSource || colorReader.hasAlpha();
+
+	bool bWriteOutput = job.sOutputPath.empty() == false;
+	DzPngStripWriter writer;
+	if (bWriteOutput && writer.open(job.sOutputPath.c_str(), nTargetWidth, nTargetHeight, result.bHasAlpha, job.nCompressionLevel) == false) {
+		return fail(result, job.sOutputPath + ": " + writer.getErrorString());
+	}
+
+	std::vector<int> aLevelWidths;
+	std::vector<int> aLevelHeights;
+	for (size_t i = 0; i < job.aLevels.size(); i++) {
+		aLevelWidths.push_back(job.aLevels[i].nWidth);
+		aLevelHeights.push_back(job.aLevels[i].nHeight);
+	}
+	std::string sLevelError;
+	std::vector<std::unique_ptr<DzPngStripWriter> > aLevelWriters;
+	DzTexturePyramid pyramid(nTargetWidth, nTargetHeight, aLevelWidths, aLevelHeights, [&](int nLevel, const uint32_t* pRow) {
+		if (aLevelWriters[nLevel]->writeRows(pRow, 1) == false) {
+			sLevelError = job.aLevels[nLevel].sOutputPath + ": " + aLevelWriters[nLevel]->getErrorString();
+			return false;
+		}
+		return true;
+	});
+	if (pyramid.getNumLevels() != (int)job.aLevels.size()) {
+		return fail(result, "texture pyramid levels must get smaller");
+	}
+	for (size_t i = 0; i < job.aLevels.size(); i++) {
+		const DzTextureStreamLevel& level = job.aLevels[i];
+		aLevelWriters.emplace_back(new DzPngStripWriter());
+		if (aLevelWriters[i]->open(level.sOutputPath.c_str(), level.nWidth, level.nHeight, result.bHasAlpha, job.nCompressionLevel) == false) {
+			return fail(result, level.sOutputPath + ": " + aLevelWriters[i]->getErrorString());
+		}
+	}
+	auto writeOutputRows = [&](const uint32_t* pRows, int nRows) {
+		if (bWriteOutput && writer.writeRows(pRows, nRows) == false) {
+			sLevelError = job.sOutputPath + ": " + writer.getErrorString();
+			return false;
+		}
+		for (int y = 0; y < nRows; y++) {
+			if (pyramid.addRow(pRows + (size_t)y * nTargetWidth) == false) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	std::unique_ptr<DzStripResampler> pResampler;
+	if (nTargetWidth != nWidth || nTargetHeight != nHeight) {
+		pResampler.reset(new DzStripResampler(nWidth, nHeight, nTargetWidth, nTargetHeight));
+	}
+
+	int nStripRows = std::max(1, std::min(job.nStripRows, nHeight));
+	std::vector<uint32_t> aColorStrip((size_t)nWidth * nStripRows);
+	std::vector<uint32_t> aAlphaStrip(bAlphaSource ? (size_t)nWidth * nStripRows : 0);
+	std::vector<uint32_t> aTargetRow(pResampler ? nTargetWidth : 0);
+
+	for (int nRow = 0; nRow < nHeight; nRow += nStripRows) {
+		int nRows = std::min(nStripRows, nHeight - nRow);
+		size_t nPixels = (size_t)nWidth * nRows;
+		if (colorReader.readRows(aColorStrip.data(), nRows) != nRows) {
+			return fail(result, job.sColorPath + ": " + colorReader.getErrorString());
+		}
+		if (bAlphaSource) {
+			if (alphaReader.readRows(aAlphaStrip.data(), nRows) != nRows) {
+				return fail(result, job.sAlphaPath + ": " + alphaReader.getErrorString());
+			}
+			DzImageKernels::CombineColorAndAlpha(aColorStrip.data(), aColorStrip.data(), aAlphaStrip.data(), nPixels);
+		}
+		if (job.bMultiplyByColor) {
+			DzImageKernels::MultiplyByColor(aColorStrip.data(), nPixels, job.nMultiplyColor);
+		}
+
+		if (pResampler) {
+			for (int y = 0; y < nRows; y++) {
+				pResampler->addRow(aColorStrip.data() + (size_t)y * nWidth);
+				while (pResampler->hasRow()) {
+					pResampler->takeRow(aTargetRow.data());
+					if (writeOutputRows(aTargetRow.data(), 1) == false) {
+						return fail(result, sLevelError);
+					}
+				}
+			}
+		}
+		else if (writeOutputRows(aColorStrip.data(), nRows) == false) {
+			return fail(result, sLevelError);
+		}
+
+		size_t nBufferBytes = colorReader.getMemoryBytes() + alphaReader.getMemoryBytes() + writer.getMemoryBytes() +
+			(aColorStrip.capacity() + aAlphaStrip.capacity() + aTargetRow.capacity()) * sizeof(uint32_t) +
+			(pResampler ? pResampler->getMemoryBytes() : 0) + pyramid.getMemoryBytes();
+		for (size_t i = 0; i < aLevelWriters.size(); i++) {
+			nBufferBytes += aLevelWriters[i]->getMemoryBytes();
+		}
+		result.nPeakBufferBytes = std::max(result.nPeakBufferBytes, nBufferBytes);
+	}
+
+	if (bWriteOutput && writer.close() == false) {
+		return fail(result, job.sOutputPath + ": " + writer.getErrorString());
+	}
+	for (size_t i = 0; i < aLevelWriters.size(); i++) {
+		if (aLevelWriters[i]->close() == false) {
+			return fail(result, job.aLevels[i].sOutputPath + ": " + aLevelWriters[i]->getErrorString());
+		}
+	}
+	return true;
+}
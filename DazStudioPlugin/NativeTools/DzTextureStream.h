@@ -0,0 +1,62 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Extra downscaled output of a texture job, always written as PNG
+struct DzTextureStreamLevel
+{
+	std::string sOutputPath;
+	int nWidth = 0;
+	int nHeight = 0;
+};
+
+// One strip-based texture job, paths are UTF-8
+struct DzTextureStreamJob
+{
+	std::string sColorPath;
+	std::string sAlphaPath;     // optional, its RGB mean becomes the alpha channel
+	std::string sOutputPath;    // always written as PNG, empty = only write aLevels
+	bool bMultiplyByColor = false;
+	uint32_t nMultiplyColor = 0xffffffff;
+	int nTargetWidth = 0;       // 0 = source size, only downscaling is supported
+	int nTargetHeight = 0;
+	int nStripRows = 64;
+	int nCompressionLevel = 6;  // PNG compression level, see DzDeflater
+	// texture pyramid reduced from the output rows, largest first
+	std::vector<DzTextureStreamLevel> aLevels;
+};
+
+struct DzTextureStreamResult
+{
+	std::string sError;
+	int nSourceWidth = 0;
+	int nSourceHeight = 0;
+	bool bHasAlpha = false;
+	// decoder, encoder, strip and resampler buffers of this job
+	size_t nPeakBufferBytes = 0;
+};
+
+/*****************************
+DzTextureStream
+
+Runs the alpha combine, color multiply and downscale texture operations on
+horizontal strips: rows are decoded incrementally from the PNG source (and
+cutout) map, transformed with the DzImageKernels and encoded incrementally to
+the PNG output and to each level of an optional texture pyramid.  Memory use depends on the image width and strip height only,
+never on the image height.
+*****************************/
+class DzTextureStream
+{
+public:
+	// True if sPath is a PNG that can be decoded in strips
+	static bool CanStream(const char* sPath);
+
+	// Expected buffer size for a job with the given source width, useful for memory budgets
+	static size_t EstimateBufferBytes(int nSourceWidth, int nTargetWidth, int nStripRows, bool bAlphaSource);
+	// Extra buffer size for one pyramid level reduced from rows of nInputWidth
+	static size_t EstimateLevelBytes(int nInputWidth, int nLevelWidth);
+
+	static bool Run(const DzTextureStreamJob& job, DzTextureStreamResult& result);
+};
@@ -0,0 +1,448 @@
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+#include "DzTriangleBvh.h"
+
+namespace
+{
+	const int kBinCount = 12;
+	// leaves always hold up to kMinLeafSize triangles, and at most kMaxLeafSize unless the triangles can not be split
+	const uint32_t kMinLeafSize = 4;
+	const uint32_t kMaxLeafSize = 8;
+	// below this depth a degenerate SAH split sequence is cut by median splits, so traversal stacks stay small
+	const int kMaxSahDepth = 96;
+	const int kStackSize = 256;
+
+	struct Bounds
+	{
+		float aMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float aMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void grow(const float* pMin, const float* pMax)
+		{
+			for (int c = 0; c < 3; c++) {
+				aMin[c] = std::min(aMin[c], pMin[c]);
+				aMax[c] = std::max(aMax[c], pMax[c]);
+			}
+		}
+		float area() const
+		{
+			if (aMin[0] > aMax[0]) return 0.0f;
+			float dx = aMax[0] - aMin[0], dy = aMax[1] - aMin[1], dz = aMax[2] - aMin[2];
+			return 2.0f * (dx * dy + dy * dz + dz * dx);
+		}
+	};
+
+	inline void cross(const float* a, const float* b, float* r)
+	{
+		r[0] = a[1] * b[2] - a[2] * b[1];
+		r[1] = a[2] * b[0] - a[0] * b[2];
+		r[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	inline float dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+}
+
+void DzTriangleBvh::build(const float* pPositions, const int* pTriangles, size_t nTriangles)
+{
+	m_aNodes.clear();
+	m_aTriangles.clear();
+	m_aTriangleIds.clear();
+	m_aTriangleVertices.clear();
+	if (nTriangles == 0) {
+		return;
+	}
+	std::vector<float> aCentroids(nTriangles * 3), aBounds(nTriangles * 6);
+	Bounds meshBounds;
+	for (size_t t = 0; t < nTriangles; t++) {
+		float* pMin = &aBounds[t * 6];
+		float* pMax = pMin + 3;
+		for (int c = 0; c < 3; c++) {
+			pMin[c] = FLT_MAX;
+			pMax[c] = -FLT_MAX;
+		}
+		for (int k = 0; k < 3; k++) {
+			const float* p = pPositions + (size_t)pTriangles[t * 3 + k] * 3;
+			for (int c = 0; c < 3; c++) {
+				pMin[c] = std::min(pMin[c], p[c]);
+				pMax[c] = std::max(pMax[c], p[c]);
+			}
+		}
+		for (int c = 0; c < 3; c++) {
+			aCentroids[t * 3 + c] = 0.5f * (pMin[c] + pMax[c]);
+		}
+		meshBounds.grow(pMin, pMax);
+	}
+	// hits up to FLT_EPSILON outside a triangle count, so the boxes are grown a little more than that
+	float fExtent = std::max(meshBounds.aMax[0] - meshBounds.aMin[0], std::max(meshBounds.aMax[1] - meshBounds.aMin[1], meshBounds.aMax[2] - meshBounds.aMin[2]));
+	m_fPadding = fExtent * 1e-5f + FLT_MIN;
+
+	std::vector<uint32_t> aOrder(nTriangles);
+	for (size_t t = 0; t < nTriangles; t++) aOrder[t] = (uint32_t)t;
+	m_aNodes.reserve(nTriangles / 2 + 1);
+	buildNode(aOrder, aCentroids, aBounds, 0, (uint32_t)nTriangles, 0);
+
+	m_aTriangles.resize(nTriangles * 9);
+	m_aTriangleIds.resize(nTriangles);
+	m_aTriangleVertices.resize(nTriangles * 3);
+	for (size_t i = 0; i < nTriangles; i++) {
+		uint32_t t = aOrder[i];
+		m_aTriangleIds[i] = (int)t;
+		for (int k = 0; k < 3; k++) m_aTriangleVertices[i * 3 + k] = pTriangles[t * 3 + k];
+	}
+	updateTriangles(pPositions);
+}
+
+void DzTriangleBvh::updateTriangles(const float* pPositions)
+{
+	for (size_t i = 0; i < m_aTriangleIds.size(); i++) {
+		const float* p0 = pPositions + (size_t)m_aTriangleVertices[i * 3] * 3;
+		const float* p1 = pPositions + (size_t)m_aTriangleVertices[i * 3 + 1] * 3;
+		const float* p2 = pPositions + (size_t)m_aTriangleVertices[i * 3 + 2] * 3;
+		float* pData = &m_aTriangles[i * 9];
+		for (int c = 0; c < 3; c++) {
+			pData[c] = p0[c];
+			pData[3 + c] = p1[c] - p0[c];
+			pData[6 + c] = p2[c] - p0[c];
+		}
+	}
+}
+
+void DzTriangleBvh::refit(const float* pPositions)
+{
+	updateTriangles(pPositions);
+	// children always come after their parent
+	for (size_t n = m_aNodes.size(); n-- > 0;) {
+		Node& node = m_aNodes[n];
+		Bounds bounds;
+		if (node.nCount > 0) {
+			for (uint32_t i = node.nFirst; i < node.nFirst + node.nCount; i++) {
+				for (int k = 0; k < 3; k++) {
+					const float* p = pPositions + (size_t)m_aTriangleVertices[i * 3 + k] * 3;
+					bounds.grow(p, p);
+				}
+			}
+			for (int c = 0; c < 3; c++) {
+				bounds.aMin[c] -= m_fPadding;
+				bounds.aMax[c] += m_fPadding;
+			}
+		}
+		else {
+			const Node& left = m_aNodes[n + 1];
+			const Node& right = m_aNodes[node.nFirst];
+			bounds.grow(left.aMin, left.aMax);
+			bounds.grow(right.aMin, right.aMax);
+		}
+		for (int c = 0; c < 3; c++) {
+			node.aMin[c] = bounds.aMin[c];
+			node.aMax[c] = bounds.aMax[c];
+		}
+	}
+}
+
+uint32_t DzTriangleBvh::buildNode(std::vector<uint32_t>& aOrder, const std::vector<float>& aCentroids,
+	const std::vector<float>& aBounds, uint32_t nBegin, uint32_t nEnd, int nDepth)
+{
+	uint32_t nNode = (uint32_t)m_aNodes.size();
+	m_aNodes.push_back(Node());
+	Bounds bounds, centroidBounds;
+	for (uint32_t i = nBegin; i < nEnd; i++) {
+		bounds.grow(&aBounds[aOrder[i] * 6], &aBounds[aOrder[i] * 6 + 3]);
+		centroidBounds.grow(&aCentroids[aOrder[i] * 3], &aCentroids[aOrder[i] * 3]);
+	}
+	for (int c = 0; c < 3; c++) {
+		m_aNodes[nNode].aMin[c] = bounds.aMin[c] - m_fPadding;
+		m_aNodes[nNode].aMax[c] = bounds.aMax[c] + m_fPadding;
+	}
+	uint32_t nCount = nEnd - nBegin;
+
+	int nBestAxis = -1, nBestSplit = 0;
+	float fBestCost = FLT_MAX;
+	if (nCount > kMinLeafSize && nDepth < kMaxSahDepth) {
+		for (int nAxis = 0; nAxis < 3; nAxis++) {
+			float fMin = centroidBounds.aMin[nAxis], fExtent = centroidBounds.aMax[nAxis] - fMin;
+			if (!(fExtent > 0.0f)) continue;
+			float fBinScale = kBinCount / fExtent;
+			Bounds aBins[kBinCount];
+			uint32_t aCounts[kBinCount] = { 0 };
+			for (uint32_t i = nBegin; i < nEnd; i++) {
+				int nBin = std::min(kBinCount - 1, (int)((aCentroids[aOrder[i] * 3 + nAxis] - fMin) * fBinScale));
+				aBins[nBin].grow(&aBounds[aOrder[i] * 6], &aBounds[aOrder[i] * 6 + 3]);
+				aCounts[nBin]++;
+			}
+			// areas and counts left of every split plane, then sweep from the right
+			float aLeftAreas[kBinCount];
+			uint32_t aLeftCounts[kBinCount];
+			Bounds left;
+			uint32_t nLeft = 0;
+			for (int b = 0; b < kBinCount - 1; b++) {
+				left.grow(aBins[b].aMin, aBins[b].aMax);
+				nLeft += aCounts[b];
+				aLeftAreas[b + 1] = left.area();
+				aLeftCounts[b + 1] = nLeft;
+			}
+			Bounds right;
+			uint32_t nRight = 0;
+			for (int b = kBinCount - 1; b > 0; b--) {
+				right.grow(aBins[b].aMin, aBins[b].aMax);
+				nRight += aCounts[b];
+				if (aLeftCounts[b] == 0 || nRight == 0) continue;
+				float fCost = aLeftAreas[b] * aLeftCounts[b] + right.area() * nRight;
+				if (fCost < fBestCost) {
+					fBestCost = fCost;
+					nBestAxis = nAxis;
+					nBestSplit = b;
+				}
+			}
+		}
+	}
+
+	uint32_t nMiddle = nBegin;
+	float fLeafCost = bounds.area() * nCount;
+	if (nBestAxis >= 0 && (fBestCost + bounds.area() < fLeafCost || nCount > kMaxLeafSize)) {
+		float fMin = centroidBounds.aMin[nBestAxis];
+		float fBinScale = kBinCount / (centroidBounds.aMax[nBestAxis] - fMin);
+		nMiddle = (uint32_t)(std::partition(aOrder.begin() + nBegin, aOrder.begin() + nEnd, [&](uint32_t t) {
+			return std::min(kBinCount - 1, (int)((aCentroids[t * 3 + nBestAxis] - fMin) * fBinScale)) < nBestSplit;
+		}) - aOrder.begin());
+	}
+	else if (nCount > kMaxLeafSize) {
+		// no useful SAH split (identical centroids or a very deep tree), split at the median of the widest axis
+		int nAxis = 0;
+		for (int c = 1; c < 3; c++) {
+			if (centroidBounds.aMax[c] - centroidBounds.aMin[c] > centroidBounds.aMax[nAxis] - centroidBounds.aMin[nAxis]) nAxis = c;
+		}
+		nMiddle = nBegin + nCount / 2;
+		std::nth_element(aOrder.begin() + nBegin, aOrder.begin() + nMiddle, aOrder.begin() + nEnd, [&](uint32_t a, uint32_t b) {
+			return aCentroids[a * 3 + nAxis] < aCentroids[b * 3 + nAxis];
+		});
+	}
+	if (nMiddle == nBegin || nMiddle == nEnd) {
+		m_aNodes[nNode].nFirst = nBegin;
+		m_aNodes[nNode].nCount = nCount;
+		return nNode;
+	}
+	buildNode(aOrder, aCentroids, aBounds, nBegin, nMiddle, nDepth + 1);
+	uint32_t nRight = buildNode(aOrder, aCentroids, aBounds, nMiddle, nEnd, nDepth + 1);
+	m_aNodes[nNode].nFirst = nRight;
+	m_aNodes[nNode].nCount = 0;
+	return nNode;
+}
+
+void DzTriangleBvh::intersectPacket(const float* pOrigins, const float* pDirections, int nRays, float fMaxDistance, DzRayHit* pHits,
+	const int* pIgnoreVertices) const
+{
+	nRays = std::min(nRays, (int)kPacketSize);
+	// structure of arrays over the packet, unused lanes can never enter a node
+	float aOrigins[3][kPacketSize], aInverse[3][kPacketSize], aBest[kPacketSize];
+	for (int r = 0; r < kPacketSize; r++) {
+		bool bActive = r < nRays && (pDirections[r * 3] != 0.0f || pDirections[r * 3 + 1] != 0.0f || pDirections[r * 3 + 2] != 0.0f);
+		for (int c = 0; c < 3; c++) {
+			aOrigins[c][r] = bActive ? pOrigins[r * 3 + c] : 0.0f;
+			float fDirection = bActive ? pDirections[r * 3 + c] : 1.0f;
+			if (fDirection == 0.0f) fDirection = 1e-30f;
+			aInverse[c][r] = 1.0f / fDirection;
+		}
+		aBest[r] = bActive ? fMaxDistance : -1.0f;
+		if (r < nRays) {
+			pHits[r].nTriangle = -1;
+			pHits[r].fDistance = 0.0f;
+		}
+	}
+	if (m_aNodes.empty()) {
+		return;
+	}
+
+	auto entersNode = [&](const Node& node, int r) {
+		float fNear = 0.0f, fFar = aBest[r];
+		for (int c = 0; c < 3; c++) {
+			float t0 = (node.aMin[c] - aOrigins[c][r]) * aInverse[c][r];
+			float t1 = (node.aMax[c] - aOrigins[c][r]) * aInverse[c][r];
+			fNear = std::max(fNear, std::min(t0, t1));
+			fFar = std::min(fFar, std::max(t0, t1));
+		}
+		return fNear <= fFar ? fNear : FLT_MAX;
+	};
+
+	uint32_t aStack[kStackSize];
+	int nStack = 0;
+	aStack[nStack++] = 0;
+	while (nStack > 0) {
+		const Node& node = m_aNodes[aStack[--nStack]];
+		bool bEnters = false;
+		for (int r = 0; r < kPacketSize; r++) {
+			bEnters |= entersNode(node, r) != FLT_MAX;
+		}
+		if (!bEnters) continue;
+
+		if (node.nCount == 0) {
+			uint32_t nLeft = (uint32_t)(&node - m_aNodes.data()) + 1, nRight = node.nFirst;
+			// the child the first active ray enters first is visited first
+			float fLeft = FLT_MAX, fRight = FLT_MAX;
+			for (int r = 0; r < nRays; r++) {
+				if (aBest[r] < 0.0f) continue;
+				fLeft = entersNode(m_aNodes[nLeft], r);
+				fRight = entersNode(m_aNodes[nRight], r);
+				break;
+			}
+			if (fLeft <= fRight) {
+				aStack[nStack++] = nRight;
+				aStack[nStack++] = nLeft;
+			}
+			else {
+				aStack[nStack++] = nLeft;
+				aStack[nStack++] = nRight;
+			}
+			continue;
+		}
+
+		for (uint32_t i = node.nFirst; i < node.nFirst + node.nCount; i++) {
+			const float* v0 = &m_aTriangles[i * 9];
+			const float* e1 = v0 + 3;
+			const float* e2 = v0 + 6;
+			for (int r = 0; r < nRays; r++) {
+				if (aBest[r] < 0.0f) continue;
+				if (pIgnoreVertices && (m_aTriangleVertices[i * 3] == pIgnoreVertices[r] || m_aTriangleVertices[i * 3 + 1] == pIgnoreVertices[r] ||
+					m_aTriangleVertices[i * 3 + 2] == pIgnoreVertices[r])) continue;
+				// same test and epsilon as Blender's isect_ray_tri_epsilon_v3
+				const float* d = pDirections + r * 3;
+				float p[3], s[3], q[3];
+				cross(d, e2, p);
+				float a = dot(e1, p);
+				if (a == 0.0f) continue;
+				float f = 1.0f / a;
+				for (int c = 0; c < 3; c++) s[c] = aOrigins[c][r] - v0[c];
+				float u = f * dot(s, p);
+				if (u < -FLT_EPSILON || u > 1.0f + FLT_EPSILON) continue;
+				cross(s, e1, q);
+				float v = f * dot(d, q);
+				if (v < -FLT_EPSILON || u + v > 1.0f + FLT_EPSILON) continue;
+				float fDistance = f * dot(e2, q);
+				if (fDistance < 0.0f) continue;
+				// the first hit up to the maximum distance counts, after that only strictly nearer ones
+				if (fDistance < aBest[r] || (pHits[r].nTriangle < 0 && fDistance <= aBest[r])) {
+					aBest[r] = fDistance;
+					pHits[r].nTriangle = m_aTriangleIds[i];
+					pHits[r].fDistance = fDistance;
+				}
+			}
+		}
+	}
+}
+
+namespace
+{
+	// squared distance from p to a box, 0 inside
+	inline float boxDistanceSquared(const float* pMin, const float* pMax, const float* p)
+	{
+		float fDistance = 0.0f;
+		for (int c = 0; c < 3; c++) {
+			float d = std::max(std::max(pMin[c] - p[c], p[c] - pMax[c]), 0.0f);
+			fDistance += d * d;
+		}
+		return fDistance;
+	}
+
+	// Closest point of triangle (v0, v0 + e1, v0 + e2) to p by its Voronoi regions (Ericson, Real-Time Collision Detection
+	// 5.1.5), as barycentric weights.  Returns the squared distance.
+	float closestPointOnTriangle(const float* v0, const float* e1, const float* e2, const float* p, float* pBarycentric)
+	{
+		float ap[3];
+		for (int c = 0; c < 3; c++) ap[c] = p[c] - v0[c];
+		float d1 = dot(e1, ap), d2 = dot(e2, ap);
+		float u = 0.0f, v = 0.0f;
+		if (d1 <= 0.0f && d2 <= 0.0f) {
+			// vertex 0
+		}
+		else {
+			float bp[3], cp[3];
+			for (int c = 0; c < 3; c++) {
+				bp[c] = ap[c] - e1[c];
+				cp[c] = ap[c] - e2[c];
+			}
+			float d3 = dot(e1, bp), d4 = dot(e2, bp), d5 = dot(e1, cp), d6 = dot(e2, cp);
+			float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+			if (d3 >= 0.0f && d4 <= d3) {
+				u = 1.0f;
+			}
+			else if (d6 >= 0.0f && d5 <= d6) {
+				v = 1.0f;
+			}
+			else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+				u = d1 / (d1 - d3);
+			}
+			else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+				v = d2 / (d2 - d6);
+			}
+			else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+				v = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+				u = 1.0f - v;
+			}
+			else {
+				float fDenominator = va + vb + vc;
+				if (fDenominator > 0.0f) {
+					u = vb / fDenominator;
+					v = vc / fDenominator;
+				}
+			}
+		}
+		pBarycentric[0] = 1.0f - u - v;
+		pBarycentric[1] = u;
+		pBarycentric[2] = v;
+		float fDistance = 0.0f;
+		for (int c = 0; c < 3; c++) {
+			float d = ap[c] - e1[c] * u - e2[c] * v;
+			fDistance += d * d;
+		}
+		return fDistance;
+	}
+}
+
+DzClosestPoint DzTriangleBvh::findClosestPoint(const float* pPoint, float fMaxDistance) const
+{
+	DzClosestPoint closest;
+	if (m_aNodes.empty()) {
+		return closest;
+	}
+	float fBest = fMaxDistance * fMaxDistance;
+	uint32_t aStack[kStackSize];
+	int nStack = 0;
+	aStack[nStack++] = 0;
+	while (nStack > 0) {
+		const Node& node = m_aNodes[aStack[--nStack]];
+		if (boxDistanceSquared(node.aMin, node.aMax, pPoint) > fBest) continue;
+
+		if (node.nCount == 0) {
+			uint32_t nLeft = (uint32_t)(&node - m_aNodes.data()) + 1, nRight = node.nFirst;
+			float fLeft = boxDistanceSquared(m_aNodes[nLeft].aMin, m_aNodes[nLeft].aMax, pPoint);
+			float fRight = boxDistanceSquared(m_aNodes[nRight].aMin, m_aNodes[nRight].aMax, pPoint);
+			if (fLeft <= fRight) {
+				aStack[nStack++] = nRight;
+				aStack[nStack++] = nLeft;
+			}
+			else {
+				aStack[nStack++] = nLeft;
+				aStack[nStack++] = nRight;
+			}
+			continue;
+		}
+
+		for (uint32_t i = node.nFirst; i < node.nFirst + node.nCount; i++) {
+			const float* v0 = &m_aTriangles[i * 9];
+			float aBarycentric[3];
+			float fDistance = closestPointOnTriangle(v0, v0 + 3, v0 + 6, pPoint, aBarycentric);
+			// the first triangle up to the maximum distance counts, after that only strictly nearer ones
+			if (fDistance < fBest || (closest.nTriangle < 0 && fDistance <= fBest)) {
+				fBest = fDistance;
+				closest.nTriangle = m_aTriangleIds[i];
+				closest.fDistance = sqrtf(fDistance);
+				for (int c = 0; c < 3; c++) closest.aBarycentric[c] = aBarycentric[c];
+			}
+		}
+	}
+	return closest;
+}
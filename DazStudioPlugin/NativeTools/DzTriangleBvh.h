@@ -0,0 +1,77 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct DzRayHit
+{
+	int nTriangle = -1;     // input triangle index, -1 = no hit
+	float fDistance = 0.0f; // along the normalized direction
+};
+
+struct DzClosestPoint
+{
+	int nTriangle = -1;     // input triangle index, -1 = none within the maximum distance
+	float fDistance = 0.0f;
+	float aBarycentric[3] = { 0.0f, 0.0f, 0.0f };    // weights of the triangle's vertices, in input order
+};
+
+/*****************************
+DzTriangleBvh
+
+Bounding volume hierarchy over a triangle soup, built top-down with the
+binned surface area heuristic (12 bins per axis, 4 to 8 triangles per
+leaf).  The tree and the triangles are stored in depth-first order, so a
+traversal reads memory mostly forward.
+
+intersectPacket() traverses up to kPacketSize rays together: a node is
+visited while any ray of the packet still enters it, which suits rays with
+nearby origins, for example all rays leaving one vertex.  Rays hit both
+sides of a triangle with the same test as Blender's BVH ray casts
+(Moller-Trumbore with the triangle grown by FLT_EPSILON), so the nearest
+hits match Object.ray_cast().
+
+findClosestPoint() descends into the nearer child first and skips nodes
+farther than the closest point found so far.
+*****************************/
+class DzTriangleBvh
+{
+public:
+	static const int kPacketSize = 8;
+
+	// pTriangles holds 3 vertex indices per triangle into pPositions (xyz per vertex)
+	void build(const float* pPositions, const int* pTriangles, size_t nTriangles);
+
+	// Updates the triangles and node bounds for new positions of the same vertices, keeping the tree.  Much faster than
+	// build(), but the tree gets slower the more the mesh moved.
+	void refit(const float* pPositions);
+
+	// Nearest hit of every ray up to fMaxDistance (inclusive).  Directions must be normalized, a zero direction never hits.
+	// pIgnoreVertices (optional) holds a vertex per ray whose triangles the ray passes through, for rays leaving a vertex.
+	void intersectPacket(const float* pOrigins, const float* pDirections, int nRays, float fMaxDistance, DzRayHit* pHits,
+		const int* pIgnoreVertices = nullptr) const;
+
+	// Closest point on any triangle up to fMaxDistance (inclusive), as BVHTree.find_nearest() finds it
+	DzClosestPoint findClosestPoint(const float* pPoint, float fMaxDistance) const;
+
+	size_t getNodeCount() const { return m_aNodes.size(); }
+
+private:
+	struct Node
+	{
+		float aMin[3];
+		uint32_t nFirst;    // first triangle of a leaf, the right child of an inner node (the left child is the next node)
+		float aMax[3];
+		uint32_t nCount;    // triangles of a leaf, 0 for inner nodes
+	};
+
+	uint32_t buildNode(std::vector<uint32_t>& aOrder, const std::vector<float>& aCentroids,
+		const std::vector<float>& aBounds, uint32_t nBegin, uint32_t nEnd, int nDepth);
+	void updateTriangles(const float* pPositions);
+
+	std::vector<Node> m_aNodes;
+	std::vector<float> m_aTriangles;    // v0, v1 - v0, v2 - v0 per triangle, in leaf order
+	std::vector<int> m_aTriangleIds;
+	std::vector<int> m_aTriangleVertices;   // in leaf order
+	float m_fPadding = 0.0f;
+};
@@ -0,0 +1,363 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+
+#include "DzUVPacker.h"
+
+namespace
+{
+	struct UVVertexKey {
+		int nVertex;
+		uint32_t nU;
+		uint32_t nV;
+		bool operator==(const UVVertexKey& other) const { return nVertex == other.nVertex && nU == other.nU && nV == other.nV; }
+	};
+
+	struct UVVertexKeyHash {
+		size_t operator()(const UVVertexKey& key) const
+		{
+			uint64_t nHash = (uint64_t)(uint32_t)key.nVertex * 0x9e3779b97f4a7c15ull;
+			nHash ^= ((uint64_t)key.nU << 32 | key.nV) + 0x7f4a7c159e3779b9ull + (nHash << 6) + (nHash >> 2);
+			return (size_t)nHash;
+		}
+	};
+
+	uint32_t floatBits(float fValue)
+	{
+		// +0 and -0 must hash the same
+		if (fValue == 0.0f) fValue = 0.0f;
+		uint32_t nBits;
+		memcpy(&nBits, &fValue, sizeof(nBits));
+		return nBits;
+	}
+
+	int findRoot(std::vector<int>& aParents, int n)
+	{
+		while (aParents[n] != n) {
+			aParents[n] = aParents[aParents[n]];
+			n = aParents[n];
+		}
+		return n;
+	}
+
+	struct Point {
+		double x, y;
+		bool operator<(const Point& other) const { return x < other.x || (x == other.x && y < other.y); }
+	};
+
+	double cross(const Point& o, const Point& a, const Point& b)
+	{
+		return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+	}
+
+	// Andrew's monotone chain, counter-clockwise without repeated end point
+	std::vector<Point> convexHull(std::vector<Point> aPoints)
+	{
+		std::sort(aPoints.begin(), aPoints.end());
+		aPoints.erase(std::unique(aPoints.begin(), aPoints.end(), [](const Point& a, const Point& b) { return a.x == b.x && a.y == b.y; }), aPoints.end());
+		if (aPoints.size() < 3) {
+			return aPoints;
+		}
+		std::vector<Point> aHull(aPoints.size() * 2);
+		size_t k = 0;
+		for (size_t i = 0; i < aPoints.size(); i++) {
+			while (k >= 2 && cross(aHull[k - 2], aHull[k - 1], aPoints[i]) <= 0) k--;
+			aHull[k++] = aPoints[i];
+		}
+		for (size_t i = aPoints.size() - 1, t = k + 1; i > 0; i--) {
+			while (k >= t && cross(aHull[k - 2], aHull[k - 1], aPoints[i - 1]) <= 0) k--;
+			aHull[k++] = aPoints[i - 1];
+		}
+		aHull.resize(k - 1);
+		return aHull;
+	}
+
+	double faceArea(const float* pLoopUVs, int nStart, int nCount)
+	{
+		double dArea = 0.0;
+		for (int i = 0; i < nCount; i++) {
+			const float* pA = pLoopUVs + (size_t)(nStart + i) * 2;
+			const float* pB = pLoopUVs + (size_t)(nStart + (i + 1) % nCount) * 2;
+			dArea += (double)pA[0] * pB[1] - (double)pB[0] * pA[1];
+		}
+		return fabs(dArea) * 0.5;
+	}
+
+	struct SkylineNode {
+		double x, y, dWidth;
+	};
+}
+
+DzUVPacker::DzUVPacker(const DzUVPackSettings& settings) :
+	m_oSettings(settings)
+{
+	if (m_oSettings.nAtlasSize < 1) m_oSettings.nAtlasSize = 1;
+	if (m_oSettings.fMarginPixels < 0.0f) m_oSettings.fMarginPixels = 0.0f;
+}
+
+void DzUVPacker::findIslands(const int* pFaceLoopStarts, const int* pFaceLoopCounts, size_t nFaces,
+	const int* pLoopVertices, const float* pLoopUVs, size_t nLoops)
+{
+	std::vector<int> aParents(nFaces);
+	for (size_t f = 0; f < nFaces; f++) {
+		aParents[f] = (int)f;
+	}
+
+	std::unordered_map<UVVertexKey, int, UVVertexKeyHash> oUVVertexFaces;
+	oUVVertexFaces.reserve(nLoops);
+	for (size_t f = 0; f < nFaces; f++) {
+		for (int i = 0; i < pFaceLoopCounts[f]; i++) {
+			size_t nLoop = (size_t)pFaceLoopStarts[f] + i;
+			UVVertexKey key = { pLoopVertices[nLoop], floatBits(pLoopUVs[nLoop * 2]), floatBits(pLoopUVs[nLoop * 2 + 1]) };
+			auto result = oUVVertexFaces.insert(std::make_pair(key, (int)f));
+			if (result.second == false) {
+				int nRootA = findRoot(aParents, (int)f);
+				int nRootB = findRoot(aParents, result.first->second);
+				if (nRootA != nRootB) {
+					aParents[std::max(nRootA, nRootB)] = std::min(nRootA, nRootB);
+				}
+			}
+		}
+	}
+
+	// islands in order of their first face, so the result does not depend on hashing
+	std::vector<int> aIslandOfRoot(nFaces, -1);
+	for (size_t f = 0; f < nFaces; f++) {
+		int nRoot = findRoot(aParents, (int)f);
+		if (aIslandOfRoot[nRoot] < 0) {
+			aIslandOfRoot[nRoot] = (int)m_aIslands.size();
+			m_aIslands.push_back(Island());
+		}
+		m_aIslands[aIslandOfRoot[nRoot]].aFaces.push_back((int)f);
+	}
+}
+
+void DzUVPacker::fitIsland(Island& island, const int* pFaceLoopStarts, const int* pFaceLoopCounts, const float* pLoopUVs, const float* pFaceDensities)
+{
+	// area weighted texel density of the island faces
+	double dWeightedDensity = 0.0;
+	double dTotalArea = 0.0;
+	double dDensitySum = 0.0;
+	for (int f : island.aFaces) {
+		double dDensity = pFaceDensities ? std::max((double)pFaceDensities[f], 1e-6) : 1.0;
+		double dArea = faceArea(pLoopUVs, pFaceLoopStarts[f], pFaceLoopCounts[f]);
+		dWeightedDensity += dDensity * dArea;
+		dTotalArea += dArea;
+		dDensitySum += dDensity;
+	}
+	island.dDensity = dTotalArea > 0.0 ? dWeightedDensity / dTotalArea : dDensitySum / island.aFaces.size();
+
+	std::vector<Point> aPoints;
+	for (int f : island.aFaces) {
+		for (int i = 0; i < pFaceLoopCounts[f]; i++) {
+			const float* pUV = pLoopUVs + (size_t)(pFaceLoopStarts[f] + i) * 2;
+			Point point = { pUV[0] * island.dDensity, pUV[1] * island.dDensity };
+			aPoints.push_back(point);
+		}
+	}
+	std::vector<Point> aHull = convexHull(aPoints);
+
+	auto measure = [&](double dCos, double dSin, double* pBounds) {
+		pBounds[0] = pBounds[1] = 1e300;
+		pBounds[2] = pBounds[3] = -1e300;
+		for (const Point& point : aHull) {
+			double x = dCos * point.x + dSin * point.y;
+			double y = -dSin * point.x + dCos * point.y;
+			pBounds[0] = std::min(pBounds[0], x);
+			pBounds[1] = std::min(pBounds[1], y);
+			pBounds[2] = std::max(pBounds[2], x);
+			pBounds[3] = std::max(pBounds[3], y);
+		}
+		return (pBounds[2] - pBounds[0]) * (pBounds[3] - pBounds[1]);
+	};
+
+	double aBounds[4];
+	double dBestArea = measure(1.0, 0.0, aBounds);
+	double aBestBounds[4] = { aBounds[0], aBounds[1], aBounds[2], aBounds[3] };
+	island.dCos = 1.0;
+	island.dSin = 0.0;
+	if (m_oSettings.bRotate && aHull.size() >= 3) {
+		// the minimum area rectangle has a side on a hull edge, keep the original orientation unless it saves at least 1%
+		double dThreshold = dBestArea * 0.99;
+		for (size_t i = 0; i < aHull.size(); i++) {
+			const Point& a = aHull[i];
+			const Point& b = aHull[(i + 1) % aHull.size()];
+			double dLength = hypot(b.x - a.x, b.y - a.y);
+			if (dLength <= 0.0) continue;
+			double dCos = (b.x - a.x) / dLength;
+			double dSin = (b.y - a.y) / dLength;
+			double dArea = measure(dCos, dSin, aBounds);
+			if (dArea < dThreshold && dArea < dBestArea) {
+				dBestArea = dArea;
+				island.dCos = dCos;
+				island.dSin = dSin;
+				memcpy(aBestBounds, aBounds, sizeof(aBounds));
+			}
+		}
+	}
+	island.aOrigin[0] = aBestBounds[0];
+	island.aOrigin[1] = aBestBounds[1];
+	island.dWidth = std::max(aBestBounds[2] - aBestBounds[0], 1e-9);
+	island.dHeight = std::max(aBestBounds[3] - aBestBounds[1], 1e-9);
+}
+
+bool DzUVPacker::packIslands(double dSize, std::vector<int>& aOrder)
+{
+	double dPadding = m_oSettings.fMarginPixels * dSize / m_oSettings.nAtlasSize;
+	double dEpsilon = dSize * 1e-9;
+	std::vector<SkylineNode> aSkyline;
+	SkylineNode start = { 0.0, 0.0, dSize };
+	aSkyline.push_back(start);
+
+	for (int nIsland : aOrder) {
+		Island& island = m_aIslands[nIsland];
+		int nBestNode = -1;
+		double dBestTop = 1e300, dBestWidth = 0.0, dBestHeight = 0.0, dBestX = 0.0, dBestY = 0.0;
+		bool bBestTurned = false;
+		for (int nTurn = 0; nTurn < (m_oSettings.bRotate ? 2 : 1); nTurn++) {
+			double dWidth = (nTurn ? island.dHeight : island.dWidth) + dPadding;
+			double dHeight = (nTurn ? island.dWidth : island.dHeight) + dPadding;
+			for (size_t i = 0; i < aSkyline.size(); i++) {
+				double x = aSkyline[i].x;
+				if (x + dWidth > dSize + dEpsilon) break;
+				// resting height over every skyline segment below the rectangle
+				double y = 0.0;
+				double dCovered = 0.0;
+				for (size_t j = i; j < aSkyline.size() && dCovered < dWidth - dEpsilon; j++) {
+					y = std::max(y, aSkyline[j].y);
+					dCovered = aSkyline[j].x + aSkyline[j].dWidth - x;
+				}
+				double dTop = y + dHeight;
+				if (dTop > dSize + dEpsilon) continue;
+				if (dTop < dBestTop - dEpsilon || (fabs(dTop - dBestTop) <= dEpsilon && x < dBestX)) {
+					nBestNode = (int)i;
+					dBestTop = dTop;
+					dBestWidth = dWidth;
+					dBestHeight = dHeight;
+					dBestX = x;
+					dBestY = y;
+					bBestTurned = nTurn != 0;
+				}
+			}
+		}
+		if (nBestNode < 0) {
+			return false;
+		}
+		island.aPosition[0] = dBestX + dPadding * 0.5;
+		island.aPosition[1] = dBestY + dPadding * 0.5;
+		island.bTurned = bBestTurned;
+
+		// raise the skyline under the new rectangle
+		SkylineNode node = { dBestX, dBestY + dBestHeight, dBestWidth };
+		aSkyline.insert(aSkyline.begin() + nBestNode, node);
+		for (size_t i = nBestNode + 1; i < aSkyline.size(); ) {
+			double dShrink = node.x + node.dWidth - aSkyline[i].x;
+			if (dShrink <= 0.0) break;
+			aSkyline[i].x += dShrink;
+			aSkyline[i].dWidth -= dShrink;
+			if (aSkyline[i].dWidth <= dEpsilon) {
+				aSkyline.erase(aSkyline.begin() + i);
+				continue;
+			}
+			break;
+		}
+		for (size_t i = 0; i + 1 < aSkyline.size(); ) {
+			if (fabs(aSkyline[i].y - aSkyline[i + 1].y) <= dEpsilon) {
+				aSkyline[i].dWidth += aSkyline[i + 1].dWidth;
+				aSkyline.erase(aSkyline.begin() + i + 1);
+			}
+			else {
+				i++;
+			}
+		}
+	}
+	return true;
+}
+
+bool DzUVPacker::pack(const int* pFaceLoopStarts, const int* pFaceLoopCounts, size_t nFaces,
+	const int* pLoopVertices, const float* pLoopUVs, size_t nLoops,
+	const float* pFaceDensities, float* pOutUVs)
+{
+	m_aIslands.clear();
+	m_dCoverage = 0.0;
+	if (!pFaceLoopStarts || !pFaceLoopCounts || !pLoopVertices || !pLoopUVs || !pOutUVs) {
+		return false;
+	}
+	for (size_t f = 0; f < nFaces; f++) {
+		if (pFaceLoopStarts[f] < 0 || pFaceLoopCounts[f] < 1 || (size_t)pFaceLoopStarts[f] + pFaceLoopCounts[f] > nLoops) {
+			return false;
+		}
+	}
+	memcpy(pOutUVs, pLoopUVs, nLoops * 2 * sizeof(float));
+	if (nFaces == 0) {
+		return true;
+	}
+
+	findIslands(pFaceLoopStarts, pFaceLoopCounts, nFaces, pLoopVertices, pLoopUVs, nLoops);
+	double dIslandArea = 0.0;
+	for (Island& island : m_aIslands) {
+		fitIsland(island, pFaceLoopStarts, pFaceLoopCounts, pLoopUVs, pFaceDensities);
+		dIslandArea += island.dWidth * island.dHeight;
+	}
+
+	// tallest first suits the skyline packer
+	std::vector<int> aOrder(m_aIslands.size());
+	for (size_t i = 0; i < aOrder.size(); i++) {
+		aOrder[i] = (int)i;
+	}
+	std::stable_sort(aOrder.begin(), aOrder.end(), [&](int a, int b) {
+		const Island& islandA = m_aIslands[a];
+		const Island& islandB = m_aIslands[b];
+		double dSideA = m_oSettings.bRotate ? std::min(islandA.dWidth, islandA.dHeight) : islandA.dHeight;
+		double dSideB = m_oSettings.bRotate ? std::min(islandB.dWidth, islandB.dHeight) : islandB.dHeight;
+		return dSideA > dSideB;
+	});
+
+	// smallest packing square, the bounding box area is a lower bound
+	double dLow = sqrt(dIslandArea);
+	for (const Island& island : m_aIslands) {
+		dLow = std::max(dLow, std::max(island.dWidth, island.dHeight));
+	}
+	double dHigh = dLow * 1.05;
+	int nAttempts = 0;
+	while (packIslands(dHigh, aOrder) == false) {
+		dLow = dHigh;
+		dHigh *= 1.15;
+		if (++nAttempts > 100) {
+			return false;
+		}
+	}
+	for (int i = 0; i < 16 && dHigh - dLow > dHigh * 1e-4; i++) {
+		double dMiddle = (dLow + dHigh) * 0.5;
+		if (packIslands(dMiddle, aOrder)) {
+			dHigh = dMiddle;
+		}
+		else {
+			dLow = dMiddle;
+		}
+	}
+	packIslands(dHigh, aOrder);
+
+	double dScale = 1.0 / dHigh;
+	for (const Island& island : m_aIslands) {
+		for (int f : island.aFaces) {
+			for (int i = 0; i < pFaceLoopCounts[f]; i++) {
+				size_t nLoop = (size_t)pFaceLoopStarts[f] + i;
+				double px = pLoopUVs[nLoop * 2] * island.dDensity;
+				double py = pLoopUVs[nLoop * 2 + 1] * island.dDensity;
+				double x = island.dCos * px + island.dSin * py - island.aOrigin[0];
+				double y = -island.dSin * px + island.dCos * py - island.aOrigin[1];
+				if (island.bTurned) {
+					double dTurned = island.dHeight - y;
+					y = x;
+					x = dTurned;
+				}
+				pOutUVs[nLoop * 2] = (float)((x + island.aPosition[0]) * dScale);
+				pOutUVs[nLoop * 2 + 1] = (float)((y + island.aPosition[1]) * dScale);
+			}
+			m_dCoverage += faceArea(pOutUVs, pFaceLoopStarts[f], pFaceLoopCounts[f]);
+		}
+	}
+	return true;
+}
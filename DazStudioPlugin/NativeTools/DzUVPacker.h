@@ -0,0 +1,69 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct DzUVPackSettings
+{
+	int nAtlasSize = 4096;       // only used to convert the margin to UV units
+	float fMarginPixels = 4.0f;  // space between islands in atlas pixels
+	bool bRotate = true;         // rotate islands to their tightest bounding box and allow 90 degree turns
+};
+
+/*****************************
+DzUVPacker
+
+Repacks the UV islands of one or more meshes into the unit square, as a fast
+replacement for Blender's pack_islands operator.
+
+Islands are the connected groups of faces sharing a UV vertex, which is a
+mesh vertex together with its UV coordinates, so UV seams split islands.
+Every island is scaled by the texel density of its faces, typically the
+resolution of the source textures, so that islands keep their source texel
+count relative to each other instead of their UV area.  Islands are then
+rotated to their minimum area bounding box (rotating calipers over the
+convex hull) and packed with a skyline bottom-left packer that tries both 90
+degree orientations.  The packing square is found by binary search and the
+result is scaled to fill the unit square.
+
+Faces are given as loop ranges in the Blender Mesh layout: loop start and
+count per face, mesh vertex index and UV per loop.
+*****************************/
+class DzUVPacker
+{
+public:
+	DzUVPacker(const DzUVPackSettings& settings = DzUVPackSettings());
+
+	// pFaceDensities can be null for uniform density, pOutUVs receives nLoops UV pairs
+	bool pack(const int* pFaceLoopStarts, const int* pFaceLoopCounts, size_t nFaces,
+		const int* pLoopVertices, const float* pLoopUVs, size_t nLoops,
+		const float* pFaceDensities, float* pOutUVs);
+
+	int getIslandCount() const { return (int)m_aIslands.size(); }
+	// Fraction of the unit square covered by island faces after packing
+	double getCoverage() const { return m_dCoverage; }
+
+protected:
+	struct Island {
+		std::vector<int> aFaces;
+		double dDensity = 1.0;
+		// island space = rotation(uv * density) - origin
+		double dCos = 1.0;
+		double dSin = 0.0;
+		double aOrigin[2] = { 0.0, 0.0 };
+		double dWidth = 0.0;
+		double dHeight = 0.0;
+		// placement in the packing square
+		double aPosition[2] = { 0.0, 0.0 };
+		bool bTurned = false;
+	};
+
+	void findIslands(const int* pFaceLoopStarts, const int* pFaceLoopCounts, size_t nFaces,
+		const int* pLoopVertices, const float* pLoopUVs, size_t nLoops);
+	void fitIsland(Island& island, const int* pFaceLoopStarts, const int* pFaceLoopCounts, const float* pLoopUVs, const float* pFaceDensities);
+	bool packIslands(double dSize, std::vector<int>& aOrder);
+
+	DzUVPackSettings m_oSettings;
+	std::vector<Island> m_aIslands;
+	double m_dCoverage = 0.0;
+};
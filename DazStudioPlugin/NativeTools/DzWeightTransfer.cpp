@@ -0,0 +1,117 @@
+#include <float.h>
+#include <algorithm>
+
+#include "DzWeightTransfer.h"
+#include "DzTriangleBvh.h"
+#include "DzNativeParallel.h"
+
+namespace
+{
+	// a query is a few dozen box and triangle tests
+	const size_t kMinPointsPerThread = 4096;
+}
+
+bool DzWeightTransfer::Transfer(const DzWeightTransferSource& source, const float* pTargetPositions, size_t nTargetPoints,
+	const DzWeightTransferSettings& settings, std::vector<int>& aGroups, std::vector<float>& aWeights,
+	std::vector<int>* pTriangles, DzWeightTransferStats* pStats)
+{
+	const int nMaxInfluences = std::max(settings.nMaxInfluences, 1);
+	aGroups.assign(nTargetPoints * nMaxInfluences, -1);
+	aWeights.assign(nTargetPoints * nMaxInfluences, 0.0f);
+	for (size_t t = 0; t < source.nTriangles * 3; t++) {
+		if (source.pTriangles[t] < 0 || (size_t)source.pTriangles[t] >= source.nVertices) return false;
+	}
+	for (size_t i = 0; i < source.nWeights; i++) {
+		if (source.pWeightVertices[i] < 0 || (size_t)source.pWeightVertices[i] >= source.nVertices || source.pWeightGroups[i] < 0) return false;
+	}
+
+	// the influences of every source vertex
+	std::vector<uint32_t> aOffsets(source.nVertices + 1, 0);
+	for (size_t i = 0; i < source.nWeights; i++) {
+		aOffsets[source.pWeightVertices[i] + 1]++;
+	}
+	for (size_t v = 0; v < source.nVertices; v++) {
+		aOffsets[v + 1] += aOffsets[v];
+	}
+	std::vector<int> aVertexGroups(source.nWeights);
+	std::vector<float> aVertexWeights(source.nWeights);
+	std::vector<uint32_t> aFill(aOffsets.begin(), aOffsets.end() - 1);
+	for (size_t i = 0; i < source.nWeights; i++) {
+		uint32_t k = aFill[source.pWeightVertices[i]]++;
+		aVertexGroups[k] = source.pWeightGroups[i];
+		aVertexWeights[k] = source.pWeights[i];
+	}
+
+	DzTriangleBvh bvh;
+	bvh.build(source.pPositions, source.pTriangles, source.nTriangles);
+	float fMaxDistance = settings.fMaxDistance > 0.0f ? settings.fMaxDistance : FLT_MAX;
+	std::vector<int> aTriangles(nTargetPoints, -1);
+	std::vector<float> aDistances(nTargetPoints, 0.0f);
+	DzNativeParallel::For(nTargetPoints, kMinPointsPerThread, [&](size_t nBegin, size_t nEnd) {
+		// the groups of the three vertices, merged
+		std::vector<std::pair<float, int> > aInfluences;
+		for (size_t p = nBegin; p < nEnd; p++) {
+			DzClosestPoint closest = bvh.findClosestPoint(pTargetPositions + p * 3, fMaxDistance);
+			if (closest.nTriangle < 0) continue;
+			aTriangles[p] = closest.nTriangle;
+			aDistances[p] = closest.fDistance;
+			aInfluences.clear();
+			for (int c = 0; c < 3; c++) {
+				int v = source.pTriangles[closest.nTriangle * 3 + c];
+				for (uint32_t k = aOffsets[v]; k < aOffsets[v + 1]; k++) {
+					aInfluences.push_back(std::make_pair(aVertexWeights[k] * closest.aBarycentric[c], aVertexGroups[k]));
+				}
+			}
+			std::sort(aInfluences.begin(), aInfluences.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+				return a.second < b.second;
+			});
+			size_t nMerged = 0;
+			for (size_t i = 0; i < aInfluences.size(); i++) {
+				if (nMerged > 0 && aInfluences[nMerged - 1].second == aInfluences[i].second) {
+					aInfluences[nMerged - 1].first += aInfluences[i].first;
+				}
+				else {
+					aInfluences[nMerged++] = aInfluences[i];
+				}
+			}
+			aInfluences.resize(nMerged);
+			// largest first, ties by group so the result does not depend on the input order
+			std::sort(aInfluences.begin(), aInfluences.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+				return a.first > b.first || (a.first == b.first && a.second < b.second);
+			});
+			float fSum = 0.0f, fKeptSum = 0.0f;
+			size_t nKept = 0;
+			for (size_t i = 0; i < aInfluences.size(); i++) {
+				fSum += aInfluences[i].first;
+				if (aInfluences[i].first <= 0.0f) continue;
+				if (nKept < (size_t)nMaxInfluences && (nKept == 0 || aInfluences[i].first >= settings.fMinWeight)) {
+					fKeptSum += aInfluences[i].first;
+					nKept++;
+				}
+			}
+			float fScale = fKeptSum > 0.0f ? fSum / fKeptSum : 0.0f;
+			for (size_t i = 0; i < nKept; i++) {
+				aGroups[p * nMaxInfluences + i] = aInfluences[i].second;
+				aWeights[p * nMaxInfluences + i] = aInfluences[i].first * fScale;
+			}
+		}
+	});
+
+	if (pStats) {
+		DzWeightTransferStats stats;
+		stats.nPoints = nTargetPoints;
+		stats.nBvhNodes = bvh.getNodeCount();
+		for (size_t p = 0; p < nTargetPoints; p++) {
+			if (aTriangles[p] < 0) stats.nUnmatchedPoints++;
+			stats.fMaxDistance = std::max(stats.fMaxDistance, aDistances[p]);
+		}
+		for (size_t i = 0; i < aGroups.size(); i++) {
+			if (aGroups[i] >= 0) stats.nInfluences++;
+		}
+		*pStats = stats;
+	}
+	if (pTriangles) {
+		pTriangles->swap(aTriangles);
+	}
+	return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// The mesh weights are copied from: triangles, and the weights as (vertex, group, weight) entries (Blender vertex groups
+// or FBX skin clusters)
+struct DzWeightTransferSource
+{
+	const float* pPositions = nullptr;    // xyz per vertex
+	size_t nVertices = 0;
+	const int* pTriangles = nullptr;      // 3 vertices per triangle
+	size_t nTriangles = 0;
+	const int* pWeightVertices = nullptr;
+	const int* pWeightGroups = nullptr;
+	const float* pWeights = nullptr;
+	size_t nWeights = 0;
+};
+
+struct DzWeightTransferSettings
+{
+	// points farther from the source get no weights, 0 = no limit
+	float fMaxDistance = 0.0f;
+	// the largest interpolated weights of every point are kept, at least 1
+	int nMaxInfluences = 4;
+	// interpolated weights below this are removed, the largest weight of a point is always kept
+	float fMinWeight = 0.0f;
+};
+
+struct DzWeightTransferStats
+{
+	size_t nPoints = 0;
+	// points without a source triangle within the maximum distance
+	size_t nUnmatchedPoints = 0;
+	size_t nInfluences = 0;
+	float fMaxDistance = 0.0f;
+	size_t nBvhNodes = 0;
+};
+
+/*****************************
+DzWeightTransfer
+
+Closest point skin weight transfer, as Blender's Data Transfer of vertex
+group weights with the "Nearest Face Interpolated" mapping: every target
+point takes the weights of the closest point on the source triangles,
+interpolated from the triangle's vertices with barycentric weights.
+
+The source triangles go into a DzTriangleBvh and the target points are
+queried in parallel.  Every point keeps its nMaxInfluences largest weights
+above fMinWeight, rescaled to the interpolated weight sum, so normalized
+source weights stay normalized.
+*****************************/
+class DzWeightTransfer
+{
+public:
+	// The influences of target point p are aGroups/aWeights[p * nMaxInfluences, + nMaxInfluences), largest first, unused
+	// entries have group -1.  aTriangles (optional) receives the closest source triangle of every point, -1 if none.
+	// Returns false on invalid input (indices out of range).
+	static bool Transfer(const DzWeightTransferSource& source, const float* pTargetPositions, size_t nTargetPoints,
+		const DzWeightTransferSettings& settings, std::vector<int>& aGroups, std::vector<float>& aWeights,
+		std::vector<int>* pTriangles = nullptr, DzWeightTransferStats* pStats = nullptr);
+};
@@ -9,8 +9,14 @@ Requirements:
     - Python 3+
     - Blender 3.6+
 
-Version: 1.32
-
+Version: 1.33
+
+2026-10-18
+- Added wait_for_texture_jobs(), process_dtu() now waits on the texture jobs manifest before loading textures
+- Added apply_texture_manifest() to remap DTU textures to processed (and cached) textures
+- apply_texture_manifest() also applies per-material overrides (combined diffuse/alpha, color multiplied textures)
+- Added link_orm_texture(), process_material() uses packed occlusion/roughness/metallic textures from the manifest
+- swap_lowres_filename() picks texture pyramid variants listed in the manifest
 2024-12-26
 - Bugfix for duplicate materials
 - Bugfix for Instance labels
@@ -29,6 +35,7 @@ logFilename = "blender_tools.log"
 ## Do not modify below
 import sys, json, os
 import re
+import time
 
 try:
     import bpy
@@ -43,6 +50,11 @@ def _add_to_log(sMessage):
 
 
 global_image_cache = {}
+# texture path -> downscaled variants from the texture jobs manifest, largest first
+global_texture_variants = {}
+
+# maximum time to wait for Daz Studio to finish background texture jobs
+TEXTURE_JOBS_TIMEOUT = 600
 
 def scalar_to_vec3(i):
     return [i, i, i]
@@ -87,6 +99,40 @@ def load_cached_image_to_material(matName, input_key, output_key, texture_map, t
     return link
 
 
+def get_gltf_material_output_group():
+    # the glTF exporter reads occlusion from the input of a node group with this name
+    group_name = "glTF Material Output"
+    if group_name in bpy.data.node_groups:
+        return bpy.data.node_groups[group_name]
+    group = bpy.data.node_groups.new(group_name, "ShaderNodeTree")
+    if bpy.app.version[0] >= 4:
+        group.interface.new_socket("Occlusion", in_out="INPUT", socket_type="NodeSocketFloat")
+    else:
+        group.inputs.new("NodeSocketFloat", "Occlusion")
+    group.nodes.new("NodeGroupInput")
+    return group
+
+def link_orm_texture(matName, orm_texture):
+    """Link the channels of a packed occlusion (R), roughness (G), metallic (B) texture from the texture jobs manifest."""
+    data = bpy.data.materials[matName]
+    nodes = data.node_tree.nodes
+    links = data.node_tree.links
+    bsdf_inputs = nodes["Principled BSDF"].inputs
+
+    node_tex = nodes.new("ShaderNodeTexImage")
+    node_tex.image = cached_image_load(orm_texture["Texture"], "Non-Color")
+    node_separate = nodes.new("ShaderNodeSeparateColor")
+    links.new(node_tex.outputs["Color"], node_separate.inputs["Color"])
+    if orm_texture.get("Roughness", False):
+        links.new(node_separate.outputs["Green"], bsdf_inputs["Roughness"])
+    if orm_texture.get("Metallic", False):
+        links.new(node_separate.outputs["Blue"], bsdf_inputs["Metallic"])
+    if orm_texture.get("Occlusion", False):
+        node_gltf = nodes.new("ShaderNodeGroup")
+        node_gltf.node_tree = get_gltf_material_output_group()
+        links.new(node_separate.outputs["Red"], node_gltf.inputs["Occlusion"])
+
+
 def srgb_to_linear_rgb(srgb):
     if srgb < 0:
         return 0
@@ -136,6 +182,14 @@ def fix_scalp():
             mat.show_transparent_back = False
 
 def swap_lowres_filename(filename, lowres_mode="2k"):
+    # texture pyramid variants written by the texture pipeline, the largest one that fits lowres_mode
+    variants = global_texture_variants.get(filename)
+    if variants:
+        mode = lowres_mode.lower()
+        max_size = int(mode[:-1]) * 1024 if mode.endswith("k") else int(mode)
+        for variant in variants:
+            if variant["Size"] <= max_size and os.path.exists(variant["Texture"]):
+                return variant["Texture"]
     filename_base, ext = os.path.splitext(filename)
     filename_2k = filename_base + "_2k"
     filename_1k = filename_base + "_1k"
@@ -435,6 +489,20 @@ def process_material(mat, lowres_mode=None):
     # _add_to_log("DEBUG: process_dtu(): e map = \"" + str(emissionMap) + "\"")
     # _add_to_log("DEBUG: process_dtu(): n map = \"" + str(normalMap) + "\"")
 
+    # packed occlusion/roughness/metallic texture, replaces the separate maps of the packed channels
+    orm_texture = mat.get("ORM Texture")
+    if orm_texture is not None and lowres_mode is not None:
+        orm_texture = dict(orm_texture, Texture=swap_lowres_filename(orm_texture["Texture"], lowres_mode))
+    if orm_texture is not None:
+        if not os.path.exists(orm_texture["Texture"]):
+            _add_to_log("ERROR: process_dtu(): ORM texture file does not exist, using separate maps...")
+            orm_texture = None
+        else:
+            if orm_texture.get("Roughness", False):
+                roughnessMap = ""
+            if orm_texture.get("Metallic", False):
+                metallicMap = ""
+
     # get Principled BSDF Shader inputs
     data = bpy.data.materials[matName]
     nodes = data.node_tree.nodes
@@ -563,6 +631,9 @@ def process_material(mat, lowres_mode=None):
     else:
         bsdf_inputs["Roughness"].default_value = roughness_value
 
+    if orm_texture is not None:
+        link_orm_texture(matName, orm_texture)
+
     if (emissionMap != ""):
         if (not os.path.exists(emissionMap)):
             _add_to_log("ERROR: process_dtu(): emission map file does not exist, skipping...")
@@ -761,6 +832,96 @@ def rename_with_dtu_labels(obj_data_dict):
     return
 
 
+def wait_for_texture_jobs(jsonObj, timeout=TEXTURE_JOBS_TIMEOUT):
+    """Block until Daz Studio has finished the background texture jobs for this DTU.
+
+    Returns the parsed manifest, or None if the DTU has no manifest or the wait timed out.
+    """
+    if "Texture Jobs Manifest" not in jsonObj:
+        return None
+    manifest_path = jsonObj["Texture Jobs Manifest"]
+    if manifest_path == "":
+        return None
+    start_time = time.time()
+    if not os.path.exists(manifest_path):
+        _add_to_log("INFO: wait_for_texture_jobs(): waiting for texture jobs to complete: " + manifest_path)
+    while not os.path.exists(manifest_path):
+        if time.time() - start_time > timeout:
+            _add_to_log("ERROR: wait_for_texture_jobs(): timed out waiting for texture jobs manifest: " + manifest_path)
+            return None
+        time.sleep(0.1)
+    try:
+        with open(manifest_path, "r") as file:
+            manifest = json.load(file)
+    except Exception as e:
+        _add_to_log("ERROR: wait_for_texture_jobs(): unable to read texture jobs manifest: " + manifest_path + ", " + str(e))
+        return None
+    if manifest.get("Status") != "Complete":
+        _add_to_log("ERROR: wait_for_texture_jobs(): texture jobs did not complete: " + str(manifest.get("Error Message")))
+    _add_to_log("DEBUG: wait_for_texture_jobs(): waited %.2f seconds" % (time.time() - start_time))
+    return manifest
+
+
+def apply_texture_manifest(jsonObj, manifest):
+    """Replace DTU texture paths with the processed textures listed in the texture jobs manifest."""
+    if manifest is None or "Materials" not in jsonObj:
+        return
+    materials = jsonObj["Materials"]
+    # per-material results (diffuse/alpha combine, color multiply) take precedence over the per-file remap
+    num_overridden = 0
+    for material_override in manifest.get("Material Overrides", []):
+        material_index = material_override.get("Material Index", -1)
+        if material_index < 0 or material_index >= len(materials):
+            continue
+        for property in materials[material_index].get("Properties", []):
+            if property.get("Name") != material_override.get("Property"):
+                continue
+            property["Texture"] = material_override["Texture"]
+            if "Value" in material_override:
+                property["Value"] = material_override["Value"]
+            num_overridden += 1
+    # packed occlusion/roughness/metallic textures are linked by process_material()
+    num_packed = 0
+    for orm_texture in manifest.get("ORM Textures", []):
+        material_index = orm_texture.get("Material Index", -1)
+        if material_index < 0 or material_index >= len(materials):
+            continue
+        materials[material_index]["ORM Texture"] = orm_texture
+        num_packed += 1
+    if num_packed > 0:
+        _add_to_log("DEBUG: apply_texture_manifest(): %d materials use packed ORM textures" % num_packed)
+    texture_remap = manifest.get("Texture Remap", {})
+    num_remapped = 0
+    for mat in materials:
+        for property in mat.get("Properties", []):
+            texture = property.get("Texture", "")
+            if texture in texture_remap:
+                property["Texture"] = texture_remap[texture]
+                num_remapped += 1
+    global global_texture_variants
+    global_texture_variants = manifest.get("Texture Variants", {})
+    if len(global_texture_variants) > 0:
+        _add_to_log("DEBUG: apply_texture_manifest(): %d textures have downscaled variants" % len(global_texture_variants))
+    # Blender cannot load BC7 DDS files, the block compressed copies are only listed for engine import
+    compressed_textures = manifest.get("Compressed Textures", {})
+    if len(compressed_textures) > 0:
+        _add_to_log("DEBUG: apply_texture_manifest(): %d textures have block compressed DDS copies" % len(compressed_textures))
+    texture_cache = manifest.get("Texture Cache", {})
+    _add_to_log("DEBUG: apply_texture_manifest(): overrode %d material properties, remapped %d texture references, cache hits=%s, misses=%s" % (num_overridden, num_remapped, texture_cache.get("Hits"), texture_cache.get("Misses")))
+    # duplicates are already part of the remap, so each content is loaded (and embedded) once
+    texture_dedup = manifest.get("Texture Deduplication", {})
+    if texture_dedup.get("Duplicate Textures", 0) > 0:
+        _add_to_log("DEBUG: apply_texture_manifest(): %s duplicate textures collapsed into %s unique textures, %.1f MB saved" % (texture_dedup.get("Duplicate Textures"), texture_dedup.get("Unique Textures"), texture_dedup.get("Bytes Saved", 0) / (1024.0 * 1024.0)))
+    # collapsed maps are already material overrides with an empty texture and a scalar or color value
+    texture_statistics = manifest.get("Texture Statistics", {})
+    if texture_statistics.get("Collapsed Textures", 0) > 0:
+        _add_to_log("DEBUG: apply_texture_manifest(): %d constant texture maps replaced by material values" % texture_statistics.get("Collapsed Textures"))
+    # the resized textures themselves are already part of the remap
+    texture_sizing = manifest.get("Texture Sizing", {})
+    if texture_sizing.get("Enabled", False):
+        _add_to_log("DEBUG: apply_texture_manifest(): texel density sizing (%s texels/m) of %d textures: %.1f MB -> %.1f MB" % (texture_sizing.get("Target Texel Density"), len(texture_sizing.get("Textures", {})), texture_sizing.get("Bytes Before", 0) / (1024.0 * 1024.0), texture_sizing.get("Bytes After", 0) / (1024.0 * 1024.0)))
+
+
 def process_dtu(jsonPath, lowres_mode=None):
     _add_to_log("DEBUG: process_dtu(): json file = " + jsonPath)
     jsonObj = {}
@@ -813,6 +974,9 @@ def process_dtu(jsonPath, lowres_mode=None):
 
     rename_with_dtu_labels(obj_data_dict)
 
+    # textures may still be processing in Daz Studio, only block now that they are needed
+    manifest = wait_for_texture_jobs(jsonObj)
+    apply_texture_manifest(jsonObj, manifest)
     apply_dtu_materials(jsonObj, lowres_mode)
 
     _add_to_log("DEBUG: process_dtu(): done processing DTU: " + jsonPath)
@@ -872,6 +1036,79 @@ def import_fbx(fbxPath, force_connect_bones=False):
                              force_connect_children=force_connect_bones,
                              use_prepost_rot=True)
 
+# Adds the morphs that DzBlenderAction moved from the fbx file into the "_morphs.bin" file next to it (see DzMorphDeltas.h
+# for the layout) as shape keys, one foreach_set() per morph.
+def load_sparse_morphs(morph_path):
+    import numpy as np
+    _add_to_log("DEBUG: load_sparse_morphs(): morph file = " + morph_path)
+    start_time = time.perf_counter()
+    with open(morph_path, "rb") as file:
+        data = file.read()
+    if data[:8] != b"DZMORPHS":
+        _add_to_log("ERROR: load_sparse_morphs(): not a morph file: " + morph_path)
+        return 0
+    offset = 8
+
+    def read_array(dtype, count):
+        nonlocal offset
+        values = np.frombuffer(data, dtype=dtype, count=count, offset=offset)
+        offset += (values.nbytes + 3) & ~3
+        return values
+
+    def read_string():
+        nonlocal offset
+        length = int(read_array("<u4", 1)[0])
+        text = data[offset:offset + length].decode("utf-8")
+        offset += (length + 3) & ~3
+        return text
+
+    version, mesh_count = read_array("<u4", 2)
+    if version != 1:
+        _add_to_log("ERROR: load_sparse_morphs(): unsupported morph file version " + str(version))
+        return 0
+    morph_total = 0
+    for _ in range(mesh_count):
+        mesh_name = read_string()
+        vertex_count, morph_count = (int(value) for value in read_array("<u4", 2))
+        # objects are named after the fbx nodes, their meshes after the fbx geometry
+        obj = bpy.data.objects.get(mesh_name)
+        if obj is None or obj.type != 'MESH':
+            obj = next((o for o in bpy.data.objects if o.type == 'MESH' and o.data.name == mesh_name), None)
+        if obj is not None and len(obj.data.vertices) != vertex_count:
+            _add_to_log("ERROR: load_sparse_morphs(): " + mesh_name + " has " + str(len(obj.data.vertices)) + " vertices, the morphs " + str(vertex_count))
+            obj = None
+        elif obj is None:
+            _add_to_log("ERROR: load_sparse_morphs(): no mesh named " + mesh_name)
+        if obj is not None:
+            if obj.data.shape_keys is None:
+                obj.shape_key_add(name="Basis", from_mix=False)
+            base = np.empty(vertex_count * 3, dtype=np.float32)
+            obj.data.vertices.foreach_get("co", base)
+            positions = np.empty_like(base)
+            points = positions.reshape(-1, 3)
+        for _ in range(morph_count):
+            morph_name = read_string()
+            default_value = float(read_array("<f4", 1)[0])
+            delta_count, bits = (int(value) for value in read_array("<u4", 2))
+            delta_offset = read_array("<f4", 3)
+            delta_scale = read_array("<f4", 3)
+            indices = read_array("<u4", delta_count)
+            if bits == 0:
+                deltas = read_array("<f4", delta_count * 3).reshape(-1, 3)
+            else:
+                quantized = read_array("<u1" if bits == 8 else "<u2", delta_count * 3).reshape(-1, 3)
+                deltas = delta_offset + quantized.astype(np.float32) * delta_scale
+            if obj is None:
+                continue
+            positions[:] = base
+            points[indices] += deltas
+            shape_key = obj.shape_key_add(name=morph_name, from_mix=False)
+            shape_key.data.foreach_set("co", positions)
+            shape_key.value = default_value
+            morph_total += 1
+    _add_to_log("DEBUG: load_sparse_morphs(): added " + str(morph_total) + " shape keys in " + str(round(time.perf_counter() - start_time, 3)) + " seconds")
+    return morph_total
+
 def delete_all_items():
 #    bpy.ops.object.mode_set(mode="OBJECT");
     bpy.ops.object.select_all(action="SELECT")
@@ -109,6 +109,8 @@ def _main(argv):
     texture_atlas_size = 0
     export_rig_mode = ""
     enable_gpu_baking = False
+    pack_orm_textures = False
+    lod_ratios = []
     enable_embed_textures = False
     generate_final_fbx = False
     generate_final_glb = False
@@ -142,6 +144,10 @@ def _main(argv):
             export_rig_mode = json_obj["Export Rig Mode"]
         if "Enable Gpu Baking" in json_obj:
             enable_gpu_baking = json_obj["Enable Gpu Baking"]
+        if "Pack ORM Textures" in json_obj:
+            pack_orm_textures = json_obj["Pack ORM Textures"]
+        if "LOD Ratios" in json_obj:
+            lod_ratios = json_obj["LOD Ratios"]
     except:
         print("ERROR: error occured while reading json file: " + str(jsonPath))
 
@@ -179,6 +185,14 @@ def _main(argv):
         with open(jsonPath, "r") as data:
             oDtu.dtu_dict = json.load(data)
 
+        # the texture transforms are done by the texture jobs, and the DTB addon reads the DTU from disk,
+        # so the processed textures are written back into the DTU before it is imported
+        manifest = blender_tools.wait_for_texture_jobs(oDtu.dtu_dict)
+        if manifest is not None:
+            blender_tools.apply_texture_manifest(oDtu.dtu_dict, manifest)
+            with open(jsonPath, "w") as data:
+                json.dump(oDtu.dtu_dict, data, indent=4)
+
         DTB.Global.clear_variables()
         DTB.Global.setHomeTown(sDtuFolderPath)
         DTB.Global.load_asset_name()
@@ -197,6 +211,10 @@ def _main(argv):
         # load FBX
         _add_to_log("DEBUG: main(): loading fbx file: " + str(fbxPath))
         blender_tools.import_fbx(fbxPath, force_connect_bones)
+        # morphs exported as sparse deltas instead of fbx blend shapes
+        morph_path = os.path.splitext(fbxPath)[0] + "_morphs.bin"
+        if os.path.exists(morph_path):
+            blender_tools.load_sparse_morphs(morph_path)
 
         blender_tools.center_all_viewports()
         _add_to_log("DEBUG: main(): loading json file: " + str(jsonPath))
@@ -216,7 +234,7 @@ def _main(argv):
         bake_quality = 1
         for obj in bpy.data.objects:
             if obj.type == 'MESH' and obj.visible_get():
-                atlas, atlas_material, _ = game_readiness_tools.convert_to_atlas(obj, intermediate_folder_path, texture_atlas_size, bake_quality, make_uv, enable_gpu_baking)
+                atlas, atlas_material, _ = game_readiness_tools.convert_to_atlas(obj, intermediate_folder_path, texture_atlas_size, bake_quality, make_uv, enable_gpu_baking, pack_orm_textures)
     elif texture_atlas_mode == "single_atlas":
         _add_to_log("DEBUG: main(): converting to single atlas...")
         texture_size = 2048
@@ -226,7 +244,15 @@ def _main(argv):
         for obj in bpy.data.objects:
             if obj.type == 'MESH' and obj.visible_get():
                 obj_list.append(obj)
-        atlas, atlas_material, _ = game_readiness_tools.convert_to_atlas(obj_list, intermediate_folder_path, texture_atlas_size, bake_quality, make_uv, enable_gpu_baking)
+        atlas, atlas_material, _ = game_readiness_tools.convert_to_atlas(obj_list, intermediate_folder_path, texture_atlas_size, bake_quality, make_uv, enable_gpu_baking, pack_orm_textures)
+
+    # <mesh>_LOD1.._LODn objects next to every mesh, after the atlas so that they share its material
+    if len(lod_ratios) > 0:
+        _add_to_log("DEBUG: main(): generating LODs: " + str(lod_ratios))
+        obj_list = [obj for obj in bpy.data.objects if obj.type == 'MESH' and obj.visible_get() and len(obj.data.polygons) > 0]
+        for obj in obj_list:
+            if game_readiness_tools.generate_lods(obj, lod_ratios) is None:
+                game_readiness_tools.generate_lods_with_decimate(obj, lod_ratios)
 
     # remove missing or unused images
     print("DEBUG: deleting missing or unused images...")
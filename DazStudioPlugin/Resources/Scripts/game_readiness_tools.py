@@ -13,6 +13,7 @@ from pathlib import Path
 script_dir = str(Path( __file__ ).parent.absolute())
 
 import os
+import time
 
 try:
     import bpy
@@ -704,10 +705,87 @@ def create_new_uv_layer(obj_or_list, name="AtlasUV"):
     mesh.uv_layers.active = new_uv
     return new_uv
 
-def repack_uv(obj_or_list):
-    bpy.ops.object.select_all(action='DESELECT')
+def get_material_texel_density(material, default_density=256.0):
+    """Texels per UV unit along one axis: the largest texture resolution used by the material, times its UV tiling."""
+    density = 0.0
+    if material is not None and material.use_nodes:
+        for node in material.node_tree.nodes:
+            if node.type != 'TEX_IMAGE' or node.image is None or node.image.size[0] == 0:
+                continue
+            tiling = 1.0
+            vector_input = node.inputs['Vector']
+            if vector_input.is_linked and vector_input.links[0].from_node.type == 'MAPPING':
+                scale = vector_input.links[0].from_node.inputs['Scale'].default_value
+                tiling = max(abs(scale[0] * scale[1]), 1e-6) ** 0.5
+            density = max(density, (node.image.size[0] * node.image.size[1]) ** 0.5 * tiling)
+    return density if density > 0.0 else default_density
+
+def repack_uv_natively(obj_list, atlas_size=4096, margin_pixels=8.0, use_texel_density=True):
+    """Pack the active UV map of every object together with the native packer, scaling islands by the
+    texture resolution of their materials.  Returns False if the native library is not available."""
+    if native_tools is None or not native_tools.is_available():
+        return False
+    start_time = time.time()
+    mesh_ranges = []
+    face_loop_starts = []
+    face_loop_counts = []
+    loop_vertices = []
+    loop_uvs = []
+    face_densities = []
+    loop_offset = 0
+    vertex_offset = 0
+    packed_meshes = set()
+    for obj in obj_list:
+        mesh = obj.data
+        uv_layer = mesh.uv_layers.active
+        if uv_layer is None or mesh.name in packed_meshes:
+            continue
+        packed_meshes.add(mesh.name)
+        face_count = len(mesh.polygons)
+        loop_count = len(mesh.loops)
+        starts = np.empty(face_count, dtype=np.int32)
+        mesh.polygons.foreach_get("loop_start", starts)
+        counts = np.empty(face_count, dtype=np.int32)
+        mesh.polygons.foreach_get("loop_total", counts)
+        material_indices = np.empty(face_count, dtype=np.int32)
+        mesh.polygons.foreach_get("material_index", material_indices)
+        vertices = np.empty(loop_count, dtype=np.int32)
+        mesh.loops.foreach_get("vertex_index", vertices)
+        uvs = np.empty(loop_count * 2, dtype=np.float32)
+        uv_layer.data.foreach_get("uv", uvs)
+        densities = np.ones(face_count, dtype=np.float32)
+        if use_texel_density and len(obj.material_slots) > 0:
+            slot_densities = np.array([get_material_texel_density(slot.material) for slot in obj.material_slots], dtype=np.float32)
+            densities = slot_densities[np.clip(material_indices, 0, len(slot_densities) - 1)]
+        face_loop_starts.append(starts + loop_offset)
+        face_loop_counts.append(counts)
+        # objects never share vertices
+        loop_vertices.append(vertices + vertex_offset)
+        loop_uvs.append(uvs)
+        face_densities.append(densities)
+        mesh_ranges.append((uv_layer, loop_offset, loop_count))
+        loop_offset += loop_count
+        vertex_offset += len(mesh.vertices)
+    if len(mesh_ranges) == 0:
+        return True
+    result = native_tools.pack_uv_islands(np.concatenate(face_loop_starts), np.concatenate(face_loop_counts), np.concatenate(loop_vertices),
+                                          np.concatenate(loop_uvs), np.concatenate(face_densities), atlas_size, margin_pixels, True)
+    if result is None:
+        return False
+    packed_uvs, island_count, coverage = result
+    for uv_layer, offset, loop_count in mesh_ranges:
+        uv_layer.data.foreach_set("uv", packed_uvs[offset * 2:(offset + loop_count) * 2])
+    for obj in obj_list:
+        obj.data.update()
+    print(f"DEBUG: repack_uv_natively(): {island_count} islands, {coverage * 100.0:.1f}% coverage, {time.time() - start_time:.2f}s")
+    return True
+
+def repack_uv(obj_or_list, atlas_size=4096):
     if not isinstance(obj_or_list, list):
         obj_or_list = [obj_or_list]
+    if repack_uv_natively(obj_or_list, atlas_size):
+        return
+    bpy.ops.object.select_all(action='DESELECT')
     for obj in obj_or_list:
         obj.select_set(True)
     bpy.context.view_layer.objects.active = obj
@@ -845,7 +923,258 @@ def obj_uses_normal(obj_list):
                             return True
     return False
 
-def convert_to_atlas(obj_list, image_output_path, atlas_size=4096, bake_quality=4, make_uv=True, enable_gpu=False):
+def get_principled_node(material):
+    for node in material.node_tree.nodes:
+        if node.type == 'BSDF_PRINCIPLED':
+            return node
+    return None
+
+def get_uv_layer_names(obj):
+    # image textures read the active render UV map, bakes write through the active UV map
+    mesh = obj.data
+    source_uv_name = None
+    for uv_layer in mesh.uv_layers:
+        if uv_layer.active_render:
+            source_uv_name = uv_layer.name
+    if source_uv_name is None or mesh.uv_layers.active is None:
+        return None, None
+    return source_uv_name, mesh.uv_layers.active.name
+
+def is_source_uv_link(link, source_uv_name):
+    node = link.from_node
+    if node.type == 'TEX_COORD':
+        return link.from_socket.name == 'UV' and not node.from_instancer
+    if node.type == 'UVMAP':
+        return node.uv_map in ("", source_uv_name) and not node.from_instancer
+    return False
+
+def get_native_uv_scale(tex_node, source_uv_name):
+    vector_input = tex_node.inputs['Vector']
+    if not vector_input.is_linked:
+        return (1.0, 1.0)
+    link = vector_input.links[0]
+    if is_source_uv_link(link, source_uv_name):
+        return (1.0, 1.0)
+    mapping_node = link.from_node
+    if mapping_node.type != 'MAPPING' or mapping_node.vector_type != 'POINT':
+        return None
+    for input_name in ['Location', 'Rotation', 'Scale']:
+        if mapping_node.inputs[input_name].is_linked:
+            return None
+    if any(value != 0.0 for value in mapping_node.inputs['Location'].default_value):
+        return None
+    if any(value != 0.0 for value in mapping_node.inputs['Rotation'].default_value):
+        return None
+    mapping_vector = mapping_node.inputs['Vector']
+    if not mapping_vector.is_linked or not is_source_uv_link(mapping_vector.links[0], source_uv_name):
+        return None
+    scale = mapping_node.inputs['Scale'].default_value
+    return (scale[0], scale[1])
+
+def get_native_image_source(link, source_uv_name):
+    tex_node = link.from_node
+    if tex_node.type != 'TEX_IMAGE' or link.from_socket.name not in ['Color', 'Alpha']:
+        return None
+    image = tex_node.image
+    if image is None or image.source not in ['FILE', 'GENERATED'] or tex_node.projection != 'FLAT' or tex_node.extension != 'REPEAT':
+        return None
+    if image.size[0] == 0 or image.size[1] == 0:
+        return None
+    colorspace = image.colorspace_settings.name
+    if colorspace != 'sRGB' and colorspace != 'Non-Color' and not colorspace.startswith('Linear'):
+        return None
+    scale = get_native_uv_scale(tex_node, source_uv_name)
+    if scale is None:
+        return None
+    return {"image": image, "srgb": colorspace == 'sRGB' and not image.is_float,
+            "alpha_output": link.from_socket.name == 'Alpha', "scale": scale}
+
+def get_native_atlas_sources(material, source_uv_name):
+    """Returns the atlas sources of a material indexed by native_tools.ATLAS_*, or None if it needs Cycles."""
+    if material is None or not material.use_nodes:
+        return None
+    bsdf = get_principled_node(material)
+    if bsdf is None:
+        return None
+    sources = []
+    for input_name in ['Base Color', 'Alpha']:
+        socket = bsdf.inputs[input_name]
+        if socket.is_linked:
+            source = get_native_image_source(socket.links[0], source_uv_name)
+            if source is None:
+                return None
+        elif input_name == 'Base Color':
+            source = {"value": tuple(socket.default_value)}
+        else:
+            source = {"value": (socket.default_value,) * 4}
+        sources.append(source)
+    normal_socket = bsdf.inputs['Normal']
+    source = {"value": (0.5, 0.5, 1.0, 1.0)}
+    if normal_socket.is_linked:
+        normal_node = normal_socket.links[0].from_node
+        if (normal_node.type != 'NORMAL_MAP' or normal_node.space != 'TANGENT' or normal_node.uv_map not in ("", source_uv_name)
+            or normal_node.inputs['Strength'].is_linked):
+            return None
+        color_socket = normal_node.inputs['Color']
+        if color_socket.is_linked:
+            source = get_native_image_source(color_socket.links[0], source_uv_name)
+            if source is None or source["alpha_output"]:
+                return None
+        else:
+            source = {"value": tuple(color_socket.default_value)}
+        source["strength"] = normal_node.inputs['Strength'].default_value
+    sources.append(source)
+    for input_name in ['Metallic', 'Roughness']:
+        socket = bsdf.inputs[input_name]
+        if socket.is_linked:
+            source = get_native_image_source(socket.links[0], source_uv_name)
+            if source is None:
+                return None
+        else:
+            source = {"value": (socket.default_value,) * 3 + (1.0,)}
+        sources.append(source)
+    return sources
+
+def can_bake_atlas_natively(obj_list):
+    if native_tools is None or not native_tools.is_available():
+        return False
+    for obj in obj_list:
+        source_uv_name, atlas_uv_name = get_uv_layer_names(obj)
+        if source_uv_name is None:
+            return False
+        for mat_slot in obj.material_slots:
+            if get_native_atlas_sources(mat_slot.material, source_uv_name) is None:
+                print(f"DEBUG: can_bake_atlas_natively(): material needs Cycles: {mat_slot.name}")
+                return False
+    return len(obj_list) > 0
+
+def get_image_pixels(image):
+    pixels = np.empty(len(image.pixels), dtype=np.float32)
+    image.pixels.foreach_get(pixels)
+    return pixels
+
+def save_atlas_png(image, image_path, compression_level=6):
+    """Save a generated atlas image as PNG, with the native parallel encoder when possible."""
+    image.filepath_raw = image_path
+    image.file_format = 'PNG'
+    if native_tools.is_available() and not image.is_float:
+        width, height = image.size
+        start_time = time.perf_counter()
+        if native_tools.write_png(image_path, get_image_pixels(image), width, height, image.channels,
+                                  image.depth == 32, compression_level):
+            # same state as after image.save(), the image now refers to the file that holds its pixels
+            image.source = 'FILE'
+            print("DEBUG: save_atlas_png(): native PNG encoder wrote %s in %.2f s" % (image_path, time.perf_counter() - start_time))
+            return
+    image.save()
+
+def pack_orm_atlas(obj_name, roughness_atlas, metallic_atlas, image_path):
+    """Pack the roughness and metallic atlases into the G and B channels of one Non-Color atlas, R (occlusion) is 1."""
+    width, height = roughness_atlas.size
+    # both atlases store sRGB encoded bytes, the packed channels hold the linear values the shader used
+    roughness = srgb_to_linear(get_image_pixels(roughness_atlas)[0::4])
+    metallic = srgb_to_linear(get_image_pixels(metallic_atlas)[0::4])
+    pixels = np.ones(width * height * 4, dtype=np.float32)
+    pixels[1::4] = roughness
+    pixels[2::4] = metallic
+    orm_atlas = bpy.data.images.new(name=f"{obj_name}_Atlas_ORM", width=width, height=height)
+    orm_atlas.colorspace_settings.name = 'Non-Color'
+    orm_atlas.pixels.foreach_set(pixels)
+    save_atlas_png(orm_atlas, image_path)
+    return orm_atlas
+
+def bake_atlas_natively(obj_list, atlas_images, bake_quality=4, margin=8):
+    """Bake every channel of atlas_images (native_tools.ATLAS_* -> image or None) from the source UVs into the active UVs.
+
+    Materials are baked one at a time, so only the textures of one material are held as float pixels.
+    """
+    atlas_size = None
+    for atlas in atlas_images.values():
+        if atlas is not None:
+            atlas_size = (atlas.size[0], atlas.size[1])
+    if atlas_size is None:
+        return True
+    baker = native_tools.create_atlas_baker(atlas_size[0], atlas_size[1], max(1, min(bake_quality, 4)))
+    if baker is None:
+        return False
+    start_time = time.time()
+
+    # triangles of every object, grouped by material
+    material_triangles = {}
+    depsgraph = bpy.context.evaluated_depsgraph_get()
+    for obj in obj_list:
+        source_uv_name, atlas_uv_name = get_uv_layer_names(obj)
+        eval_obj = obj.evaluated_get(depsgraph)
+        mesh = eval_obj.to_mesh()
+        try:
+            if source_uv_name not in mesh.uv_layers or atlas_uv_name not in mesh.uv_layers:
+                print(f"ERROR: bake_atlas_natively(): UV maps not found on evaluated mesh: {obj.name}")
+                return False
+            mesh.calc_loop_triangles()
+            triangle_count = len(mesh.loop_triangles)
+            loops = np.empty(triangle_count * 3, dtype=np.int32)
+            mesh.loop_triangles.foreach_get("loops", loops)
+            material_indices = np.empty(triangle_count, dtype=np.int32)
+            mesh.loop_triangles.foreach_get("material_index", material_indices)
+            uv_lists = []
+            for uv_name in [source_uv_name, atlas_uv_name]:
+                uvs = np.empty(len(mesh.loops) * 2, dtype=np.float32)
+                mesh.uv_layers[uv_name].data.foreach_get("uv", uvs)
+                uv_lists.append(uvs.reshape((-1, 2))[loops].reshape((-1, 6)))
+        finally:
+            eval_obj.to_mesh_clear()
+        slot_count = len(obj.material_slots)
+        if slot_count == 0:
+            continue
+        material_indices = np.clip(material_indices, 0, slot_count - 1)
+        for slot_index, mat_slot in enumerate(obj.material_slots):
+            selected = material_indices == slot_index
+            if not np.any(selected):
+                continue
+            key = (mat_slot.material.name, source_uv_name)
+            if key not in material_triangles:
+                material_triangles[key] = (mat_slot.material, [], [])
+            material_triangles[key][1].append(uv_lists[0][selected])
+            material_triangles[key][2].append(uv_lists[1][selected])
+
+    atlas_pixels = {}
+    for channel, atlas in atlas_images.items():
+        if atlas is not None:
+            atlas_pixels[channel] = get_image_pixels(atlas)
+            if not baker.set_target(channel, atlas_pixels[channel]):
+                print(f"ERROR: bake_atlas_natively(): unsupported atlas image: {atlas.name}")
+                return False
+
+    triangle_total = 0
+    for (material_name, source_uv_name), (material, source_uvs, atlas_uvs) in material_triangles.items():
+        sources = get_native_atlas_sources(material, source_uv_name)
+        image_pixels = {}
+        for channel, source in enumerate(sources):
+            if atlas_images.get(channel) is None:
+                sources[channel] = None
+                continue
+            image = source.pop("image", None)
+            if image is not None:
+                if image.name not in image_pixels:
+                    image_pixels[image.name] = get_image_pixels(image)
+                source["pixels"] = image_pixels[image.name]
+                source["width"] = image.size[0]
+                source["height"] = image.size[1]
+                source["channels"] = image.channels
+        source_uvs = np.concatenate(source_uvs)
+        baker.bake(source_uvs, np.concatenate(atlas_uvs), sources)
+        triangle_total += len(source_uvs)
+        image_pixels = None
+
+    baker.dilate(margin)
+    for channel, pixels in atlas_pixels.items():
+        atlas_images[channel].pixels.foreach_set(pixels)
+        atlas_images[channel].update()
+    baker.close()
+    print(f"DEBUG: bake_atlas_natively(): {triangle_total} triangles, {len(material_triangles)} materials, {time.time() - start_time:.2f}s")
+    return True
+
+def convert_to_atlas(obj_list, image_output_path, atlas_size=4096, bake_quality=4, make_uv=True, enable_gpu=False, pack_orm=False):
     if type(obj_list) != list:
         obj_list = [obj_list]
 
@@ -888,39 +1217,48 @@ def convert_to_atlas(obj_list, image_output_path, atlas_size=4096, bake_quality=
         new_uv_name = "AtlasUV"
         new_uv = create_new_uv_layer(obj_list, new_uv_name)
         # unwrap_object(obj)
-        repack_uv(obj_list)
-
-    if enable_gpu:
-        enable_gpu_acceleration()
-
-    for obj in obj_list:
-        if uses_alpha:
-            bake_alpha_to_atlas(obj, alpha_atlas, bake_quality, False)
-        if uses_diffuse:
-            bake_diffuse_to_atlas(obj, diffuse_atlas, bake_quality, False)
-        if uses_normal:
-            bake_normal_to_atlas(obj, normal_atlas, bake_quality, False)
-        if uses_metallic:
-            bake_metallic_to_atlas(obj, metallic_atlas, bake_quality, False)
-        if uses_roughness:
-            bake_roughness_to_atlas(obj, roughness_atlas, bake_quality, False)
+        repack_uv(obj_list, atlas_size)
+
+    # image-textured Principled materials are resampled natively, Cycles is the fallback for everything else
+    baked_natively = False
+    if can_bake_atlas_natively(obj_list):
+        atlas_images = {
+            native_tools.ATLAS_DIFFUSE: diffuse_atlas if uses_diffuse else None,
+            native_tools.ATLAS_ALPHA: alpha_atlas if uses_alpha else None,
+            native_tools.ATLAS_NORMAL: normal_atlas if uses_normal else None,
+            native_tools.ATLAS_METALLIC: metallic_atlas if uses_metallic else None,
+            native_tools.ATLAS_ROUGHNESS: roughness_atlas if uses_roughness else None,
+        }
+        baked_natively = bake_atlas_natively(obj_list, atlas_images, bake_quality)
+
+    if not baked_natively:
+        if enable_gpu:
+            enable_gpu_acceleration()
+
+        for obj in obj_list:
+            if uses_alpha:
+                bake_alpha_to_atlas(obj, alpha_atlas, bake_quality, False)
+            if uses_diffuse:
+                bake_diffuse_to_atlas(obj, diffuse_atlas, bake_quality, False)
+            if uses_normal:
+                bake_normal_to_atlas(obj, normal_atlas, bake_quality, False)
+            if uses_metallic:
+                bake_metallic_to_atlas(obj, metallic_atlas, bake_quality, False)
+            if uses_roughness:
+                bake_roughness_to_atlas(obj, roughness_atlas, bake_quality, False)
 
     if uses_alpha:
         alpha_atlas_path = image_output_path + "/" + f"{obj_name}_Atlas_A.png"
         print("DEBUG: saving: " + alpha_atlas_path)
         # save atlas image to disk
-        alpha_atlas.filepath_raw = alpha_atlas_path
-        alpha_atlas.file_format = 'PNG'
-        alpha_atlas.save()
+        save_atlas_png(alpha_atlas, alpha_atlas_path)
         copy_intensity_to_alpha(alpha_atlas, diffuse_atlas)
 
     if uses_diffuse or uses_alpha:
         diffuse_atlas_path = image_output_path + "/" + f"{obj_name}_Atlas_D.png"
         print("DEBUG: saving: " + diffuse_atlas_path)
         # save atlas image to disk
-        diffuse_atlas.filepath_raw = diffuse_atlas_path
-        diffuse_atlas.file_format = 'PNG'
-        diffuse_atlas.save()
+        save_atlas_png(diffuse_atlas, diffuse_atlas_path)
 
     if uses_normal:
         normal_atlas_path = image_output_path + "/" + f"{obj_name}_Atlas_N.jpg"
@@ -929,6 +1267,16 @@ def convert_to_atlas(obj_list, image_output_path, atlas_size=4096, bake_quality=
         normal_atlas.file_format = 'JPEG'
         normal_atlas.save()
 
+    orm_atlas = None
+    if pack_orm and uses_metallic and uses_roughness:
+        orm_atlas_path = image_output_path + "/" + f"{obj_name}_Atlas_ORM.png"
+        print("DEBUG: saving: " + orm_atlas_path)
+        orm_atlas = pack_orm_atlas(obj_name, roughness_atlas, metallic_atlas, orm_atlas_path)
+        bpy.data.images.remove(roughness_atlas)
+        bpy.data.images.remove(metallic_atlas)
+        uses_metallic = False
+        uses_roughness = False
+
     if uses_metallic:
         metallic_atlas_path = image_output_path + "/" + f"{obj_name}_Atlas_M.jpg"
         print("DEBUG: saving: " + metallic_atlas_path)
@@ -964,6 +1312,14 @@ def convert_to_atlas(obj_list, image_output_path, atlas_size=4096, bake_quality=
         metallic_node.image = metallic_atlas
     #    metallic_node.image.colorspace_settings.name = 'Non-Color'
         atlas_material.node_tree.links.new(metallic_node.outputs['Color'], nodes["Principled BSDF"].inputs['Metallic'])
+    if orm_atlas is not None:
+        # link packed roughness (G) and metallic (B) atlas to atlas material
+        orm_node = nodes.new(type='ShaderNodeTexImage')
+        orm_node.image = orm_atlas
+        separate_node = nodes.new(type='ShaderNodeSeparateColor')
+        atlas_material.node_tree.links.new(orm_node.outputs['Color'], separate_node.inputs['Color'])
+        atlas_material.node_tree.links.new(separate_node.outputs['Green'], nodes["Principled BSDF"].inputs['Roughness'])
+        atlas_material.node_tree.links.new(separate_node.outputs['Blue'], nodes["Principled BSDF"].inputs['Metallic'])
     NodeArrange.toNodeArrange(nodes)
 
     original_materials = assign_atlas_to_object(obj_list, atlas_material)
@@ -985,10 +1341,23 @@ def convert_to_atlas(obj_list, image_output_path, atlas_size=4096, bake_quality=
 import bpy
 import numpy as np
 
+try:
+    import native_tools
+except:
+    native_tools = None
+
 def srgb_to_linear(x):
+    if native_tools is not None and isinstance(x, np.ndarray) and x.dtype == np.float32:
+        result = np.array(x, dtype=np.float32, order="C")
+        if native_tools.srgb_to_linear_f32(result.reshape(-1), 1):
+            return result
     return np.where(x <= 0.04045, x / 12.92, ((x + 0.055) / 1.055) ** 2.4)
 
 def linear_to_srgb(x):
+    if native_tools is not None and isinstance(x, np.ndarray) and x.dtype == np.float32:
+        result = np.array(x, dtype=np.float32, order="C")
+        if native_tools.linear_to_srgb_f32(result.reshape(-1), 1):
+            return result
     return np.where(x <= 0.0031308, x * 12.92, 1.055 * (x ** (1/2.4)) - 0.055)
 
 def copy_intensity_to_alpha(source_image, target_image):
@@ -999,9 +1368,11 @@ def copy_intensity_to_alpha(source_image, target_image):
                          source=({source_image.size[0]}, {source_image.size[1]}), \
                         target=({target_image.size[0]}, {target_image.size[1]})")
     
-    # Get image data as numpy arrays
-    source_pixels = np.array(source_image.pixels[:]).reshape((-1, 4))
-    target_pixels = np.array(target_image.pixels[:]).reshape((-1, 4))
+    # Get image data as float32 numpy arrays, foreach_get avoids a python float per channel
+    source_pixels = np.empty(len(source_image.pixels), dtype=np.float32)
+    source_image.pixels.foreach_get(source_pixels)
+    target_pixels = np.empty(len(target_image.pixels), dtype=np.float32)
+    target_image.pixels.foreach_get(target_pixels)
     
     # Convert source RGB to linear space
     # source_linear = srgb_to_linear(source_pixels[:, :3])
@@ -1009,34 +1380,77 @@ def copy_intensity_to_alpha(source_image, target_image):
     # Calculate intensity in linear space using correct coefficients
     # intensity = np.dot(source_linear, [0.2126, 0.7152, 0.0722])
     # intensity = np.dot(source_pixels[:, :3], [0.299, 0.587, 0.114])
-    intensity = np.mean(source_pixels[:, :3], axis=1)
 
     # Copy intensity to alpha channel of target image
-    target_pixels[:, 3] = intensity
+    if native_tools is None or not native_tools.intensity_to_alpha_f32(target_pixels, source_pixels):
+        source_rgba = source_pixels.reshape((-1, 4))
+        target_rgba = target_pixels.reshape((-1, 4))
+        target_rgba[:, 3] = np.mean(source_rgba[:, :3], axis=1)
     
     # Convert RGB of target back to sRGB space (alpha remains linear)
     # target_pixels[:, :3] = linear_to_srgb(target_pixels[:, :3])
     
     # Update the target image
-    target_image.pixels = target_pixels.flatten()
+    target_image.pixels.foreach_set(target_pixels)
     
     # Refresh the image in Blender
     target_image.update()
 
 
 
-def transfer_weights(source_mesh_name, target_mesh_name):
-    # Ensure objects exist
-    if source_mesh_name not in bpy.data.objects or target_mesh_name not in bpy.data.objects:
-        raise ValueError(f"One or both of the specified meshes do not exist in the scene: {source_mesh_name}, {target_mesh_name}")
-
-    # Get source and target objects
-    source_obj = bpy.data.objects[source_mesh_name]
-    target_obj = bpy.data.objects[target_mesh_name]
-
-    # Switch to Object Mode
-    bpy.ops.object.mode_set(mode='OBJECT')
+def get_vertex_group_weights(obj):
+    """Vertex group weights of obj as (vertex, group index, weight) arrays."""
+    weight_vertices = []
+    weight_groups = []
+    weights = []
+    for v in obj.data.vertices:
+        for g in v.groups:
+            weight_vertices.append(v.index)
+            weight_groups.append(g.group)
+            weights.append(g.weight)
+    return np.array(weight_vertices, dtype=np.int32), np.array(weight_groups, dtype=np.int32), np.array(weights, dtype=np.float32)
 
+def get_world_positions(obj):
+    mesh = obj.data
+    positions = np.empty(len(mesh.vertices) * 3, dtype=np.float32)
+    mesh.vertices.foreach_get("co", positions)
+    matrix = np.array(obj.matrix_world, dtype=np.float32)
+    return positions.reshape(-1, 3) @ matrix[:3, :3].T + matrix[:3, 3]
+
+def transfer_weights_natively(source_obj, target_obj, max_influences=8):
+    """Vertex group weight transfer of transfer_weights() with the native closest point kernel, without operators.
+    Returns False if the native library is not available."""
+    if native_tools is None or not native_tools.is_available():
+        return False
+    start_time = time.time()
+    source_mesh = source_obj.data
+    source_mesh.calc_loop_triangles()
+    source_triangles = np.empty(len(source_mesh.loop_triangles) * 3, dtype=np.int32)
+    source_mesh.loop_triangles.foreach_get("vertices", source_triangles)
+    weight_vertices, weight_groups, weights = get_vertex_group_weights(source_obj)
+    result = native_tools.transfer_weights(get_world_positions(source_obj), source_triangles, weight_vertices, weight_groups, weights,
+                                           get_world_positions(target_obj), max_influences)
+    if result is None:
+        return False
+    groups, group_weights = result
+
+    # same vertex groups as the source, in the same order
+    target_obj.vertex_groups.clear()
+    target_groups = [target_obj.vertex_groups.new(name=src_vg.name) for src_vg in source_obj.vertex_groups]
+    vertex_indices = np.repeat(np.arange(groups.shape[0], dtype=np.int32), groups.shape[1])
+    groups = groups.reshape(-1)
+    group_weights = group_weights.reshape(-1)
+    for group_index, target_group in enumerate(target_groups):
+        mask = groups == group_index
+        # one add() per distinct weight, rigid parts share weight 1.0
+        unique_weights, inverse = np.unique(group_weights[mask], return_inverse=True)
+        group_vertices = vertex_indices[mask]
+        for i, weight in enumerate(unique_weights):
+            target_group.add(group_vertices[inverse == i].tolist(), float(weight), 'REPLACE')
+    print(f"DEBUG: transfer_weights_natively(): {len(target_groups)} vertex groups, {int(np.count_nonzero(groups >= 0))} weights ({time.time() - start_time:.2f}s)")
+    return True
+
+def transfer_weights_with_operator(source_obj, target_obj):
     # Deselect all objects
     bpy.ops.object.select_all(action='DESELECT')
 
@@ -1071,6 +1485,21 @@ def transfer_weights(source_mesh_name, target_mesh_name):
     # Switch back to Object Mode
     bpy.ops.object.mode_set(mode='OBJECT')
 
+def transfer_weights(source_mesh_name, target_mesh_name):
+    # Ensure objects exist
+    if source_mesh_name not in bpy.data.objects or target_mesh_name not in bpy.data.objects:
+        raise ValueError(f"One or both of the specified meshes do not exist in the scene: {source_mesh_name}, {target_mesh_name}")
+
+    # Get source and target objects
+    source_obj = bpy.data.objects[source_mesh_name]
+    target_obj = bpy.data.objects[target_mesh_name]
+
+    # Switch to Object Mode
+    bpy.ops.object.mode_set(mode='OBJECT')
+
+    if not transfer_weights_natively(source_obj, target_obj):
+        transfer_weights_with_operator(source_obj, target_obj)
+
     # get armature from source_obj and parent target_obj to same armature
     armature_name = None
     for mod in source_obj.modifiers:
@@ -1125,7 +1554,68 @@ def are_normals_same(normal1, normal2, threshold=0.01):
     return normal1.normalized().dot(normal2.normalized()) > 1 - threshold
 
 
+def get_native_fit_mesh(obj, group_indices):
+    """Mesh arrays of obj for native_tools.autofit_mesh(), with the vertex groups renumbered by group_indices (name to index)."""
+    mesh = obj.data
+    mesh.calc_loop_triangles()
+    data = {}
+    data["positions"] = np.empty(len(mesh.vertices) * 3, dtype=np.float32)
+    mesh.vertices.foreach_get("co", data["positions"])
+    data["face_loop_starts"] = np.empty(len(mesh.polygons), dtype=np.int32)
+    mesh.polygons.foreach_get("loop_start", data["face_loop_starts"])
+    data["face_loop_counts"] = np.empty(len(mesh.polygons), dtype=np.int32)
+    mesh.polygons.foreach_get("loop_total", data["face_loop_counts"])
+    data["loop_vertices"] = np.empty(len(mesh.loops), dtype=np.int32)
+    mesh.loops.foreach_get("vertex_index", data["loop_vertices"])
+    data["triangle_vertices"] = np.empty(len(mesh.loop_triangles) * 3, dtype=np.int32)
+    mesh.loop_triangles.foreach_get("vertices", data["triangle_vertices"])
+    data["triangle_faces"] = np.empty(len(mesh.loop_triangles), dtype=np.int32)
+    mesh.loop_triangles.foreach_get("polygon_index", data["triangle_faces"])
+    # groups the other mesh does not have can never match, so they are left out
+    group_map = {vg.index: group_indices[vg.name] for vg in obj.vertex_groups if vg.name in group_indices}
+    weight_vertices = []
+    weight_groups = []
+    weights = []
+    for v in mesh.vertices:
+        for g in v.groups:
+            if g.group in group_map:
+                weight_vertices.append(v.index)
+                weight_groups.append(group_map[g.group])
+                weights.append(g.weight)
+    data["weight_vertices"] = np.array(weight_vertices, dtype=np.int32)
+    data["weight_groups"] = np.array(weight_groups, dtype=np.int32)
+    data["weights"] = np.array(weights, dtype=np.float32)
+    return data
+
+def autofit_mesh_natively(source, target, fit_ratio=1.0, distance_cutoff=10.0, pass1_iterations=200, pass2_iterations=5, lock_tagged_verts=True):
+    """autofit_mesh() with the native BVH ray caster.  Returns False if the native library is not available."""
+    if native_tools is None or not native_tools.is_available():
+        return False
+    start_time = time.time()
+    group_names = sorted(set(vg.name for vg in source.vertex_groups) & set(vg.name for vg in target.vertex_groups))
+    group_indices = {name: i for i, name in enumerate(group_names)}
+    result = native_tools.autofit_mesh(get_native_fit_mesh(source, group_indices), get_native_fit_mesh(target, group_indices),
+                                       len(group_names), fit_ratio, distance_cutoff, pass1_iterations, pass2_iterations, lock_tagged_verts)
+    if result is None:
+        return False
+    positions, tagged, stats = result
+    source.data.vertices.foreach_set("co", positions.reshape(-1))
+    source.data.update()
+    if stats["aborted"]:
+        print("DEBUG: autofit_mesh_natively(): Flipped normals detected. Aborting.")
+    if lock_tagged_verts:
+        lock_string = "locked verts"
+    else:
+        lock_string = "tagged verts"
+    print(f"DEBUG: autofit_mesh_natively(): PASS1: {stats['pass1_iterations']} iterations, PASS2: {stats['pass2_iterations']} iterations, "
+          f"{stats['pass2_faces_moved']} faces moved, {stats['flip_reverts']} flips and {stats['pokethrough_reverts']} self poke-throughs undone, "
+          f"{lock_string} [{int(np.count_nonzero(tagged))}]")
+    print(f"autofit_mesh(): obj={source.name} DONE ({time.time() - start_time:.2f}s)")
+    return True
+
 def autofit_mesh(source, target, fit_ratio=1.0, distance_cutoff=10.0, pass1_iterations=200, pass2_iterations=5, lock_tagged_verts=True):
+    if autofit_mesh_natively(source, target, fit_ratio, distance_cutoff, pass1_iterations, pass2_iterations, lock_tagged_verts):
+        return
 
     weight_threshold = 0.55
     normal_threshold = 0.01
@@ -1647,6 +2137,44 @@ def create_vertex_at_loc(bm, location):
     return new_vert
 
 
+def remove_obscured_faces_natively(obj, offset, threshold_list):
+    """remove_obscured_faces() with the native BVH ray caster.  Returns False if the native library is not available."""
+    if native_tools is None or not native_tools.is_available() or len(threshold_list) == 0:
+        return False
+    start_time = time.time()
+    mesh = obj.data
+    mesh.calc_loop_triangles()
+    face_count = len(mesh.polygons)
+    positions = np.empty(len(mesh.vertices) * 3, dtype=np.float32)
+    mesh.vertices.foreach_get("co", positions)
+    face_loop_starts = np.empty(face_count, dtype=np.int32)
+    mesh.polygons.foreach_get("loop_start", face_loop_starts)
+    face_loop_counts = np.empty(face_count, dtype=np.int32)
+    mesh.polygons.foreach_get("loop_total", face_loop_counts)
+    face_normals = np.empty(face_count * 3, dtype=np.float32)
+    mesh.polygons.foreach_get("normal", face_normals)
+    loop_vertices = np.empty(len(mesh.loops), dtype=np.int32)
+    mesh.loops.foreach_get("vertex_index", loop_vertices)
+    triangle_vertices = np.empty(len(mesh.loop_triangles) * 3, dtype=np.int32)
+    mesh.loop_triangles.foreach_get("vertices", triangle_vertices)
+    triangle_faces = np.empty(len(mesh.loop_triangles), dtype=np.int32)
+    mesh.loop_triangles.foreach_get("polygon_index", triangle_faces)
+    # a larger threshold only removes more faces, so the largest one gives the result of all of them
+    obscured = native_tools.find_obscured_faces(positions, face_loop_starts, face_loop_counts, face_normals, loop_vertices,
+                                                triangle_vertices, triangle_faces, offset, max(threshold_list))
+    if obscured is None:
+        return False
+    bm = bmesh.new()
+    bm.from_mesh(mesh)
+    bm.faces.ensure_lookup_table()
+    faces_to_remove = [bm.faces[i] for i in np.flatnonzero(obscured)]
+    bmesh.ops.delete(bm, geom=faces_to_remove, context='FACES')
+    bm.to_mesh(mesh)
+    mesh.update()
+    bm.free()
+    print(f"Removed {len(faces_to_remove)} obscured faces ({time.time() - start_time:.2f}s)")
+    return True
+
 def remove_obscured_faces(obj, offset=0.001, threshold_list=[0.5, 1.0, 1.5]):
     if "StudioPresentationType" in obj:
         asset_type = obj["StudioPresentationType"]
@@ -1663,6 +2191,9 @@ def remove_obscured_faces(obj, offset=0.001, threshold_list=[0.5, 1.0, 1.5]):
     # Object Mode
     bpy.ops.object.mode_set(mode='OBJECT')
 
+    if remove_obscured_faces_natively(obj, offset, threshold_list):
+        return
+
     # Create a bmesh
     bm = bmesh.new()
     bm.from_mesh(obj.data)
@@ -1672,6 +2203,7 @@ def remove_obscured_faces(obj, offset=0.001, threshold_list=[0.5, 1.0, 1.5]):
     depsgraph = bpy.context.evaluated_depsgraph_get()
     depsgraph.update()
     faces_to_remove = []
+    removed_faces = set()
 
     # for threshold in [offset*500, offset*1000, offset*2000, offset*3000, offset*4000]:
     # for threshold in [0.005, 0.010, 0.015]:
@@ -1681,7 +2213,7 @@ def remove_obscured_faces(obj, offset=0.001, threshold_list=[0.5, 1.0, 1.5]):
 
         for face in bm.faces:
             obscured_verts = []
-            if face in faces_to_remove:
+            if face in removed_faces:
                 continue
             for v in face.verts:
                 obscured_face_normal = []
@@ -1710,7 +2242,8 @@ def remove_obscured_faces(obj, offset=0.001, threshold_list=[0.5, 1.0, 1.5]):
             # If all verts are obscured, mark face for removal
             # print(f"DEBUG: obscured_verts = {len(obscured_verts)} vs face.verts={len(face.verts)}")
             if len(obscured_verts) == len(face.verts):
-                faces_to_remove.append(face)               
+                faces_to_remove.append(face)
+                removed_faces.add(face)               
     
     # Remove marked faces
     bmesh.ops.delete(bm, geom=faces_to_remove, context='FACES')
@@ -1738,10 +2271,210 @@ def get_triangle_count(obj):
     
     return triangles_count
 
+def get_native_simplify_mesh(obj, lod_targets, vertex_group_ratios=None, skin_attribute_count=8):
+    """Gather obj for native_tools.simplify_meshes().  Wedges are the distinct (vertex, UVs) combinations of the loops,
+    skin weights are projected to skin_attribute_count attributes and vertex_group_ratios (name -> kept ratio) become
+    regions.  Returns (native mesh, mesh data) where mesh data is what apply_native_lod() needs."""
+    mesh = obj.data
+    mesh.calc_loop_triangles()
+    vertex_count = len(mesh.vertices)
+    loop_count = len(mesh.loops)
+    triangle_count = len(mesh.loop_triangles)
+    positions = np.empty(vertex_count * 3, dtype=np.float32)
+    mesh.vertices.foreach_get("co", positions)
+    loop_vertices = np.empty(loop_count, dtype=np.int32)
+    mesh.loops.foreach_get("vertex_index", loop_vertices)
+    triangle_loops = np.empty(triangle_count * 3, dtype=np.int32)
+    mesh.loop_triangles.foreach_get("loops", triangle_loops)
+    triangle_polygons = np.empty(triangle_count, dtype=np.int32)
+    mesh.loop_triangles.foreach_get("polygon_index", triangle_polygons)
+    polygon_materials = np.empty(len(mesh.polygons), dtype=np.int32)
+    mesh.polygons.foreach_get("material_index", polygon_materials)
+    polygon_smooth = np.empty(len(mesh.polygons), dtype=bool)
+    mesh.polygons.foreach_get("use_smooth", polygon_smooth)
+
+    uv_layers = []
+    wedge_keys = [loop_vertices.reshape(-1, 1)]
+    for uv_layer in mesh.uv_layers:
+        uvs = np.empty(loop_count * 2, dtype=np.float32)
+        uv_layer.data.foreach_get("uv", uvs)
+        uv_layers.append((uv_layer.name, uvs.reshape(-1, 2)))
+        # compare the exact bits, so that only loops with identical UVs share a wedge
+        wedge_keys.append(uvs.view(np.int32).reshape(-1, 2))
+    _, wedge_loops, loop_wedges = np.unique(np.hstack(wedge_keys), axis=0, return_index=True, return_inverse=True)
+    loop_wedges = loop_wedges.reshape(-1)
+
+    weight_vertices = []
+    weight_groups = []
+    weight_values = []
+    for vertex in mesh.vertices:
+        for group in vertex.groups:
+            weight_vertices.append(vertex.index)
+            weight_groups.append(group.group)
+            weight_values.append(group.weight)
+    weight_vertices = np.array(weight_vertices, dtype=np.int32)
+    weight_groups = np.array(weight_groups, dtype=np.int32)
+    weight_values = np.array(weight_values, dtype=np.float32)
+
+    native_mesh = {
+        "positions": positions,
+        "wedge_vertices": loop_vertices[wedge_loops],
+        "triangles": loop_wedges[triangle_loops],
+        "materials": polygon_materials[triangle_polygons],
+        "lod_targets": lod_targets,
+    }
+    if len(weight_values) > 0 and len(obj.vertex_groups) > 0:
+        # a fixed random projection keeps the distances between the weight vectors of the vertices
+        rng = np.random.default_rng(0)
+        projection = rng.standard_normal((len(obj.vertex_groups), skin_attribute_count)).astype(np.float32) / np.sqrt(skin_attribute_count)
+        attributes = np.zeros((vertex_count, skin_attribute_count), dtype=np.float32)
+        np.add.at(attributes, weight_vertices, weight_values[:, None] * projection[weight_groups])
+        native_mesh["attributes"] = attributes
+    if vertex_group_ratios:
+        regions = np.zeros(vertex_count, dtype=np.int32)
+        region_ratios = []
+        for vertex_group_name, ratio in vertex_group_ratios.items():
+            vertex_group = obj.vertex_groups.get(vertex_group_name)
+            if vertex_group is None:
+                print("ERROR: get_native_simplify_mesh(): vertex_group_name not found: " + vertex_group_name + " for object: " + obj.name)
+                continue
+            region_ratios.append(ratio)
+            in_group = (weight_groups == vertex_group.index) & (weight_values > 0.0)
+            np.maximum.at(regions, weight_vertices[in_group], len(region_ratios))
+        native_mesh["regions"] = regions
+        native_mesh["region_ratios"] = region_ratios
+    mesh_data = {
+        "positions": positions.reshape(-1, 3),
+        "wedge_vertices": native_mesh["wedge_vertices"],
+        "wedge_loops": wedge_loops,
+        "uv_layers": uv_layers,
+        "triangle_polygons": triangle_polygons,
+        "polygon_materials": polygon_materials,
+        "polygon_smooth": polygon_smooth,
+        "weights": (weight_vertices, weight_groups, weight_values),
+    }
+    return native_mesh, mesh_data
+
+def apply_native_lod(obj, mesh_data, lod, mesh_name):
+    """Build a new mesh from one LOD of native_tools.simplify_meshes(), with the UVs, materials and vertex group
+    weights of obj.  Shape keys are not carried over.  Returns the new mesh."""
+    triangles, source_triangles, error = lod
+    wedge_vertices = mesh_data["wedge_vertices"]
+    triangle_vertices = wedge_vertices[triangles]
+    used_vertices, new_corners = np.unique(triangle_vertices.reshape(-1), return_inverse=True)
+    new_mesh = bpy.data.meshes.new(mesh_name)
+    new_mesh.vertices.add(len(used_vertices))
+    new_mesh.vertices.foreach_set("co", mesh_data["positions"][used_vertices].reshape(-1))
+    new_mesh.loops.add(len(new_corners))
+    new_mesh.loops.foreach_set("vertex_index", new_corners.astype(np.int32))
+    new_mesh.polygons.add(len(triangles))
+    new_mesh.polygons.foreach_set("loop_start", np.arange(0, len(new_corners), 3, dtype=np.int32))
+    try:
+        new_mesh.polygons.foreach_set("loop_total", np.full(len(triangles), 3, dtype=np.int32))
+    except:
+        # read only since Blender 4.0, where the loop starts are enough
+        pass
+    source_polygons = mesh_data["triangle_polygons"][source_triangles]
+    new_mesh.polygons.foreach_set("material_index", mesh_data["polygon_materials"][source_polygons])
+    new_mesh.polygons.foreach_set("use_smooth", mesh_data["polygon_smooth"][source_polygons])
+    corner_loops = mesh_data["wedge_loops"][triangles.reshape(-1)]
+    for uv_name, uvs in mesh_data["uv_layers"]:
+        new_uv_layer = new_mesh.uv_layers.new(name=uv_name)
+        new_uv_layer.data.foreach_set("uv", uvs[corner_loops].reshape(-1))
+    for material in obj.data.materials:
+        new_mesh.materials.append(material)
+    new_mesh.update(calc_edges=True)
+    return new_mesh, used_vertices
+
+def copy_native_lod_weights(obj, mesh_data, used_vertices):
+    weight_vertices, weight_groups, weight_values = mesh_data["weights"]
+    new_vertex_indices = np.full(len(mesh_data["positions"]), -1, dtype=np.int64)
+    new_vertex_indices[used_vertices] = np.arange(len(used_vertices))
+    kept = new_vertex_indices[weight_vertices] >= 0
+    kept_vertices = new_vertex_indices[weight_vertices[kept]]
+    kept_groups = weight_groups[kept]
+    kept_weights = weight_values[kept]
+    for group_index in np.unique(kept_groups):
+        mask = kept_groups == group_index
+        # one add() per distinct weight, as in transfer_weights_natively()
+        unique_weights, inverse = np.unique(kept_weights[mask], return_inverse=True)
+        group_vertices = kept_vertices[mask]
+        vertex_group = obj.vertex_groups[int(group_index)]
+        for i, weight in enumerate(unique_weights):
+            vertex_group.add(group_vertices[inverse == i].tolist(), float(weight), 'REPLACE')
+
+def generate_lods(obj, lod_ratios=[0.5, 0.25, 0.125], vertex_group_ratios=None):
+    """Create the objects <name>_LOD1.._LODn next to obj with the native simplifier, lod_ratios are the triangle
+    ratios of the LODs and vertex_group_ratios (name -> ratio) the minimum kept ratios of vertex groups, like
+    add_decimate_modifier_per_vertex_group().  Returns [obj, LOD1, ...], or None without the native library."""
+    if native_tools is None or not native_tools.is_available():
+        return None
+    start_time = time.time()
+    triangle_count = sum(len(poly.vertices) - 2 for poly in obj.data.polygons)
+    lod_targets = [max(1, int(triangle_count * ratio)) for ratio in lod_ratios]
+    native_mesh, mesh_data = get_native_simplify_mesh(obj, lod_targets, vertex_group_ratios)
+    results = native_tools.simplify_meshes([native_mesh])
+    if results is None or results[0] is None:
+        print("ERROR: generate_lods(): unable to simplify object: " + obj.name)
+        return None
+    lod_objects = [obj]
+    for lod_index, lod in enumerate(results[0]):
+        lod_name = obj.name + "_LOD" + str(lod_index + 1)
+        new_mesh, used_vertices = apply_native_lod(obj, mesh_data, lod, lod_name)
+        lod_obj = obj.copy()
+        lod_obj.data = new_mesh
+        lod_obj.name = lod_name
+        for collection in obj.users_collection:
+            collection.objects.link(lod_obj)
+        copy_native_lod_weights(lod_obj, mesh_data, used_vertices)
+        lod_objects.append(lod_obj)
+        print(f"DEBUG: generate_lods(): {lod_name}: {len(lod[0])} triangles (target {lod_targets[lod_index]}), error {lod[2]:.2e}")
+    print(f"DEBUG: generate_lods(): {obj.name}: {len(lod_objects) - 1} LODs in {time.time() - start_time:.2f}s")
+    return lod_objects
+
+def generate_lods_with_decimate(obj, lod_ratios=[0.5, 0.25, 0.125]):
+    """Fallback of generate_lods() without the native library: copies of obj named <name>_LOD1.._LODn, each with a
+    Decimate modifier adjusted to its triangle target.  Returns [obj, LOD1, ...]."""
+    triangle_count = sum(len(poly.vertices) - 2 for poly in obj.data.polygons)
+    lod_objects = [obj]
+    for lod_index, ratio in enumerate(lod_ratios):
+        lod_name = obj.name + "_LOD" + str(lod_index + 1)
+        lod_obj = obj.copy()
+        lod_obj.data = obj.data.copy()
+        lod_obj.name = lod_name
+        for collection in obj.users_collection:
+            collection.objects.link(lod_obj)
+        adjust_decimation_to_target(lod_obj, max(1, int(triangle_count * ratio)))
+        lod_objects.append(lod_obj)
+    return lod_objects
+
+def simplify_natively(obj, target_triangles, vertex_group_ratios=None):
+    """Replace the mesh of obj with a native simplification to exactly target_triangles.  Returns False if the
+    native library is not available or the mesh has shape keys, which the simplified mesh would lose."""
+    if native_tools is None or not native_tools.is_available() or obj.data.shape_keys is not None:
+        return False
+    native_mesh, mesh_data = get_native_simplify_mesh(obj, [target_triangles], vertex_group_ratios)
+    results = native_tools.simplify_meshes([native_mesh])
+    if results is None or results[0] is None:
+        return False
+    old_mesh = obj.data
+    new_mesh, used_vertices = apply_native_lod(obj, mesh_data, results[0][0], old_mesh.name)
+    obj.data = new_mesh
+    copy_native_lod_weights(obj, mesh_data, used_vertices)
+    if old_mesh.users == 0:
+        bpy.data.meshes.remove(old_mesh)
+    print(f"DEBUG: simplify_natively(): obj={obj.name}, Triangles: {len(results[0][0][0])}, Target: {target_triangles}, error {results[0][0][2]:.2e}")
+    return True
+
 def adjust_decimation_to_target(obj, target_triangles, tolerance=0.01):
     print(f"DEBUG: adjust_decimation_to_target(): obj={obj.name}, target_triangles={target_triangles}, tolerance={tolerance}")
-    # Ensure the object has a Decimate modifier
     decimate_mod = next((mod for mod in obj.modifiers if mod.type == 'DECIMATE'), None)
+    if simplify_natively(obj, target_triangles):
+        # the new mesh already has the target, the Decimate modifier adjusted below would reduce it again
+        if decimate_mod:
+            obj.modifiers.remove(decimate_mod)
+        return
+    # Ensure the object has a Decimate modifier
     if not decimate_mod:
         decimate_mod = obj.modifiers.new(name="Decimate", type='DECIMATE')
     
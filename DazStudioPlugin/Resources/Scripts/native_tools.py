@@ -0,0 +1,542 @@
+""" Native Tools for Blender
+native_tools.py
+
+ctypes bindings for the dzblendernative shared library, which contains the SIMD texture kernels
+from DazStudioPlugin/NativeTools.  The library is copied next to this script by the Daz Studio plugin.
+
+Every kernel wrapper returns False when the library can not be used (missing, built for another
+CPU architecture, or unsupported buffer), so that callers can fall back to numpy.
+
+Requirements:
+    - Python 3.7+
+    - Blender 3.6+
+
+"""
+
+from pathlib import Path
+script_dir = str(Path( __file__ ).parent.absolute())
+
+import os
+import sys
+import ctypes
+
+try:
+    import numpy as np
+except:
+    np = None
+
+NATIVE_API_VERSION = 8
+
+# atlas baker channels, see DzAtlasBaker.h
+ATLAS_DIFFUSE = 0
+ATLAS_ALPHA = 1
+ATLAS_NORMAL = 2
+ATLAS_METALLIC = 3
+ATLAS_ROUGHNESS = 4
+ATLAS_CHANNEL_COUNT = 5
+
+_native_lib = None
+_load_attempted = False
+
+
+class _AtlasSource(ctypes.Structure):
+    _fields_ = [("pixels", ctypes.POINTER(ctypes.c_float)),
+                ("width", ctypes.c_int),
+                ("height", ctypes.c_int),
+                ("channels", ctypes.c_int),
+                ("srgb", ctypes.c_int),
+                ("alpha_output", ctypes.c_int),
+                ("scale", ctypes.c_float * 2),
+                ("value", ctypes.c_float * 4),
+                ("strength", ctypes.c_float)]
+
+
+class _SimplifyMesh(ctypes.Structure):
+    _fields_ = [("positions", ctypes.POINTER(ctypes.c_float)),
+                ("vertex_count", ctypes.c_size_t),
+                ("wedge_vertices", ctypes.POINTER(ctypes.c_int)),
+                ("wedge_count", ctypes.c_size_t),
+                ("triangles", ctypes.POINTER(ctypes.c_int)),
+                ("triangle_count", ctypes.c_size_t),
+                ("triangle_materials", ctypes.POINTER(ctypes.c_int)),
+                ("vertex_attributes", ctypes.POINTER(ctypes.c_float)),
+                ("attribute_count", ctypes.c_int),
+                ("attribute_weight", ctypes.c_float),
+                ("vertex_regions", ctypes.POINTER(ctypes.c_int)),
+                ("region_ratios", ctypes.POINTER(ctypes.c_float)),
+                ("region_count", ctypes.c_int),
+                ("lod_targets", ctypes.POINTER(ctypes.c_int)),
+                ("lod_count", ctypes.c_int),
+                ("out_triangles", ctypes.POINTER(ctypes.c_int)),
+                ("out_source_triangles", ctypes.POINTER(ctypes.c_int)),
+                ("out_triangle_counts", ctypes.POINTER(ctypes.c_int)),
+                ("out_errors", ctypes.POINTER(ctypes.c_float))]
+
+
+class _FitMesh(ctypes.Structure):
+    _fields_ = [("positions", ctypes.POINTER(ctypes.c_float)),
+                ("vertex_count", ctypes.c_size_t),
+                ("face_loop_starts", ctypes.POINTER(ctypes.c_int)),
+                ("face_loop_counts", ctypes.POINTER(ctypes.c_int)),
+                ("face_count", ctypes.c_size_t),
+                ("loop_vertices", ctypes.POINTER(ctypes.c_int)),
+                ("loop_count", ctypes.c_size_t),
+                ("triangle_vertices", ctypes.POINTER(ctypes.c_int)),
+                ("triangle_faces", ctypes.POINTER(ctypes.c_int)),
+                ("triangle_count", ctypes.c_size_t),
+                ("weight_vertices", ctypes.POINTER(ctypes.c_int)),
+                ("weight_groups", ctypes.POINTER(ctypes.c_int)),
+                ("weights", ctypes.POINTER(ctypes.c_float)),
+                ("weight_count", ctypes.c_size_t)]
+
+
+def _get_library_filename():
+    if sys.platform == "win32":
+        return "dzblendernative.dll"
+    elif sys.platform == "darwin":
+        return "dzblendernative.dylib"
+    return "dzblendernative.so"
+
+
+def load_library():
+    """Load the native library once.  Returns None if it is not available."""
+    global _native_lib, _load_attempted
+    if _load_attempted:
+        return _native_lib
+    _load_attempted = True
+    if np is None:
+        return None
+    library_path = os.path.join(script_dir, _get_library_filename())
+    if not os.path.exists(library_path):
+        print("DEBUG: native_tools: library not found, using numpy fallback: " + library_path)
+        return None
+    try:
+        lib = ctypes.CDLL(library_path)
+    except OSError as e:
+        print("DEBUG: native_tools: unable to load library, using numpy fallback: " + str(e))
+        return None
+    lib.dznative_get_api_version.restype = ctypes.c_int
+    if lib.dznative_get_api_version() != NATIVE_API_VERSION:
+        print("DEBUG: native_tools: library API version mismatch, using numpy fallback")
+        return None
+    lib.dznative_get_simd_level.restype = ctypes.c_char_p
+    lib.dznative_set_simd_level.restype = ctypes.c_char_p
+    lib.dznative_set_simd_level.argtypes = [ctypes.c_char_p]
+    lib.dznative_set_num_threads.argtypes = [ctypes.c_int]
+    float_pointer = ctypes.POINTER(ctypes.c_float)
+    lib.dznative_intensity_to_alpha_f32.argtypes = [float_pointer, float_pointer, ctypes.c_size_t]
+    lib.dznative_srgb_to_linear_f32.argtypes = [float_pointer, ctypes.c_size_t, ctypes.c_int]
+    lib.dznative_linear_to_srgb_f32.argtypes = [float_pointer, ctypes.c_size_t, ctypes.c_int]
+    lib.dznative_atlas_create.restype = ctypes.c_void_p
+    lib.dznative_atlas_create.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.dznative_atlas_destroy.argtypes = [ctypes.c_void_p]
+    lib.dznative_atlas_set_target.argtypes = [ctypes.c_void_p, ctypes.c_int, float_pointer]
+    lib.dznative_atlas_bake.argtypes = [ctypes.c_void_p, float_pointer, float_pointer, ctypes.c_size_t, ctypes.POINTER(_AtlasSource)]
+    lib.dznative_atlas_dilate.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.dznative_atlas_get_covered_pixels.restype = ctypes.c_size_t
+    lib.dznative_atlas_get_covered_pixels.argtypes = [ctypes.c_void_p]
+    int_pointer = ctypes.POINTER(ctypes.c_int)
+    lib.dznative_pack_uv_islands.restype = ctypes.c_int
+    lib.dznative_pack_uv_islands.argtypes = [int_pointer, int_pointer, ctypes.c_size_t, int_pointer, float_pointer, ctypes.c_size_t, float_pointer,
+                                             ctypes.c_int, ctypes.c_float, ctypes.c_int, float_pointer, float_pointer]
+    lib.dznative_simplify_meshes.restype = ctypes.c_int
+    lib.dznative_simplify_meshes.argtypes = [ctypes.POINTER(_SimplifyMesh), ctypes.c_size_t]
+    lib.dznative_find_obscured_faces.restype = ctypes.c_int
+    lib.dznative_find_obscured_faces.argtypes = [float_pointer, ctypes.c_size_t, int_pointer, int_pointer, float_pointer, ctypes.c_size_t,
+                                                 int_pointer, ctypes.c_size_t, int_pointer, int_pointer, ctypes.c_size_t,
+                                                 ctypes.c_float, ctypes.c_float, ctypes.POINTER(ctypes.c_uint8)]
+    lib.dznative_autofit_mesh.restype = ctypes.c_int
+    lib.dznative_autofit_mesh.argtypes = [ctypes.POINTER(_FitMesh), ctypes.POINTER(_FitMesh), ctypes.c_int, ctypes.c_float, ctypes.c_float,
+                                          ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, float_pointer, ctypes.POINTER(ctypes.c_uint8),
+                                          int_pointer]
+    lib.dznative_transfer_weights.restype = ctypes.c_int
+    lib.dznative_transfer_weights.argtypes = [float_pointer, ctypes.c_size_t, int_pointer, ctypes.c_size_t, int_pointer, int_pointer, float_pointer,
+                                              ctypes.c_size_t, float_pointer, ctypes.c_size_t, ctypes.c_float, ctypes.c_int, ctypes.c_float,
+                                              int_pointer, float_pointer]
+    lib.dznative_write_png_f32.restype = ctypes.c_int
+    lib.dznative_write_png_f32.argtypes = [ctypes.c_char_p, float_pointer, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    _native_lib = lib
+    print("DEBUG: native_tools: loaded " + library_path + ", simd=" + get_simd_level())
+    return _native_lib
+
+
+def is_available():
+    return load_library() is not None
+
+
+def get_simd_level():
+    lib = _native_lib
+    if lib is None:
+        return "none"
+    return lib.dznative_get_simd_level().decode("utf-8")
+
+
+def _is_float_buffer(array):
+    return (np is not None and isinstance(array, np.ndarray) and array.dtype == np.float32
+            and array.flags["C_CONTIGUOUS"] and array.flags["WRITEABLE"])
+
+
+def _float_pointer(array):
+    return array.ctypes.data_as(ctypes.POINTER(ctypes.c_float))
+
+
+def intensity_to_alpha_f32(target_pixels, source_pixels):
+    """Set the alpha of target_pixels (flat float32 RGBA) to the mean RGB of source_pixels, in place."""
+    lib = load_library()
+    if lib is None or not _is_float_buffer(target_pixels) or not _is_float_buffer(source_pixels):
+        return False
+    if target_pixels.size != source_pixels.size or target_pixels.size % 4 != 0:
+        return False
+    lib.dznative_intensity_to_alpha_f32(_float_pointer(target_pixels), _float_pointer(source_pixels), target_pixels.size // 4)
+    return True
+
+
+def srgb_to_linear_f32(pixels, channels=4):
+    """Convert flat float32 pixels in place.  With 2 or 4 channels the last channel is alpha and is left unchanged."""
+    lib = load_library()
+    if lib is None or not _is_float_buffer(pixels) or channels < 1 or channels > 4 or pixels.size % channels != 0:
+        return False
+    lib.dznative_srgb_to_linear_f32(_float_pointer(pixels), pixels.size // channels, channels)
+    return True
+
+
+def linear_to_srgb_f32(pixels, channels=4):
+    """Convert flat float32 pixels in place.  With 2 or 4 channels the last channel is alpha and is left unchanged."""
+    lib = load_library()
+    if lib is None or not _is_float_buffer(pixels) or channels < 1 or channels > 4 or pixels.size % channels != 0:
+        return False
+    lib.dznative_linear_to_srgb_f32(_float_pointer(pixels), pixels.size // channels, channels)
+    return True
+
+
+def pack_uv_islands(face_loop_starts, face_loop_counts, loop_vertices, loop_uvs, face_densities=None,
+                    atlas_size=4096, margin_pixels=8.0, rotate=True):
+    """Repack UV islands into the unit square.  Returns (packed flat float32 UVs, island count, coverage) or None."""
+    lib = load_library()
+    if lib is None:
+        return None
+    face_loop_starts = np.ascontiguousarray(face_loop_starts, dtype=np.int32)
+    face_loop_counts = np.ascontiguousarray(face_loop_counts, dtype=np.int32)
+    loop_vertices = np.ascontiguousarray(loop_vertices, dtype=np.int32)
+    loop_uvs = np.ascontiguousarray(loop_uvs, dtype=np.float32).reshape(-1)
+    if face_loop_starts.size != face_loop_counts.size or loop_uvs.size != loop_vertices.size * 2:
+        return None
+    density_pointer = None
+    if face_densities is not None:
+        face_densities = np.ascontiguousarray(face_densities, dtype=np.float32)
+        if face_densities.size != face_loop_starts.size:
+            return None
+        density_pointer = _float_pointer(face_densities)
+    int_pointer = ctypes.POINTER(ctypes.c_int)
+    packed_uvs = np.empty(loop_uvs.size, dtype=np.float32)
+    coverage = ctypes.c_float(0.0)
+    island_count = lib.dznative_pack_uv_islands(face_loop_starts.ctypes.data_as(int_pointer), face_loop_counts.ctypes.data_as(int_pointer), face_loop_starts.size,
+                                                loop_vertices.ctypes.data_as(int_pointer), _float_pointer(loop_uvs), loop_vertices.size, density_pointer,
+                                                atlas_size, margin_pixels, 1 if rotate else 0, _float_pointer(packed_uvs), ctypes.byref(coverage))
+    if island_count < 0:
+        return None
+    return packed_uvs, island_count, coverage.value
+
+
+def simplify_meshes(meshes):
+    """Build a LOD chain for every mesh with the native quadric simplifier, in parallel.
+
+    Each mesh is a dict with "positions" (xyz per vertex), "wedge_vertices" (vertex of every wedge, the distinct
+    vertex and UV combinations), "triangles" (3 wedges each) and "lod_targets" (triangle counts, largest first),
+    plus optional "materials" (per triangle), "attributes" (per vertex rows, for example skin weights),
+    "attribute_weight", "regions" (per vertex, 0 = none) and "region_ratios" (minimum kept ratio of region 1, 2...).
+    Returns one entry per mesh, None for invalid input or else a list of (triangles (n, 3), source triangles, error)
+    per LOD.  Returns None when the library can not be used.
+    """
+    lib = load_library()
+    if lib is None:
+        return None
+    int_pointer = ctypes.POINTER(ctypes.c_int)
+    native_meshes = (_SimplifyMesh * len(meshes))()
+    keep_alive = []
+    outputs = []
+    for mesh, native_mesh in zip(meshes, native_meshes):
+        positions = np.ascontiguousarray(mesh["positions"], dtype=np.float32).reshape(-1)
+        wedge_vertices = np.ascontiguousarray(mesh["wedge_vertices"], dtype=np.int32).reshape(-1)
+        triangles = np.ascontiguousarray(mesh["triangles"], dtype=np.int32).reshape(-1)
+        lod_targets = np.ascontiguousarray(mesh["lod_targets"], dtype=np.int32).reshape(-1)
+        triangle_count = triangles.size // 3
+        lod_count = lod_targets.size
+        out_triangles = np.empty(lod_count * triangle_count * 3, dtype=np.int32)
+        out_source_triangles = np.empty(lod_count * triangle_count, dtype=np.int32)
+        out_triangle_counts = np.full(lod_count, -1, dtype=np.int32)
+        out_errors = np.zeros(lod_count, dtype=np.float32)
+        keep_alive += [positions, wedge_vertices, triangles, lod_targets]
+        outputs.append((triangle_count, out_triangles, out_source_triangles, out_triangle_counts, out_errors))
+        native_mesh.positions = _float_pointer(positions)
+        native_mesh.vertex_count = positions.size // 3
+        native_mesh.wedge_vertices = wedge_vertices.ctypes.data_as(int_pointer)
+        native_mesh.wedge_count = wedge_vertices.size
+        native_mesh.triangles = triangles.ctypes.data_as(int_pointer)
+        native_mesh.triangle_count = triangle_count
+        native_mesh.lod_targets = lod_targets.ctypes.data_as(int_pointer)
+        native_mesh.lod_count = lod_count
+        native_mesh.out_triangles = out_triangles.ctypes.data_as(int_pointer)
+        native_mesh.out_source_triangles = out_source_triangles.ctypes.data_as(int_pointer)
+        native_mesh.out_triangle_counts = out_triangle_counts.ctypes.data_as(int_pointer)
+        native_mesh.out_errors = _float_pointer(out_errors)
+        if mesh.get("materials") is not None:
+            materials = np.ascontiguousarray(mesh["materials"], dtype=np.int32).reshape(-1)
+            if materials.size != triangle_count:
+                return None
+            keep_alive.append(materials)
+            native_mesh.triangle_materials = materials.ctypes.data_as(int_pointer)
+        if mesh.get("attributes") is not None:
+            attributes = np.ascontiguousarray(mesh["attributes"], dtype=np.float32)
+            if attributes.ndim != 2 or attributes.shape[0] != native_mesh.vertex_count:
+                return None
+            keep_alive.append(attributes)
+            native_mesh.vertex_attributes = _float_pointer(attributes)
+            native_mesh.attribute_count = attributes.shape[1]
+        native_mesh.attribute_weight = mesh.get("attribute_weight", 0.01)
+        if mesh.get("regions") is not None:
+            regions = np.ascontiguousarray(mesh["regions"], dtype=np.int32).reshape(-1)
+            region_ratios = np.ascontiguousarray(mesh.get("region_ratios", []), dtype=np.float32).reshape(-1)
+            if regions.size != native_mesh.vertex_count:
+                return None
+            keep_alive += [regions, region_ratios]
+            native_mesh.vertex_regions = regions.ctypes.data_as(int_pointer)
+            native_mesh.region_ratios = _float_pointer(region_ratios)
+            native_mesh.region_count = region_ratios.size
+    lib.dznative_simplify_meshes(native_meshes, len(meshes))
+    results = []
+    for triangle_count, out_triangles, out_source_triangles, out_triangle_counts, out_errors in outputs:
+        if out_triangle_counts.size > 0 and out_triangle_counts[0] < 0:
+            results.append(None)
+            continue
+        lods = []
+        for lod in range(out_triangle_counts.size):
+            count = out_triangle_counts[lod]
+            start = lod * triangle_count
+            lods.append((out_triangles[start * 3:(start + count) * 3].reshape(-1, 3),
+                         out_source_triangles[start:start + count], float(out_errors[lod])))
+        results.append(lods)
+    return results
+
+
+def find_obscured_faces(positions, face_loop_starts, face_loop_counts, face_normals, loop_vertices, triangle_vertices, triangle_faces,
+                        offset, threshold):
+    """Hidden surface removal of game_readiness_tools.remove_obscured_faces() on a native BVH.  The triangles are the
+    Mesh.loop_triangles vertices and polygon indices.  Returns a bool array with True for every face to remove, or None."""
+    lib = load_library()
+    if lib is None:
+        return None
+    positions = np.ascontiguousarray(positions, dtype=np.float32).reshape(-1)
+    face_loop_starts = np.ascontiguousarray(face_loop_starts, dtype=np.int32)
+    face_loop_counts = np.ascontiguousarray(face_loop_counts, dtype=np.int32)
+    face_normals = np.ascontiguousarray(face_normals, dtype=np.float32).reshape(-1)
+    loop_vertices = np.ascontiguousarray(loop_vertices, dtype=np.int32)
+    triangle_vertices = np.ascontiguousarray(triangle_vertices, dtype=np.int32).reshape(-1)
+    triangle_faces = np.ascontiguousarray(triangle_faces, dtype=np.int32)
+    face_count = face_loop_starts.size
+    if face_loop_counts.size != face_count or face_normals.size != face_count * 3 or triangle_vertices.size != triangle_faces.size * 3:
+        return None
+    int_pointer = ctypes.POINTER(ctypes.c_int)
+    obscured = np.zeros(face_count, dtype=np.uint8)
+    result = lib.dznative_find_obscured_faces(_float_pointer(positions), positions.size // 3, face_loop_starts.ctypes.data_as(int_pointer),
+                                              face_loop_counts.ctypes.data_as(int_pointer), _float_pointer(face_normals), face_count,
+                                              loop_vertices.ctypes.data_as(int_pointer), loop_vertices.size,
+                                              triangle_vertices.ctypes.data_as(int_pointer), triangle_faces.ctypes.data_as(int_pointer), triangle_faces.size,
+                                              offset, threshold, obscured.ctypes.data_as(ctypes.POINTER(ctypes.c_uint8)))
+    if result < 0:
+        return None
+    return obscured.astype(bool)
+
+
+def _get_fit_mesh(mesh, keep_alive):
+    int_pointer = ctypes.POINTER(ctypes.c_int)
+    arrays = {}
+    for key in ["face_loop_starts", "face_loop_counts", "loop_vertices", "triangle_vertices", "triangle_faces", "weight_vertices", "weight_groups"]:
+        arrays[key] = np.ascontiguousarray(mesh[key], dtype=np.int32).reshape(-1)
+    positions = np.ascontiguousarray(mesh["positions"], dtype=np.float32).reshape(-1)
+    weights = np.ascontiguousarray(mesh["weights"], dtype=np.float32).reshape(-1)
+    if (arrays["face_loop_counts"].size != arrays["face_loop_starts"].size or arrays["triangle_vertices"].size != arrays["triangle_faces"].size * 3
+            or arrays["weight_vertices"].size != weights.size or arrays["weight_groups"].size != weights.size):
+        return None
+    keep_alive += list(arrays.values()) + [positions, weights]
+    native_mesh = _FitMesh()
+    native_mesh.positions = _float_pointer(positions)
+    native_mesh.vertex_count = positions.size // 3
+    native_mesh.face_loop_starts = arrays["face_loop_starts"].ctypes.data_as(int_pointer)
+    native_mesh.face_loop_counts = arrays["face_loop_counts"].ctypes.data_as(int_pointer)
+    native_mesh.face_count = arrays["face_loop_starts"].size
+    native_mesh.loop_vertices = arrays["loop_vertices"].ctypes.data_as(int_pointer)
+    native_mesh.loop_count = arrays["loop_vertices"].size
+    native_mesh.triangle_vertices = arrays["triangle_vertices"].ctypes.data_as(int_pointer)
+    native_mesh.triangle_faces = arrays["triangle_faces"].ctypes.data_as(int_pointer)
+    native_mesh.triangle_count = arrays["triangle_faces"].size
+    native_mesh.weight_vertices = arrays["weight_vertices"].ctypes.data_as(int_pointer)
+    native_mesh.weight_groups = arrays["weight_groups"].ctypes.data_as(int_pointer)
+    native_mesh.weights = _float_pointer(weights)
+    native_mesh.weight_count = weights.size
+    return native_mesh
+
+
+def autofit_mesh(source, target, group_count, fit_ratio=1.0, distance_cutoff=10.0, pass1_iterations=200, pass2_iterations=5,
+                 lock_tagged_verts=True, check_self_pokethrough=True):
+    """Clothing auto-fit of game_readiness_tools.autofit_mesh() on native BVH ray casts.
+
+    source (the clothing) and target (the body) are dicts with "positions", "face_loop_starts", "face_loop_counts",
+    "loop_vertices", "triangle_vertices" and "triangle_faces" (Mesh.loop_triangles), and the vertex group weights as
+    "weight_vertices", "weight_groups" and "weights", with group indices below group_count shared by both meshes.
+    Returns (fitted source positions (n, 3), tagged vertices as a bool array, stats dict), or None.
+    """
+    lib = load_library()
+    if lib is None:
+        return None
+    keep_alive = []
+    native_source = _get_fit_mesh(source, keep_alive)
+    native_target = _get_fit_mesh(target, keep_alive)
+    if native_source is None or native_target is None:
+        return None
+    positions = np.empty(native_source.vertex_count * 3, dtype=np.float32)
+    tagged = np.zeros(native_source.vertex_count, dtype=np.uint8)
+    stats = np.zeros(6, dtype=np.int32)
+    result = lib.dznative_autofit_mesh(ctypes.byref(native_source), ctypes.byref(native_target), group_count, fit_ratio, distance_cutoff,
+                                       pass1_iterations, pass2_iterations, 1 if lock_tagged_verts else 0, 1 if check_self_pokethrough else 0,
+                                       _float_pointer(positions), tagged.ctypes.data_as(ctypes.POINTER(ctypes.c_uint8)),
+                                       stats.ctypes.data_as(ctypes.POINTER(ctypes.c_int)))
+    if result < 0:
+        return None
+    stats = {"pass1_iterations": int(stats[0]), "pass2_iterations": int(stats[1]), "flip_reverts": int(stats[2]),
+             "pokethrough_reverts": int(stats[3]), "pass2_faces_moved": int(stats[4]), "aborted": bool(stats[5])}
+    return positions.reshape(-1, 3), tagged.astype(bool), stats
+
+
+def transfer_weights(source_positions, source_triangles, weight_vertices, weight_groups, weights, target_positions,
+                     max_influences=4, min_weight=0.0, max_distance=0.0):
+    """Closest point weight transfer ("Nearest Face Interpolated" of Blender's Data Transfer) on a native BVH.
+
+    The source weights are (vertex, group, weight) entries.  Returns (groups, weights), both (target points, max_influences)
+    with the largest weights first and group -1 for unused entries, or None.  max_distance 0 = no limit.
+    """
+    lib = load_library()
+    if lib is None:
+        return None
+    source_positions = np.ascontiguousarray(source_positions, dtype=np.float32).reshape(-1)
+    source_triangles = np.ascontiguousarray(source_triangles, dtype=np.int32).reshape(-1)
+    weight_vertices = np.ascontiguousarray(weight_vertices, dtype=np.int32).reshape(-1)
+    weight_groups = np.ascontiguousarray(weight_groups, dtype=np.int32).reshape(-1)
+    weights = np.ascontiguousarray(weights, dtype=np.float32).reshape(-1)
+    target_positions = np.ascontiguousarray(target_positions, dtype=np.float32).reshape(-1)
+    if weight_vertices.size != weights.size or weight_groups.size != weights.size or max_influences < 1:
+        return None
+    int_pointer = ctypes.POINTER(ctypes.c_int)
+    target_count = target_positions.size // 3
+    out_groups = np.full(target_count * max_influences, -1, dtype=np.int32)
+    out_weights = np.zeros(target_count * max_influences, dtype=np.float32)
+    result = lib.dznative_transfer_weights(_float_pointer(source_positions), source_positions.size // 3,
+                                           source_triangles.ctypes.data_as(int_pointer), source_triangles.size // 3,
+                                           weight_vertices.ctypes.data_as(int_pointer), weight_groups.ctypes.data_as(int_pointer),
+                                           _float_pointer(weights), weights.size, _float_pointer(target_positions), target_count,
+                                           max_distance, max_influences, min_weight, out_groups.ctypes.data_as(int_pointer),
+                                           _float_pointer(out_weights))
+    if result < 0:
+        return None
+    return out_groups.reshape(-1, max_influences), out_weights.reshape(-1, max_influences)
+
+
+def write_png(path, pixels, width, height, channels=4, alpha=True, compression_level=6):
+    """Write flat float Image.pixels (bottom row first) as an 8-bit PNG with the parallel native encoder.
+
+    Values are rounded like Blender's own float to byte conversion, so the pixels of a byte image are written unchanged.
+    """
+    lib = load_library()
+    if lib is None or channels < 1 or channels > 4:
+        return False
+    pixels = np.ascontiguousarray(pixels, dtype=np.float32).reshape(-1)
+    if pixels.size != width * height * channels:
+        return False
+    result = lib.dznative_write_png_f32(path.encode("utf-8"), _float_pointer(pixels), width, height, channels,
+                                        1 if alpha else 0, compression_level)
+    return result == 0
+
+
+class AtlasBaker:
+    """Native texture atlas baker.  Atlas and texture buffers are flat float32 arrays in the Image.pixels layout.
+
+    Each channel source passed to bake() is None (channel not baked for these triangles) or a dict with
+    either "value" (linear RGBA constant) or "pixels", "width", "height", "channels", plus optional
+    "srgb", "alpha_output", "scale" (UV tiling) and "strength" (normal maps).
+    """
+
+    def __init__(self, lib, width, height, max_samples):
+        self._lib = lib
+        self._handle = lib.dznative_atlas_create(width, height, max_samples)
+        self._width = width
+        self._height = height
+        # the native side keeps pointers to the targets, keep them alive
+        self._targets = {}
+
+    def set_target(self, channel, pixels):
+        if not _is_float_buffer(pixels) or pixels.size != self._width * self._height * 4:
+            return False
+        self._targets[channel] = pixels
+        self._lib.dznative_atlas_set_target(self._handle, channel, _float_pointer(pixels))
+        return True
+
+    def bake(self, source_uvs, atlas_uvs, sources):
+        source_uvs = np.ascontiguousarray(source_uvs, dtype=np.float32)
+        atlas_uvs = np.ascontiguousarray(atlas_uvs, dtype=np.float32)
+        triangle_count = source_uvs.size // 6
+        if triangle_count == 0 or atlas_uvs.size != source_uvs.size:
+            return
+        native_sources = (_AtlasSource * ATLAS_CHANNEL_COUNT)()
+        keep_alive = []
+        for channel in range(ATLAS_CHANNEL_COUNT):
+            source = sources[channel] if channel < len(sources) else None
+            native_source = native_sources[channel]
+            native_source.scale[0] = 1.0
+            native_source.scale[1] = 1.0
+            native_source.strength = 1.0
+            if source is None:
+                continue
+            pixels = source.get("pixels")
+            if pixels is not None:
+                pixels = np.ascontiguousarray(pixels, dtype=np.float32)
+                keep_alive.append(pixels)
+                native_source.pixels = _float_pointer(pixels)
+                native_source.width = source["width"]
+                native_source.height = source["height"]
+                native_source.channels = source.get("channels", 4)
+                native_source.srgb = 1 if source.get("srgb", False) else 0
+                native_source.alpha_output = 1 if source.get("alpha_output", False) else 0
+                scale = source.get("scale", (1.0, 1.0))
+                native_source.scale[0] = scale[0]
+                native_source.scale[1] = scale[1]
+            value = source.get("value", (0.0, 0.0, 0.0, 1.0))
+            for i in range(4):
+                native_source.value[i] = value[i] if i < len(value) else 1.0
+            native_source.strength = source.get("strength", 1.0)
+        self._lib.dznative_atlas_bake(self._handle, _float_pointer(source_uvs), _float_pointer(atlas_uvs), triangle_count, native_sources)
+
+    def dilate(self, margin):
+        self._lib.dznative_atlas_dilate(self._handle, margin)
+
+    def get_covered_pixels(self):
+        return self._lib.dznative_atlas_get_covered_pixels(self._handle)
+
+    def close(self):
+        if self._handle:
+            self._lib.dznative_atlas_destroy(self._handle)
+            self._handle = None
+        self._targets = {}
+
+    def __del__(self):
+        self.close()
+
+
+def create_atlas_baker(width, height, max_samples=4):
+    """Returns an AtlasBaker, or None when the library can not be used."""
+    lib = load_library()
+    if lib is None:
+        return None
+    baker = AtlasBaker(lib, width, height, max_samples)
+    if not baker._handle:
+        return None
+    return baker